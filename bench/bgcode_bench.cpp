@@ -0,0 +1,620 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/benchmark/detail/catch_benchmark_stats.hpp>
+#include <catch2/reporters/catch_reporter_event_listener.hpp>
+#include <catch2/reporters/catch_reporter_registrars.hpp>
+
+#include "convert/convert.hpp"
+#include "convert/catalog.hpp"
+#include "convert/patch.hpp"
+#include "binarize/gcode_stream.hpp"
+
+extern "C" {
+#include <heatshrink/heatshrink_encoder.h>
+#include <heatshrink/heatshrink_decoder.h>
+}
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory_resource>
+#include <new>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace bgcode::core;
+using namespace bgcode::binarize;
+using namespace bgcode::convert;
+
+//
+// Throughput benchmarks of the checksums, of the codecs, of the conversions and of the catalog scan, over the gcode files of tests/data and
+// over a synthetic gcode of 16 MiB. Build with LibBGCode_BUILD_BENCHMARKS=ON, in release, and run:
+// bgcode_bench [--benchmark-samples N] [test name or tag]
+// After the timings of each benchmark, its throughput (MB/s of ascii gcode) and the heap allocations (count and size) of a
+// single run are printed, so that regressions of both are visible. The allocations done through operator new and through
+// the default memory resource are counted, the ones done by zlib with malloc are not.
+//
+
+static std::atomic<size_t> s_allocations_count{ 0 };
+static std::atomic<size_t> s_allocations_size{ 0 };
+
+// Counts the allocations and forwards them to std::pmr::new_delete_resource()
+class CountingResource : public std::pmr::memory_resource
+{
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        ++s_allocations_count;
+        s_allocations_size += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+    void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+static CountingResource s_counting_resource;
+
+void* operator new(std::size_t size)
+{
+    ++s_allocations_count;
+    s_allocations_size += size;
+    if (void* ptr = std::malloc(size != 0 ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+struct Workload
+{
+    // bytes of ascii gcode processed by each run
+    size_t size;
+    size_t allocations_count;
+    size_t allocations_size;
+};
+
+static std::map<std::string, Workload> s_workloads;
+
+// Prints, at the end of each test case, the throughput and the allocations of its benchmarks started by benchmark_throughput()
+class ThroughputListener : public Catch::EventListenerBase
+{
+public:
+    using Catch::EventListenerBase::EventListenerBase;
+
+    void testRunStarting(const Catch::TestRunInfo& info) override {
+        Catch::EventListenerBase::testRunStarting(info);
+        std::pmr::set_default_resource(&s_counting_resource);
+    }
+
+    void benchmarkEnded(const Catch::BenchmarkStats<>& stats) override {
+        Catch::EventListenerBase::benchmarkEnded(stats);
+        const auto it = s_workloads.find(stats.info.name);
+        if (it != s_workloads.end())
+            m_results.emplace_back(stats.info.name, stats.mean.point.count() * 1e-9);
+    }
+
+    void testCaseEnded(const Catch::TestCaseStats& stats) override {
+        Catch::EventListenerBase::testCaseEnded(stats);
+        if (m_results.empty())
+            return;
+        std::cout << "\nThroughput and allocations of a single run:\n";
+        for (const auto& [name, seconds] : m_results) {
+            const Workload& workload = s_workloads[name];
+            std::cout << name << ": " << std::fixed << std::setprecision(1) << (double)workload.size / (seconds * 1e6) << " MB/s, " <<
+                workload.allocations_count << " allocations (" << workload.allocations_size << " bytes)\n";
+        }
+        std::cout.unsetf(std::ios::fixed);
+        std::cout << "\n";
+        m_results.clear();
+    }
+
+private:
+    // name and mean time, in seconds, of the benchmarks of the current test case
+    std::vector<std::pair<std::string, double>> m_results;
+};
+
+CATCH_REGISTER_LISTENER(ThroughputListener)
+
+// Runs fn once, to count its allocations, then benchmarks it. size is the count of bytes of ascii gcode processed by fn.
+template<typename Fn>
+static void benchmark_throughput(const std::string& name, size_t size, Fn&& fn)
+{
+    const size_t allocations_count = s_allocations_count;
+    const size_t allocations_size = s_allocations_size;
+    fn();
+    s_workloads[name] = { size, s_allocations_count - allocations_count, s_allocations_size - allocations_size };
+    BENCHMARK(std::string(name)) {
+        return fn();
+    };
+}
+
+class ScopedFile
+{
+public:
+    explicit ScopedFile(FILE* file) : m_file(file) {}
+    ~ScopedFile() { if (m_file != nullptr) fclose(m_file); }
+private:
+    FILE* m_file{ nullptr };
+};
+
+struct Input
+{
+    std::string name;
+    std::string gcode;
+};
+
+static std::string read_text_file(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    REQUIRE(file.good());
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+// Returns a temporary file containing the given data, to be closed by the caller
+static FILE* data_tmpfile(const std::string& data)
+{
+    FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+    REQUIRE(fwrite(data.data(), 1, data.size(), file) == data.size());
+    rewind(file);
+    return file;
+}
+
+// Returns a gcode of about the given size, with the metadata of the given gcode, required by the conversion to binary, and with
+// its layers replaced by layers of extrusion moves with pseudo random coordinates
+static std::string synthetic_gcode(const std::string& model, size_t size)
+{
+    const size_t layers_begin = model.find(";LAYER_CHANGE\n");
+    const size_t layers_end = model.rfind("; filament used [mm]");
+    REQUIRE(layers_begin != std::string::npos);
+    REQUIRE(layers_end != std::string::npos);
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<double> coordinate(0.0, 250.0);
+    std::uniform_real_distribution<double> extrusion(0.01, 2.0);
+    std::string gcode = model.substr(0, layers_begin);
+    std::array<char, 128> line;
+    for (double z = 0.2; gcode.size() + model.size() - layers_end < size; z += 0.2) {
+        snprintf(line.data(), line.size(), ";LAYER_CHANGE\n;Z:%.1f\nG1 Z%.1f F720\n;TYPE:Solid infill\n", z, z);
+        gcode += line.data();
+        for (size_t i = 0; i < 1000; ++i) {
+            const int length = snprintf(line.data(), line.size(), "G1 X%.3f Y%.3f E%.5f\n", coordinate(generator), coordinate(generator),
+                extrusion(generator));
+            gcode.append(line.data(), (size_t)length);
+        }
+    }
+    gcode += model.substr(layers_end);
+    return gcode;
+}
+
+static const std::vector<Input>& inputs()
+{
+    static const std::vector<Input> ret = [] {
+        std::vector<Input> ret = {
+            { "mini_cube_a", read_text_file(std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode") },
+            { "mini_cube_ps2.8.1", read_text_file(std::string(TEST_DATA_DIR) + "/mini_cube_ps2.8.1.gcode") }
+        };
+        ret.push_back({ "synthetic 16 MiB", synthetic_gcode(ret.front().gcode, size_t(16) << 20) });
+        return ret;
+    }();
+    return ret;
+}
+
+// Splits the given gcode into blocks of whole lines of at most 64 KiB, as the Binarizer does
+static std::vector<GCodeBlock> gcode_blocks(const std::string& gcode, EGCodeEncodingType encoding)
+{
+    static constexpr const size_t MaxBlockSize{ 65536 };
+    std::vector<GCodeBlock> ret;
+    size_t begin = 0;
+    while (begin < gcode.size()) {
+        size_t end = std::min(begin + MaxBlockSize, gcode.size());
+        if (end < gcode.size()) {
+            const size_t last_newline = gcode.rfind('\n', end - 1);
+            end = (last_newline != std::string::npos && last_newline >= begin) ? last_newline + 1 : end;
+        }
+        GCodeBlock& block = ret.emplace_back();
+        block.encoding_type = (uint16_t)encoding;
+        block.raw_data.assign(gcode, begin, end - begin);
+        begin = end;
+    }
+    return ret;
+}
+
+// Returns the given blocks serialized with the given compression and no checksum
+static std::vector<std::pmr::vector<uint8_t>> serialize_blocks(const std::vector<GCodeBlock>& blocks, ECompressionType compression)
+{
+    std::vector<std::pmr::vector<uint8_t>> ret(blocks.size());
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        REQUIRE(blocks[i].write(ret[i], compression, EChecksumType::None) == EResult::Success);
+    }
+    return ret;
+}
+
+// Returns the header of the block serialized into data
+static BlockHeader serialized_block_header(const std::pmr::vector<uint8_t>& data)
+{
+    BlockHeader block_header;
+    std::memcpy(&block_header.type, data.data(), sizeof(block_header.type));
+    std::memcpy(&block_header.compression, data.data() + 2, sizeof(block_header.compression));
+    std::memcpy(&block_header.uncompressed_size, data.data() + 4, sizeof(block_header.uncompressed_size));
+    if ((ECompressionType)block_header.compression != ECompressionType::None)
+        std::memcpy(&block_header.compressed_size, data.data() + 8, sizeof(block_header.compressed_size));
+    return block_header;
+}
+
+// Decodes the payload of each of the given serialized blocks
+static size_t decode_blocks(const std::vector<std::pmr::vector<uint8_t>>& serialized)
+{
+    size_t decoded = 0;
+    for (const std::pmr::vector<uint8_t>& data : serialized) {
+        const BlockHeader block_header = serialized_block_header(data);
+        if (decode_block_payload(block_header, data.data() + block_header.get_size(), block_payload_size(block_header)) == EResult::Success)
+            ++decoded;
+    }
+    return decoded;
+}
+
+static size_t serialized_size(const std::vector<std::pmr::vector<uint8_t>>& serialized)
+{
+    size_t size = 0;
+    for (const std::pmr::vector<uint8_t>& data : serialized) {
+        size += data.size();
+    }
+    return size;
+}
+
+// Compresses data with the heatshrink library
+static std::vector<uint8_t> stock_heatshrink_encode(std::string_view data, uint8_t window_sz)
+{
+    heatshrink_encoder* encoder = heatshrink_encoder_alloc(window_sz, 4);
+    REQUIRE(encoder != nullptr);
+    std::vector<uint8_t> input(data.begin(), data.end());
+    std::vector<uint8_t> ret;
+    std::array<uint8_t, 1024> buffer;
+    size_t sunk = 0;
+    while (sunk < input.size()) {
+        size_t count = 0;
+        REQUIRE(heatshrink_encoder_sink(encoder, input.data() + sunk, input.size() - sunk, &count) == HSER_SINK_OK);
+        sunk += count;
+        HSE_poll_res poll_res;
+        do {
+            poll_res = heatshrink_encoder_poll(encoder, buffer.data(), buffer.size(), &count);
+            REQUIRE(poll_res >= 0);
+            ret.insert(ret.end(), buffer.data(), buffer.data() + count);
+        } while (poll_res == HSER_POLL_MORE);
+    }
+    while (heatshrink_encoder_finish(encoder) == HSER_FINISH_MORE) {
+        size_t count = 0;
+        REQUIRE(heatshrink_encoder_poll(encoder, buffer.data(), buffer.size(), &count) >= 0);
+        ret.insert(ret.end(), buffer.data(), buffer.data() + count);
+    }
+    heatshrink_encoder_free(encoder);
+    return ret;
+}
+
+// Decompresses data with the heatshrink library
+static std::string stock_heatshrink_decode(const std::vector<uint8_t>& data, uint8_t window_sz)
+{
+    heatshrink_decoder* decoder = heatshrink_decoder_alloc(256, window_sz, 4);
+    REQUIRE(decoder != nullptr);
+    std::string ret;
+    std::array<uint8_t, 1024> buffer;
+    size_t sunk = 0;
+    while (sunk < data.size()) {
+        size_t count = 0;
+        REQUIRE(heatshrink_decoder_sink(decoder, const_cast<uint8_t*>(data.data()) + sunk, data.size() - sunk, &count) >= 0);
+        sunk += count;
+        HSD_poll_res poll_res;
+        do {
+            poll_res = heatshrink_decoder_poll(decoder, buffer.data(), buffer.size(), &count);
+            REQUIRE(poll_res >= 0);
+            ret.append(reinterpret_cast<const char*>(buffer.data()), count);
+        } while (poll_res == HSDR_POLL_MORE);
+    }
+    REQUIRE(heatshrink_decoder_finish(decoder) == HSDR_FINISH_DONE);
+    heatshrink_decoder_free(decoder);
+    return ret;
+}
+
+TEST_CASE("Checksums", "[Benchmark]")
+{
+    for (const Input& input : inputs()) {
+        GCodeBlock block;
+        block.raw_data.assign(input.gcode);
+        std::pmr::vector<uint8_t> serialized;
+        for (const auto& [type, name] : { std::make_pair(EChecksumType::None, "no checksum"), std::make_pair(EChecksumType::CRC32, "CRC32"),
+            std::make_pair(EChecksumType::CRC32C, "CRC32C") }) {
+            benchmark_throughput(std::string("Serialization with ") + name + ", " + input.name, input.gcode.size(), [&block, &serialized, type = type]() {
+                block.write(serialized, ECompressionType::None, type);
+                return serialized.size();
+            });
+        }
+    }
+}
+
+TEST_CASE("Compressions", "[Benchmark]")
+{
+    const std::vector<std::pair<ECompressionType, std::string>> compressions = {
+        { ECompressionType::Deflate, "Deflate" }, { ECompressionType::Heatshrink_11_4, "Heatshrink 11/4" },
+        { ECompressionType::Heatshrink_12_4, "Heatshrink 12/4" }, { ECompressionType::DeflateDictionary, "Deflate with dictionary" }
+    };
+    for (const Input& input : inputs()) {
+        const std::vector<GCodeBlock> blocks = gcode_blocks(input.gcode, EGCodeEncodingType::None);
+        for (const auto& [compression, name] : compressions) {
+            std::vector<std::pmr::vector<uint8_t>> serialized(blocks.size());
+            benchmark_throughput(name + " compression, " + input.name, input.gcode.size(), [&blocks, &serialized, compression = compression]() {
+                for (size_t i = 0; i < blocks.size(); ++i) {
+                    blocks[i].write(serialized[i], compression, EChecksumType::None);
+                }
+                return serialized.size();
+            });
+            std::cout << name << ", " << input.name << ": " << input.gcode.size() << " -> " << serialized_size(serialized) << " bytes\n";
+            REQUIRE(decode_blocks(serialized) == serialized.size());
+            benchmark_throughput(name + " uncompression, " + input.name, input.gcode.size(), [&serialized]() {
+                return decode_blocks(serialized);
+            });
+        }
+    }
+}
+
+TEST_CASE("Heatshrink library", "[Benchmark]")
+{
+    // the heatshrink library on the same blocks, to compare with the Heatshrink 12/4 codec of the Compressions benchmarks.
+    // Its encoder is too slow for the synthetic gcode.
+    for (const Input& input : inputs()) {
+        if (input.gcode.size() > (size_t(1) << 20))
+            continue;
+        const std::vector<GCodeBlock> blocks = gcode_blocks(input.gcode, EGCodeEncodingType::None);
+        std::vector<std::vector<uint8_t>> compressed(blocks.size());
+        benchmark_throughput("Heatshrink library 12/4 compression, " + input.name, input.gcode.size(), [&blocks, &compressed]() {
+            for (size_t i = 0; i < blocks.size(); ++i) {
+                compressed[i] = stock_heatshrink_encode(blocks[i].raw_data, 12);
+            }
+            return compressed.size();
+        });
+        benchmark_throughput("Heatshrink library 12/4 uncompression, " + input.name, input.gcode.size(), [&compressed]() {
+            size_t size = 0;
+            for (const std::vector<uint8_t>& data : compressed) {
+                size += stock_heatshrink_decode(data, 12).size();
+            }
+            return size;
+        });
+    }
+}
+
+TEST_CASE("GCode encodings", "[Benchmark]")
+{
+    const std::vector<std::pair<EGCodeEncodingType, std::string>> encodings = {
+        { EGCodeEncodingType::MeatPack, "MeatPack" }, { EGCodeEncodingType::MeatPackComments, "MeatPack with comments" },
+        { EGCodeEncodingType::Tokenized, "Tokenized" }
+    };
+    for (const Input& input : inputs()) {
+        for (const auto& [encoding, name] : encodings) {
+            const std::vector<GCodeBlock> blocks = gcode_blocks(input.gcode, encoding);
+            std::vector<std::pmr::vector<uint8_t>> serialized(blocks.size());
+            benchmark_throughput(name + " encoding, " + input.name, input.gcode.size(), [&blocks, &serialized]() {
+                for (size_t i = 0; i < blocks.size(); ++i) {
+                    blocks[i].write(serialized[i], ECompressionType::None, EChecksumType::None);
+                }
+                return serialized.size();
+            });
+            REQUIRE(decode_blocks(serialized) == serialized.size());
+            benchmark_throughput(name + " decoding, " + input.name, input.gcode.size(), [&serialized]() {
+                return decode_blocks(serialized);
+            });
+        }
+    }
+}
+
+TEST_CASE("Line splitting", "[Benchmark]")
+{
+    // lines emitted by GCodeStreamDecoder, as read by the firmware. The line reader of the ascii to binary conversion is
+    // internal to convert.cpp, its throughput is part of the Ascii to binary benchmarks of the Conversions test case.
+    for (const Input& input : inputs()) {
+        for (const auto& [encoding, name] : { std::make_pair(EGCodeEncodingType::None, "no encoding"),
+            std::make_pair(EGCodeEncodingType::MeatPackComments, "MeatPack with comments") }) {
+            const std::vector<std::pmr::vector<uint8_t>> serialized = serialize_blocks(gcode_blocks(input.gcode, encoding),
+                ECompressionType::None);
+            benchmark_throughput(std::string("Line splitting, ") + name + ", " + input.name, input.gcode.size(), [&serialized]() {
+                std::array<char, 4096> line_buffer;
+                size_t lines_count = 0;
+                GCodeStreamDecoder decoder(nullptr, 0, line_buffer.data(), line_buffer.size(),
+                    [](void* user_data, const char*, size_t) { ++*static_cast<size_t*>(user_data); }, &lines_count);
+                for (const std::pmr::vector<uint8_t>& data : serialized) {
+                    const BlockHeader block_header = serialized_block_header(data);
+                    if (decoder.reset(block_header, EChecksumType::None) != EResult::Success ||
+                        decoder.push(data.data() + block_header.get_size(), data.size() - block_header.get_size()) != EResult::Success ||
+                        decoder.finish() != EResult::Success)
+                        return size_t(0);
+                }
+                return lines_count;
+            });
+        }
+    }
+}
+
+TEST_CASE("Conversions", "[Benchmark]")
+{
+    BinarizerConfig slicer_config;
+    slicer_config.compression.file_metadata = ECompressionType::None;
+    slicer_config.compression.print_metadata = ECompressionType::None;
+    slicer_config.compression.printer_metadata = ECompressionType::None;
+    slicer_config.compression.slicer_metadata = ECompressionType::Deflate;
+    slicer_config.compression.gcode = ECompressionType::Heatshrink_12_4;
+    slicer_config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+    const std::vector<std::pair<BinarizerConfig, std::string>> configs = {
+        { BinarizerConfig(), "default config" }, { slicer_config, "Heatshrink 12/4 and MeatPack with comments" }
+    };
+
+    for (const Input& input : inputs()) {
+        FILE* ascii_file = data_tmpfile(input.gcode);
+        ScopedFile scoped_ascii_file(ascii_file);
+        for (const auto& [config, name] : configs) {
+            benchmark_throughput("Ascii to binary, " + name + ", " + input.name, input.gcode.size(), [ascii_file, &config = config]() {
+                rewind(ascii_file);
+                return from_ascii_to_binary(*ascii_file, [](const std::byte*, size_t) { return true; }, config);
+            });
+
+            FILE* binary_file = std::tmpfile();
+            REQUIRE(binary_file != nullptr);
+            ScopedFile scoped_binary_file(binary_file);
+            rewind(ascii_file);
+            REQUIRE(from_ascii_to_binary(*ascii_file, *binary_file, config) == EResult::Success);
+            FILE* dst_file = std::tmpfile();
+            REQUIRE(dst_file != nullptr);
+            ScopedFile scoped_dst_file(dst_file);
+            benchmark_throughput("Binary to ascii, " + name + ", " + input.name, input.gcode.size(), [binary_file, dst_file]() {
+                rewind(binary_file);
+                rewind(dst_file);
+                return from_binary_to_ascii(*binary_file, *dst_file, true);
+            });
+        }
+    }
+}
+
+// Converts the given ascii file to binary into dst_file, returns the statistics of the conversion
+static BinarizerStatistics convert_to_tmpfile(FILE& ascii_file, FILE& dst_file, const BinarizerConfig& config)
+{
+    rewind(&ascii_file);
+    rewind(&dst_file);
+    BinarizerStatistics statistics;
+    REQUIRE(from_ascii_to_binary(ascii_file, dst_file, config, statistics) == EResult::Success);
+    return statistics;
+}
+
+TEST_CASE("Deflate parameters", "[Benchmark]")
+{
+    BinarizerConfig config;
+    config.compression.gcode = ECompressionType::Deflate;
+    config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+    const std::vector<std::pair<EDeflateStrategy, std::string>> strategies = {
+        { EDeflateStrategy::Default, "Default" }, { EDeflateStrategy::Filtered, "Filtered" }, { EDeflateStrategy::RLE, "RLE" }
+    };
+
+    // size of the gcode blocks and time of the conversion for the fastest, the default and the smallest levels, for each strategy
+    for (const Input& input : inputs()) {
+        FILE* ascii_file = data_tmpfile(input.gcode);
+        ScopedFile scoped_ascii_file(ascii_file);
+        FILE* binary_file = std::tmpfile();
+        REQUIRE(binary_file != nullptr);
+        ScopedFile scoped_binary_file(binary_file);
+        for (const auto& [strategy, strategy_name] : strategies) {
+            for (uint8_t level : { 1, 6, 9 }) {
+                config.deflate.gcode.level = level;
+                config.deflate.gcode.strategy = strategy;
+                const std::string name = "Deflate level " + std::to_string(level) + ", " + strategy_name + ", " + input.name;
+                std::cout << name << ": " << convert_to_tmpfile(*ascii_file, *binary_file, config).gcode_blocks_size << " bytes\n";
+                benchmark_throughput(name, input.gcode.size(), [ascii_file, config]() {
+                    rewind(ascii_file);
+                    return from_ascii_to_binary(*ascii_file, [](const std::byte*, size_t) { return true; }, config);
+                });
+            }
+        }
+    }
+}
+
+TEST_CASE("Content defined blocks", "[Benchmark]")
+{
+    BinarizerConfig config;
+    config.compression.gcode = ECompressionType::Deflate;
+    config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+    const std::vector<std::tuple<bool, uint32_t, std::string>> policies = {
+        { false, 0, "Fixed size" }, { true, 7, "Content defined, 7 bits" }, { true, 9, "Content defined, 9 bits" },
+        { true, 11, "Content defined, 11 bits" }
+    };
+
+    // size, blocks reused after a small change and time of the conversion for each block boundaries policy
+    for (const Input& input : inputs()) {
+        // a few lines inserted at about a quarter of the gcode, as sliced again after a small change
+        std::string modified_gcode = input.gcode;
+        modified_gcode.insert(modified_gcode.find('\n', modified_gcode.size() / 4) + 1, "; modified\nG1 X10 Y10 F600\n");
+        FILE* ascii_file = data_tmpfile(input.gcode);
+        ScopedFile scoped_ascii_file(ascii_file);
+        FILE* modified_ascii_file = data_tmpfile(modified_gcode);
+        ScopedFile scoped_modified_ascii_file(modified_ascii_file);
+        for (const auto& [content_defined, bits, policy_name] : policies) {
+            config.content_defined_blocks = content_defined;
+            config.content_boundary_bits = bits;
+            FILE* binary_file = std::tmpfile();
+            REQUIRE(binary_file != nullptr);
+            ScopedFile scoped_binary_file(binary_file);
+            FILE* modified_binary_file = std::tmpfile();
+            REQUIRE(modified_binary_file != nullptr);
+            ScopedFile scoped_modified_binary_file(modified_binary_file);
+            FILE* patch_file = std::tmpfile();
+            REQUIRE(patch_file != nullptr);
+            ScopedFile scoped_patch_file(patch_file);
+            const BinarizerStatistics statistics = convert_to_tmpfile(*ascii_file, *binary_file, config);
+            convert_to_tmpfile(*modified_ascii_file, *modified_binary_file, config);
+            rewind(binary_file);
+            rewind(modified_binary_file);
+            PatchStatistics patch_statistics;
+            REQUIRE(diff_binary_gcode(*binary_file, *modified_binary_file, *patch_file, &patch_statistics) == EResult::Success);
+            size_t blocks_count = 0;
+            for (uint32_t count : statistics.gcode_blocks) {
+                blocks_count += count;
+            }
+
+            const std::string name = policy_name + ", " + input.name;
+            std::cout << name << ": " << statistics.gcode_blocks_size << " bytes, " << blocks_count << " gcode blocks, " <<
+                patch_statistics.copied_blocks << " of " << patch_statistics.copied_blocks + patch_statistics.inserted_blocks <<
+                " blocks reused after the change\n";
+            benchmark_throughput(name, input.gcode.size(), [ascii_file, config]() {
+                rewind(ascii_file);
+                return from_ascii_to_binary(*ascii_file, [](const std::byte*, size_t) { return true; }, config);
+            });
+        }
+    }
+}
+
+TEST_CASE("Catalog scan", "[Benchmark]")
+{
+    namespace fs = std::filesystem;
+
+    // 500 copies of the binary conversion of each of the test files, not of the synthetic gcode, half of them into a subdirectory
+    const fs::path dir = fs::temp_directory_path() / "bgcode_bench_catalog";
+    fs::remove_all(dir);
+    fs::create_directories(dir / "sub");
+    for (size_t i = 0; i < inputs().size(); ++i) {
+        if (inputs()[i].gcode.size() > (size_t(1) << 20))
+            continue;
+        FILE* ascii_file = data_tmpfile(inputs()[i].gcode);
+        ScopedFile scoped_ascii_file(ascii_file);
+        const fs::path filename = dir / ("input_" + std::to_string(i) + ".bgcode");
+        FILE* binary_file = std::fopen(filename.string().c_str(), "wb");
+        REQUIRE(binary_file != nullptr);
+        REQUIRE(from_ascii_to_binary(*ascii_file, *binary_file, BinarizerConfig()) == EResult::Success);
+        fclose(binary_file);
+        for (size_t j = 0; j < 500; ++j) {
+            fs::copy_file(filename, dir / (j % 2 == 0 ? fs::path() : fs::path("sub")) / ("input_" + std::to_string(i) + "_" +
+                std::to_string(j) + ".bgcode"));
+        }
+        fs::remove(filename);
+    }
+
+    const CatalogConfig config;
+    Catalog warm_catalog;
+    REQUIRE(warm_catalog.scan(dir.string(), config) == EResult::Success);
+
+    BENCHMARK("Cold scan") {
+        Catalog catalog;
+        return catalog.scan(dir.string(), config);
+    };
+
+    BENCHMARK("Warm scan") {
+        return warm_catalog.scan(dir.string(), config);
+    };
+
+    fs::remove_all(dir);
+}
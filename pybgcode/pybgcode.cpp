@@ -1,12 +1,18 @@
 #include <cstdio>
 #include <cerrno>
 #include <cstring>
+#include <optional>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
 #include <boost/nowide/cstdio.hpp>
 
 #include "convert/convert.hpp"
+#include "convert/appender.hpp"
+#include "convert/catalog.hpp"
+#include "convert/metadata_editor.hpp"
+#include "convert/patch.hpp"
+#include "convert/validator.hpp"
 
 namespace py = pybind11;
 
@@ -65,6 +71,7 @@ PYBIND11_MODULE(MODULE_NAME, m) {
            translate_result
            is_valid_binary_gcode
            read_header
+           read_summary
            get_config
            from_ascii_to_binary
            from_binary_to_ascii
@@ -157,29 +164,46 @@ PYBIND11_MODULE(MODULE_NAME, m) {
         .value("MissingPrinterMetadata", core::EResult::MissingPrinterMetadata)
         .value("MissingPrintMetadata", core::EResult::MissingPrintMetadata)
         .value("MissingSlicerMetadat", core::EResult::MissingSlicerMetadata)
+        .value("InvalidIndex", core::EResult::InvalidIndex)
+        .value("InvalidHashTree", core::EResult::InvalidHashTree)
         ;
 
     py::enum_<core::ECompressionType>(m, "CompressionType")
         .value("none", core::ECompressionType::None)
         .value("Deflate", core::ECompressionType::Deflate)
         .value("Heatshrink_11_4", core::ECompressionType::Heatshrink_11_4)
-        .value("Heatshrink_12_4", core::ECompressionType::Heatshrink_12_4);
+        .value("Heatshrink_12_4", core::ECompressionType::Heatshrink_12_4)
+        .value("DeflateDictionary", core::ECompressionType::DeflateDictionary);
     py::enum_<core::EGCodeEncodingType>(m, "GCodeEncodingType")
         .value("none", core::EGCodeEncodingType::None)
         .value("MeatPack", core::EGCodeEncodingType::MeatPack)
-        .value("MeatPackComments", core::EGCodeEncodingType::MeatPackComments);
+        .value("MeatPackComments", core::EGCodeEncodingType::MeatPackComments)
+        .value("Tokenized", core::EGCodeEncodingType::Tokenized)
+        .value("Columnar", core::EGCodeEncodingType::Columnar);
     py::enum_<core::EMetadataEncodingType>(m, "MetadataEncodingType")
         .value("INI", core::EMetadataEncodingType::INI);
     py::enum_<core::EChecksumType>(m, "ChecksumType")
         .value("none", core::EChecksumType::None)
-        .value("CRC32", core::EChecksumType::CRC32);
+        .value("CRC32", core::EChecksumType::CRC32)
+        .value("CRC32C", core::EChecksumType::CRC32C);
+    py::enum_<binarize::EAutoCompression>(m, "AutoCompression")
+        .value("Disabled", binarize::EAutoCompression::Disabled)
+        .value("Smallest", binarize::EAutoCompression::Smallest)
+        .value("FastestDecoding", binarize::EAutoCompression::FastestDecoding);
+
+    py::enum_<binarize::EDeflateStrategy>(m, "DeflateStrategy")
+        .value("Default", binarize::EDeflateStrategy::Default)
+        .value("Filtered", binarize::EDeflateStrategy::Filtered)
+        .value("RLE", binarize::EDeflateStrategy::RLE);
     py::enum_<core::EBlockType>(m, "EBlockType")
         .value("FileMetadata", core::EBlockType::FileMetadata)
         .value("GCode", core::EBlockType::GCode)
         .value("SlicerMetadata", core::EBlockType::SlicerMetadata)
         .value("PrinterMetadata", core::EBlockType::PrinterMetadata)
         .value("PrintMetadata", core::EBlockType::PrintMetadata)
-        .value("Thumbnail", core::EBlockType::Thumbnail);
+        .value("Thumbnail", core::EBlockType::Thumbnail)
+        .value("Index", core::EBlockType::Index)
+        .value("HashTree", core::EBlockType::HashTree);
     py::enum_<core::EThumbnailFormat>(m, "EThumbnailFormat")
         .value("PNG", core::EThumbnailFormat::PNG)
         .value("JPG", core::EThumbnailFormat::JPG)
@@ -302,6 +326,28 @@ PYBIND11_MODULE(MODULE_NAME, m) {
         )pbdoc",
         py::arg("file"), py::arg("file_header"), py::arg("block_header"), py::arg("block_type"));
 
+    py::class_<core::GCodeBlockIndexEntry>(m, "GCodeBlockIndexEntry")
+        .def(py::init<>())
+        .def_readonly("position", &core::GCodeBlockIndexEntry::position)
+        .def_readonly("first_line", &core::GCodeBlockIndexEntry::first_line)
+        .def_readonly("data_offset", &core::GCodeBlockIndexEntry::data_offset);
+
+    m.def(
+        "read_gcode_block_index",
+        [](FILEWrapper &file, const core::FileHeader &file_header) {
+            std::array<std::byte, MaxBuffSz> buff;
+            core::GCodeBlockIndex index;
+            const core::EResult res = core::read_gcode_block_index(*file.fptr, file_header, index, buff.data(), buff.size());
+            return std::make_pair(res, std::vector<core::GCodeBlockIndexEntry>(index.begin(), index.end()));
+        },
+        R"pbdoc(
+            Searches and reads the index block from the current file position, stopping at the first gcode block.
+            File position must be at the start of a block header.
+            Returns (result, entries), result is EResult.BlockNotFound if the file has no index block.
+        )pbdoc",
+        py::arg("file"), py::arg("file_header")
+    );
+
     m.def(
         "verify_block_checksum",
         [](FILEWrapper& file, const core::FileHeader& file_header, const core::BlockHeader& block_header){
@@ -486,6 +532,24 @@ PYBIND11_MODULE(MODULE_NAME, m) {
             return binarize::peek_slicer_metadata_block(*file.fptr, block_header);
         });
 
+    py::class_<binarize::FileSummary>(m, "FileSummary")
+        .def(py::init<>())
+        .def_readonly("file_header", &binarize::FileSummary::file_header)
+        .def_readonly("file_metadata", &binarize::FileSummary::file_metadata)
+        .def_readonly("printer_metadata", &binarize::FileSummary::printer_metadata)
+        .def_readonly("thumbnails", &binarize::FileSummary::thumbnails)
+        .def_readonly("print_metadata", &binarize::FileSummary::print_metadata)
+        .def_readonly("gcode_position", &binarize::FileSummary::gcode_position);
+
+    m.def("read_summary", [](FILEWrapper& file, bool verify_checksum, bool read_thumbnails) {
+            binarize::FileSummary summary;
+            const core::EResult res = binarize::read_summary(*file.fptr, summary, verify_checksum, read_thumbnails);
+            return std::make_pair(res, summary);
+        },
+        R"pbdoc(Read the metadata and the thumbnails stored in front of the gcode blocks, returns (result, summary))pbdoc",
+        py::arg("file"), py::arg("verify_checksum") = false, py::arg("read_thumbnails") = true
+    );
+
     py::class_<binarize::BinarizerConfig::Compression>(m, "BinarizerCompression")
         .def(py::init<>())
         .def_readwrite("file_metadata", &binarize::BinarizerConfig::Compression::file_metadata)
@@ -494,12 +558,72 @@ PYBIND11_MODULE(MODULE_NAME, m) {
         .def_readwrite("slicer_metadata", &binarize::BinarizerConfig::Compression::slicer_metadata)
         .def_readwrite("gcode", &binarize::BinarizerConfig::Compression::gcode);
 
+    py::class_<binarize::DeflateParameters>(m, "DeflateParameters")
+        .def(py::init<>())
+        .def_readwrite("level", &binarize::DeflateParameters::level)
+        .def_readwrite("strategy", &binarize::DeflateParameters::strategy)
+        .def_readwrite("mem_level", &binarize::DeflateParameters::mem_level);
+
+    py::class_<binarize::BinarizerConfig::Deflate>(m, "BinarizerDeflate")
+        .def(py::init<>())
+        .def_readwrite("metadata", &binarize::BinarizerConfig::Deflate::metadata)
+        .def_readwrite("gcode", &binarize::BinarizerConfig::Deflate::gcode);
+
     py::class_<binarize::BinarizerConfig>(m, "BinarizerConfig")
         .def(py::init<>())
         .def_readwrite("compression", &binarize::BinarizerConfig::compression)
         .def_readwrite("gcode_encoding", &binarize::BinarizerConfig::gcode_encoding)
         .def_readwrite("metadata_encoding", &binarize::BinarizerConfig::metadata_encoding)
-        .def_readwrite("checksum", &binarize::BinarizerConfig::checksum);
+        .def_readwrite("checksum", &binarize::BinarizerConfig::checksum)
+        .def_readwrite("layer_aligned_blocks", &binarize::BinarizerConfig::layer_aligned_blocks)
+        .def_readwrite("min_layer_block_size", &binarize::BinarizerConfig::min_layer_block_size)
+        .def_readwrite("content_defined_blocks", &binarize::BinarizerConfig::content_defined_blocks)
+        .def_readwrite("min_content_block_size", &binarize::BinarizerConfig::min_content_block_size)
+        .def_readwrite("max_content_block_size", &binarize::BinarizerConfig::max_content_block_size)
+        .def_readwrite("content_boundary_bits", &binarize::BinarizerConfig::content_boundary_bits)
+        .def_readwrite("index_block", &binarize::BinarizerConfig::index_block)
+        .def_readwrite("hash_tree_block", &binarize::BinarizerConfig::hash_tree_block)
+        .def_readwrite("auto_gcode_compression", &binarize::BinarizerConfig::auto_gcode_compression)
+        .def_readwrite("auto_compression_candidates", &binarize::BinarizerConfig::auto_compression_candidates)
+        .def_readwrite("auto_compression_tolerance", &binarize::BinarizerConfig::auto_compression_tolerance)
+        .def_readwrite("deflate", &binarize::BinarizerConfig::deflate);
+
+    py::class_<binarize::BinarizerStatistics>(m, "BinarizerStatistics")
+        .def(py::init<>())
+        .def_readonly("gcode_blocks", &binarize::BinarizerStatistics::gcode_blocks)
+        .def_readonly("gcode_size", &binarize::BinarizerStatistics::gcode_size)
+        .def_readonly("gcode_blocks_size", &binarize::BinarizerStatistics::gcode_blocks_size);
+
+    py::class_<binarize::LayerIndexEntry>(m, "LayerIndexEntry")
+        .def(py::init<>())
+        .def_readwrite("z", &binarize::LayerIndexEntry::z)
+        .def_readwrite("block_position", &binarize::LayerIndexEntry::block_position)
+        .def_readwrite("data_offset", &binarize::LayerIndexEntry::data_offset);
+
+    m.def("read_layer_index", [](FILEWrapper &file) {
+            binarize::LayerIndex index;
+            const core::EResult res = binarize::read_layer_index(*file.fptr, index);
+            return std::make_pair(res, std::vector<binarize::LayerIndexEntry>(index.begin(), index.end()));
+        },
+        R"pbdoc(Read a layer index sidecar file, returns (result, entries))pbdoc",
+        py::arg("file")
+    );
+
+    m.def("write_layer_index", [](FILEWrapper &file, const std::vector<binarize::LayerIndexEntry> &entries) {
+            return binarize::write_layer_index(*file.fptr, binarize::LayerIndex(entries.begin(), entries.end()));
+        },
+        R"pbdoc(Write a layer index sidecar file)pbdoc",
+        py::arg("file"), py::arg("entries")
+    );
+
+    m.def("read_layer_gcode", [](FILEWrapper &file, const std::vector<binarize::LayerIndexEntry> &entries, size_t layer) {
+            std::pmr::string gcode;
+            const core::EResult res = binarize::read_layer_gcode(*file.fptr, binarize::LayerIndex(entries.begin(), entries.end()), layer, gcode);
+            return std::make_pair(res, std::string(gcode));
+        },
+        R"pbdoc(Decode the gcode of the given layer, decoding only the blocks containing it, returns (result, gcode))pbdoc",
+        py::arg("file"), py::arg("entries"), py::arg("layer")
+    );
 
     py::class_<binarize::BinaryData>(m, "BinaryData")
         .def(py::init<>())
@@ -526,7 +650,8 @@ PYBIND11_MODULE(MODULE_NAME, m) {
             return self.initialize(*file.fptr, config);
         })
         .def("append_gcode", &binarize::Binarizer::append_gcode)
-        .def("finalize", &binarize::Binarizer::finalize);
+        .def("finalize", &binarize::Binarizer::finalize)
+        .def("get_statistics", &binarize::Binarizer::get_statistics);
 
     // Convert API:
 
@@ -539,6 +664,15 @@ PYBIND11_MODULE(MODULE_NAME, m) {
         py::arg("infile"), py::arg("outfile"), py::arg("config") = get_config()
     );
 
+    m.def("from_ascii_to_binary_with_layer_index", [](FILEWrapper &infile, FILEWrapper &outfile, const binarize::BinarizerConfig &config) {
+            binarize::LayerIndex index;
+            const core::EResult res = convert::from_ascii_to_binary(*infile.fptr, *outfile.fptr, config, index);
+            return std::make_pair(res, std::vector<binarize::LayerIndexEntry>(index.begin(), index.end()));
+        },
+        R"pbdoc(Convert ascii gcode to binary format, returns (result, layer index entries))pbdoc",
+        py::arg("infile"), py::arg("outfile"), py::arg("config") = get_config()
+    );
+
     m.def("from_binary_to_ascii", [] (FILEWrapper &infile, FILEWrapper &outfile, bool verify_checksum) {
             return convert::from_binary_to_ascii(*infile.fptr, *outfile.fptr, verify_checksum);
         },
@@ -546,6 +680,192 @@ PYBIND11_MODULE(MODULE_NAME, m) {
         py::arg("infile"), py::arg("outfile"), py::arg("verify_checksum") = true
     );
 
+    m.def("transcode", [] (FILEWrapper &infile, FILEWrapper &outfile, const binarize::BinarizerConfig &config, size_t jobs) {
+            py::gil_scoped_release release;
+            return convert::transcode(*infile.fptr, *outfile.fptr, config, jobs);
+        },
+        R"pbdoc(Rewrite binary gcode with a different compression, encoding or checksum)pbdoc",
+        py::arg("infile"), py::arg("outfile"), py::arg("config") = get_config(), py::arg("jobs") = 0
+    );
+
+    m.def("concatenate", [] (const std::vector<FILEWrapper*> &infiles, FILEWrapper &outfile) {
+            std::vector<FILE*> src_files;
+            for (FILEWrapper *infile : infiles)
+                src_files.emplace_back(infile->fptr);
+            return convert::concatenate(src_files, *outfile.fptr);
+        },
+        R"pbdoc(Merge the gcode blocks of the given binary gcode files under the metadata of the first one)pbdoc",
+        py::arg("infiles"), py::arg("outfile")
+    );
+
+    m.def("count_gcode_blocks", [] (FILEWrapper &file) {
+            size_t count = 0;
+            const core::EResult res = convert::count_gcode_blocks(*file.fptr, count);
+            return std::make_pair(res, count);
+        },
+        R"pbdoc(Count the gcode blocks of a binary gcode file, returns (result, count))pbdoc",
+        py::arg("file")
+    );
+
+    m.def("extract_gcode_blocks", [] (FILEWrapper &infile, FILEWrapper &outfile, size_t first_block, size_t blocks_count) {
+            return convert::extract_gcode_blocks(*infile.fptr, *outfile.fptr, first_block, blocks_count);
+        },
+        R"pbdoc(Save the metadata and the given range of gcode blocks of a binary gcode file)pbdoc",
+        py::arg("infile"), py::arg("outfile"), py::arg("first_block"), py::arg("blocks_count")
+    );
+
+    m.def("verify_blocks", [] (FILEWrapper &file, size_t first_block, size_t blocks_count, size_t jobs, std::optional<uint32_t> expected_root) {
+            // the verification runs on worker threads, it does not need the GIL
+            py::gil_scoped_release release;
+            return convert::verify_blocks(*file.fptr, first_block, blocks_count, jobs, expected_root.has_value() ? &*expected_root : nullptr);
+        },
+        R"pbdoc(Verify the metadata and the given range of gcode blocks of a binary gcode file against its hash tree block, and the hash tree against expected_root, if given)pbdoc",
+        py::arg("file"), py::arg("first_block") = 0, py::arg("blocks_count") = SIZE_MAX, py::arg("jobs") = 0,
+        py::arg("expected_root") = py::none()
+    );
+
+    // Validator API:
+
+    py::class_<convert::BlockReport>(m, "BlockReport")
+        .def(py::init<>())
+        .def_readonly("offset", &convert::BlockReport::offset)
+        .def_readonly("type", &convert::BlockReport::type)
+        .def_readonly("compression", &convert::BlockReport::compression)
+        .def_readonly("encoding", &convert::BlockReport::encoding)
+        .def_readonly("uncompressed_size", &convert::BlockReport::uncompressed_size)
+        .def_readonly("compressed_size", &convert::BlockReport::compressed_size)
+        .def_readonly("checksum", &convert::BlockReport::checksum)
+        .def_readonly("decoding", &convert::BlockReport::decoding);
+
+    py::class_<convert::ValidationReport>(m, "ValidationReport")
+        .def(py::init<>())
+        .def_readonly("result", &convert::ValidationReport::result)
+        .def_readonly("checksum_type", &convert::ValidationReport::checksum_type)
+        .def_readonly("blocks", &convert::ValidationReport::blocks);
+
+    m.def("validate_binary_gcode", [] (FILEWrapper &file, size_t jobs, bool decode_blocks) {
+            convert::ValidationReport report;
+            {
+                // the validation runs on worker threads, it does not need the GIL
+                py::gil_scoped_release release;
+                convert::validate_binary_gcode(*file.fptr, report, jobs, decode_blocks);
+            }
+            return report;
+        },
+        R"pbdoc(Validate the structure, the checksums and the payloads of all the blocks of a binary gcode file, returns a ValidationReport)pbdoc",
+        py::arg("file"), py::arg("jobs") = 0, py::arg("decode_blocks") = true
+    );
+
+    // Catalog API:
+
+    py::class_<convert::CatalogEntry>(m, "CatalogEntry")
+        .def(py::init<>())
+        .def_readonly("path", &convert::CatalogEntry::path)
+        .def_readonly("file_size", &convert::CatalogEntry::file_size)
+        .def_readonly("mtime", &convert::CatalogEntry::mtime)
+        .def_readonly("header_crc", &convert::CatalogEntry::header_crc)
+        .def_readonly("checksum_verified", &convert::CatalogEntry::checksum_verified)
+        .def_readonly("result", &convert::CatalogEntry::result)
+        .def_readonly("printer_metadata", &convert::CatalogEntry::printer_metadata)
+        .def_readonly("print_metadata", &convert::CatalogEntry::print_metadata)
+        .def_readonly("thumbnail", &convert::CatalogEntry::thumbnail)
+        .def_readonly("thumbnail_position", &convert::CatalogEntry::thumbnail_position)
+        .def_readonly("gcode_position", &convert::CatalogEntry::gcode_position);
+
+    py::class_<convert::CatalogConfig>(m, "CatalogConfig")
+        .def(py::init<>())
+        .def_readwrite("jobs", &convert::CatalogConfig::jobs)
+        .def_readwrite("recursive", &convert::CatalogConfig::recursive)
+        .def_readwrite("verify_checksum", &convert::CatalogConfig::verify_checksum)
+        .def_readwrite("thumbnail_format", &convert::CatalogConfig::thumbnail_format);
+
+    py::class_<convert::Catalog>(m, "Catalog")
+        .def(py::init<>())
+        .def("load", &convert::Catalog::load, R"pbdoc(Load the entries from the given cache file)pbdoc", py::arg("cache_path"))
+        .def("save", &convert::Catalog::save, R"pbdoc(Save the entries into the given cache file)pbdoc", py::arg("cache_path"))
+        .def("scan", [](convert::Catalog &self, const std::string &directory, const convert::CatalogConfig &config) {
+                size_t rescanned_count = 0;
+                // the scan runs on worker threads, it does not need the GIL
+                py::gil_scoped_release release;
+                const core::EResult res = self.scan(directory, config, &rescanned_count);
+                return std::make_pair(res, rescanned_count);
+            }, R"pbdoc(Scan the given directory, reading only new and modified files, returns (result, rescanned_count))pbdoc",
+            py::arg("directory"), py::arg("config") = convert::CatalogConfig())
+        .def("get_entries", &convert::Catalog::get_entries)
+        .def("clear", &convert::Catalog::clear);
+
+    // Metadata editor API:
+
+    py::class_<convert::MetadataEdit>(m, "MetadataEdit")
+        .def(py::init<>())
+        .def(py::init([](core::EBlockType block_type, const std::string &key, const std::string &value, bool erase) {
+                return convert::MetadataEdit{ block_type, key, value, erase };
+            }), py::arg("block_type"), py::arg("key"), py::arg("value") = "", py::arg("erase") = false)
+        .def_readwrite("block_type", &convert::MetadataEdit::block_type)
+        .def_readwrite("key", &convert::MetadataEdit::key)
+        .def_readwrite("value", &convert::MetadataEdit::value)
+        .def_readwrite("erase", &convert::MetadataEdit::erase);
+
+    m.def("edit_metadata", [](FILEWrapper &infile, FILEWrapper &outfile, const std::vector<convert::MetadataEdit> &edits) {
+            return convert::edit_metadata(*infile.fptr, *outfile.fptr, edits);
+        },
+        R"pbdoc(Apply the given edits to the metadata and save the results into outfile, the other blocks are copied raw)pbdoc",
+        py::arg("infile"), py::arg("outfile"), py::arg("edits")
+    );
+
+    m.def("edit_metadata_in_place", [](FILEWrapper &file, const std::vector<convert::MetadataEdit> &edits) {
+            bool edited = false;
+            const core::EResult res = convert::edit_metadata_in_place(*file.fptr, edits, edited);
+            return std::make_pair(res, edited);
+        },
+        R"pbdoc(Apply the given edits to the metadata of a file opened for update, if the edited blocks keep their size, returns (result, edited))pbdoc",
+        py::arg("file"), py::arg("edits")
+    );
+
+    // Appender API:
+
+    py::class_<convert::GCodeAppender>(m, "GCodeAppender")
+        .def(py::init<>())
+        .def("open", [](convert::GCodeAppender &self, FILEWrapper &file, const binarize::BinarizerConfig &config) {
+                return self.open(*file.fptr, config);
+            }, R"pbdoc(Open a binary gcode file, opened for update, to append gcode blocks to it)pbdoc",
+            // the file must outlive the appender
+            py::arg("file"), py::arg("config") = binarize::BinarizerConfig(), py::keep_alive<1, 2>())
+        .def("append_gcode", &convert::GCodeAppender::append_gcode, R"pbdoc(Append the given gcode, made of whole lines)pbdoc", py::arg("gcode"))
+        .def("finalize", &convert::GCodeAppender::finalize, R"pbdoc(Save the gcode still cached)pbdoc")
+        .def("update_metadata", [](convert::GCodeAppender &self, const std::vector<convert::MetadataEdit> &edits) {
+                bool edited = false;
+                const core::EResult res = self.update_metadata(edits, edited);
+                return std::make_pair(res, edited);
+            }, R"pbdoc(Apply the given edits to the metadata in place, after finalize(), returns (result, edited))pbdoc", py::arg("edits"))
+        .def("get_gcode_blocks_count", &convert::GCodeAppender::get_gcode_blocks_count);
+
+    // Patch API:
+
+    py::class_<convert::PatchStatistics>(m, "PatchStatistics")
+        .def(py::init<>())
+        .def_readonly("copied_blocks", &convert::PatchStatistics::copied_blocks)
+        .def_readonly("inserted_blocks", &convert::PatchStatistics::inserted_blocks)
+        .def_readonly("copied_size", &convert::PatchStatistics::copied_size)
+        .def_readonly("inserted_size", &convert::PatchStatistics::inserted_size)
+        .def_readonly("patch_size", &convert::PatchStatistics::patch_size);
+
+    m.def("diff_binary_gcode", [] (FILEWrapper &old_file, FILEWrapper &new_file, FILEWrapper &patch_file) {
+            convert::PatchStatistics statistics;
+            const core::EResult res = convert::diff_binary_gcode(*old_file.fptr, *new_file.fptr, *patch_file.fptr, &statistics);
+            return std::make_pair(res, statistics);
+        },
+        R"pbdoc(Save the block level patch turning a binary gcode file into another one, returns (result, statistics))pbdoc",
+        py::arg("old_file"), py::arg("new_file"), py::arg("patch_file")
+    );
+
+    m.def("apply_patch", [] (FILEWrapper &old_file, FILEWrapper &patch_file, FILEWrapper &new_file) {
+            return convert::apply_patch(*old_file.fptr, *patch_file.fptr, *new_file.fptr);
+        },
+        R"pbdoc(Rebuild a binary gcode file from the file and the patch saved by diff_binary_gcode)pbdoc",
+        py::arg("old_file"), py::arg("patch_file"), py::arg("new_file")
+    );
+
 #ifdef VERSION_INFO
     m.attr("__version__") = VERSION_INFO;
 #else
@@ -3,6 +3,9 @@
 from typing import Type, Union
 from ._bgcode import (  # type: ignore
     BlockHeader,
+    Catalog,
+    CatalogConfig,
+    CatalogEntry,
     CompressionType,
     EBlockType,
     EResult,
@@ -15,20 +18,36 @@ from ._bgcode import (  # type: ignore
     SlicerMetadataBlock,
     Slicer3MetadataBlock,
     FileMetadataBlock,
+    FileSummary,
+    GCodeBlockIndexEntry,
+    LayerIndexEntry,
+    MetadataEdit,
     ThumbnailBlock,
     close,
+    concatenate,
+    count_gcode_blocks,
+    edit_metadata,
+    edit_metadata_in_place,
+    extract_gcode_blocks,
     from_ascii_to_binary,
+    from_ascii_to_binary_with_layer_index,
     from_binary_to_ascii,
     get_config,
     is_open,
     open,
     memopen,
+    read_gcode_block_index,
     read_header,
+    read_layer_gcode,
+    read_layer_index,
     read_next_block_header,
+    read_summary,
     rewind,
     skip_block,
     skip_block_content,
+    transcode,
     translate_result,
+    write_layer_index,
     peek_slicer_metadata_block,
     version,
 )
@@ -37,6 +56,9 @@ __version__ = version()
 
 __all__ = [
         "BlockHeader",
+        "Catalog",
+        "CatalogConfig",
+        "CatalogEntry",
         "CompressionType",
         "EBlockType",
         "EResult",
@@ -44,22 +66,38 @@ __all__ = [
         "EPeekSlicerMetadataResult",
         "FileHeader",
         "FileMetadataBlock",
+        "FileSummary",
+        "GCodeBlockIndexEntry",
+        "LayerIndexEntry",
+        "MetadataEdit",
         "PrintMetadataBlock",
         "PrinterMetadataBlock",
         "ThumbnailBlock",
         "close",
+        "concatenate",
+        "count_gcode_blocks",
+        "edit_metadata",
+        "edit_metadata_in_place",
+        "extract_gcode_blocks",
         "from_ascii_to_binary",
+        "from_ascii_to_binary_with_layer_index",
         "from_binary_to_ascii",
         "get_config",
         "is_open",
         "open",
         "peek_slicer_metadata_block",
+        "read_gcode_block_index",
         "read_header",
+        "read_layer_gcode",
+        "read_layer_index",
         "read_next_block_header",
+        "read_summary",
         "rewind",
         "skip_block",
         "skip_block_content",
-        "translate_result"]
+        "transcode",
+        "translate_result",
+        "write_layer_index"]
 
 
 class ResultError(Exception):
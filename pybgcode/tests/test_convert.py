@@ -5,6 +5,7 @@ import pytest
 
 import pybgcode
 from pybgcode import (
+    EBlockType,
     EResult,
     EThumbnailFormat,
     read_thumbnails,
@@ -91,8 +92,33 @@ def test_main():
     assert len(all_metadata['thumbnails']) == TEST_THUMBNAILS
     for key in all_metadata['metadata'].keys():
         assert key in connect_metadata_keys
+
+    res, summary = pybgcode.read_summary(thumb_f, True)
+    assert res == EResult.Success
+    assert dict(summary.printer_metadata.raw_data) == TEST_PRINTER_METADATA
+    assert dict(summary.print_metadata.raw_data) == TEST_PRINT_METADATA
+    assert len(summary.thumbnails) == TEST_THUMBNAILS
     pybgcode.close(thumb_f)
 
+    catalog = pybgcode.Catalog()
+    catalog_cfg = pybgcode.CatalogConfig()
+    catalog_cfg.recursive = False
+    res, rescanned_count = catalog.scan(".", catalog_cfg)
+    assert res == EResult.Success
+    assert rescanned_count == 1
+    entries = catalog.get_entries()
+    assert len(entries) == 1
+    assert dict(entries[0].printer_metadata) == TEST_PRINTER_METADATA
+
+    # same size, the block is rewritten in place
+    edit_f = pybgcode.open(TEST_BGCODE, "r+b")
+    edits = [pybgcode.MetadataEdit(EBlockType.PrinterMetadata, "filament_type",
+                                   TEST_PRINTER_METADATA["filament_type"])]
+    res, edited = pybgcode.edit_metadata_in_place(edit_f, edits)
+    assert res == EResult.Success
+    assert edited
+    pybgcode.close(edit_f)
+
     # write thumbnails to png files
     thumcnt = 0
     for thumb in thumbnails:
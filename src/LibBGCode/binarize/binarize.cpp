@@ -1,16 +1,20 @@
 #include "binarize.hpp"
 #include "meatpack.hpp"
+#include "gcode_tokens.hpp"
+#include "deflate_dictionary.hpp"
+#include "heatshrink_codec.hpp"
 
 #include "core/core_impl.hpp"
 
-extern "C" {
-#include <heatshrink/heatshrink_encoder.h>
-#include <heatshrink/heatshrink_decoder.h>
-}
 #include <zlib.h>
 
+#include <algorithm>
+#include <array>
+#include <cstdlib>
 #include <cstring>
+#include <cstddef>
 #include <cassert>
+#include <new>
 
 namespace bgcode {
 
@@ -34,26 +38,59 @@ static bool read_from_file(FILE& file, T *data, size_t data_size)
     return !ferror(&file) && rsize == data_size;
 }
 
-void update_checksum(Checksum& checksum, const ThumbnailBlock &th)
+template<class T>
+static void append_to_buffer(std::pmr::vector<uint8_t>& dst, const T* data, size_t data_size)
 {
-    checksum.append(th.params.format);
-    checksum.append(th.params.width);
-    checksum.append(th.params.height);
-    checksum.append(th.data);
+    const uint8_t* begin = reinterpret_cast<const uint8_t*>(data);
+    dst.insert(dst.end(), begin, begin + data_size);
 }
 
-static std::vector<uint8_t> encode(const std::byte* data, size_t data_size)
+static void append_block_header(std::pmr::vector<uint8_t>& dst, const BlockHeader& block_header)
 {
-    std::vector<uint8_t> ret(data_size);
-    memcpy(ret.data(), data, data_size);
-    return ret;
+    append_to_buffer(dst, &block_header.type, sizeof(block_header.type));
+    append_to_buffer(dst, &block_header.compression, sizeof(block_header.compression));
+    append_to_buffer(dst, &block_header.uncompressed_size, sizeof(block_header.uncompressed_size));
+    if (block_header.compression != (uint16_t)ECompressionType::None)
+        append_to_buffer(dst, &block_header.compressed_size, sizeof(block_header.compressed_size));
+}
+
+// Appends the checksum of the given serialized block (header + payload) at its end
+static void append_block_checksum(std::pmr::vector<uint8_t>& block, EChecksumType checksum_type)
+{
+    if (checksum_type == EChecksumType::None)
+        return;
+
+    Checksum cs(checksum_type);
+    cs.append(block.data(), block.size());
+    append_to_buffer(block, cs.data(), cs.size());
 }
 
 static uint16_t metadata_encoding_types_count() { return 1 + (uint16_t)EMetadataEncodingType::JSON; }
 static uint16_t thumbnail_formats_count()       { return 1 + (uint16_t)EThumbnailFormat::QOI; }
-static uint16_t gcode_encoding_types_count()    { return 1 + (uint16_t)EGCodeEncodingType::MeatPackComments; }
+static uint16_t gcode_encoding_types_count()    { return 1 + (uint16_t)EGCodeEncodingType::Columnar; }
+
+// zlib allocation functions, forwarding to the memory resource passed as opaque
+static voidpf zlib_alloc(voidpf opaque, uInt items, uInt size)
+{
+    // the size is stored in front of the allocated memory, zlib does not pass it to zlib_free()
+    const size_t bytes = sizeof(std::max_align_t) + (size_t)items * size;
+    try {
+        std::byte* memory = static_cast<std::byte*>(static_cast<std::pmr::memory_resource*>(opaque)->allocate(bytes, alignof(std::max_align_t)));
+        *reinterpret_cast<size_t*>(memory) = bytes;
+        return memory + sizeof(std::max_align_t);
+    }
+    catch (const std::bad_alloc&) {
+        return Z_NULL;
+    }
+}
+
+static void zlib_free(voidpf opaque, voidpf address)
+{
+    std::byte* memory = static_cast<std::byte*>(address) - sizeof(std::max_align_t);
+    static_cast<std::pmr::memory_resource*>(opaque)->deallocate(memory, *reinterpret_cast<size_t*>(memory), alignof(std::max_align_t));
+}
 
-static bool encode_metadata(const std::vector<std::pair<std::string, std::string>>& src, std::vector<uint8_t>& dst,
+static bool encode_metadata(const std::pmr::vector<std::pair<std::pmr::string, std::pmr::string>>& src, std::pmr::vector<uint8_t>& dst,
     EMetadataEncodingType encoding_type)
 {
 
@@ -81,7 +118,7 @@ static bool encode_metadata(const std::vector<std::pair<std::string, std::string
     return true;
 }
 
-static bool decode_metadata(const std::vector<uint8_t>& src, std::vector<std::pair<std::string, std::string>>& dst,
+static bool decode_metadata(const std::pmr::vector<uint8_t>& src, std::pmr::vector<std::pair<std::pmr::string, std::pmr::string>>& dst,
     EMetadataEncodingType encoding_type)
 {
     switch (encoding_type)
@@ -94,7 +131,7 @@ static bool decode_metadata(const std::vector<uint8_t>& src, std::vector<std::pa
             while (end_it != src.end() && *end_it != '\n') {
                 ++end_it;
             }
-            const std::string item(begin_it, end_it);
+            const std::string_view item(reinterpret_cast<const char*>(src.data()) + std::distance(src.begin(), begin_it), std::distance(begin_it, end_it));
             const size_t pos = item.find_first_of('=');
             if (pos != std::string::npos) {
                 dst.emplace_back(item.substr(0, pos), item.substr(pos + 1));
@@ -105,9 +142,7 @@ static bool decode_metadata(const std::vector<uint8_t>& src, std::vector<std::pa
     }
     case EMetadataEncodingType::JSON:
     {
-        std::string v;
-        v.insert(v.end(), src.begin(), src.end());
-        dst.emplace_back("", v);
+        dst.emplace_back("", std::string_view(reinterpret_cast<const char*>(src.data()), src.size()));
     break;
     }
     }
@@ -115,7 +150,7 @@ static bool decode_metadata(const std::vector<uint8_t>& src, std::vector<std::pa
     return true;
 }
 
-static bool encode_gcode(const std::string& src, std::vector<uint8_t>& dst, EGCodeEncodingType encoding_type)
+static bool encode_gcode(const std::pmr::string& src, std::pmr::vector<uint8_t>& dst, EGCodeEncodingType encoding_type)
 {
     switch (encoding_type)
     {
@@ -129,26 +164,34 @@ static bool encode_gcode(const std::string& src, std::vector<uint8_t>& dst, EGCo
     {
         uint8_t binarizer_flags = (encoding_type == EGCodeEncodingType::MeatPack) ? MeatPack::Flag_RemoveComments : 0;
         binarizer_flags |= MeatPack::Flag_OmitWhitespaces;
-        MeatPack::MPBinarizer binarizer(binarizer_flags);
+        MeatPack::MPBinarizer binarizer(binarizer_flags, dst.get_allocator().resource());
         binarizer.initialize(dst);
-        auto begin_it = src.begin();
-        auto end_it = src.begin();
-        while (end_it != src.end()) {
-            while (end_it != src.end() && *end_it != '\n') {
-                ++end_it;
-            }
-            const std::string line(begin_it, ++end_it);
-            binarizer.binarize_line(line, dst);
-            begin_it = end_it;
+        const std::string_view src_view(src);
+        size_t begin_pos = 0;
+        while (begin_pos < src_view.size()) {
+            size_t end_pos = src_view.find('\n', begin_pos);
+            end_pos = (end_pos == std::string_view::npos) ? src_view.size() : end_pos + 1;
+            binarizer.binarize_line(src_view.substr(begin_pos, end_pos - begin_pos), dst);
+            begin_pos = end_pos;
         }
         binarizer.finalize(dst);
         break;
     }
+    case EGCodeEncodingType::Tokenized:
+    {
+        GCodeTokens::encode(src, dst);
+        break;
+    }
+    case EGCodeEncodingType::Columnar:
+    {
+        // encoded together with the compression, see encode_columnar_gcode()
+        return false;
+    }
     }
     return true;
 }
 
-static bool decode_gcode(const std::vector<uint8_t>& src, std::string& dst, EGCodeEncodingType encoding_type)
+static bool decode_gcode(const std::pmr::vector<uint8_t>& src, std::pmr::string& dst, EGCodeEncodingType encoding_type)
 {
     switch (encoding_type)
     {
@@ -163,32 +206,73 @@ static bool decode_gcode(const std::vector<uint8_t>& src, std::string& dst, EGCo
         MeatPack::unbinarize(src, dst);
         break;
     }
+    case EGCodeEncodingType::Tokenized:
+    {
+        return GCodeTokens::decode(src, dst);
+    }
+    case EGCodeEncodingType::Columnar:
+    {
+        // decoded together with the uncompression, see decode_columnar_gcode()
+        return false;
+    }
     }
     return true;
 }
 
-static bool compress(std::vector<uint8_t>& src, std::vector<uint8_t>& dst, ECompressionType compression_type)
+static int deflate_strategy(EDeflateStrategy strategy)
+{
+    switch (strategy)
+    {
+    case EDeflateStrategy::Filtered: { return Z_FILTERED; }
+    case EDeflateStrategy::RLE:      { return Z_RLE; }
+    default:                         { return Z_DEFAULT_STRATEGY; }
+    }
+}
+
+static bool is_valid(const DeflateParameters& parameters)
+{
+    return parameters.level >= 1 && parameters.level <= 9 && parameters.mem_level >= 1 && parameters.mem_level <= 9 &&
+        parameters.strategy <= EDeflateStrategy::RLE;
+}
+
+// temporaries are allocated from the memory resource of dst
+static bool compress(std::pmr::vector<uint8_t>& src, std::pmr::vector<uint8_t>& dst, ECompressionType compression_type,
+    const DeflateParameters& deflate_parameters = DeflateParameters())
 {
     switch (compression_type)
     {
     case ECompressionType::Deflate:
+    case ECompressionType::DeflateDictionary:
     {
         dst.clear();
 
         const size_t BUFSIZE = 2048;
-        std::vector<uint8_t> temp_buffer(BUFSIZE);
+        std::pmr::vector<uint8_t> temp_buffer(BUFSIZE, dst.get_allocator().resource());
 
         z_stream strm{};
+        strm.zalloc = zlib_alloc;
+        strm.zfree = zlib_free;
+        strm.opaque = dst.get_allocator().resource();
         strm.next_in = static_cast<Bytef*>(src.data());
         strm.avail_in = static_cast<uInt>(src.size());
         strm.next_out = temp_buffer.data();
         strm.avail_out = BUFSIZE;
 
-        const int level = Z_DEFAULT_COMPRESSION;
-        int res = deflateInit(&strm, level);
+        int res = deflateInit2(&strm, deflate_parameters.level, Z_DEFLATED, MAX_WBITS, deflate_parameters.mem_level,
+            deflate_strategy(deflate_parameters.strategy));
         if (res != Z_OK)
             return false;
 
+        if (compression_type == ECompressionType::DeflateDictionary) {
+            // zlib saves the id of the dictionary into the header of the compressed data
+            const std::string_view dictionary = current_deflate_dictionary().data;
+            res = deflateSetDictionary(&strm, reinterpret_cast<const Bytef*>(dictionary.data()), (uInt)dictionary.size());
+            if (res != Z_OK) {
+                deflateEnd(&strm);
+                return false;
+            }
+        }
+
         while (strm.avail_in > 0) {
             res = deflate(&strm, Z_NO_FLUSH);
             if (res != Z_OK) {
@@ -226,60 +310,7 @@ static bool compress(std::vector<uint8_t>& src, std::vector<uint8_t>& dst, EComp
     {
         const uint8_t window_sz = (compression_type == ECompressionType::Heatshrink_11_4) ? 11 : 12;
         const uint8_t lookahead_sz = 4;
-        heatshrink_encoder* encoder = heatshrink_encoder_alloc(window_sz, lookahead_sz);
-        if (encoder == nullptr)
-            return false;
-
-        // calculate the maximum compressed size (assuming a conservative estimate)
-        const size_t src_size = src.size();
-        const size_t max_compressed_size = src_size + (src_size >> 2);
-        dst.resize(max_compressed_size);
-
-        uint8_t* buf = src.data();
-        uint8_t* outbuf = dst.data();
-
-        // compress data
-        size_t tosink = src_size;
-        size_t output_size = 0;
-        while (tosink > 0) {
-            size_t sunk = 0;
-            const HSE_sink_res sink_res = heatshrink_encoder_sink(encoder, buf, tosink, &sunk);
-            if (sink_res != HSER_SINK_OK) {
-                heatshrink_encoder_free(encoder);
-                return false;
-            }
-            if (sunk == 0)
-                // all input data processed
-                break;
-
-            tosink -= sunk;
-            buf += sunk;
-
-            size_t polled = 0;
-            const HSE_poll_res poll_res = heatshrink_encoder_poll(encoder, outbuf + output_size, max_compressed_size - output_size, &polled);
-            if (poll_res < 0) {
-                heatshrink_encoder_free(encoder);
-                return false;
-            }
-            output_size += polled;
-        }
-
-        // input data finished
-        const HSE_finish_res finish_res = heatshrink_encoder_finish(encoder);
-        if (finish_res < 0) {
-            heatshrink_encoder_free(encoder);
-            return false;
-        }
-
-        // poll for final output
-        size_t polled = 0;
-        const HSE_poll_res poll_res = heatshrink_encoder_poll(encoder, outbuf + output_size, max_compressed_size - output_size, &polled);
-        if (poll_res < 0) {
-            heatshrink_encoder_free(encoder);
-            return false;
-        }
-        dst.resize(output_size + polled);
-        heatshrink_encoder_free(encoder);
+        HeatshrinkCodec::encode(src.data(), src.size(), window_sz, lookahead_sz, dst);
         break;
     }
     case ECompressionType::None:
@@ -292,19 +323,24 @@ static bool compress(std::vector<uint8_t>& src, std::vector<uint8_t>& dst, EComp
     return true;
 }
 
-static bool uncompress(const std::vector<uint8_t>& src, std::vector<uint8_t>& dst, ECompressionType compression_type, size_t uncompressed_size)
+// temporaries are allocated from the memory resource of dst
+static bool uncompress(const std::pmr::vector<uint8_t>& src, std::pmr::vector<uint8_t>& dst, ECompressionType compression_type, size_t uncompressed_size)
 {
     switch (compression_type)
     {
     case ECompressionType::Deflate:
+    case ECompressionType::DeflateDictionary:
     {
         dst.clear();
         dst.reserve(uncompressed_size);
 
         const size_t BUFSIZE = 2048;
-        std::vector<uint8_t> temp_buffer(BUFSIZE);
+        std::pmr::vector<uint8_t> temp_buffer(BUFSIZE, dst.get_allocator().resource());
 
         z_stream strm{};
+        strm.zalloc = zlib_alloc;
+        strm.zfree = zlib_free;
+        strm.opaque = dst.get_allocator().resource();
         strm.next_in = const_cast<uint8_t*>(src.data());
         strm.avail_in = (uInt)src.size();
         strm.next_out = temp_buffer.data();
@@ -313,8 +349,22 @@ static bool uncompress(const std::vector<uint8_t>& src, std::vector<uint8_t>& ds
         if (res != Z_OK)
             return false;
 
+        // requests the dictionary, by id, after reading the header of the compressed data
+        auto inflate_with_dictionary = [&strm, compression_type](int flush) {
+            int ret = inflate(&strm, flush);
+            if (ret == Z_NEED_DICT && compression_type == ECompressionType::DeflateDictionary) {
+                const DeflateDictionary* dictionary = find_deflate_dictionary((uint32_t)strm.adler);
+                if (dictionary == nullptr)
+                    return Z_DATA_ERROR;
+                ret = inflateSetDictionary(&strm, reinterpret_cast<const Bytef*>(dictionary->data.data()), (uInt)dictionary->data.size());
+                if (ret == Z_OK)
+                    ret = inflate(&strm, flush);
+            }
+            return ret;
+        };
+
         while (strm.avail_in > 0) {
-            res = inflate(&strm, Z_NO_FLUSH);
+            res = inflate_with_dictionary(Z_NO_FLUSH);
             if (res != Z_OK && res != Z_STREAM_END) {
                 inflateEnd(&strm);
                 return false;
@@ -333,7 +383,7 @@ static bool uncompress(const std::vector<uint8_t>& src, std::vector<uint8_t>& ds
                 strm.next_out = temp_buffer.data();
                 strm.avail_out = BUFSIZE;
             }
-            inflate_res = inflate(&strm, Z_FINISH);
+            inflate_res = inflate_with_dictionary(Z_FINISH);
         }
 
         if (inflate_res != Z_STREAM_END) {
@@ -350,48 +400,9 @@ static bool uncompress(const std::vector<uint8_t>& src, std::vector<uint8_t>& ds
     {
         const uint8_t window_sz = (compression_type == ECompressionType::Heatshrink_11_4) ? 11 : 12;
         const uint8_t lookahead_sz = 4;
-        const uint16_t input_buffer_size = 2048;
-        heatshrink_decoder* decoder = heatshrink_decoder_alloc(input_buffer_size, window_sz, lookahead_sz);
-        if (decoder == nullptr)
-            return false;
-
         dst.resize(uncompressed_size);
-
-        uint8_t* buf = const_cast<uint8_t*>(src.data());
-        uint8_t* outbuf = dst.data();
-
-        uint32_t sunk = 0;
-        uint32_t polled = 0;
-
-        const size_t compressed_size = src.size();
-        while (sunk < compressed_size) {
-            size_t count = 0;
-            const HSD_sink_res sink_res = heatshrink_decoder_sink(decoder, &buf[sunk], compressed_size - sunk, &count);
-            if (sink_res < 0) {
-                heatshrink_decoder_free(decoder);
-                return false;
-            }
-
-            sunk += (uint32_t)count;
-
-            HSD_poll_res poll_res;
-            do {
-                poll_res = heatshrink_decoder_poll(decoder, &outbuf[polled], uncompressed_size - polled, &count);
-                if (poll_res < 0) {
-                    heatshrink_decoder_free(decoder);
-                    return false;
-                }
-                polled += (uint32_t)count;
-            } while (polled < uncompressed_size && poll_res == HSDR_POLL_MORE);
-        }
-
-        const HSD_finish_res finish_res = heatshrink_decoder_finish(decoder);
-        if (finish_res < 0) {
-            heatshrink_decoder_free(decoder);
+        if (!HeatshrinkCodec::decode(src.data(), src.size(), window_sz, lookahead_sz, dst.data(), dst.size()))
             return false;
-        }
-
-        heatshrink_decoder_free(decoder);
         break;
     }
     case ECompressionType::None:
@@ -404,54 +415,156 @@ static bool uncompress(const std::vector<uint8_t>& src, std::vector<uint8_t>& ds
     return true;
 }
 
+// Encodes src with EGCodeEncodingType::Columnar, compressing each column with the given compression,
+// and sets uncompressed_size to the size of dst with no compression
+// temporaries are allocated from the memory resource of dst
+static EResult encode_columnar_gcode(const std::pmr::string& src, ECompressionType compression_type, const DeflateParameters& deflate_parameters,
+    std::pmr::vector<uint8_t>& dst, uint32_t& uncompressed_size)
+{
+    std::pmr::memory_resource* resource = dst.get_allocator().resource();
+    GCodeTokens::Columns columns(resource);
+    GCodeTokens::encode_columns(src, columns);
+
+    dst.clear();
+    size_t data_size = 0;
+    std::pmr::vector<std::pmr::vector<uint8_t>> compressed_columns(columns.size(), resource);
+    for (size_t i = 0; i < columns.size(); ++i) {
+        GCodeTokens::append_varint(dst, columns[i].size());
+        data_size += columns[i].size();
+        if (compression_type == ECompressionType::None)
+            continue;
+        if (!columns[i].empty() && !compress(columns[i], compressed_columns[i], compression_type, deflate_parameters))
+            return EResult::DataCompressionError;
+        GCodeTokens::append_varint(dst, compressed_columns[i].size());
+    }
+    if (compression_type == ECompressionType::None) {
+        uncompressed_size = (uint32_t)(dst.size() + data_size);
+        for (const std::pmr::vector<uint8_t>& column : columns) {
+            dst.insert(dst.end(), column.begin(), column.end());
+        }
+    }
+    else {
+        std::pmr::vector<uint8_t> sizes(resource);
+        for (const std::pmr::vector<uint8_t>& column : columns) {
+            GCodeTokens::append_varint(sizes, column.size());
+        }
+        uncompressed_size = (uint32_t)(sizes.size() + data_size);
+        for (const std::pmr::vector<uint8_t>& column : compressed_columns) {
+            dst.insert(dst.end(), column.begin(), column.end());
+        }
+    }
+    return EResult::Success;
+}
+
+// Decodes the data of a block encoded with EGCodeEncodingType::Columnar, whose header has the given uncompressed size
+// temporaries are allocated from the memory resource of dst
+static EResult decode_columnar_gcode(const std::pmr::vector<uint8_t>& src, ECompressionType compression_type, size_t uncompressed_size,
+    std::pmr::string& dst)
+{
+    std::pmr::memory_resource* resource = dst.get_allocator().resource();
+    std::array<uint64_t, GCodeTokens::ColumnsCount> sizes;
+    std::array<uint64_t, GCodeTokens::ColumnsCount> stored_sizes;
+    size_t pos = 0;
+    for (size_t i = 0; i < GCodeTokens::ColumnsCount; ++i) {
+        if (!GCodeTokens::read_varint(src, pos, sizes[i]))
+            return EResult::GCodeDecodingError;
+        stored_sizes[i] = sizes[i];
+        if (compression_type != ECompressionType::None && !GCodeTokens::read_varint(src, pos, stored_sizes[i]))
+            return EResult::GCodeDecodingError;
+    }
+    // the columns are contained into the uncompressed data, their sizes are checked before allocating them
+    uint64_t columns_size = 0;
+    for (const uint64_t size : sizes) {
+        if (size > uncompressed_size - columns_size)
+            return EResult::GCodeDecodingError;
+        columns_size += size;
+    }
+
+    GCodeTokens::Columns columns(GCodeTokens::ColumnsCount, resource);
+    std::pmr::vector<uint8_t> stored_column(resource);
+    for (size_t i = 0; i < GCodeTokens::ColumnsCount; ++i) {
+        if (stored_sizes[i] > src.size() - pos)
+            return EResult::GCodeDecodingError;
+        const auto begin = src.begin() + pos;
+        const auto end = begin + (size_t)stored_sizes[i];
+        pos += (size_t)stored_sizes[i];
+        if (compression_type == ECompressionType::None) {
+            columns[i].assign(begin, end);
+            continue;
+        }
+        if (sizes[i] == 0) {
+            if (stored_sizes[i] != 0)
+                return EResult::GCodeDecodingError;
+            continue;
+        }
+        stored_column.assign(begin, end);
+        if (!uncompress(stored_column, columns[i], compression_type, (size_t)sizes[i]) || columns[i].size() != sizes[i])
+            return EResult::DataUncompressionError;
+    }
+    if (pos != src.size())
+        return EResult::GCodeDecodingError;
+
+    return GCodeTokens::decode_columns(columns, dst) ? EResult::Success : EResult::GCodeDecodingError;
+}
 
-// write block header and data in encoded format
-core::EResult write(const BaseMetadataBlock &block, FILE& file, core::EBlockType block_type, core::ECompressionType compression_type, core::Checksum &checksum)
+// serialize block header, payload and checksum in encoded format
+static EResult serialize(const BaseMetadataBlock& block, EBlockType block_type, ECompressionType compression_type, EChecksumType checksum_type,
+    std::pmr::vector<uint8_t>& dst, const DeflateParameters& deflate_parameters = DeflateParameters())
 {
     if (block.encoding_type > metadata_encoding_types_count())
         return EResult::InvalidMetadataEncodingType;
 
     BlockHeader block_header((uint16_t)block_type, (uint16_t)compression_type, (uint32_t)0);
-    std::vector<uint8_t> out_data;
+    std::pmr::memory_resource* resource = dst.get_allocator().resource();
+    std::pmr::vector<uint8_t> out_data(resource);
     if (!block.raw_data.empty()) {
         // process payload encoding
-        std::vector<uint8_t> uncompressed_data;
+        std::pmr::vector<uint8_t> uncompressed_data(resource);
         if (!encode_metadata(block.raw_data, uncompressed_data, (EMetadataEncodingType)block.encoding_type))
             return EResult::MetadataEncodingError;
         // process payload compression
         block_header.uncompressed_size = (uint32_t)uncompressed_data.size();
-        std::vector<uint8_t> compressed_data;
+        std::pmr::vector<uint8_t> compressed_data(resource);
         if (compression_type != ECompressionType::None) {
-            if (!compress(uncompressed_data, compressed_data, compression_type))
+            if (!compress(uncompressed_data, compressed_data, compression_type, deflate_parameters))
                 return EResult::DataCompressionError;
             block_header.compressed_size = (uint32_t)compressed_data.size();
         }
         out_data.swap((compression_type == ECompressionType::None) ? uncompressed_data : compressed_data);
     }
 
-    // write block header
-    EResult res = block_header.write(file);
-    if (res != EResult::Success)
-        // propagate error
-        return res;
+    dst.clear();
+    dst.reserve(block_header.get_size() + sizeof(block.encoding_type) + out_data.size() + checksum_size(checksum_type));
+    // block header
+    append_block_header(dst, block_header);
+    // block payload
+    append_to_buffer(dst, &block.encoding_type, sizeof(block.encoding_type));
+    dst.insert(dst.end(), out_data.begin(), out_data.end());
+    // block checksum
+    append_block_checksum(dst, checksum_type);
 
-    // write block payload
-    if (!write_to_file(file, &block.encoding_type, sizeof(block.encoding_type)))
-        return EResult::WriteError;
-    if (!out_data.empty()) {
-        if (!write_to_file(file, out_data.data(), out_data.size()))
-            return EResult::WriteError;
-    }
+    return EResult::Success;
+}
+
+// write the given serialized block
+static EResult write_block(FILE& file, const std::pmr::vector<uint8_t>& block)
+{
+    return write_to_file(file, block.data(), block.size()) ? EResult::Success : EResult::WriteError;
+}
 
-    if (checksum.get_type() != EChecksumType::None) {
-        // update checksum with block header
-        update_checksum(checksum, block_header);
-        // update checksum with block payload
-        checksum.append(block.encoding_type);
-        if (!out_data.empty())
-            checksum.append(static_cast<unsigned char*>(out_data.data()), out_data.size());
+// Decodes the data of a metadata block, as saved into the file
+static EResult decode_metadata_data(const std::pmr::vector<uint8_t>& data, ECompressionType compression_type, EMetadataEncodingType encoding_type,
+    size_t uncompressed_size, std::pmr::vector<std::pair<std::pmr::string, std::pmr::string>>& raw_data)
+{
+    std::pmr::vector<uint8_t> uncompressed_data(data.get_allocator().resource());
+    if (compression_type != ECompressionType::None) {
+        if (!uncompress(data, uncompressed_data, compression_type, uncompressed_size))
+            return EResult::DataUncompressionError;
     }
 
+    if (!decode_metadata((compression_type == ECompressionType::None) ? data : uncompressed_data, raw_data, encoding_type))
+        return EResult::MetadataDecodingError;
+
     return EResult::Success;
 }
 
@@ -464,7 +577,8 @@ EResult BaseMetadataBlock::read_data(FILE& file, const BlockHeader& block_header
     if (encoding_type > metadata_encoding_types_count())
         return EResult::InvalidMetadataEncodingType;
 
-    std::vector<uint8_t> data;
+    std::pmr::memory_resource* resource = raw_data.get_allocator().resource();
+    std::pmr::vector<uint8_t> data(resource);
     const size_t data_size = (compression_type == ECompressionType::None) ? block_header.uncompressed_size : block_header.compressed_size;
     if (data_size > 0) {
         data.resize(data_size);
@@ -472,33 +586,25 @@ EResult BaseMetadataBlock::read_data(FILE& file, const BlockHeader& block_header
             return EResult::ReadError;
     }
 
-    std::vector<uint8_t> uncompressed_data;
-    if (compression_type != ECompressionType::None) {
-        if (!uncompress(data, uncompressed_data, compression_type, block_header.uncompressed_size))
-            return EResult::DataUncompressionError;
-    }
-
-    if (!decode_metadata((compression_type == ECompressionType::None) ? data : uncompressed_data, raw_data, (EMetadataEncodingType)encoding_type))
-        return EResult::MetadataDecodingError;
+    return decode_metadata_data(data, compression_type, (EMetadataEncodingType)encoding_type, block_header.uncompressed_size, raw_data);
+}
 
-    return EResult::Success;
+EResult BaseMetadataBlock::serialize(std::pmr::vector<uint8_t>& dst, EBlockType block_type, ECompressionType compression_type,
+    EChecksumType checksum_type, const DeflateParameters& deflate) const
+{
+    return bgcode::binarize::serialize(*this, block_type, compression_type, checksum_type, dst, deflate);
 }
 
 EResult FileMetadataBlock::write(FILE& file, ECompressionType compression_type, EChecksumType checksum_type) const
 {
-    Checksum cs(checksum_type);
-
-    // write block header, payload
-    EResult res = binarize::write(*this, file, EBlockType::FileMetadata, compression_type, cs);
+    // serialize block header, payload and checksum
+    std::pmr::vector<uint8_t> block(raw_data.get_allocator().resource());
+    const EResult res = serialize(block, EBlockType::FileMetadata, compression_type, checksum_type);
     if (res != EResult::Success)
         // propagate error
         return res;
 
-    // write block checksum
-    if (checksum_type != EChecksumType::None)
-        return cs.write(file);
-
-    return EResult::Success;
+    return write_block(file, block);
 }
 
 EResult FileMetadataBlock::read_data(FILE& file, const FileHeader& file_header, const BlockHeader& block_header)
@@ -523,19 +629,14 @@ EResult FileMetadataBlock::read_data(FILE& file, const FileHeader& file_header,
 
 EResult PrintMetadataBlock::write(FILE& file, ECompressionType compression_type, EChecksumType checksum_type) const
 {
-    Checksum cs(checksum_type);
-
-    // write block header, payload
-    EResult res = binarize::write(*this, file, EBlockType::PrintMetadata, compression_type, cs);
+    // serialize block header, payload and checksum
+    std::pmr::vector<uint8_t> block(raw_data.get_allocator().resource());
+    const EResult res = serialize(block, EBlockType::PrintMetadata, compression_type, checksum_type);
     if (res != EResult::Success)
         // propagate error
         return res;
 
-    // write block checksum
-    if (checksum_type != EChecksumType::None)
-        return cs.write(file);
-
-    return EResult::Success;
+    return write_block(file, block);
 }
 
 EResult PrintMetadataBlock::read_data(FILE& file, const FileHeader& file_header, const BlockHeader& block_header)
@@ -560,19 +661,14 @@ EResult PrintMetadataBlock::read_data(FILE& file, const FileHeader& file_header,
 
 EResult PrinterMetadataBlock::write(FILE& file, ECompressionType compression_type, EChecksumType checksum_type) const
 {
-    Checksum cs(checksum_type);
-
-    // write block header, payload
-    EResult res = binarize::write(*this, file, EBlockType::PrinterMetadata, compression_type, cs);
+    // serialize block header, payload and checksum
+    std::pmr::vector<uint8_t> block(raw_data.get_allocator().resource());
+    const EResult res = serialize(block, EBlockType::PrinterMetadata, compression_type, checksum_type);
     if (res != EResult::Success)
         // propagate error
         return res;
 
-    // write block checksum
-    if (checksum_type != EChecksumType::None)
-        return cs.write(file);
-
-    return EResult::Success;
+    return write_block(file, block);
 }
 
 EResult PrinterMetadataBlock::read_data(FILE& file, const FileHeader& file_header, const BlockHeader& block_header)
@@ -595,46 +691,45 @@ EResult PrinterMetadataBlock::read_data(FILE& file, const FileHeader& file_heade
     return EResult::Success;
 }
 
-EResult ThumbnailBlock::write(FILE& file, EChecksumType checksum_type)
+// serialize block header, payload and checksum
+static EResult serialize(const ThumbnailBlock& block, EChecksumType checksum_type, std::pmr::vector<uint8_t>& dst)
 {
-    if (params.format >= thumbnail_formats_count())
+    if (block.params.format >= thumbnail_formats_count())
         return EResult::InvalidThumbnailFormat;
-    if (params.width == 0)
+    if (block.params.width == 0)
         return EResult::InvalidThumbnailWidth;
-    if (params.height == 0)
+    if (block.params.height == 0)
         return EResult::InvalidThumbnailHeight;
-    if (data.size() == 0)
+    if (block.data.size() == 0)
         return EResult::InvalidThumbnailDataSize;
 
-    // write block header
-    BlockHeader block_header((uint16_t)EBlockType::Thumbnail, (uint16_t)ECompressionType::None, (uint32_t)data.size());
-    EResult res = block_header.write(file);
-    if (res != EResult::Success)
-        // propagate error
-        return res;
+    const BlockHeader block_header((uint16_t)EBlockType::Thumbnail, (uint16_t)ECompressionType::None, (uint32_t)block.data.size());
+
+    dst.clear();
+    dst.reserve(block_header.get_size() + block_parameters_size(EBlockType::Thumbnail) + block.data.size() + checksum_size(checksum_type));
+    // block header
+    append_block_header(dst, block_header);
+    // block payload
+    append_to_buffer(dst, &block.params.format, sizeof(block.params.format));
+    append_to_buffer(dst, &block.params.width, sizeof(block.params.width));
+    append_to_buffer(dst, &block.params.height, sizeof(block.params.height));
+    append_to_buffer(dst, block.data.data(), block.data.size());
+    // block checksum
+    append_block_checksum(dst, checksum_type);
+
+    return EResult::Success;
+}
 
-    res = params.write(file);
-    if (res != EResult::Success){
+EResult ThumbnailBlock::write(FILE& file, EChecksumType checksum_type)
+{
+    // serialize block header, payload and checksum
+    std::pmr::vector<uint8_t> block(data.get_allocator().resource());
+    const EResult res = serialize(*this, checksum_type, block);
+    if (res != EResult::Success)
         // propagate error
         return res;
-    }
-
-    if (!write_to_file(file, data.data(), data.size()))
-        return EResult::WriteError;
 
-    if (checksum_type != EChecksumType::None) {
-        Checksum cs(checksum_type);
-        // update checksum with block header
-        update_checksum(cs, block_header);
-        // update checksum with block payload
-        update_checksum(cs, *this);
-        // write block checksum
-        res = cs.write(file);
-        if (res != EResult::Success)
-            // propagate error
-            return res;
-    }
-    return EResult::Success;
+    return write_block(file, block);
 }
 
 EResult ThumbnailBlock::read_data(FILE& file, const FileHeader& file_header, const BlockHeader& block_header)
@@ -669,59 +764,129 @@ EResult ThumbnailBlock::read_data(FILE& file, const FileHeader& file_header, con
     return EResult::Success;
 }
 
-EResult GCodeBlock::write(FILE& file, ECompressionType compression_type, EChecksumType checksum_type) const
+// serialize block header, payload and checksum in encoded format
+static EResult serialize(const GCodeBlock& block, ECompressionType compression_type, EChecksumType checksum_type, std::pmr::vector<uint8_t>& dst,
+    const DeflateParameters& deflate_parameters = DeflateParameters())
 {
-    if (encoding_type > gcode_encoding_types_count())
+    if (block.encoding_type > gcode_encoding_types_count())
         return EResult::InvalidGCodeEncodingType;
 
     BlockHeader block_header((uint16_t)EBlockType::GCode, (uint16_t)compression_type, (uint32_t)0);
-    std::vector<uint8_t> out_data;
-    if (!raw_data.empty()) {
+    std::pmr::memory_resource* resource = dst.get_allocator().resource();
+    std::pmr::vector<uint8_t> out_data(resource);
+    if (!block.raw_data.empty() && (EGCodeEncodingType)block.encoding_type == EGCodeEncodingType::Columnar) {
+        // process payload encoding and compression
+        const EResult res = encode_columnar_gcode(block.raw_data, compression_type, deflate_parameters, out_data, block_header.uncompressed_size);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        if (compression_type != ECompressionType::None)
+            block_header.compressed_size = (uint32_t)out_data.size();
+    }
+    else if (!block.raw_data.empty()) {
         // process payload encoding
-        std::vector<uint8_t> uncompressed_data;
-        if (!encode_gcode(raw_data, uncompressed_data, (EGCodeEncodingType)encoding_type))
+        std::pmr::vector<uint8_t> uncompressed_data(resource);
+        if (!encode_gcode(block.raw_data, uncompressed_data, (EGCodeEncodingType)block.encoding_type))
             return EResult::GCodeEncodingError;
         // process payload compression
         block_header.uncompressed_size = (uint32_t)uncompressed_data.size();
-        std::vector<uint8_t> compressed_data;
+        std::pmr::vector<uint8_t> compressed_data(resource);
         if (compression_type != ECompressionType::None) {
-            if (!compress(uncompressed_data, compressed_data, compression_type))
+            if (!compress(uncompressed_data, compressed_data, compression_type, deflate_parameters))
                 return EResult::DataCompressionError;
             block_header.compressed_size = (uint32_t)compressed_data.size();
         }
         out_data.swap((compression_type == ECompressionType::None) ? uncompressed_data : compressed_data);
     }
 
-    // write block header
-    EResult res = block_header.write(file);
+    dst.clear();
+    dst.reserve(block_header.get_size() + sizeof(block.encoding_type) + out_data.size() + checksum_size(checksum_type));
+    // block header
+    append_block_header(dst, block_header);
+    // block payload
+    append_to_buffer(dst, &block.encoding_type, sizeof(block.encoding_type));
+    dst.insert(dst.end(), out_data.begin(), out_data.end());
+    // block checksum
+    append_block_checksum(dst, checksum_type);
+
+    return EResult::Success;
+}
+
+EResult GCodeBlock::write(FILE& file, ECompressionType compression_type, EChecksumType checksum_type) const
+{
+    // serialize block header, payload and checksum
+    std::pmr::vector<uint8_t> block(raw_data.get_allocator().resource());
+    const EResult res = serialize(*this, compression_type, checksum_type, block);
     if (res != EResult::Success)
         // propagate error
         return res;
 
-    // write block payload
-    if (!write_to_file(file, &encoding_type, sizeof(encoding_type)))
-        return EResult::WriteError;
-    if (!out_data.empty()) {
-        if (!write_to_file(file, out_data.data(), out_data.size()))
-            return EResult::WriteError;
+    return write_block(file, block);
+}
+
+EResult GCodeBlock::write(std::pmr::vector<uint8_t>& dst, ECompressionType compression_type, EChecksumType checksum_type,
+    const DeflateParameters& deflate) const
+{
+    return serialize(*this, compression_type, checksum_type, dst, deflate);
+}
+
+EResult write_gcode_block_index(const GCodeBlockIndex& index, EChecksumType checksum_type, std::pmr::vector<uint8_t>& dst)
+{
+    const uint16_t encoding_type = 0;
+    const size_t entry_size = sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint64_t);
+    const BlockHeader block_header((uint16_t)EBlockType::Index, (uint16_t)ECompressionType::None, (uint32_t)(index.size() * entry_size));
+
+    dst.clear();
+    dst.reserve(block_header.get_size() + sizeof(encoding_type) + block_header.uncompressed_size + checksum_size(checksum_type));
+    // block header
+    append_block_header(dst, block_header);
+    // block payload
+    append_to_buffer(dst, &encoding_type, sizeof(encoding_type));
+    for (const GCodeBlockIndexEntry& entry : index) {
+        append_to_buffer(dst, &entry.position, sizeof(entry.position));
+        append_to_buffer(dst, &entry.first_line, sizeof(entry.first_line));
+        append_to_buffer(dst, &entry.data_offset, sizeof(entry.data_offset));
     }
+    // block checksum
+    append_block_checksum(dst, checksum_type);
 
-    // write checksum
-    if (checksum_type != EChecksumType::None) {
-        Checksum cs(checksum_type);
-        // update checksum with block header
-        update_checksum(cs, block_header);
-        // update checksum with block payload
-        std::vector<uint8_t> data_to_encode =
-            encode(reinterpret_cast<const std::byte*>(&encoding_type), sizeof(encoding_type));
-        cs.append(data_to_encode.data(), data_to_encode.size());
-        if (!out_data.empty())
-            cs.append(static_cast<unsigned char *>(out_data.data()), out_data.size());
-        res = cs.write(file);
-        if (res != EResult::Success)
-            // propagate error
-            return res;
+    return EResult::Success;
+}
+
+EResult write_hash_tree(const HashTreeLeaves& leaves, EChecksumType checksum_type, std::pmr::vector<uint8_t>& dst)
+{
+    const uint16_t encoding_type = 0;
+    const BlockHeader block_header((uint16_t)EBlockType::HashTree, (uint16_t)ECompressionType::None, (uint32_t)(leaves.size() * sizeof(uint32_t)));
+
+    dst.clear();
+    dst.reserve(block_header.get_size() + sizeof(encoding_type) + block_header.uncompressed_size + checksum_size(checksum_type));
+    // block header
+    append_block_header(dst, block_header);
+    // block payload
+    append_to_buffer(dst, &encoding_type, sizeof(encoding_type));
+    append_to_buffer(dst, leaves.data(), leaves.size() * sizeof(uint32_t));
+    // block checksum
+    append_block_checksum(dst, checksum_type);
+
+    return EResult::Success;
+}
+
+// Decodes the data of a gcode block, as saved into the file
+static EResult decode_gcode_data(const std::pmr::vector<uint8_t>& data, ECompressionType compression_type, EGCodeEncodingType encoding_type,
+    size_t uncompressed_size, std::pmr::string& raw_data)
+{
+    if (encoding_type == EGCodeEncodingType::Columnar)
+        return data.empty() ? EResult::Success : decode_columnar_gcode(data, compression_type, uncompressed_size, raw_data);
+
+    std::pmr::vector<uint8_t> uncompressed_data(data.get_allocator().resource());
+    if (compression_type != ECompressionType::None) {
+        if (!uncompress(data, uncompressed_data, compression_type, uncompressed_size))
+            return EResult::DataUncompressionError;
     }
+
+    if (!decode_gcode((compression_type == ECompressionType::None) ? data : uncompressed_data, raw_data, encoding_type))
+        return EResult::GCodeDecodingError;
+
     return EResult::Success;
 }
 
@@ -731,10 +896,12 @@ EResult GCodeBlock::read_data(FILE& file, const FileHeader& file_header, const B
 
     if (!read_from_file(file, (void*)&encoding_type, sizeof(encoding_type)))
         return EResult::ReadError;
-    if (encoding_type > gcode_encoding_types_count())
+    if (encoding_type >= gcode_encoding_types_count() || gcode_encoding_version((EGCodeEncodingType)encoding_type) > file_header.version)
+        // unknown encoding, or added by a later version
         return EResult::InvalidGCodeEncodingType;
 
-    std::vector<uint8_t> data;
+    std::pmr::memory_resource* resource = raw_data.get_allocator().resource();
+    std::pmr::vector<uint8_t> data(resource);
     const size_t data_size = (compression_type == ECompressionType::None) ? block_header.uncompressed_size : block_header.compressed_size;
     if (data_size > 0) {
         data.resize(data_size);
@@ -742,14 +909,10 @@ EResult GCodeBlock::read_data(FILE& file, const FileHeader& file_header, const B
             return EResult::ReadError;
     }
 
-    std::vector<uint8_t> uncompressed_data;
-    if (compression_type != ECompressionType::None) {
-        if (!uncompress(data, uncompressed_data, compression_type, block_header.uncompressed_size))
-            return EResult::DataUncompressionError;
-    }
-
-    if (!decode_gcode((compression_type == ECompressionType::None) ? data : uncompressed_data, raw_data, (EGCodeEncodingType)encoding_type))
-        return EResult::GCodeDecodingError;
+    const EResult res = decode_gcode_data(data, compression_type, (EGCodeEncodingType)encoding_type, block_header.uncompressed_size, raw_data);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
 
     const EChecksumType checksum_type = (EChecksumType)file_header.checksum_type;
     if (checksum_type != EChecksumType::None) {
@@ -763,21 +926,84 @@ EResult GCodeBlock::read_data(FILE& file, const FileHeader& file_header, const B
     return EResult::Success;
 }
 
-EResult SlicerMetadataBlock::write(FILE& file, ECompressionType compression_type, EChecksumType checksum_type) const
+EResult decode_block_payload(const BlockHeader& block_header, const uint8_t* payload, size_t payload_size, std::pmr::memory_resource* resource)
 {
-    Checksum cs(checksum_type);
+    if (block_header.type >= block_types_count())
+        return EResult::InvalidBlockType;
+    if (block_header.compression >= compression_types_count())
+        return EResult::InvalidCompressionType;
+    const EBlockType block_type = (EBlockType)block_header.type;
+    const ECompressionType compression_type = (ECompressionType)block_header.compression;
+    const size_t parameters_size = block_parameters_size(block_type);
+    if (payload_size != block_payload_size(block_header))
+        return EResult::InvalidBuffer;
+
+    // all the block types but the thumbnails have the encoding type as only parameter
+    uint16_t encoding_type;
+    memcpy(&encoding_type, payload, sizeof(encoding_type));
+    const std::pmr::vector<uint8_t> data(payload + parameters_size, payload + payload_size, resource);
+    switch (block_type)
+    {
+    case EBlockType::FileMetadata:
+    case EBlockType::PrinterMetadata:
+    case EBlockType::PrintMetadata:
+    case EBlockType::SlicerMetadata:
+    {
+        if (encoding_type > metadata_encoding_types_count())
+            return EResult::InvalidMetadataEncodingType;
+        std::pmr::vector<std::pair<std::pmr::string, std::pmr::string>> raw_data(resource);
+        return decode_metadata_data(data, compression_type, (EMetadataEncodingType)encoding_type, block_header.uncompressed_size, raw_data);
+    }
+    case EBlockType::GCode:
+    {
+        if (encoding_type > gcode_encoding_types_count())
+            return EResult::InvalidGCodeEncodingType;
+        std::pmr::string raw_data(resource);
+        return decode_gcode_data(data, compression_type, (EGCodeEncodingType)encoding_type, block_header.uncompressed_size, raw_data);
+    }
+    case EBlockType::Thumbnail:
+    {
+        ThumbnailParams params;
+        memcpy(&params.format, payload, sizeof(params.format));
+        memcpy(&params.width, payload + sizeof(params.format), sizeof(params.width));
+        memcpy(&params.height, payload + sizeof(params.format) + sizeof(params.width), sizeof(params.height));
+        if (params.format >= thumbnail_formats_count())
+            return EResult::InvalidThumbnailFormat;
+        if (params.width == 0)
+            return EResult::InvalidThumbnailWidth;
+        if (params.height == 0)
+            return EResult::InvalidThumbnailHeight;
+        if (block_header.uncompressed_size == 0)
+            return EResult::InvalidThumbnailDataSize;
+        return EResult::Success;
+    }
+    case EBlockType::Index:
+    {
+        if (compression_type != ECompressionType::None)
+            return EResult::InvalidCompressionType;
+        const size_t entry_size = sizeof(uint64_t) + sizeof(uint64_t) + sizeof(uint64_t);
+        return (encoding_type == 0 && block_header.uncompressed_size % entry_size == 0) ? EResult::Success : EResult::InvalidIndex;
+    }
+    case EBlockType::HashTree:
+    {
+        if (compression_type != ECompressionType::None)
+            return EResult::InvalidCompressionType;
+        return (encoding_type == 0 && block_header.uncompressed_size % sizeof(uint32_t) == 0) ? EResult::Success : EResult::InvalidHashTree;
+    }
+    }
+    return EResult::InvalidBlockType;
+}
 
-    // write block header, payload
-    EResult res = binarize::write(*this, file, EBlockType::SlicerMetadata, compression_type, cs);
+EResult SlicerMetadataBlock::write(FILE& file, ECompressionType compression_type, EChecksumType checksum_type) const
+{
+    // serialize block header, payload and checksum
+    std::pmr::vector<uint8_t> block(raw_data.get_allocator().resource());
+    const EResult res = serialize(block, EBlockType::SlicerMetadata, compression_type, checksum_type);
     if (res != EResult::Success)
         // propagate error
         return res;
 
-    // write block checksum
-    if (checksum_type != EChecksumType::None)
-        return cs.write(file);
-
-    return EResult::Success;
+    return write_block(file, block);
 }
 
 EResult SlicerMetadataBlock::read_data(FILE& file, const FileHeader& file_header, const BlockHeader& block_header)
@@ -808,31 +1034,24 @@ void Slicer3MetadataBlock::set_json(std::string_view json)
         raw_data.front().second = json;
 }
 
-const std::string& Slicer3MetadataBlock::json() const
+std::string_view Slicer3MetadataBlock::json() const
 {
-    if (raw_data.empty()) {
-        static std::string EMPTY;
-        return EMPTY;
-    }
+    if (raw_data.empty())
+        return std::string_view();
     return raw_data.front().second;
 }
 
 
 EResult Slicer3MetadataBlock::write(FILE& file, ECompressionType compression_type, EChecksumType checksum_type) const
 {
-    Checksum cs(checksum_type);
-
-    // write block header, payload
-    EResult res = binarize::write(*this, file, EBlockType::SlicerMetadata, compression_type, cs);
+    // serialize block header, payload and checksum
+    std::pmr::vector<uint8_t> block(raw_data.get_allocator().resource());
+    const EResult res = serialize(block, EBlockType::SlicerMetadata, compression_type, checksum_type);
     if (res != EResult::Success)
         // propagate error
         return res;
 
-    // write block checksum
-    if (checksum_type != EChecksumType::None)
-        return cs.write(file);
-
-    return EResult::Success;
+    return write_block(file, block);
 }
 
 EResult Slicer3MetadataBlock::read_data(FILE& file, const FileHeader& file_header, const BlockHeader& block_header)
@@ -870,33 +1089,154 @@ EPeekSlicerMetadataResult peek_slicer_metadata_block(FILE& file, const core::Blo
     return EMetadataEncodingType{encoding_type} == EMetadataEncodingType::JSON ? EPeekSlicerMetadataResult::Slicer3MetadataFound : EPeekSlicerMetadataResult::SlicerMetadataFound;
 }
 
+EResult read_summary(FILE& file, FileSummary& summary, bool verify_checksum, bool read_thumbnails)
+{
+    const FileHeader& file_header = summary.file_header;
+    EResult res = read_header(file, summary.file_header, nullptr);
+    if (res != EResult::Success)
+        return res;
+
+    summary.file_metadata.raw_data.clear();
+    summary.printer_metadata.raw_data.clear();
+    summary.print_metadata.raw_data.clear();
+    summary.thumbnails.clear();
+
+    std::array<std::byte, 4096> cs_buffer;
+    bool printer_metadata_found = false;
+    bool print_metadata_found = false;
+    BlockHeader block_header;
+    while (true) {
+        res = read_next_block_header(file, file_header, block_header);
+        if (res != EResult::Success)
+            return res;
+
+        const EBlockType type = (EBlockType)block_header.type;
+        if (type == EBlockType::GCode)
+            break;
+
+        if (type == EBlockType::SlicerMetadata || type == EBlockType::Index || type == EBlockType::HashTree || (type == EBlockType::Thumbnail && !read_thumbnails)) {
+            res = skip_block(file, file_header, block_header);
+            if (res != EResult::Success)
+                return res;
+            continue;
+        }
+
+        if (verify_checksum && file_header.checksum_type != (uint16_t)EChecksumType::None) {
+            res = verify_block_checksum(file, file_header, block_header, cs_buffer.data(), cs_buffer.size());
+            if (res != EResult::Success)
+                return res;
+            // return to payload position after checksum verification
+            if (fseek(&file, block_header.get_position() + static_cast<long>(block_header.get_size()), SEEK_SET) != 0)
+                return EResult::ReadError;
+        }
+
+        switch (type)
+        {
+        case EBlockType::FileMetadata:    { res = summary.file_metadata.read_data(file, file_header, block_header); break; }
+        case EBlockType::PrinterMetadata: { res = summary.printer_metadata.read_data(file, file_header, block_header); printer_metadata_found = true; break; }
+        case EBlockType::PrintMetadata:   { res = summary.print_metadata.read_data(file, file_header, block_header); print_metadata_found = true; break; }
+        case EBlockType::Thumbnail:
+        {
+            ThumbnailBlock& thumbnail = summary.thumbnails.emplace_back(summary.thumbnails.get_allocator().resource());
+            res = thumbnail.read_data(file, file_header, block_header);
+            break;
+        }
+        default: { return EResult::InvalidBlockType; }
+        }
+        if (res != EResult::Success)
+            return res;
+    }
+
+    if (!printer_metadata_found)
+        return EResult::MissingPrinterMetadata;
+    if (!print_metadata_found)
+        return EResult::MissingPrintMetadata;
+
+    summary.gcode_position = block_header.get_position();
+    if (fseek(&file, summary.gcode_position, SEEK_SET) != 0)
+        return EResult::ReadError;
+
+    return EResult::Success;
+}
+
+Binarizer::Binarizer(std::pmr::memory_resource* resource)
+: m_binary_data(resource)
+, m_gcode_cache(resource)
+, m_output_buffer(resource)
+, m_layer_index(resource)
+, m_gcode_blocks(resource)
+, m_gcode_block_index(resource)
+, m_block_checksums(resource)
+{
+}
+
 bool Binarizer::is_enabled() const { return m_enabled; }
 void Binarizer::set_enabled(bool enable) { m_enabled = enable; }
 BinaryData& Binarizer::get_binary_data() { return m_binary_data; }
 const BinaryData& Binarizer::get_binary_data() const { return m_binary_data; }
 size_t Binarizer::get_max_gcode_cache_size() const { return m_gcode_cache_size; }
 void Binarizer::set_max_gcode_cache_size(size_t size) { m_gcode_cache_size = size; }
+const LayerIndex& Binarizer::get_layer_index() const { return m_layer_index; }
+const BinarizerStatistics& Binarizer::get_statistics() const { return m_statistics; }
+
+// serialize file header
+static EResult serialize(const FileHeader& file_header, std::pmr::vector<uint8_t>& dst)
+{
+    if (file_header.magic != MAGICi32)
+        return EResult::InvalidMagicNumber;
+    if (file_header.checksum_type >= checksum_types_count())
+        return EResult::InvalidChecksumType;
+
+    dst.clear();
+    append_to_buffer(dst, &file_header.magic, sizeof(file_header.magic));
+    append_to_buffer(dst, &file_header.version, sizeof(file_header.version));
+    append_to_buffer(dst, &file_header.checksum_type, sizeof(file_header.checksum_type));
+    return EResult::Success;
+}
 
 EResult Binarizer::initialize(FILE& file, const BinarizerConfig& config)
+{
+    return initialize([&file](const std::byte* data, size_t size) { return write_to_file(file, data, size); }, config);
+}
+
+EResult Binarizer::initialize(OutputCallback output, const BinarizerConfig& config)
 {
     if (!m_enabled)
         return EResult::Success;
 
-    m_file = &file;
-    m_config = config;
+    EResult res = reset(std::move(output), config, 0);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
 
     // save header
     FileHeader file_header;
     file_header.checksum_type = (uint16_t)m_config.checksum;
-    EResult res = file_header.write(*m_file);
+    file_header.version = gcode_encoding_version(m_config.gcode_encoding);
+    if (m_config.index_block || m_config.hash_tree_block)
+        file_header.version = std::max({ file_header.version, block_type_version(EBlockType::Index), block_type_version(EBlockType::HashTree) });
+    res = serialize(file_header, m_output_buffer);
     if (res != EResult::Success)
         // propagate error
         return res;
+    res = write_output();
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    // save the given metadata block
+    auto save_metadata = [this](const BaseMetadataBlock& block, EBlockType type, ECompressionType compression_type) {
+        const EResult res = serialize(block, type, compression_type, m_config.checksum, m_output_buffer, m_config.deflate.metadata);
+        if (res != EResult::Success)
+            return res;
+        add_block_checksum();
+        return write_output();
+    };
 
     // save file metadata block, if present
     if (!m_binary_data.file_metadata.raw_data.empty()) {
         m_binary_data.file_metadata.encoding_type = (uint16_t)config.metadata_encoding;
-        res = m_binary_data.file_metadata.write(*m_file, m_config.compression.file_metadata, m_config.checksum);
+        res = save_metadata(m_binary_data.file_metadata, EBlockType::FileMetadata, m_config.compression.file_metadata);
         if (res != EResult::Success)
             // propagate error
             return res;
@@ -906,14 +1246,19 @@ EResult Binarizer::initialize(FILE& file, const BinarizerConfig& config)
     if (m_binary_data.printer_metadata.raw_data.empty())
         return EResult::MissingPrinterMetadata;
     m_binary_data.printer_metadata.encoding_type = (uint16_t)config.metadata_encoding;
-    res = m_binary_data.printer_metadata.write(*m_file, m_config.compression.printer_metadata, m_config.checksum);
+    res = save_metadata(m_binary_data.printer_metadata, EBlockType::PrinterMetadata, m_config.compression.printer_metadata);
     if (res != EResult::Success)
         // propagate error
         return res;
 
     // save thumbnail blocks
-    for (ThumbnailBlock& block : m_binary_data.thumbnails) {
-        res = block.write(*m_file, m_config.checksum);
+    for (const ThumbnailBlock& block : m_binary_data.thumbnails) {
+        res = serialize(block, m_config.checksum, m_output_buffer);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        add_block_checksum();
+        res = write_output();
         if (res != EResult::Success)
             // propagate error
             return res;
@@ -923,7 +1268,7 @@ EResult Binarizer::initialize(FILE& file, const BinarizerConfig& config)
     if (m_binary_data.print_metadata.raw_data.empty())
         return EResult::MissingPrintMetadata;
     m_binary_data.print_metadata.encoding_type = (uint16_t)config.metadata_encoding;
-    res = m_binary_data.print_metadata.write(*m_file, m_config.compression.print_metadata, m_config.checksum);
+    res = save_metadata(m_binary_data.print_metadata, EBlockType::PrintMetadata, m_config.compression.print_metadata);
     if (res != EResult::Success)
         // propagate error
         return res;
@@ -934,7 +1279,7 @@ EResult Binarizer::initialize(FILE& file, const BinarizerConfig& config)
 
     if (!m_binary_data.slicer_metadata.raw_data.empty()) {
         m_binary_data.slicer_metadata.encoding_type = (uint16_t)config.metadata_encoding;
-        res = m_binary_data.slicer_metadata.write(*m_file, m_config.compression.slicer_metadata, m_config.checksum);
+        res = save_metadata(m_binary_data.slicer_metadata, EBlockType::SlicerMetadata, m_config.compression.slicer_metadata);
         if (res != EResult::Success) {
             // propagate error
             return res;
@@ -942,22 +1287,250 @@ EResult Binarizer::initialize(FILE& file, const BinarizerConfig& config)
     }
 
     if (!m_binary_data.slicer3_metadata.raw_data.empty()) {
-        res = m_binary_data.slicer3_metadata.write(*m_file, m_config.compression.slicer3_metadata, m_config.checksum);
+        res = save_metadata(m_binary_data.slicer3_metadata, EBlockType::SlicerMetadata, m_config.compression.slicer3_metadata);
         if (res != EResult::Success) {
             // propagate error
             return res;
         }
     }
 
+    m_leading_blocks_count = m_block_checksums.size();
     return EResult::Success;
 }
 
-static EResult write_gcode_block(FILE& file, const std::string& raw_data, const BinarizerConfig& config)
+EResult Binarizer::initialize_append(FILE& file, const BinarizerConfig& config, uint64_t file_size)
 {
-    GCodeBlock block;
-    block.encoding_type = (uint16_t)config.gcode_encoding;
-    block.raw_data = raw_data;
-    return block.write(file, config.compression.gcode, config.checksum);
+    if (!m_enabled)
+        return EResult::Success;
+    // the index and the hash tree blocks precede the gcode blocks
+    if (config.index_block || config.hash_tree_block)
+        return EResult::InvalidSequenceOfBlocks;
+
+    return reset([&file](const std::byte* data, size_t size) { return write_to_file(file, data, size); }, config, file_size);
+}
+
+EResult Binarizer::reset(OutputCallback output, const BinarizerConfig& config, uint64_t output_size)
+{
+    if (!is_valid(config.deflate.metadata) || !is_valid(config.deflate.gcode))
+        return EResult::InvalidCompressionType;
+    // the leaves of the hash tree are 4 bytes long
+    if (config.hash_tree_block && checksum_size(config.checksum) != sizeof(uint32_t))
+        return EResult::InvalidChecksumType;
+
+    m_output = std::move(output);
+    m_config = config;
+    m_output_size = output_size;
+    m_gcode_cache.clear();
+    m_layer_index.clear();
+    m_layer_z_pending = false;
+    m_lines_hash = 0;
+    m_gcode_blocks.clear();
+    m_gcode_block_index.clear();
+    m_gcode_lines_count = 0;
+    m_gcode_size = 0;
+    m_block_checksums.clear();
+    m_leading_blocks_count = 0;
+    m_statistics = BinarizerStatistics();
+    return EResult::Success;
+}
+
+EResult Binarizer::write_output()
+{
+    if (!m_output(reinterpret_cast<const std::byte*>(m_output_buffer.data()), m_output_buffer.size()))
+        return EResult::WriteError;
+    m_output_size += m_output_buffer.size();
+    return EResult::Success;
+}
+
+// Returns the checksum closing the given serialized block, which must be 4 bytes long
+static uint32_t block_checksum(const std::pmr::vector<uint8_t>& block)
+{
+    uint32_t ret;
+    memcpy(&ret, block.data() + block.size() - sizeof(ret), sizeof(ret));
+    return ret;
+}
+
+void Binarizer::add_block_checksum()
+{
+    if (m_config.hash_tree_block)
+        m_block_checksums.emplace_back(block_checksum(m_output_buffer));
+}
+
+bool Binarizer::holds_gcode_blocks() const
+{
+    return m_config.index_block || m_config.hash_tree_block;
+}
+
+uint64_t Binarizer::next_gcode_block_position() const
+{
+    return m_output_size + m_gcode_blocks.size();
+}
+
+EResult Binarizer::write_gcode_block()
+{
+    if (m_config.index_block) {
+        m_gcode_block_index.push_back({ next_gcode_block_position(), m_gcode_lines_count, m_gcode_size });
+        m_gcode_lines_count += std::count(m_gcode_cache.begin(), m_gcode_cache.end(), '\n');
+        m_gcode_size += m_gcode_cache.size();
+    }
+
+    GCodeBlock block(m_gcode_cache.get_allocator().resource());
+    block.encoding_type = (uint16_t)m_config.gcode_encoding;
+    block.raw_data.swap(m_gcode_cache);
+    const EResult res = serialize_gcode_block(block, m_config, m_output_buffer);
+    // give the cache back to keep its capacity
+    m_gcode_cache.swap(block.raw_data);
+    const size_t gcode_size = m_gcode_cache.size();
+    m_gcode_cache.clear();
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    // the compression type follows the block type into the serialized header
+    uint16_t compression_type;
+    memcpy(&compression_type, m_output_buffer.data() + sizeof(uint16_t), sizeof(compression_type));
+    ++m_statistics.gcode_blocks[compression_type];
+    m_statistics.gcode_size += gcode_size;
+    m_statistics.gcode_blocks_size += m_output_buffer.size();
+    add_block_checksum();
+
+    if (holds_gcode_blocks()) {
+        // hold the block until the index and the hash tree are complete
+        m_gcode_blocks.insert(m_gcode_blocks.end(), m_output_buffer.begin(), m_output_buffer.end());
+        return EResult::Success;
+    }
+    return write_output();
+}
+
+struct AutoCompressionCandidate
+{
+    ECompressionType type;
+    uint8_t deflate_level;
+};
+
+// From the fastest to decode: inflate outputs bytes, while heatshrink decodes bit by bit
+static constexpr const std::array<AutoCompressionCandidate, 7> AutoCompressionCandidates{ {
+    { ECompressionType::None, 0 },
+    { ECompressionType::Deflate, 1 },
+    { ECompressionType::Deflate, 6 },
+    { ECompressionType::Deflate, 9 },
+    { ECompressionType::DeflateDictionary, 9 },
+    { ECompressionType::Heatshrink_12_4, 0 },
+    { ECompressionType::Heatshrink_11_4, 0 }
+} };
+
+EResult serialize_gcode_block(const GCodeBlock& block, const BinarizerConfig& config, std::pmr::vector<uint8_t>& dst)
+{
+    if (config.auto_gcode_compression == EAutoCompression::Disabled)
+        return serialize(block, config.compression.gcode, config.checksum, dst, config.deflate.gcode);
+
+    std::pmr::memory_resource* resource = dst.get_allocator().resource();
+    std::pmr::vector<std::pmr::vector<uint8_t>> results(AutoCompressionCandidates.size(), resource);
+    size_t smallest_size = 0;
+    for (size_t i = 0; i < AutoCompressionCandidates.size(); ++i) {
+        const AutoCompressionCandidate& candidate = AutoCompressionCandidates[i];
+        if ((config.auto_compression_candidates & auto_compression_candidate(candidate.type)) == 0)
+            continue;
+        DeflateParameters deflate_parameters = config.deflate.gcode;
+        deflate_parameters.level = candidate.deflate_level;
+        const EResult res = serialize(block, candidate.type, config.checksum, results[i], deflate_parameters);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        if (smallest_size == 0 || results[i].size() < smallest_size)
+            smallest_size = results[i].size();
+    }
+    if (smallest_size == 0)
+        // no candidates
+        return EResult::InvalidCompressionType;
+
+    const size_t max_size = (config.auto_gcode_compression == EAutoCompression::FastestDecoding) ?
+        smallest_size + smallest_size * config.auto_compression_tolerance / 100 : smallest_size;
+    for (std::pmr::vector<uint8_t>& result : results) {
+        if (!result.empty() && result.size() <= max_size) {
+            dst.swap(result);
+            break;
+        }
+    }
+    return EResult::Success;
+}
+
+EResult Binarizer::write_held_gcode_blocks()
+{
+    // the sizes of the hash tree and of the index blocks do not depend on the positions
+    uint64_t offset = 0;
+    if (m_config.hash_tree_block) {
+        const size_t leaves_count = m_block_checksums.size() + (m_config.index_block ? 1 : 0);
+        const BlockHeader block_header((uint16_t)EBlockType::HashTree, (uint16_t)ECompressionType::None, (uint32_t)(leaves_count * sizeof(uint32_t)));
+        offset += block_header.get_size() + block_payload_size(block_header) + checksum_size(m_config.checksum);
+    }
+    std::pmr::vector<uint8_t> index_block(m_output_buffer.get_allocator().resource());
+    if (m_config.index_block) {
+        const EResult res = binarize::write_gcode_block_index(m_gcode_block_index, m_config.checksum, index_block);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        offset += index_block.size();
+    }
+
+    // the gcode blocks will follow the hash tree and the index blocks
+    for (GCodeBlockIndexEntry& entry : m_gcode_block_index) {
+        entry.position += offset;
+    }
+    for (LayerIndexEntry& entry : m_layer_index) {
+        entry.block_position += offset;
+    }
+
+    if (m_config.index_block) {
+        const EResult res = binarize::write_gcode_block_index(m_gcode_block_index, m_config.checksum, index_block);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        if (m_config.hash_tree_block)
+            m_block_checksums.insert(m_block_checksums.begin() + m_leading_blocks_count, block_checksum(index_block));
+    }
+
+    if (m_config.hash_tree_block) {
+        EResult res = binarize::write_hash_tree(m_block_checksums, m_config.checksum, m_output_buffer);
+        if (res == EResult::Success)
+            res = write_output();
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+    }
+
+    if (m_config.index_block) {
+        m_output_buffer.swap(index_block);
+        const EResult res = write_output();
+        m_output_buffer.swap(index_block);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+    }
+
+    m_output_buffer.swap(m_gcode_blocks);
+    const EResult res = write_output();
+    m_output_buffer.swap(m_gcode_blocks);
+    m_gcode_blocks.clear();
+    return res;
+}
+
+static constexpr const std::string_view LayerChangeTag = ";LAYER_CHANGE";
+static constexpr const std::string_view ZTag = ";Z:";
+
+// Hash of the given line, spread over 64 bits
+static uint64_t content_hash(std::string_view line)
+{
+    return (uint64_t)crc32c(line.data(), line.size(), 0) * 0x9E3779B97F4A7C15ull;
+}
+
+// Parses the value of a ;Z: line, without allocating
+static float parse_z(std::string_view value)
+{
+    std::array<char, 32> buffer{};
+    value = value.substr(0, std::min(value.find_first_of("\r\n"), buffer.size() - 1));
+    std::copy(value.begin(), value.end(), buffer.begin());
+    return std::strtof(buffer.data(), nullptr);
 }
 
 EResult Binarizer::append_gcode(const std::string& gcode)
@@ -965,8 +1538,8 @@ EResult Binarizer::append_gcode(const std::string& gcode)
     if (gcode.empty())
         return EResult::Success;
 
-    assert(m_file != nullptr);
-    if (m_file == nullptr)
+    assert(m_output);
+    if (!m_output)
         return EResult::WriteError;
 
     auto it_begin = gcode.begin();
@@ -977,21 +1550,60 @@ EResult Binarizer::append_gcode(const std::string& gcode)
             return EResult::WriteError;
 
         const size_t line_size = 1 + end_line_pos - begin_pos;
-        if (line_size + m_gcode_cache.length() > m_gcode_cache_size) {
+        const std::string_view line = std::string_view(gcode).substr(begin_pos, line_size);
+        bool layer_change = false;
+        if (line.substr(0, LayerChangeTag.length()) == LayerChangeTag) {
+            layer_change = true;
+            m_layer_z_pending = true;
+        }
+        else if (line.substr(0, ZTag.length()) == ZTag) {
+            // a ;Z: line not preceded by a ;LAYER_CHANGE line is a layer change by itself
+            layer_change = !m_layer_z_pending;
+        }
+
+        if (layer_change && m_config.layer_aligned_blocks && m_gcode_cache.length() >= m_config.min_layer_block_size) {
+            const EResult res = write_gcode_block();
+            if (res != EResult::Success)
+                // propagate error
+                return res;
+        }
+
+        const size_t max_block_size = m_config.content_defined_blocks ? std::min(m_config.max_content_block_size, m_gcode_cache_size) :
+            m_gcode_cache_size;
+        if (line_size + m_gcode_cache.length() > max_block_size) {
             if (!m_gcode_cache.empty()) {
-                const EResult res = write_gcode_block(*m_file, m_gcode_cache, m_config);
+                const EResult res = write_gcode_block();
                 if (res != EResult::Success)
                     // propagate error
                     return res;
-                m_gcode_cache.clear();
             }
         }
 
         if (line_size > m_gcode_cache_size)
             return EResult::WriteError;
 
+        if (layer_change)
+            // the current cache will be the next block passed to the output
+            m_layer_index.push_back({ 0.0f, next_gcode_block_position(), (uint32_t)m_gcode_cache.length() });
+        if (line.substr(0, ZTag.length()) == ZTag) {
+            m_layer_index.back().z = parse_z(line.substr(ZTag.length()));
+            m_layer_z_pending = false;
+        }
+
         m_gcode_cache.insert(m_gcode_cache.end(), it_begin, it_begin + line_size);
         it_begin += line_size;
+
+        if (m_config.content_defined_blocks) {
+            // each line shifts the hash by one bit, the lines older than 64 lines do not count anymore
+            m_lines_hash = (m_lines_hash << 1) + content_hash(line);
+            const uint32_t bits = std::min<uint32_t>(m_config.content_boundary_bits, 63);
+            if (m_gcode_cache.length() >= m_config.min_content_block_size && (m_lines_hash >> (63 - bits)) >> 1 == 0) {
+                const EResult res = write_gcode_block();
+                if (res != EResult::Success)
+                    // propagate error
+                    return res;
+            }
+        }
     } while (it_begin != gcode.end());
 
     return EResult::Success;
@@ -1004,12 +1616,15 @@ EResult Binarizer::finalize()
 
     // save gcode cache, if not empty
     if (!m_gcode_cache.empty()) {
-        const EResult res = write_gcode_block(*m_file, m_gcode_cache, m_config);
+        const EResult res = write_gcode_block();
         if (res != EResult::Success)
             // propagate error
             return res;
     }
 
+    if (holds_gcode_blocks())
+        return write_held_gcode_blocks();
+
     return EResult::Success;
 }
 
@@ -3,22 +3,62 @@
 
 #include "binarize/export.h"
 #include "core/core.hpp"
+#include "binarize/layer_index.hpp"
+
+#include <array>
+#include <functional>
+#include <memory_resource>
 
 namespace bgcode { namespace binarize {
 
+//
+// The data of the blocks, and the temporaries used to encode and decode them,
+// are allocated from the memory resource given to the block constructor,
+// so that a whole conversion can run out of a per-job arena (e.g. std::pmr::monotonic_buffer_resource).
+//
+
+enum class EDeflateStrategy : uint8_t
+{
+    Default,
+    // Z_FILTERED, favors the literals over the matches, better suited to numeric data
+    Filtered,
+    // Z_RLE, matches only repeats of the previous bytes, fast
+    RLE
+};
+
+// Parameters of the blocks compressed with ECompressionType::Deflate and ECompressionType::DeflateDictionary, see zlib's
+// deflateInit2(). They change only the effort of the compression, any decoder can read the result.
+struct DeflateParameters
+{
+    // from 1 (fastest) to 9 (smallest)
+    uint8_t level{ 6 };
+    EDeflateStrategy strategy{ EDeflateStrategy::Default };
+    // from 1 to 9, the compressor uses about 2^(mem_level + 9) bytes for its hash table, higher values are faster
+    // and give slightly smaller data
+    uint8_t mem_level{ 8 };
+};
+
 struct BGCODE_BINARIZE_EXPORT BaseMetadataBlock
 {
+    BaseMetadataBlock() = default;
+    explicit BaseMetadataBlock(std::pmr::memory_resource* resource) : raw_data(resource) {}
+
     // type of data encoding
     uint16_t encoding_type{ 0 };
     // data in key/value form
-    std::vector<std::pair<std::string, std::string>> raw_data;
+    std::pmr::vector<std::pair<std::pmr::string, std::pmr::string>> raw_data;
 
     // read block data in encoded format
     core::EResult read_data(FILE& file, const core::BlockHeader& block_header);
+    // serialize block header, data and checksum of a block of the given type into dst
+    core::EResult serialize(std::pmr::vector<uint8_t>& dst, core::EBlockType block_type, core::ECompressionType compression_type,
+        core::EChecksumType checksum_type, const DeflateParameters& deflate = DeflateParameters()) const;
 };
 
 struct BGCODE_BINARIZE_EXPORT FileMetadataBlock : public BaseMetadataBlock
 {
+    using BaseMetadataBlock::BaseMetadataBlock;
+
     // write block header and data
     core::EResult write(FILE& file, core::ECompressionType compression_type, core::EChecksumType checksum_type) const;
     // read block data
@@ -27,6 +67,8 @@ struct BGCODE_BINARIZE_EXPORT FileMetadataBlock : public BaseMetadataBlock
 
 struct BGCODE_BINARIZE_EXPORT PrintMetadataBlock : public BaseMetadataBlock
 {
+    using BaseMetadataBlock::BaseMetadataBlock;
+
     // write block header and data
     core::EResult write(FILE& file, core::ECompressionType compression_type, core::EChecksumType checksum_type) const;
     // read block data
@@ -35,6 +77,8 @@ struct BGCODE_BINARIZE_EXPORT PrintMetadataBlock : public BaseMetadataBlock
 
 struct BGCODE_BINARIZE_EXPORT PrinterMetadataBlock : public BaseMetadataBlock
 {
+    using BaseMetadataBlock::BaseMetadataBlock;
+
     // write block header and data
     core::EResult write(FILE& file, core::ECompressionType compression_type, core::EChecksumType checksum_type) const;
     // read block data
@@ -43,8 +87,11 @@ struct BGCODE_BINARIZE_EXPORT PrinterMetadataBlock : public BaseMetadataBlock
 
 struct BGCODE_BINARIZE_EXPORT ThumbnailBlock
 {
+    ThumbnailBlock() = default;
+    explicit ThumbnailBlock(std::pmr::memory_resource* resource) : data(resource) {}
+
     core::ThumbnailParams params;
-    std::vector<std::byte> data;
+    std::pmr::vector<std::byte> data;
 
     // write block header and data
     core::EResult write(FILE& file, core::EChecksumType checksum_type);
@@ -54,17 +101,40 @@ struct BGCODE_BINARIZE_EXPORT ThumbnailBlock
 
 struct BGCODE_BINARIZE_EXPORT GCodeBlock
 {
+    GCodeBlock() = default;
+    explicit GCodeBlock(std::pmr::memory_resource* resource) : raw_data(resource) {}
+
     uint16_t encoding_type{ 0 };
-    std::string raw_data;
+    std::pmr::string raw_data;
 
     // write block header and data
     core::EResult write(FILE& file, core::ECompressionType compression_type, core::EChecksumType checksum_type) const;
+    // serialize block header, data and checksum into dst, does not touch any file so it can run on worker threads
+    core::EResult write(std::pmr::vector<uint8_t>& dst, core::ECompressionType compression_type, core::EChecksumType checksum_type,
+        const DeflateParameters& deflate = DeflateParameters()) const;
     // read block data
     core::EResult read_data(FILE& file, const core::FileHeader& file_header, const core::BlockHeader& block_header);
 };
 
+// Serializes the header, data and checksum of an index block with the given entries into dst (see core::GCodeBlockIndexEntry).
+// The index block is never compressed.
+extern BGCODE_BINARIZE_EXPORT core::EResult write_gcode_block_index(const core::GCodeBlockIndex& index, core::EChecksumType checksum_type,
+    std::pmr::vector<uint8_t>& dst);
+
+// Serializes the header, data and checksum of a hash tree block with the given leaves into dst (see core::HashTreeLeaves).
+// The hash tree block is never compressed.
+extern BGCODE_BINARIZE_EXPORT core::EResult write_hash_tree(const core::HashTreeLeaves& leaves, core::EChecksumType checksum_type,
+    std::pmr::vector<uint8_t>& dst);
+
+// Decodes the payload (parameters and data, as saved into the file) of the block with the given header, only to check it,
+// and returns the outcome of the decoding. Does not touch any file, so it can run on worker threads.
+extern BGCODE_BINARIZE_EXPORT core::EResult decode_block_payload(const core::BlockHeader& block_header, const uint8_t* payload,
+    size_t payload_size, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
 struct BGCODE_BINARIZE_EXPORT SlicerMetadataBlock : public BaseMetadataBlock
 {
+    using BaseMetadataBlock::BaseMetadataBlock;
+
     // write block header and data
     core::EResult write(FILE& file, core::ECompressionType compression_type, core::EChecksumType checksum_type) const;
     // read block data
@@ -77,9 +147,13 @@ struct BGCODE_BINARIZE_EXPORT Slicer3MetadataBlock : public BaseMetadataBlock
         encoding_type = static_cast<std::underlying_type_t<core::EMetadataEncodingType>>(
               core::EMetadataEncodingType::JSON);
     }
+    explicit Slicer3MetadataBlock(std::pmr::memory_resource* resource) : BaseMetadataBlock(resource) {
+        encoding_type = static_cast<std::underlying_type_t<core::EMetadataEncodingType>>(
+              core::EMetadataEncodingType::JSON);
+    }
 
     void set_json(std::string_view);
-    const std::string& json() const;
+    std::string_view json() const;
 
     // write block header and data
     core::EResult write(FILE& file, core::ECompressionType compression_type, core::EChecksumType checksum_type) const;
@@ -97,6 +171,45 @@ enum class EPeekSlicerMetadataResult {
 // Peek the block content (just metadata extra "header") and decide what kind of block follows
 extern BGCODE_BINARIZE_EXPORT EPeekSlicerMetadataResult peek_slicer_metadata_block(FILE& file, const core::BlockHeader& block_header);
 
+// Metadata and thumbnails stored in front of the gcode blocks
+struct BGCODE_BINARIZE_EXPORT FileSummary
+{
+    FileSummary() = default;
+    explicit FileSummary(std::pmr::memory_resource* resource)
+        : file_metadata(resource), printer_metadata(resource), thumbnails(resource), print_metadata(resource) {}
+
+    core::FileHeader file_header;
+    FileMetadataBlock file_metadata;
+    PrinterMetadataBlock printer_metadata;
+    std::pmr::vector<ThumbnailBlock> thumbnails;
+    PrintMetadataBlock print_metadata;
+    // position of the header of the first gcode block in the file
+    long gcode_position{ 0 };
+};
+
+// Reads the file header and the blocks preceding the first gcode block, without touching any gcode block content.
+// The slicer metadata block is skipped, the thumbnail blocks are skipped if read_thumbnails is false.
+// If verify_checksum is true, only the checksums of the blocks being read are verified.
+// If return == EResult::Success:
+// - summary will contain the data of the read blocks.
+// - file position will be set at the start of the header of the first gcode block.
+extern BGCODE_BINARIZE_EXPORT core::EResult read_summary(FILE& file, FileSummary& summary, bool verify_checksum, bool read_thumbnails = true);
+
+// Selection of the compression of each gcode block by the Binarizer
+enum class EAutoCompression : uint8_t
+{
+    // BinarizerConfig::compression.gcode is used for all the blocks
+    Disabled,
+    // the candidate giving the smallest block
+    Smallest,
+    // the candidate fastest to decode whose block is not bigger than the smallest one by more than
+    // BinarizerConfig::auto_compression_tolerance percent.
+    // The candidates, from the fastest to decode: None, Deflate, DeflateDictionary, Heatshrink_12_4, Heatshrink_11_4
+    FastestDecoding
+};
+
+// Returns the bit of the given compression type into BinarizerConfig::auto_compression_candidates
+constexpr uint32_t auto_compression_candidate(core::ECompressionType type) { return uint32_t(1) << (uint32_t)type; }
 
 struct BinarizerConfig
 {
@@ -113,13 +226,74 @@ struct BinarizerConfig
     core::EGCodeEncodingType gcode_encoding{ core::EGCodeEncodingType::None };
     core::EMetadataEncodingType metadata_encoding{ core::EMetadataEncodingType::INI };
     core::EChecksumType checksum{ core::EChecksumType::CRC32 };
+    // when true, the gcode blocks are closed at the layer changes (;LAYER_CHANGE or ;Z: lines), if at least
+    // min_layer_block_size bytes long, so that a layer starts at the beginning of a block.
+    // The blocks are anyway closed when reaching the max gcode cache size (see Binarizer::set_max_gcode_cache_size()).
+    bool layer_aligned_blocks{ false };
+    size_t min_layer_block_size{ 4096 };
+    // when true, the gcode blocks are closed where the content of the gcode says so instead of when full: after a line, if the
+    // block is at least min_content_block_size bytes long and a rolling hash of the last 64 lines has its top
+    // content_boundary_bits bits set to 0, or before a line which would make it longer than max_content_block_size bytes.
+    // The unchanged parts of a modified gcode (e.g. sliced again after a small change) then produce the same blocks, which
+    // can be deduplicated or skipped by delta transfers. The blocks are anyway closed when reaching the max gcode cache size.
+    bool content_defined_blocks{ false };
+    size_t min_content_block_size{ 16384 };
+    size_t max_content_block_size{ 65536 };
+    // a boundary is found, on average, every 2^content_boundary_bits lines (max 63) after min_content_block_size
+    uint32_t content_boundary_bits{ 9 };
+    // when true, an index block is saved in front of the gcode blocks, to let the readers seek to any gcode block at once.
+    // The gcode blocks are held in memory until finalize(), when the index is complete.
+    bool index_block{ false };
+    // when true, a hash tree block with the checksums of all the other blocks is saved in front of the index block, if any,
+    // and of the gcode blocks, to let the readers verify the whole file, or only some blocks, in parallel.
+    // Requires a 4 bytes checksum. As for index_block, the gcode blocks are held in memory until finalize().
+    bool hash_tree_block{ false };
+    // when not disabled, each gcode block is compressed with all the candidates (Deflate with levels 1, 6 and 9) and saved
+    // with the one selected by the given policy, instead of compression.gcode
+    EAutoCompression auto_gcode_compression{ EAutoCompression::Disabled };
+    // compression types tried by auto_gcode_compression, see auto_compression_candidate(), all by default.
+    // E.g. restrict them to None, Heatshrink_11_4 and Heatshrink_12_4 for printers not supporting Deflate.
+    uint32_t auto_compression_candidates{ 0xFFFFFFFF };
+    // percentage, see EAutoCompression::FastestDecoding
+    uint32_t auto_compression_tolerance{ 10 };
+    struct Deflate
+    {
+        // used for all the metadata blocks
+        DeflateParameters metadata;
+        // used for the gcode blocks, auto_gcode_compression replaces the level with the one of each candidate
+        DeflateParameters gcode;
+    };
+    Deflate deflate;
 };
 
+struct BinarizerStatistics
+{
+    // count of gcode blocks saved with each compression type, indexed by ECompressionType
+    std::array<uint32_t, 1 + (size_t)core::ECompressionType::DeflateDictionary> gcode_blocks{};
+    // size of the gcode, as text
+    uint64_t gcode_size{ 0 };
+    // size of the gcode blocks, headers and checksums included
+    uint64_t gcode_blocks_size{ 0 };
+};
+
+// Serializes the header, data and checksum of the given gcode block into dst, with the compression selected by
+// config.auto_gcode_compression, if enabled, otherwise with config.compression.gcode, and with config.checksum.
+// Returns EResult::InvalidCompressionType if auto_gcode_compression is enabled without candidates.
+// Does not touch any file, so it can run on worker threads.
+extern BGCODE_BINARIZE_EXPORT core::EResult serialize_gcode_block(const GCodeBlock& block, const BinarizerConfig& config,
+    std::pmr::vector<uint8_t>& dst);
+
 struct BGCODE_BINARIZE_EXPORT BinaryData
 {
+    BinaryData() = default;
+    explicit BinaryData(std::pmr::memory_resource* resource)
+        : file_metadata(resource), printer_metadata(resource), thumbnails(resource)
+        , slicer_metadata(resource), slicer3_metadata(resource), print_metadata(resource) {}
+
     FileMetadataBlock file_metadata;
     PrinterMetadataBlock printer_metadata;
-    std::vector<ThumbnailBlock> thumbnails;
+    // use thumbnails.emplace_back(thumbnails.get_allocator().resource()) to allocate the new thumbnails from the same memory resource
+    std::pmr::vector<ThumbnailBlock> thumbnails;
     SlicerMetadataBlock slicer_metadata;
     Slicer3MetadataBlock slicer3_metadata;
     PrintMetadataBlock print_metadata;
@@ -128,6 +302,14 @@ struct BGCODE_BINARIZE_EXPORT BinaryData
 class BGCODE_BINARIZE_EXPORT Binarizer
 {
 public:
+    // Receives the binarized data, one block at a time, as soon as each block is complete.
+    // Returns false if the data could not be consumed.
+    using OutputCallback = std::function<bool(const std::byte* data, size_t size)>;
+
+    Binarizer() = default;
+    // The binary data, the gcode cache and the output buffer are allocated from the given memory resource
+    explicit Binarizer(std::pmr::memory_resource* resource);
+
     bool is_enabled() const;
     void set_enabled(bool enable);
 
@@ -138,16 +320,61 @@ public:
     void set_max_gcode_cache_size(size_t size);
 
     core::EResult initialize(FILE& file, const BinarizerConfig& config);
+    // Passes the binarized data to the given callback instead of writing them into a file.
+    // The output is never repositioned, so it may be forwarded to a pipe, a socket or an upload.
+    core::EResult initialize(OutputCallback output, const BinarizerConfig& config);
+    // Continues the binary gcode file of the given size, whose header, metadata and gcode blocks are already saved, writing
+    // only new gcode blocks at the current position of the file (see convert::GCodeAppender). The binary data are ignored.
+    // The index and the hash tree blocks cannot be saved, as they precede the gcode blocks.
+    core::EResult initialize_append(FILE& file, const BinarizerConfig& config, uint64_t file_size);
     core::EResult append_gcode(const std::string& gcode);
     core::EResult finalize();
 
+    // Index of the layers of the gcode appended so far, see layer_index.hpp
+    const LayerIndex& get_layer_index() const;
+    // Statistics of the gcode blocks saved so far
+    const BinarizerStatistics& get_statistics() const;
+
 private:
-    FILE* m_file{ nullptr };
+    OutputCallback m_output;
     bool m_enabled{ false };
     BinarizerConfig m_config;
     BinaryData m_binary_data;
-    std::string m_gcode_cache;
+    std::pmr::string m_gcode_cache;
     size_t m_gcode_cache_size{ 65536 };
+    // serialized block waiting to be passed to the output
+    std::pmr::vector<uint8_t> m_output_buffer;
+    // count of bytes passed to the output
+    uint64_t m_output_size{ 0 };
+    LayerIndex m_layer_index;
+    // true if the last layer change was a ;LAYER_CHANGE line, whose z is expected into the next ;Z: line
+    bool m_layer_z_pending{ false };
+    // rolling hash of the last 64 lines, when BinarizerConfig::content_defined_blocks is true
+    uint64_t m_lines_hash{ 0 };
+    // serialized gcode blocks held back until the index and the hash tree blocks are saved, when BinarizerConfig::index_block
+    // or BinarizerConfig::hash_tree_block are true
+    std::pmr::vector<uint8_t> m_gcode_blocks;
+    // positions do not account for the index block itself until finalize()
+    core::GCodeBlockIndex m_gcode_block_index;
+    uint64_t m_gcode_lines_count{ 0 };
+    uint64_t m_gcode_size{ 0 };
+    // checksums of the blocks saved so far, in file order, when BinarizerConfig::hash_tree_block is true
+    core::HashTreeLeaves m_block_checksums;
+    // count of the blocks preceding the gcode blocks into m_block_checksums
+    size_t m_leading_blocks_count{ 0 };
+    BinarizerStatistics m_statistics;
+
+    // resets the state for a new output, whose first output_size bytes are already saved
+    core::EResult reset(OutputCallback output, const BinarizerConfig& config, uint64_t output_size);
+    core::EResult write_output();
+    // adds the checksum of the block into m_output_buffer to m_block_checksums, if needed
+    void add_block_checksum();
+    core::EResult write_gcode_block();
+    bool holds_gcode_blocks() const;
+    // saves the hash tree and the index blocks, if enabled, followed by the held gcode blocks
+    core::EResult write_held_gcode_blocks();
+    // position, from the start of the file, of the next gcode block
+    uint64_t next_gcode_block_position() const;
 };
 
 } // namespace binarize
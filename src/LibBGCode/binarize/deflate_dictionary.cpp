@@ -0,0 +1,127 @@
+#include "deflate_dictionary.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+
+namespace bgcode { namespace binarize {
+
+// Version 1, curated from the output of PrusaSlicer 2.6 - 2.8: the keys of the slicer config, without their values,
+// and the gcode lines and comment prefixes not depending on the sliced objects
+static constexpr const char DictionaryV1[] =
+#include "deflate_dictionary_v1.inc"
+    ;
+
+static DeflateDictionary make_dictionary(uint32_t version, std::string_view data)
+{
+    DeflateDictionary ret;
+    ret.version = version;
+    ret.id = (uint32_t)adler32(adler32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(data.data()), (uInt)data.size());
+    ret.data = data;
+    return ret;
+}
+
+// In version order
+static const std::array<DeflateDictionary, 1>& dictionaries()
+{
+    static const std::array<DeflateDictionary, 1> ret{ {
+        make_dictionary(1, std::string_view(DictionaryV1, sizeof(DictionaryV1) - 1))
+    } };
+    return ret;
+}
+
+const DeflateDictionary& current_deflate_dictionary()
+{
+    return dictionaries().back();
+}
+
+const DeflateDictionary* find_deflate_dictionary(uint32_t id)
+{
+    for (const DeflateDictionary& dictionary : dictionaries()) {
+        if (dictionary.id == id)
+            return &dictionary;
+    }
+    return nullptr;
+}
+
+// Size of the parts the samples are split into, close to the size of the gcode blocks
+static constexpr const size_t ChunkSize{ 4096 };
+
+std::string train_deflate_dictionary(const std::vector<std::string_view>& samples, size_t max_size)
+{
+    struct LineStats
+    {
+        // count of chunks containing the line
+        size_t chunks{ 0 };
+        size_t last_chunk{ 0 };
+        // count of samples containing the line
+        size_t samples{ 0 };
+        size_t last_sample{ 0 };
+    };
+
+    // chunks are counted from 1, so that last_chunk == 0 means no chunk yet
+    std::unordered_map<std::string_view, LineStats> lines;
+    size_t chunk = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const std::string_view sample = samples[i];
+        size_t chunk_begin = 0;
+        size_t begin_pos = 0;
+        ++chunk;
+        while (begin_pos < sample.size()) {
+            size_t end_pos = sample.find('\n', begin_pos);
+            if (end_pos == std::string_view::npos)
+                end_pos = sample.size();
+            if (begin_pos - chunk_begin >= ChunkSize) {
+                chunk_begin = begin_pos;
+                ++chunk;
+            }
+            const std::string_view line = sample.substr(begin_pos, end_pos - begin_pos);
+            if (!line.empty()) {
+                LineStats& stats = lines[line];
+                if (stats.last_chunk != chunk) {
+                    stats.last_chunk = chunk;
+                    ++stats.chunks;
+                }
+                if (stats.samples == 0 || stats.last_sample != i) {
+                    stats.last_sample = i;
+                    ++stats.samples;
+                }
+            }
+            begin_pos = end_pos + 1;
+        }
+    }
+
+    // lines found into a single chunk are already into the deflate window when repeated, lines found into a single
+    // sample (e.g. the coordinates of an object) are not general enough
+    const size_t min_samples = std::min<size_t>(samples.size(), 2);
+    std::vector<std::pair<size_t, std::string_view>> scored;
+    for (const auto& [line, stats] : lines) {
+        if (stats.chunks > 1 && stats.samples >= min_samples)
+            scored.emplace_back((stats.chunks - 1) * (line.size() + 1), line);
+    }
+    std::sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) {
+        return (a.first != b.first) ? a.first > b.first : a.second < b.second;
+    });
+
+    std::vector<std::string_view> selected;
+    size_t size = 0;
+    for (const auto& [score, line] : scored) {
+        if (size + line.size() + 1 > max_size)
+            continue;
+        selected.emplace_back(line);
+        size += line.size() + 1;
+    }
+
+    std::string ret;
+    ret.reserve(size);
+    for (auto it = selected.rbegin(); it != selected.rend(); ++it) {
+        ret.append(*it);
+        ret.push_back('\n');
+    }
+    return ret;
+}
+
+} // namespace binarize
+} // namespace bgcode
@@ -0,0 +1,42 @@
+#ifndef BGCODE_BINARIZE_DEFLATE_DICTIONARY_HPP
+#define BGCODE_BINARIZE_DEFLATE_DICTIONARY_HPP
+
+#include "binarize/export.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+//
+// Preset dictionaries used by ECompressionType::DeflateDictionary.
+// Blocks are compressed with the latest dictionary, whose id (the adler32 checksum of the dictionary, as defined by zlib)
+// is saved by zlib into the header of the compressed data, so that blocks compressed with older dictionaries can still be
+// decompressed. The dictionaries embedded into the library must never be modified, only new versions can be added.
+//
+
+namespace bgcode { namespace binarize {
+
+struct DeflateDictionary
+{
+    uint32_t version{ 0 };
+    // adler32 of data
+    uint32_t id{ 0 };
+    std::string_view data;
+};
+
+// Returns the dictionary used to compress the blocks
+extern BGCODE_BINARIZE_EXPORT const DeflateDictionary& current_deflate_dictionary();
+
+// Returns the dictionary with the given id, nullptr if none
+extern BGCODE_BINARIZE_EXPORT const DeflateDictionary* find_deflate_dictionary(uint32_t id);
+
+// Builds a dictionary, not longer than max_size, from the given samples of gcode (text, including the slicer config).
+// The dictionary contains the lines found into most parts of the samples, and into more than one sample, the most
+// frequent ones at its end, where deflate references cost less.
+extern BGCODE_BINARIZE_EXPORT std::string train_deflate_dictionary(const std::vector<std::string_view>& samples, size_t max_size);
+
+} // namespace binarize
+} // namespace bgcode
+
+#endif // BGCODE_BINARIZE_DEFLATE_DICTIONARY_HPP
@@ -0,0 +1,616 @@
+#include "gcode_stream.hpp"
+
+#include "core/core_impl.hpp"
+
+#ifndef BGCODE_FREESTANDING
+#include <cstdio>
+#endif // BGCODE_FREESTANDING
+
+namespace bgcode {
+
+using namespace core;
+
+namespace binarize {
+
+// MeatPack protocol, see meatpack.cpp
+static constexpr const uint8_t MeatPack_EnablePacking{ 251 };
+static constexpr const uint8_t MeatPack_DisablePacking{ 250 };
+static constexpr const uint8_t MeatPack_ResetAll{ 249 };
+static constexpr const uint8_t MeatPack_EnableNoSpaces{ 247 };
+static constexpr const uint8_t MeatPack_DisableNoSpaces{ 246 };
+static constexpr const uint8_t MeatPack_SignalByte{ 0xFF };
+static constexpr const uint8_t MeatPack_NotPacked{ 0b1111 };
+
+static char meatpack_char(uint8_t c, bool nospace_enabled)
+{
+    static constexpr const char chars[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '.', ' ', '\n', 'G', 'X' };
+    if (c == 0b1011 && nospace_enabled)
+        return 'E';
+    return (c < sizeof(chars)) ? chars[c] : '\0';
+}
+
+// Tokenized encoding, see gcode_tokens.cpp
+static constexpr const uint8_t Tokens_Literal{ 0x00 };
+static constexpr const uint8_t Tokens_Move{ 0x80 };
+static constexpr const uint8_t Tokens_CommandShift{ 5 };
+static constexpr const uint8_t Tokens_WordsCount{ 7 };
+static constexpr const char Tokens_Letters[Tokens_WordsCount] = { 'X', 'Y', 'Z', 'I', 'J', 'E', 'F' };
+static constexpr const uint8_t Tokens_Decimals[Tokens_WordsCount] = { 3, 3, 3, 3, 3, 5, 3 };
+static constexpr const bool Tokens_Delta[Tokens_WordsCount] = { true, true, true, false, false, false, true };
+// 0 for the words present only, and always, into the G2/G3 lines
+static constexpr const uint8_t Tokens_Mask[Tokens_WordsCount] = { 0x01, 0x02, 0x04, 0, 0, 0x08, 0x10 };
+
+static bool is_gline_parameter(char c)
+{
+    switch (c)
+    {
+    // G0, G1
+    case 'X': case 'Y': case 'Z': case 'E': case 'F':
+    // G2, G3
+    case 'I': case 'J': case 'R':
+    // G4
+    case 'S':
+    // G29
+    case 'G': case 'P': case 'W': case 'H': case 'C': case 'A':
+        return true;
+    default:
+        return false;
+    }
+}
+
+static size_t stream_checksum_size(EChecksumType type)
+{
+    switch (type)
+    {
+    case EChecksumType::None:   { return 0; }
+    case EChecksumType::CRC32:  { return 4; }
+    case EChecksumType::CRC32C: { return 4; }
+    }
+    return 0;
+}
+
+// Returns the checksum of the given type, of which crc is the current value, updated with [from, to).
+// CRC32C uses the table driven implementation, the CRC instructions are not available on the printers
+static uint32_t stream_checksum(EChecksumType type, const uint8_t* from, const uint8_t* to, uint32_t crc)
+{
+    switch (type)
+    {
+    case EChecksumType::None:   { return crc; }
+    case EChecksumType::CRC32:  { return crc32_sw(from, to, crc); }
+    case EChecksumType::CRC32C: { return crc32c_sw(from, to, crc); }
+    }
+    return crc;
+}
+
+GCodeStreamDecoder::GCodeStreamDecoder(uint8_t* window, size_t window_size, char* line_buffer, size_t line_buffer_size,
+    LineCallback callback, void* user_data)
+: m_window(window)
+, m_window_size(window_size)
+, m_line_buffer(line_buffer)
+, m_line_buffer_size(line_buffer_size)
+, m_callback(callback)
+, m_user_data(user_data)
+{
+}
+
+EResult GCodeStreamDecoder::reset(const BlockHeader& block_header, EChecksumType checksum_type, bool verify_only)
+{
+    m_stage = EStage::Done;
+    m_remaining_content = 0;
+
+    if (block_header.type != to_underlying(EBlockType::GCode))
+        return EResult::InvalidBlockType;
+    if (to_underlying(checksum_type) >= checksum_types_count() || (verify_only && checksum_type == EChecksumType::None))
+        return EResult::InvalidChecksumType;
+    if (!verify_only && (m_line_buffer == nullptr || m_line_buffer_size == 0))
+        return EResult::InvalidBuffer;
+
+    const ECompressionType compression_type = (ECompressionType)block_header.compression;
+    switch (compression_type)
+    {
+    case ECompressionType::None:            { break; }
+    case ECompressionType::Heatshrink_11_4: { m_window_bits = 11; m_lookahead_bits = 4; break; }
+    case ECompressionType::Heatshrink_12_4: { m_window_bits = 12; m_lookahead_bits = 4; break; }
+    default:                                { return EResult::InvalidCompressionType; }
+    }
+
+    if (compression_type != ECompressionType::None && !verify_only) {
+        if (m_window == nullptr || m_window_size < window_size(compression_type))
+            return EResult::InvalidBuffer;
+        for (size_t i = 0; i < window_size(compression_type); ++i) {
+            m_window[i] = 0;
+        }
+    }
+
+    m_block_header = block_header;
+    m_checksum_type = checksum_type;
+    m_verify_only = verify_only;
+    m_result = EResult::Success;
+    m_stage = EStage::Parameters;
+    m_remaining_data = (compression_type == ECompressionType::None) ? block_header.uncompressed_size : block_header.compressed_size;
+    m_remaining_content = sizeof(m_encoding) + m_remaining_data + stream_checksum_size(checksum_type);
+    m_stage_count = 0;
+    m_encoding = 0;
+
+    m_decompressed_size = 0;
+    m_bits = 0;
+    m_bits_count = 0;
+    m_hs_state = EHeatshrinkState::Tag;
+    m_hs_index = 0;
+    m_window_head = 0;
+
+    m_unbinarizing = false;
+    m_nospace_enabled = false;
+    m_cmd_active = false;
+    m_add_space = false;
+    m_char_buf = 0;
+    m_cmd_count = 0;
+    m_full_char_queue = 0;
+    m_last_char = 0;
+
+    m_tokens_state = ETokensState::Opcode;
+    m_tokens_opcode = 0;
+    m_tokens_word = 0;
+    m_tokens_shift = 0;
+    m_tokens_varint = 0;
+    m_tokens_literal_size = 0;
+    for (int64_t& previous : m_tokens_previous) {
+        previous = 0;
+    }
+
+    m_line_length = 0;
+
+    // the checksum covers the block header fields
+    m_crc = 0;
+    if (m_checksum_type != EChecksumType::None) {
+        uint8_t header[12];
+        store_integer_le(block_header.type, header + 0);
+        store_integer_le(block_header.compression, header + 2);
+        store_integer_le(block_header.uncompressed_size, header + 4);
+        store_integer_le(block_header.compressed_size, header + 8);
+        m_crc = stream_checksum(m_checksum_type, header, header + ((compression_type == ECompressionType::None) ? 8 : 12), m_crc);
+    }
+
+    return EResult::Success;
+}
+
+EResult GCodeStreamDecoder::push(const uint8_t* data, size_t size)
+{
+    if (m_result != EResult::Success)
+        return m_result;
+    if (size > m_remaining_content)
+        return EResult::InvalidBuffer;
+
+    m_remaining_content -= size;
+    const uint8_t* end = data + size;
+    while (data != end && m_result == EResult::Success) {
+        switch (m_stage)
+        {
+        case EStage::Parameters:
+        {
+            m_crc = stream_checksum(m_checksum_type, data, data + 1, m_crc);
+            m_encoding |= (uint16_t)(*data++ << (8 * m_stage_count++));
+            if (m_stage_count == sizeof(m_encoding)) {
+                // the columns can be verified, but not decoded
+                if (m_encoding > to_underlying(m_verify_only ? EGCodeEncodingType::Columnar : EGCodeEncodingType::Tokenized))
+                    m_result = EResult::InvalidGCodeEncodingType;
+                m_stage_count = 0;
+                m_stage = (m_remaining_data > 0) ? EStage::Data : EStage::Checksum;
+            }
+            break;
+        }
+        case EStage::Data:
+        {
+            const size_t count = ((size_t)(end - data) < m_remaining_data) ? (size_t)(end - data) : m_remaining_data;
+            m_crc = stream_checksum(m_checksum_type, data, data + count, m_crc);
+            for (size_t i = 0; i < count && m_result == EResult::Success && !m_verify_only; ++i) {
+                push_data(data[i]);
+            }
+            data += count;
+            m_remaining_data -= count;
+            if (m_remaining_data == 0)
+                m_stage = EStage::Checksum;
+            break;
+        }
+        case EStage::Checksum:
+        {
+            if (m_stage_count < sizeof(m_checksum))
+                m_checksum[m_stage_count] = *data;
+            ++data;
+            ++m_stage_count;
+            break;
+        }
+        case EStage::Done:
+        {
+            m_result = EResult::InvalidBuffer;
+            break;
+        }
+        }
+    }
+
+    return m_result;
+}
+
+EResult GCodeStreamDecoder::finish()
+{
+    if (m_result != EResult::Success)
+        return m_result;
+    if (m_stage == EStage::Done || m_remaining_content > 0)
+        return EResult::ReadError;
+
+    m_stage = EStage::Done;
+
+    if (m_checksum_type != EChecksumType::None) {
+        if (load_integer<uint32_t>(m_checksum, m_checksum + sizeof(m_checksum)) != m_crc)
+            return EResult::InvalidChecksum;
+    }
+    if (m_verify_only)
+        return EResult::Success;
+
+    if (m_decompressed_size != m_block_header.uncompressed_size)
+        return EResult::DataUncompressionError;
+    if ((EGCodeEncodingType)m_encoding == EGCodeEncodingType::Tokenized && m_tokens_state != ETokensState::Opcode)
+        return EResult::GCodeDecodingError;
+
+    if (m_line_length > 0) {
+        m_callback(m_user_data, m_line_buffer, m_line_length);
+        m_line_length = 0;
+    }
+
+    return EResult::Success;
+}
+
+void GCodeStreamDecoder::push_data(uint8_t c)
+{
+    if (m_block_header.compression == to_underlying(ECompressionType::None)) {
+        push_decompressed(c);
+        return;
+    }
+
+    // heatshrink bit stream, MSB first:
+    // 1 bit tag: 1 = literal byte (8 bits), 0 = backreference (window bits index, lookahead bits count)
+    m_bits = (m_bits << 8) | c;
+    m_bits_count += 8;
+
+    auto get_bits = [this](uint8_t count, uint16_t& value) {
+        if (m_bits_count < count)
+            return false;
+        m_bits_count -= count;
+        value = (uint16_t)((m_bits >> m_bits_count) & ((1u << count) - 1));
+        return true;
+    };
+
+    const size_t window_mask = (size_t(1) << m_window_bits) - 1;
+    uint16_t value = 0;
+    while (m_result == EResult::Success) {
+        switch (m_hs_state)
+        {
+        case EHeatshrinkState::Tag:
+        {
+            if (!get_bits(1, value))
+                return;
+            m_hs_state = (value != 0) ? EHeatshrinkState::Literal : EHeatshrinkState::Index;
+            break;
+        }
+        case EHeatshrinkState::Literal:
+        {
+            if (!get_bits(8, value))
+                return;
+            m_window[m_window_head++ & window_mask] = (uint8_t)value;
+            push_decompressed((uint8_t)value);
+            m_hs_state = EHeatshrinkState::Tag;
+            break;
+        }
+        case EHeatshrinkState::Index:
+        {
+            if (!get_bits(m_window_bits, value))
+                return;
+            m_hs_index = value + 1;
+            m_hs_state = EHeatshrinkState::Count;
+            break;
+        }
+        case EHeatshrinkState::Count:
+        {
+            if (!get_bits(m_lookahead_bits, value))
+                return;
+            const size_t count = (size_t)value + 1;
+            for (size_t i = 0; i < count && m_result == EResult::Success; ++i) {
+                const uint8_t b = m_window[(m_window_head - m_hs_index) & window_mask];
+                m_window[m_window_head++ & window_mask] = b;
+                push_decompressed(b);
+            }
+            m_hs_state = EHeatshrinkState::Tag;
+            break;
+        }
+        }
+    }
+}
+
+void GCodeStreamDecoder::push_decompressed(uint8_t c)
+{
+    if (m_decompressed_size == m_block_header.uncompressed_size) {
+        m_result = EResult::DataUncompressionError;
+        return;
+    }
+    ++m_decompressed_size;
+
+    switch ((EGCodeEncodingType)m_encoding)
+    {
+    case EGCodeEncodingType::None:             { push_decoded((char)c); break; }
+    case EGCodeEncodingType::MeatPack:
+    case EGCodeEncodingType::MeatPackComments: { push_meatpack(c); break; }
+    case EGCodeEncodingType::Tokenized:        { push_tokens(c); break; }
+    // rejected when reading the block parameters, the columns can be decoded only as a whole
+    case EGCodeEncodingType::Columnar:         { m_result = EResult::InvalidGCodeEncodingType; break; }
+    }
+}
+
+// Mirrors MeatPack::unbinarize(), one byte at a time
+void GCodeStreamDecoder::push_meatpack(uint8_t c)
+{
+    if (c == MeatPack_SignalByte) {
+        if (m_cmd_count > 0) {
+            m_cmd_active = true;
+            m_cmd_count = 0;
+        }
+        else
+            ++m_cmd_count;
+    }
+    else {
+        if (m_cmd_active) {
+            switch (c)
+            {
+            case MeatPack_EnablePacking:   { m_unbinarizing = true; break; }
+            case MeatPack_DisablePacking:  { m_unbinarizing = false; break; }
+            case MeatPack_EnableNoSpaces:  { m_nospace_enabled = true; break; }
+            case MeatPack_DisableNoSpaces: { m_nospace_enabled = false; break; }
+            case MeatPack_ResetAll:        { m_unbinarizing = false; break; }
+            default:                       { break; }
+            }
+            m_cmd_active = false;
+        }
+        else {
+            if (m_cmd_count > 0) {
+                push_meatpack_char(MeatPack_SignalByte);
+                m_cmd_count = 0;
+            }
+            push_meatpack_char(c);
+        }
+    }
+}
+
+void GCodeStreamDecoder::push_meatpack_char(uint8_t c)
+{
+    if (!m_unbinarizing) {
+        // packing not enabled, just copy character to output
+        push_unbinarized((char)c);
+        return;
+    }
+
+    if (m_full_char_queue > 0) {
+        push_unbinarized((char)c);
+        if (m_char_buf > 0) {
+            push_unbinarized((char)m_char_buf);
+            m_char_buf = 0;
+        }
+        --m_full_char_queue;
+        return;
+    }
+
+    const uint8_t low = c & 0xF;
+    const uint8_t high = (c >> 4) & 0xF;
+    if (low == MeatPack_NotPacked) {
+        ++m_full_char_queue;
+        if (high == MeatPack_NotPacked)
+            ++m_full_char_queue;
+        else
+            m_char_buf = (uint8_t)meatpack_char(high, m_nospace_enabled);
+    }
+    else {
+        const char first = meatpack_char(low, m_nospace_enabled);
+        push_unbinarized(first);
+        if (first != '\n') {
+            if (high == MeatPack_NotPacked)
+                ++m_full_char_queue;
+            else
+                push_unbinarized(meatpack_char(high, m_nospace_enabled));
+        }
+    }
+}
+
+void GCodeStreamDecoder::push_unbinarized(char c)
+{
+    // add the spaces between the parameters of G lines, and remove empty lines, as done by MeatPack::unbinarize()
+    const bool is_empty = m_last_char == 0;
+    bool new_line = false;
+    if (c == 'G' && (is_empty || m_last_char == '\n')) {
+        m_add_space = true;
+        new_line = true;
+    }
+    else if (c == '\n')
+        m_add_space = false;
+
+    if (!new_line && m_add_space && (is_empty || m_last_char != ' ') && is_gline_parameter(c)) {
+        m_last_char = ' ';
+        push_decoded(' ');
+    }
+
+    if (c != '\n' || is_empty || m_last_char != '\n') {
+        m_last_char = c;
+        push_decoded(c);
+    }
+}
+
+// Mirrors GCodeTokens::decode(), one byte at a time
+void GCodeStreamDecoder::push_tokens(uint8_t c)
+{
+    switch (m_tokens_state)
+    {
+    case ETokensState::Opcode:
+    {
+        if (c == Tokens_Literal) {
+            m_tokens_varint = 0;
+            m_tokens_shift = 0;
+            m_tokens_state = ETokensState::LiteralSize;
+        }
+        else if ((c & Tokens_Move) != 0) {
+            m_tokens_opcode = c;
+            push_decoded('G');
+            push_decoded((char)('0' + ((c >> Tokens_CommandShift) & 0x03)));
+            m_tokens_word = 0;
+            next_tokens_word();
+        }
+        else
+            m_result = EResult::GCodeDecodingError;
+        break;
+    }
+    case ETokensState::LiteralSize:
+    {
+        if (push_tokens_varint(c)) {
+            m_tokens_literal_size = m_tokens_varint;
+            m_tokens_state = (m_tokens_literal_size > 0) ? ETokensState::Literal : ETokensState::Opcode;
+        }
+        break;
+    }
+    case ETokensState::Literal:
+    {
+        push_decoded((char)c);
+        if (--m_tokens_literal_size == 0)
+            m_tokens_state = ETokensState::Opcode;
+        break;
+    }
+    case ETokensState::Value:
+    {
+        if (!push_tokens_varint(c))
+            break;
+
+        // zigzag decoding
+        int64_t value = (int64_t)(m_tokens_varint >> 1) ^ -(int64_t)(m_tokens_varint & 1);
+        if (Tokens_Delta[m_tokens_word])
+            // added as unsigned, the deltas of corrupted data may overflow
+            value = (int64_t)((uint64_t)value + (uint64_t)m_tokens_previous[m_tokens_word]);
+        m_tokens_previous[m_tokens_word] = value;
+
+        push_decoded(' ');
+        push_decoded(Tokens_Letters[m_tokens_word]);
+        // fixed-point value, without trailing zeros and without leading zero before the decimal point
+        uint64_t u = (uint64_t)value;
+        if (value < 0) {
+            push_decoded('-');
+            u = 0 - u;
+        }
+        uint64_t scale = 1;
+        for (uint8_t i = 0; i < Tokens_Decimals[m_tokens_word]; ++i) {
+            scale *= 10;
+        }
+        const uint64_t integer = u / scale;
+        uint64_t fraction = u % scale;
+        if (integer != 0 || fraction == 0) {
+            uint64_t divisor = 1;
+            while (integer / divisor >= 10) {
+                divisor *= 10;
+            }
+            for (; divisor > 0; divisor /= 10) {
+                push_decoded((char)('0' + (integer / divisor) % 10));
+            }
+        }
+        if (fraction != 0) {
+            push_decoded('.');
+            for (scale /= 10; fraction != 0; scale /= 10) {
+                push_decoded((char)('0' + fraction / scale));
+                fraction %= scale;
+            }
+        }
+
+        ++m_tokens_word;
+        next_tokens_word();
+        break;
+    }
+    }
+}
+
+// Accumulates the given byte of a varint, returns true when the varint is complete
+bool GCodeStreamDecoder::push_tokens_varint(uint8_t c)
+{
+    if (m_tokens_shift >= 64) {
+        m_result = EResult::GCodeDecodingError;
+        return false;
+    }
+    m_tokens_varint |= (uint64_t)(c & 0x7F) << m_tokens_shift;
+    m_tokens_shift += 7;
+    return (c & 0x80) == 0;
+}
+
+// Moves to the next word of the current move line, or to the next opcode when the line is complete
+void GCodeStreamDecoder::next_tokens_word()
+{
+    const bool arc = ((m_tokens_opcode >> Tokens_CommandShift) & 0x03) >= 2;
+    while (m_tokens_word < Tokens_WordsCount &&
+        !((Tokens_Mask[m_tokens_word] != 0) ? (m_tokens_opcode & Tokens_Mask[m_tokens_word]) != 0 : arc)) {
+        ++m_tokens_word;
+    }
+
+    if (m_tokens_word == Tokens_WordsCount) {
+        push_decoded('\n');
+        m_tokens_state = ETokensState::Opcode;
+    }
+    else {
+        m_tokens_varint = 0;
+        m_tokens_shift = 0;
+        m_tokens_state = ETokensState::Value;
+    }
+}
+
+void GCodeStreamDecoder::push_decoded(char c)
+{
+    if (c == '\n') {
+        m_callback(m_user_data, m_line_buffer, m_line_length);
+        m_line_length = 0;
+    }
+    else if (m_line_length < m_line_buffer_size)
+        m_line_buffer[m_line_length++] = c;
+    else
+        m_result = EResult::InvalidBuffer;
+}
+
+#ifndef BGCODE_FREESTANDING
+// Passes the content of the GCode block with the given header, read from the given file, to the given decoder
+static EResult push_gcode_block(FILE& file, const BlockHeader& block_header, EChecksumType checksum_type,
+    GCodeStreamDecoder& decoder, uint8_t* input_buffer, size_t input_buffer_size, bool verify_only)
+{
+    if (input_buffer == nullptr || input_buffer_size == 0)
+        return EResult::InvalidBuffer;
+
+    EResult res = decoder.reset(block_header, checksum_type, verify_only);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    while (decoder.get_remaining_size() > 0) {
+        const size_t size = (decoder.get_remaining_size() < input_buffer_size) ? decoder.get_remaining_size() : input_buffer_size;
+        if (fread(input_buffer, 1, size, &file) != size || ferror(&file))
+            return EResult::ReadError;
+        res = decoder.push(input_buffer, size);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+    }
+
+    return decoder.finish();
+}
+
+EResult decode_gcode_block(FILE& file, const BlockHeader& block_header, EChecksumType checksum_type,
+    GCodeStreamDecoder& decoder, uint8_t* input_buffer, size_t input_buffer_size)
+{
+    return push_gcode_block(file, block_header, checksum_type, decoder, input_buffer, input_buffer_size, false);
+}
+
+EResult verify_gcode_block(FILE& file, const BlockHeader& block_header, EChecksumType checksum_type,
+    GCodeStreamDecoder& decoder, uint8_t* input_buffer, size_t input_buffer_size)
+{
+    return push_gcode_block(file, block_header, checksum_type, decoder, input_buffer, input_buffer_size, true);
+}
+#endif // BGCODE_FREESTANDING
+
+} // namespace binarize
+} // namespace bgcode
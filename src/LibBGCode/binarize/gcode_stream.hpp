@@ -0,0 +1,175 @@
+#ifndef BGCODE_BINARIZE_GCODE_STREAM_HPP
+#define BGCODE_BINARIZE_GCODE_STREAM_HPP
+
+#include "binarize/export.h"
+#include "core/core.hpp"
+
+//
+// Bounded-memory decoder of GCode blocks.
+// The decoder works exclusively on buffers provided by the caller (decompression window and line buffer),
+// it never allocates on the heap and it does not use the C/C++ runtime I/O, so that it can be used on
+// resource-constrained targets (printer firmware).
+// Define BGCODE_FREESTANDING to compile only the freestanding part of this interface.
+//
+// The lines are passed to the callback by push(), as soon as they are decoded, while the block checksum is verified only
+// by finish(): the lines of a corrupted block are emitted before the error is reported. Callers executing the lines (e.g.
+// sending them to the planner) have to buffer them until finish() succeeds, or first pass the block content to a decoder
+// reset in verify only mode, which verifies the checksum without decoding, and then decode it.
+//
+// Supported compressions: None, Heatshrink_11_4, Heatshrink_12_4.
+// Supported encodings: all but Columnar, whose columns can be decoded only as a whole, and which can be only verified.
+// Deflate and DeflateDictionary require zlib, which allocates its state on the heap, and they are not supported.
+//
+
+namespace bgcode { namespace binarize {
+
+class BGCODE_BINARIZE_EXPORT GCodeStreamDecoder
+{
+public:
+    // Called for each decoded line, the line does not contain the trailing newline.
+    // The line data are valid only for the duration of the call.
+    using LineCallback = void(*)(void* user_data, const char* line, size_t length);
+
+    // Returns the size, in bytes, of the decompression window required to decode blocks
+    // compressed with the given compression type
+    static constexpr size_t window_size(core::ECompressionType compression_type) {
+        switch (compression_type)
+        {
+        case core::ECompressionType::Heatshrink_11_4: { return size_t(1) << 11; }
+        case core::ECompressionType::Heatshrink_12_4: { return size_t(1) << 12; }
+        default:                                      { return 0; }
+        }
+    }
+
+    // window:      buffer for the decompression window, see window_size()
+    // line_buffer: buffer used to assemble the decoded lines, its size is the max length of the decoded lines
+    GCodeStreamDecoder(uint8_t* window, size_t window_size, char* line_buffer, size_t line_buffer_size,
+        LineCallback callback, void* user_data);
+
+    // Prepares the decoder to decode the GCode block with the given header.
+    // The block content (parameters, data and checksum) has to be then passed to push().
+    // If verify_only is true, the data are not decoded and no line is emitted, finish() verifies only the block checksum.
+    // In this mode the decompression window and the line buffer are not used, and the checksum type must not be None.
+    core::EResult reset(const core::BlockHeader& block_header, core::EChecksumType checksum_type, bool verify_only = false);
+
+    // Decodes the given chunk of the block content.
+    // Chunks can have any size, the sum of their sizes must not exceed the block content size.
+    // Returns EResult::InvalidBuffer if a decoded line does not fit into the line buffer.
+    core::EResult push(const uint8_t* data, size_t size);
+
+    // Completes the decoding of the block: verifies the block checksum and emits the last line, if not terminated by a newline.
+    // The other lines have been already emitted by push(), even if the checksum does not match.
+    core::EResult finish();
+
+    // Returns the count of bytes of the block content not yet passed to push()
+    size_t get_remaining_size() const { return m_remaining_content; }
+
+private:
+    enum class EStage : uint8_t
+    {
+        Parameters,
+        Data,
+        Checksum,
+        Done
+    };
+
+    enum class EHeatshrinkState : uint8_t
+    {
+        Tag,
+        Literal,
+        Index,
+        Count
+    };
+
+    enum class ETokensState : uint8_t
+    {
+        Opcode,
+        LiteralSize,
+        Literal,
+        Value
+    };
+
+    uint8_t* m_window;
+    size_t m_window_size;
+    char* m_line_buffer;
+    size_t m_line_buffer_size;
+    LineCallback m_callback;
+    void* m_user_data;
+
+    core::BlockHeader m_block_header;
+    core::EChecksumType m_checksum_type{ core::EChecksumType::None };
+    core::EResult m_result{ core::EResult::Success };
+    EStage m_stage{ EStage::Done };
+    bool m_verify_only{ false };
+    size_t m_remaining_content{ 0 };
+    size_t m_remaining_data{ 0 };
+    size_t m_stage_count{ 0 };
+    uint16_t m_encoding{ 0 };
+    uint32_t m_crc{ 0 };
+    uint8_t m_checksum[4]{ 0, 0, 0, 0 };
+
+    // decompression
+    size_t m_decompressed_size{ 0 };
+    uint32_t m_bits{ 0 };
+    uint8_t m_bits_count{ 0 };
+    uint8_t m_window_bits{ 0 };
+    uint8_t m_lookahead_bits{ 0 };
+    EHeatshrinkState m_hs_state{ EHeatshrinkState::Tag };
+    uint16_t m_hs_index{ 0 };
+    size_t m_window_head{ 0 };
+
+    // MeatPack decoding
+    bool m_unbinarizing{ false };
+    bool m_nospace_enabled{ false };
+    bool m_cmd_active{ false };
+    bool m_add_space{ false };
+    uint8_t m_char_buf{ 0 };
+    uint8_t m_cmd_count{ 0 };
+    uint8_t m_full_char_queue{ 0 };
+    char m_last_char{ 0 };
+
+    // Tokenized decoding
+    ETokensState m_tokens_state{ ETokensState::Opcode };
+    uint8_t m_tokens_opcode{ 0 };
+    uint8_t m_tokens_word{ 0 };
+    uint8_t m_tokens_shift{ 0 };
+    uint64_t m_tokens_varint{ 0 };
+    uint64_t m_tokens_literal_size{ 0 };
+    int64_t m_tokens_previous[7]{ 0, 0, 0, 0, 0, 0, 0 };
+
+    // line assembly
+    size_t m_line_length{ 0 };
+
+    void push_data(uint8_t c);
+    void push_decompressed(uint8_t c);
+    void push_meatpack(uint8_t c);
+    void push_meatpack_char(uint8_t c);
+    void push_unbinarized(char c);
+    void push_tokens(uint8_t c);
+    bool push_tokens_varint(uint8_t c);
+    void next_tokens_word();
+    void push_decoded(char c);
+};
+
+#ifndef BGCODE_FREESTANDING
+// Decodes the GCode block with the given header, reading its content from the given file
+// in chunks of the size of the given input buffer.
+// Expects the file position to be at the start of the block parameters.
+// If return == EResult::Success:
+// - file position will be set at the start of the next block header.
+extern BGCODE_BINARIZE_EXPORT core::EResult decode_gcode_block(FILE& file, const core::BlockHeader& block_header,
+    core::EChecksumType checksum_type, GCodeStreamDecoder& decoder, uint8_t* input_buffer, size_t input_buffer_size);
+
+// Verifies the checksum of the GCode block with the given header, as decode_gcode_block(), using the given decoder in
+// verify only mode, without decoding the block.
+// Expects the file position to be at the start of the block parameters.
+// If return == EResult::Success:
+// - file position will be set at the start of the next block header.
+extern BGCODE_BINARIZE_EXPORT core::EResult verify_gcode_block(FILE& file, const core::BlockHeader& block_header,
+    core::EChecksumType checksum_type, GCodeStreamDecoder& decoder, uint8_t* input_buffer, size_t input_buffer_size);
+#endif // BGCODE_FREESTANDING
+
+} // namespace binarize
+} // namespace bgcode
+
+#endif // BGCODE_BINARIZE_GCODE_STREAM_HPP
@@ -0,0 +1,392 @@
+#include "gcode_tokens.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace bgcode { namespace binarize { namespace GCodeTokens {
+
+static constexpr const uint8_t Literal{ 0x00 };
+static constexpr const uint8_t Move{ 0x80 };
+static constexpr const uint8_t CommandShift{ 5 };
+
+// Words of the move lines, in their order into the lines
+enum class EWord : uint8_t
+{
+    X,
+    Y,
+    Z,
+    I,
+    J,
+    E,
+    F
+};
+static constexpr const size_t WordsCount{ 7 };
+
+struct WordInfo
+{
+    char letter;
+    uint8_t decimals;
+    bool delta;
+    // bit into the opcode mask, 0 if the word is present only into the G2/G3 lines
+    uint8_t mask;
+    // column of the columnar encoding
+    EColumn column;
+};
+
+static constexpr const std::array<WordInfo, WordsCount> Words{ {
+    { 'X', 3, true, 0x01, EColumn::X },
+    { 'Y', 3, true, 0x02, EColumn::Y },
+    { 'Z', 3, true, 0x04, EColumn::Z },
+    { 'I', 3, false, 0, EColumn::Arcs },
+    { 'J', 3, false, 0, EColumn::Arcs },
+    { 'E', 5, false, 0x08, EColumn::E },
+    { 'F', 3, true, 0x10, EColumn::F }
+} };
+
+// Max length of a rendered value: sign, 20 digits, point
+static constexpr const size_t MaxValueLength{ 24 };
+// Max count of digits of the integer part of a value, to keep the fixed-point values far from overflowing
+static constexpr const size_t MaxIntegerDigits{ 10 };
+
+static constexpr uint64_t pow10(uint8_t exponent)
+{
+    uint64_t ret = 1;
+    for (uint8_t i = 0; i < exponent; ++i) {
+        ret *= 10;
+    }
+    return ret;
+}
+
+// Writes the given fixed-point value into out, as the slicer does: no trailing zeros and no leading zero
+// before the decimal point. Returns the length of the text.
+static size_t render_value(int64_t value, uint8_t decimals, char* out)
+{
+    char* p = out;
+    uint64_t u = (uint64_t)value;
+    if (value < 0) {
+        *p++ = '-';
+        u = 0 - u;
+    }
+    const uint64_t scale = pow10(decimals);
+    const uint64_t integer = u / scale;
+    uint64_t fraction = u % scale;
+
+    std::array<char, MaxValueLength> digits;
+    size_t count = 0;
+    if (integer != 0 || fraction == 0) {
+        uint64_t v = integer;
+        do {
+            digits[count++] = (char)('0' + v % 10);
+            v /= 10;
+        } while (v != 0);
+        while (count > 0) {
+            *p++ = digits[--count];
+        }
+    }
+    if (fraction != 0) {
+        *p++ = '.';
+        uint8_t fraction_digits = decimals;
+        while (fraction % 10 == 0) {
+            fraction /= 10;
+            --fraction_digits;
+        }
+        for (uint8_t i = 0; i < fraction_digits; ++i) {
+            digits[count++] = (char)('0' + fraction % 10);
+            fraction /= 10;
+        }
+        while (count > 0) {
+            *p++ = digits[--count];
+        }
+    }
+    return (size_t)(p - out);
+}
+
+// Parses the given text into a fixed-point value, returns false if it is not a number with at most the given decimals
+static bool parse_value(std::string_view text, uint8_t decimals, int64_t& value)
+{
+    size_t pos = 0;
+    const bool negative = !text.empty() && text[0] == '-';
+    if (negative)
+        ++pos;
+
+    uint64_t u = 0;
+    size_t integer_digits = 0;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+        if (++integer_digits > MaxIntegerDigits)
+            return false;
+        u = u * 10 + (uint64_t)(text[pos++] - '0');
+    }
+    size_t fraction_digits = 0;
+    if (pos < text.size() && text[pos] == '.') {
+        ++pos;
+        while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+            if (++fraction_digits > decimals)
+                return false;
+            u = u * 10 + (uint64_t)(text[pos++] - '0');
+        }
+    }
+    if (pos != text.size() || integer_digits + fraction_digits == 0)
+        return false;
+
+    u *= pow10(decimals - (uint8_t)fraction_digits);
+    value = negative ? -(int64_t)u : (int64_t)u;
+    return true;
+}
+
+void append_varint(std::pmr::vector<uint8_t>& dst, uint64_t value)
+{
+    while (value >= 0x80) {
+        dst.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    dst.push_back((uint8_t)value);
+}
+
+bool read_varint(const std::pmr::vector<uint8_t>& src, size_t& pos, uint64_t& value)
+{
+    value = 0;
+    for (uint8_t shift = 0; shift < 64; shift += 7) {
+        if (pos == src.size())
+            return false;
+        const uint8_t c = src[pos++];
+        value |= (uint64_t)(c & 0x7F) << shift;
+        if ((c & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+static uint64_t zigzag_encode(int64_t value) { return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63); }
+static int64_t zigzag_decode(uint64_t value) { return (int64_t)(value >> 1) ^ -(int64_t)(value & 1); }
+
+// Returns the value of the given word from its encoded value and from the value of the same word into the previous move line.
+// The deltas of corrupted data may overflow, they are added as unsigned to wrap around
+static int64_t decode_word(size_t word, uint64_t encoded, int64_t previous)
+{
+    const int64_t value = zigzag_decode(encoded);
+    return Words[word].delta ? (int64_t)((uint64_t)previous + (uint64_t)value) : value;
+}
+
+struct MoveLine
+{
+    uint8_t command{ 0 };
+    std::array<bool, WordsCount> present{};
+    std::array<int64_t, WordsCount> values{};
+};
+
+// Parses the given line (without newline) into move, returns false if it is not a G0/G1/G2/G3 line
+// which decode() regenerates as it is
+static bool parse_move(std::string_view line, MoveLine& move)
+{
+    if (line.size() < 2 || line[0] != 'G' || line[1] < '0' || line[1] > '3')
+        return false;
+    move.command = (uint8_t)(line[1] - '0');
+    move.present.fill(false);
+
+    size_t pos = 2;
+    size_t next_word = 0;
+    while (pos < line.size()) {
+        // single space separated words, in their canonical order
+        if (line[pos] != ' ' || pos + 1 == line.size())
+            return false;
+        const char letter = line[++pos];
+        while (next_word < WordsCount && Words[next_word].letter != letter) {
+            ++next_word;
+        }
+        if (next_word == WordsCount)
+            return false;
+
+        const size_t end = std::min(line.find(' ', pos), line.size());
+        const std::string_view text = line.substr(pos + 1, end - pos - 1);
+        int64_t& value = move.values[next_word];
+        if (!parse_value(text, Words[next_word].decimals, value))
+            return false;
+        std::array<char, MaxValueLength> rendered;
+        if (std::string_view(rendered.data(), render_value(value, Words[next_word].decimals, rendered.data())) != text)
+            return false;
+        move.present[next_word] = true;
+        ++next_word;
+        pos = end;
+    }
+
+    // I and J are present only, and always, into the G2/G3 lines
+    const bool arc = move.command >= 2;
+    return move.present[(size_t)EWord::I] == arc && move.present[(size_t)EWord::J] == arc;
+}
+
+static uint8_t move_opcode(const MoveLine& move)
+{
+    uint8_t opcode = Move | (uint8_t)(move.command << CommandShift);
+    for (size_t i = 0; i < WordsCount; ++i) {
+        if (move.present[i])
+            opcode |= Words[i].mask;
+    }
+    return opcode;
+}
+
+static bool is_word_present(uint8_t opcode, size_t word)
+{
+    return (Words[word].mask != 0) ? (opcode & Words[word].mask) != 0 : ((opcode >> CommandShift) & 0x03) >= 2;
+}
+
+void encode(std::string_view src, std::pmr::vector<uint8_t>& dst)
+{
+    std::array<int64_t, WordsCount> previous{};
+    // start of the text not yet encoded, saved as literal when reaching the next move line
+    size_t literal_begin = 0;
+    auto append_literal = [&src, &dst, &literal_begin](size_t literal_end) {
+        if (literal_end > literal_begin) {
+            dst.push_back(Literal);
+            append_varint(dst, literal_end - literal_begin);
+            dst.insert(dst.end(), src.begin() + literal_begin, src.begin() + literal_end);
+        }
+    };
+
+    MoveLine move;
+    size_t begin_pos = 0;
+    while (begin_pos < src.size()) {
+        const size_t newline_pos = src.find('\n', begin_pos);
+        if (newline_pos == std::string_view::npos)
+            break;
+        const size_t end_pos = newline_pos + 1;
+        if (!parse_move(src.substr(begin_pos, newline_pos - begin_pos), move)) {
+            begin_pos = end_pos;
+            continue;
+        }
+
+        append_literal(begin_pos);
+        dst.push_back(move_opcode(move));
+        for (size_t i = 0; i < WordsCount; ++i) {
+            if (!move.present[i])
+                continue;
+            const int64_t value = move.values[i];
+            append_varint(dst, zigzag_encode(Words[i].delta ? value - previous[i] : value));
+            previous[i] = value;
+        }
+        begin_pos = literal_begin = end_pos;
+    }
+    append_literal(src.size());
+}
+
+bool decode(const std::pmr::vector<uint8_t>& src, std::pmr::string& dst)
+{
+    std::array<int64_t, WordsCount> previous{};
+    std::array<char, MaxValueLength> rendered;
+    size_t pos = 0;
+    while (pos < src.size()) {
+        const uint8_t opcode = src[pos++];
+        if (opcode == Literal) {
+            uint64_t size;
+            if (!read_varint(src, pos, size) || size > src.size() - pos)
+                return false;
+            dst.append(reinterpret_cast<const char*>(src.data() + pos), (size_t)size);
+            pos += (size_t)size;
+        }
+        else if ((opcode & Move) != 0) {
+            const uint8_t command = (opcode >> CommandShift) & 0x03;
+            dst.push_back('G');
+            dst.push_back((char)('0' + command));
+            for (size_t i = 0; i < WordsCount; ++i) {
+                if (!is_word_present(opcode, i))
+                    continue;
+                uint64_t encoded;
+                if (!read_varint(src, pos, encoded))
+                    return false;
+                const int64_t value = decode_word(i, encoded, previous[i]);
+                previous[i] = value;
+                dst.push_back(' ');
+                dst.push_back(Words[i].letter);
+                dst.append(rendered.data(), render_value(value, Words[i].decimals, rendered.data()));
+            }
+            dst.push_back('\n');
+        }
+        else
+            return false;
+    }
+    return true;
+}
+
+void encode_columns(std::string_view src, Columns& dst)
+{
+    dst.clear();
+    dst.resize(ColumnsCount);
+    std::pmr::vector<uint8_t>& opcodes = dst[(size_t)EColumn::Opcodes];
+    std::pmr::vector<uint8_t>& literals = dst[(size_t)EColumn::Literals];
+    std::array<int64_t, WordsCount> previous{};
+    MoveLine move;
+    size_t begin_pos = 0;
+    while (begin_pos < src.size()) {
+        const size_t newline_pos = src.find('\n', begin_pos);
+        // the last line, if not terminated by a newline, is saved as literal
+        const size_t end_pos = (newline_pos == std::string_view::npos) ? src.size() : newline_pos + 1;
+        if (newline_pos == std::string_view::npos || !parse_move(src.substr(begin_pos, newline_pos - begin_pos), move)) {
+            opcodes.push_back(Literal);
+            literals.insert(literals.end(), src.begin() + begin_pos, src.begin() + end_pos);
+            begin_pos = end_pos;
+            continue;
+        }
+
+        opcodes.push_back(move_opcode(move));
+        for (size_t i = 0; i < WordsCount; ++i) {
+            if (!move.present[i])
+                continue;
+            const int64_t value = move.values[i];
+            append_varint(dst[(size_t)Words[i].column], zigzag_encode(Words[i].delta ? value - previous[i] : value));
+            previous[i] = value;
+        }
+        begin_pos = end_pos;
+    }
+}
+
+bool decode_columns(const Columns& src, std::pmr::string& dst)
+{
+    if (src.size() != ColumnsCount)
+        return false;
+
+    const std::pmr::vector<uint8_t>& opcodes = src[(size_t)EColumn::Opcodes];
+    const std::pmr::vector<uint8_t>& literals = src[(size_t)EColumn::Literals];
+    std::array<size_t, ColumnsCount> positions{};
+    std::array<int64_t, WordsCount> previous{};
+    std::array<char, MaxValueLength> rendered;
+    for (const uint8_t opcode : opcodes) {
+        if (opcode == Literal) {
+            // a single line, the last one may miss the newline
+            size_t& pos = positions[(size_t)EColumn::Literals];
+            if (pos == literals.size())
+                return false;
+            const auto newline_it = std::find(literals.begin() + pos, literals.end(), (uint8_t)'\n');
+            const size_t end_pos = (newline_it == literals.end()) ? literals.size() : (size_t)(newline_it - literals.begin()) + 1;
+            dst.append(reinterpret_cast<const char*>(literals.data() + pos), end_pos - pos);
+            pos = end_pos;
+        }
+        else if ((opcode & Move) != 0) {
+            dst.push_back('G');
+            dst.push_back((char)('0' + ((opcode >> CommandShift) & 0x03)));
+            for (size_t i = 0; i < WordsCount; ++i) {
+                if (!is_word_present(opcode, i))
+                    continue;
+                const size_t column = (size_t)Words[i].column;
+                uint64_t encoded;
+                if (!read_varint(src[column], positions[column], encoded))
+                    return false;
+                const int64_t value = decode_word(i, encoded, previous[i]);
+                previous[i] = value;
+                dst.push_back(' ');
+                dst.push_back(Words[i].letter);
+                dst.append(rendered.data(), render_value(value, Words[i].decimals, rendered.data()));
+            }
+            dst.push_back('\n');
+        }
+        else
+            return false;
+    }
+
+    // all the columns must be consumed
+    for (size_t i = 0; i < ColumnsCount; ++i) {
+        if (i != (size_t)EColumn::Opcodes && positions[i] != src[i].size())
+            return false;
+    }
+    return true;
+}
+
+}}} // namespace bgcode::binarize::GCodeTokens
@@ -0,0 +1,67 @@
+#ifndef _BGCODE_BINARIZE_GCODE_TOKENS_HPP_
+#define _BGCODE_BINARIZE_GCODE_TOKENS_HPP_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory_resource>
+
+//
+// Tokenized G-code encoding (EGCodeEncodingType::Tokenized).
+// G0/G1/G2/G3 lines are stored as an opcode followed by their coordinates, as fixed-point integers saved into
+// zigzag varints. X, Y, Z and F are delta-encoded against the previous move of the block, E, I and J (which are
+// relative in the sliced gcode) are saved as they are. Any other line is saved as literal text.
+// A line is tokenized only if it can be regenerated byte by byte, so decoding always returns the original text.
+//
+// Records:
+// 0x00, varint size, size bytes - literal text
+// 0b1CCMMMMM                    - line G<CC>, followed by the words marked into the mask MMMMM, in the order
+//                                 X (bit 0), Y (bit 1), Z (bit 2), I, J (always present for G2/G3), E (bit 3), F (bit 4)
+// The values have 3 decimals, 5 for E. Every block is encoded independently, the deltas start from 0.
+//
+// Columnar G-code encoding (EGCodeEncodingType::Columnar).
+// The same records, split into columns: the opcodes (one per line, 0x00 for a literal line), the values of X, Y, Z,
+// E, F and of I/J, and the text of the literal lines (newlines included). Keeping values with similar distributions
+// together improves the ratio of the compression applied to each column.
+// The block data contains, for each column, its size as varint followed, if the block is compressed, by its compressed
+// size as varint, then the columns, each one compressed independently with the compression of the block.
+// The uncompressed size into the block header is the size the data would have with no compression.
+//
+
+namespace bgcode { namespace binarize { namespace GCodeTokens {
+
+enum class EColumn : uint8_t
+{
+    Opcodes,
+    X,
+    Y,
+    Z,
+    E,
+    F,
+    Arcs,
+    Literals
+};
+static constexpr const size_t ColumnsCount{ 8 };
+
+// One vector per column, in EColumn order
+using Columns = std::pmr::vector<std::pmr::vector<uint8_t>>;
+
+// The temporaries are allocated from the memory resource of dst
+extern void encode(std::string_view src, std::pmr::vector<uint8_t>& dst);
+// Returns false if src is not a valid tokenized gcode
+extern bool decode(const std::pmr::vector<uint8_t>& src, std::pmr::string& dst);
+
+// The columns are allocated from the memory resource of dst
+extern void encode_columns(std::string_view src, Columns& dst);
+// Returns false if src are not valid columns
+extern bool decode_columns(const Columns& src, std::pmr::string& dst);
+
+// Unsigned LEB128 integers
+extern void append_varint(std::pmr::vector<uint8_t>& dst, uint64_t value);
+// Returns false if src ends before the end of the value
+extern bool read_varint(const std::pmr::vector<uint8_t>& src, size_t& pos, uint64_t& value);
+
+}}} // namespace bgcode::binarize::GCodeTokens
+
+#endif // _BGCODE_BINARIZE_GCODE_TOKENS_HPP_
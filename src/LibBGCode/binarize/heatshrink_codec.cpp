@@ -0,0 +1,173 @@
+#include "heatshrink_codec.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bgcode { namespace binarize { namespace HeatshrinkCodec {
+
+// Shorter backreferences are not smaller than the literals they replace
+static constexpr const size_t MinMatch{ 3 };
+static constexpr const uint32_t HashBits{ 13 };
+// Max count of positions visited for each match, bounds the time spent on highly repetitive data
+static constexpr const size_t MaxChainLength{ 256 };
+static constexpr const uint32_t NoPosition{ 0xFFFFFFFF };
+
+// Hash of the MinMatch bytes starting at p
+static uint32_t hash(const uint8_t* p)
+{
+    const uint32_t value = (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | (uint32_t)p[2];
+    return (value * 2654435761u) >> (32 - HashBits);
+}
+
+// Writes MSB first
+class BitWriter
+{
+public:
+    explicit BitWriter(std::pmr::vector<uint8_t>& dst) : m_dst(dst) {}
+
+    // count must not be greater than 24
+    void write(uint32_t value, uint8_t count) {
+        m_bits = (m_bits << count) | value;
+        m_count += count;
+        while (m_count >= 8) {
+            m_count -= 8;
+            m_dst.push_back((uint8_t)(m_bits >> m_count));
+        }
+    }
+
+    // pads the last byte with zeros
+    void flush() {
+        if (m_count > 0) {
+            m_dst.push_back((uint8_t)(m_bits << (8 - m_count)));
+            m_count = 0;
+        }
+    }
+
+private:
+    std::pmr::vector<uint8_t>& m_dst;
+    uint32_t m_bits{ 0 };
+    uint8_t m_count{ 0 };
+};
+
+void encode(const uint8_t* src, size_t size, uint8_t window_bits, uint8_t lookahead_bits, std::pmr::vector<uint8_t>& dst)
+{
+    std::pmr::memory_resource* resource = dst.get_allocator().resource();
+    dst.clear();
+    // 9 bits per byte at most
+    dst.reserve(size + size / 8 + 1);
+
+    const size_t window_size = size_t(1) << window_bits;
+    const size_t window_mask = window_size - 1;
+    const size_t max_match = size_t(1) << lookahead_bits;
+    // last position of each hash, and previous position with the same hash of each position into the window
+    std::pmr::vector<uint32_t> heads(size_t(1) << HashBits, NoPosition, resource);
+    std::pmr::vector<uint32_t> chains(window_size, NoPosition, resource);
+    auto insert = [&](size_t pos) {
+        if (pos + MinMatch <= size) {
+            uint32_t& head = heads[hash(src + pos)];
+            chains[pos & window_mask] = head;
+            head = (uint32_t)pos;
+        }
+    };
+
+    BitWriter writer(dst);
+    size_t pos = 0;
+    while (pos < size) {
+        // longest match into the window, the nearest one if more than one
+        size_t best_length = 0;
+        size_t best_offset = 0;
+        if (pos + MinMatch <= size) {
+            const size_t max_length = std::min(max_match, size - pos);
+            uint32_t candidate = heads[hash(src + pos)];
+            // the chains entries of the positions out of the window may have been overwritten
+            for (size_t i = 0; i < MaxChainLength && candidate != NoPosition && pos - candidate <= window_size; ++i) {
+                // a longer match must differ from the best one at its end
+                if (src[candidate + best_length] == src[pos + best_length]) {
+                    size_t length = 0;
+                    while (length < max_length && src[candidate + length] == src[pos + length]) {
+                        ++length;
+                    }
+                    if (length > best_length) {
+                        best_length = length;
+                        best_offset = pos - candidate;
+                        if (length == max_length)
+                            break;
+                    }
+                }
+                candidate = chains[candidate & window_mask];
+            }
+        }
+
+        if (best_length >= MinMatch) {
+            // tag 0 and offset
+            writer.write((uint32_t)(best_offset - 1), 1 + window_bits);
+            writer.write((uint32_t)(best_length - 1), lookahead_bits);
+            for (size_t i = 0; i < best_length; ++i) {
+                insert(pos + i);
+            }
+            pos += best_length;
+        }
+        else {
+            // tag 1 and literal
+            writer.write(0x100 | src[pos], 9);
+            insert(pos);
+            ++pos;
+        }
+    }
+    writer.flush();
+}
+
+bool decode(const uint8_t* src, size_t size, uint8_t window_bits, uint8_t lookahead_bits, uint8_t* dst, size_t dst_size)
+{
+    // next bits at the top
+    uint64_t bits = 0;
+    uint8_t bits_count = 0;
+    size_t src_pos = 0;
+    auto get_bits = [&](uint8_t count) {
+        const uint32_t ret = (uint32_t)(bits >> (64 - count));
+        bits <<= count;
+        bits_count -= count;
+        return ret;
+    };
+
+    const uint8_t backreference_bits = window_bits + lookahead_bits;
+    size_t dst_pos = 0;
+    while (dst_pos < dst_size) {
+        // room for the longest record
+        while (bits_count <= 56 && src_pos < size) {
+            bits |= (uint64_t)src[src_pos++] << (56 - bits_count);
+            bits_count += 8;
+        }
+        if (bits_count == 0)
+            return false;
+
+        if (get_bits(1) != 0) {
+            if (bits_count < 8)
+                return false;
+            dst[dst_pos++] = (uint8_t)get_bits(8);
+        }
+        else {
+            if (bits_count < backreference_bits)
+                return false;
+            const size_t offset = (size_t)get_bits(window_bits) + 1;
+            const size_t length = (size_t)get_bits(lookahead_bits) + 1;
+            if (length > dst_size - dst_pos)
+                return false;
+            if (offset >= length && offset <= dst_pos) {
+                memcpy(dst + dst_pos, dst + dst_pos - offset, length);
+                dst_pos += length;
+            }
+            else {
+                // overlapping the output, or starting before the data
+                for (size_t i = 0; i < length; ++i, ++dst_pos) {
+                    dst[dst_pos] = (offset <= dst_pos) ? dst[dst_pos - offset] : 0;
+                }
+            }
+        }
+    }
+
+    // only the padding of the last byte left
+    return src_pos == size && bits_count < 8;
+}
+
+}}} // namespace bgcode::binarize::HeatshrinkCodec
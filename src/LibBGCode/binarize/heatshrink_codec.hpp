@@ -0,0 +1,29 @@
+#ifndef _BGCODE_BINARIZE_HEATSHRINK_CODEC_HPP_
+#define _BGCODE_BINARIZE_HEATSHRINK_CODEC_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <memory_resource>
+
+//
+// Heatshrink compression (ECompressionType::Heatshrink_11_4 and ECompressionType::Heatshrink_12_4) of whole blocks.
+// The bit stream is the one of the heatshrink library, MSB first: a 1 bit tag, 1 followed by a literal byte, 0 followed
+// by a backreference (window_bits of offset - 1, lookahead_bits of length - 1), the last byte padded with zeros.
+// Instead of scanning the window for every byte, as the library encoder does, the matches are looked up through
+// hash chains built over the whole block, which is known in advance.
+// The decoder, specialized for the same whole block case, writes straight into the output buffer.
+//
+
+namespace bgcode { namespace binarize { namespace HeatshrinkCodec {
+
+// The temporaries are allocated from the memory resource of dst
+extern void encode(const uint8_t* src, size_t size, uint8_t window_bits, uint8_t lookahead_bits, std::pmr::vector<uint8_t>& dst);
+// Decodes src into the dst_size bytes of dst.
+// Returns false if src does not contain exactly dst_size bytes, followed by the padding of the last byte.
+// As for the library decoder, the backreferences before the start of the data read zeros.
+extern bool decode(const uint8_t* src, size_t size, uint8_t window_bits, uint8_t lookahead_bits, uint8_t* dst, size_t dst_size);
+
+}}} // namespace bgcode::binarize::HeatshrinkCodec
+
+#endif // _BGCODE_BINARIZE_HEATSHRINK_CODEC_HPP_
@@ -0,0 +1,128 @@
+#include "layer_index.hpp"
+#include "binarize.hpp"
+
+#include "core/core_impl.hpp"
+
+#include <algorithm>
+
+namespace bgcode {
+
+using namespace core;
+
+namespace binarize {
+
+static constexpr const std::array<char, 4> LAYER_INDEX_MAGIC{ 'B', 'G', 'L', 'I' };
+static constexpr const uint32_t LAYER_INDEX_VERSION = 1;
+
+template<class T>
+static bool write_value(FILE& file, const T& value)
+{
+    return fwrite(&value, 1, sizeof(T), &file) == sizeof(T);
+}
+
+template<class T>
+static bool read_value(FILE& file, T& value)
+{
+    return fread(&value, 1, sizeof(T), &file) == sizeof(T);
+}
+
+EResult write_layer_index(FILE& file, const LayerIndex& index)
+{
+    if (!write_value(file, load_integer<uint32_t>(LAYER_INDEX_MAGIC.begin(), LAYER_INDEX_MAGIC.end())) ||
+        !write_value(file, LAYER_INDEX_VERSION) ||
+        !write_value(file, (uint32_t)index.size()))
+        return EResult::WriteError;
+    for (const LayerIndexEntry& entry : index) {
+        if (!write_value(file, entry.z) || !write_value(file, entry.block_position) || !write_value(file, entry.data_offset))
+            return EResult::WriteError;
+    }
+    return EResult::Success;
+}
+
+EResult read_layer_index(FILE& file, LayerIndex& index)
+{
+    index.clear();
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    if (!read_value(file, magic) || !read_value(file, version))
+        return EResult::ReadError;
+    if (magic != load_integer<uint32_t>(LAYER_INDEX_MAGIC.begin(), LAYER_INDEX_MAGIC.end()))
+        return EResult::InvalidMagicNumber;
+    if (version != LAYER_INDEX_VERSION)
+        return EResult::InvalidVersionNumber;
+    if (!read_value(file, count))
+        return EResult::ReadError;
+    for (uint32_t i = 0; i < count; ++i) {
+        LayerIndexEntry& entry = index.emplace_back();
+        if (!read_value(file, entry.z) || !read_value(file, entry.block_position) || !read_value(file, entry.data_offset))
+            return EResult::ReadError;
+    }
+    return EResult::Success;
+}
+
+size_t find_layer(const LayerIndex& index, float z)
+{
+    auto it = std::find_if(index.begin(), index.end(), [z](const LayerIndexEntry& entry) { return entry.z >= z; });
+    return std::distance(index.begin(), it);
+}
+
+EResult read_layer_gcode(FILE& file, const LayerIndex& index, size_t layer, std::pmr::string& gcode)
+{
+    gcode.clear();
+    if (layer >= index.size())
+        return EResult::BlockNotFound;
+
+    if (fseek(&file, 0, SEEK_END) != 0)
+        return EResult::ReadError;
+    const long file_size = ftell(&file);
+
+    FileHeader file_header;
+    EResult res = read_header(file, file_header, nullptr);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    const LayerIndexEntry& begin = index[layer];
+    // the layer ends where the next one begins, or at the end of the gcode
+    const LayerIndexEntry* end = (layer + 1 < index.size()) ? &index[layer + 1] : nullptr;
+
+    std::pmr::memory_resource* resource = gcode.get_allocator().resource();
+    std::pmr::vector<std::byte> cs_buffer(65536, resource);
+    BlockHeader block_header;
+    long position = (long)begin.block_position;
+    while (position < file_size &&
+        (end == nullptr || position < (long)end->block_position || (position == (long)end->block_position && end->data_offset > 0))) {
+        if (fseek(&file, position, SEEK_SET) != 0)
+            return EResult::ReadError;
+        res = read_next_block_header(file, file_header, block_header);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        if ((EBlockType)block_header.type != EBlockType::GCode)
+            break;
+
+        res = verify_block_checksum(file, file_header, block_header, cs_buffer.data(), cs_buffer.size());
+        if (res != EResult::Success)
+            return res;
+        if (fseek(&file, block_header.get_position() + (long)block_header.get_size(), SEEK_SET) != 0)
+            return EResult::ReadError;
+        GCodeBlock block(resource);
+        res = block.read_data(file, file_header, block_header);
+        if (res != EResult::Success)
+            return res;
+
+        const size_t data_begin = (position == (long)begin.block_position) ? begin.data_offset : 0;
+        const size_t data_end = (end != nullptr && position == (long)end->block_position) ? end->data_offset : block.raw_data.size();
+        if (data_begin > data_end || data_end > block.raw_data.size())
+            return EResult::InvalidBuffer;
+        gcode.append(block.raw_data, data_begin, data_end - data_begin);
+
+        position = block_header.get_position() + (long)block_header.get_size() + (long)block_content_size(file_header, block_header);
+    }
+
+    return EResult::Success;
+}
+
+} // namespace binarize
+} // namespace bgcode
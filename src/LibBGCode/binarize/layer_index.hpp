@@ -0,0 +1,50 @@
+#ifndef BGCODE_BINARIZE_LAYER_INDEX_HPP
+#define BGCODE_BINARIZE_LAYER_INDEX_HPP
+
+#include "binarize/export.h"
+#include "core/core.hpp"
+
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+//
+// Index of the layers of a binary gcode file, built by the Binarizer from the ;LAYER_CHANGE and ;Z: comment lines.
+// It allows to decode only the gcode blocks containing a given layer, e.g. to resume a print or to preview a single layer.
+// The index is saved into a sidecar file.
+//
+
+namespace bgcode { namespace binarize {
+
+struct LayerIndexEntry
+{
+    // z of the layer, as found into the ;Z: line, 0 if missing
+    float z{ 0.0f };
+    // position of the header of the gcode block containing the first line of the layer, from the start of the file
+    uint64_t block_position{ 0 };
+    // offset of the first line of the layer into the decoded data of the block
+    uint32_t data_offset{ 0 };
+};
+
+// The entries are in layer order
+using LayerIndex = std::pmr::vector<LayerIndexEntry>;
+
+// Writes the given index into the given (sidecar) file
+extern BGCODE_BINARIZE_EXPORT core::EResult write_layer_index(FILE& file, const LayerIndex& index);
+
+// Reads the index from the given (sidecar) file
+// Returns EResult::InvalidMagicNumber or EResult::InvalidVersionNumber if the file does not contain a layer index.
+extern BGCODE_BINARIZE_EXPORT core::EResult read_layer_index(FILE& file, LayerIndex& index);
+
+// Returns the first layer with z not smaller than the given one, index.size() if none.
+extern BGCODE_BINARIZE_EXPORT size_t find_layer(const LayerIndex& index, float z);
+
+// Decodes the gcode of the given layer from the binary gcode file the index refers to, decoding only the blocks containing it.
+// The checksum of the decoded blocks is verified.
+// Returns EResult::BlockNotFound if layer is not smaller than index.size().
+extern BGCODE_BINARIZE_EXPORT core::EResult read_layer_gcode(FILE& file, const LayerIndex& index, size_t layer, std::pmr::string& gcode);
+
+} // namespace binarize
+} // namespace bgcode
+
+#endif // BGCODE_BINARIZE_LAYER_INDEX_HPP
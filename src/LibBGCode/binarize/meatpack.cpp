@@ -59,9 +59,9 @@ static std::string_view trim(const std::string_view& str)
 
 MPBinarizer::LookupTables MPBinarizer::s_lookup_tables = { { 0 }, { 0 }, false, 0 };
 
-MPBinarizer::MPBinarizer(uint8_t flags) : m_flags(flags) {}
+MPBinarizer::MPBinarizer(uint8_t flags, std::pmr::memory_resource* resource) : m_flags(flags), m_resource(resource) {}
 
-void MPBinarizer::initialize(std::vector<uint8_t>& dst)
+void MPBinarizer::initialize(std::pmr::vector<uint8_t>& dst)
 {
     initialize_lookup_tables();
     append_command(Command_EnablePacking, dst);
@@ -70,7 +70,7 @@ void MPBinarizer::initialize(std::vector<uint8_t>& dst)
     m_binarizing = true;
 }
 
-void MPBinarizer::finalize(std::vector<uint8_t>& dst)
+void MPBinarizer::finalize(std::pmr::vector<uint8_t>& dst)
 {
     if ((m_flags & Flag_RemoveComments) != 0) {
         assert(m_binarizing);
@@ -79,14 +79,14 @@ void MPBinarizer::finalize(std::vector<uint8_t>& dst)
     }
 }
 
-void MPBinarizer::binarize_line(const std::string& line, std::vector<uint8_t>& dst)
+void MPBinarizer::binarize_line(std::string_view line, std::pmr::vector<uint8_t>& dst)
 {
-    auto unified_method = [this](const std::string& line) {
-        const std::string::size_type g_idx = line.find('G');
+    // processes the given line in place
+    auto unified_method = [this](std::pmr::string& result) {
+        const std::string::size_type g_idx = result.find('G');
         if (g_idx != std::string::npos) {
-            if (g_idx + 1 < line.size() && line[g_idx + 1] >= '0' && line[g_idx + 1] <= '9') {
+            if (g_idx + 1 < result.size() && result[g_idx + 1] >= '0' && result[g_idx + 1] <= '9') {
                 if ((m_flags & Flag_OmitWhitespaces) != 0) {
-                    std::string result = line;
                     std::replace(result.begin(), result.end(), 'e', 'E');
                     std::replace(result.begin(), result.end(), 'x', 'X');
                     std::replace(result.begin(), result.end(), 'g', 'G');
@@ -97,13 +97,13 @@ void MPBinarizer::binarize_line(const std::string& line, std::vector<uint8_t>& d
                         for (size_t i = 0; i < result.size(); ++i) {
                             checksum ^= static_cast<uint8_t>(result[i]);
                         }
-                        result += "*" + std::to_string(checksum);
+                        result += '*';
+                        result += std::to_string(checksum);
                     }
                     result += '\n';
-                    return result;
+                    return;
                 }
                 else {
-                    std::string result = line;
                     std::replace(result.begin(), result.end(), 'x', 'X');
                     std::replace(result.begin(), result.end(), 'g', 'G');
                     result.erase(std::remove(result.begin(), result.end(), ' '), result.end());
@@ -113,14 +113,14 @@ void MPBinarizer::binarize_line(const std::string& line, std::vector<uint8_t>& d
                         for (size_t i = 0; i < result.size(); ++i) {
                             checksum ^= static_cast<uint8_t>(result[i]);
                         }
-                        result += "*" + std::to_string(checksum);
+                        result += '*';
+                        result += std::to_string(checksum);
                     }
                     result += '\n';
-                    return result;
+                    return;
                 }
             }
         }
-        return line;
     };
     auto is_packable = [](char c) {
         return (s_lookup_tables.packable[static_cast<uint8_t>(c)] != 0);
@@ -149,14 +149,14 @@ void MPBinarizer::binarize_line(const std::string& line, std::vector<uint8_t>& d
             line.size() < 2)
             return;
 
-        std::string modifiedLine = std::string(trim(std::string_view(line.substr(0, line.find(';')))));
+        std::pmr::string modifiedLine(trim(line.substr(0, line.find(';'))), m_resource);
         if (modifiedLine.empty())
             return;
-        modifiedLine = unified_method(modifiedLine);
+        unified_method(modifiedLine);
         if (modifiedLine.back() != '\n')
             modifiedLine.push_back('\n');
         const size_t line_len = modifiedLine.size();
-        std::vector<uint8_t> temp_buffer;
+        std::pmr::vector<uint8_t> temp_buffer(m_resource);
         temp_buffer.reserve(line_len);
 
         for (size_t line_idx = 0; line_idx < line_len; line_idx += 2) {
@@ -196,7 +196,7 @@ void MPBinarizer::binarize_line(const std::string& line, std::vector<uint8_t>& d
     }
 }
 
-void MPBinarizer::append_command(unsigned char cmd, std::vector<uint8_t>& dst) {
+void MPBinarizer::append_command(unsigned char cmd, std::pmr::vector<uint8_t>& dst) {
     dst.emplace_back(Command_SignalByte);
     dst.emplace_back(Command_SignalByte);
     dst.emplace_back(cmd);
@@ -227,7 +227,7 @@ void MPBinarizer::initialize_lookup_tables() {
 }
 
 // See for reference: https://github.com/scottmudge/Prusa-Firmware-MeatPack/blob/MK3_sm_MeatPack/Firmware/meatpack.cpp
-void unbinarize(const std::vector<uint8_t>& src, std::string& dst)
+void unbinarize(const std::pmr::vector<uint8_t>& src, std::pmr::string& dst)
 {
     bool unbinarizing = false;
     bool nospace_enabled = false;
@@ -343,7 +343,7 @@ void unbinarize(const std::vector<uint8_t>& src, std::string& dst)
         return (size_t)0;
     };
 
-    std::vector<uint8_t> unbin_buffer(2 * src.size(), 0);
+    std::pmr::vector<uint8_t> unbin_buffer(2 * src.size(), 0, dst.get_allocator().resource());
     auto it_unbin_end = unbin_buffer.begin();
 
     bool add_space = false;
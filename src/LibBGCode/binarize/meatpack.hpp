@@ -5,6 +5,8 @@
 #include <vector>
 #include <string>
 #include <array>
+#include <string_view>
+#include <memory_resource>
 
 //
 // Adaptation of MeatPack G-Code Compression taken from:
@@ -22,16 +24,18 @@ static constexpr const uint8_t Flag_RemoveComments{ 0x02 };
 class MPBinarizer
 {
 public:
-    explicit MPBinarizer(uint8_t flags = 0);
+    // The temporaries used to process the lines are allocated from the given memory resource
+    explicit MPBinarizer(uint8_t flags = 0, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
-    void initialize(std::vector<uint8_t>& dst);
-    void finalize(std::vector<uint8_t>& dst);
+    void initialize(std::pmr::vector<uint8_t>& dst);
+    void finalize(std::pmr::vector<uint8_t>& dst);
 
-    void binarize_line(const std::string& line, std::vector<uint8_t>& dst);
+    void binarize_line(std::string_view line, std::pmr::vector<uint8_t>& dst);
 
 private:
     unsigned char m_flags{ 0 };
     bool m_binarizing{ false };
+    std::pmr::memory_resource* m_resource{ nullptr };
 
     struct LookupTables
     {
@@ -43,11 +47,12 @@ private:
 
     static LookupTables s_lookup_tables;
 
-    void append_command(unsigned char cmd, std::vector<uint8_t>& dst);
+    void append_command(unsigned char cmd, std::pmr::vector<uint8_t>& dst);
     void initialize_lookup_tables();
 };
 
-extern void unbinarize(const std::vector<uint8_t>& src, std::string& dst);
+// The temporary buffer is allocated from the memory resource of dst
+extern void unbinarize(const std::pmr::vector<uint8_t>& src, std::pmr::string& dst);
 
 } // namespace MeatPack
 
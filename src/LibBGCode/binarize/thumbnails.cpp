@@ -0,0 +1,242 @@
+#include "thumbnails.hpp"
+
+#include "core/core_impl.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif // WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif // NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace bgcode {
+
+using namespace core;
+
+namespace binarize {
+
+static uint16_t thumbnail_formats_count() { return 1 + (uint16_t)EThumbnailFormat::QOI; }
+
+static EResult check_params(const ThumbnailParams& params, const BlockHeader& block_header)
+{
+    if (params.format >= thumbnail_formats_count())
+        return EResult::InvalidThumbnailFormat;
+    if (params.width == 0)
+        return EResult::InvalidThumbnailWidth;
+    if (params.height == 0)
+        return EResult::InvalidThumbnailHeight;
+    if (block_header.uncompressed_size == 0)
+        return EResult::InvalidThumbnailDataSize;
+    return EResult::Success;
+}
+
+long ThumbnailInfo::get_data_position() const
+{
+    return block_header.get_position() + (long)block_header.get_size() + (long)block_parameters_size(EBlockType::Thumbnail);
+}
+
+EResult enumerate_thumbnails(FILE& file, FileHeader& file_header, std::vector<ThumbnailInfo>& thumbnails)
+{
+    thumbnails.clear();
+    EResult res = read_header(file, file_header, nullptr);
+    if (res != EResult::Success)
+        return res;
+
+    BlockHeader block_header;
+    while (true) {
+        res = read_next_block_header(file, file_header, block_header);
+        if (res != EResult::Success)
+            return res;
+        if ((EBlockType)block_header.type == EBlockType::GCode)
+            break;
+
+        if ((EBlockType)block_header.type == EBlockType::Thumbnail) {
+            ThumbnailInfo& thumbnail = thumbnails.emplace_back();
+            thumbnail.block_header = block_header;
+            res = thumbnail.params.read(file);
+            if (res != EResult::Success)
+                return res;
+            res = check_params(thumbnail.params, block_header);
+            if (res != EResult::Success)
+                return res;
+        }
+
+        res = skip_block(file, file_header, block_header);
+        if (res != EResult::Success)
+            return res;
+    }
+
+    return EResult::Success;
+}
+
+const ThumbnailInfo* select_thumbnail(const std::vector<ThumbnailInfo>& thumbnails, EThumbnailFormat format, uint16_t width, uint16_t height)
+{
+    auto area = [](const ThumbnailInfo& t) { return (uint32_t)t.params.width * t.params.height; };
+    auto covers = [width, height](const ThumbnailInfo& t) { return t.params.width >= width && t.params.height >= height; };
+
+    const bool format_found = std::any_of(thumbnails.begin(), thumbnails.end(),
+        [format](const ThumbnailInfo& t) { return t.params.format == (uint16_t)format; });
+
+    const ThumbnailInfo* ret = nullptr;
+    for (const ThumbnailInfo& t : thumbnails) {
+        if (format_found && t.params.format != (uint16_t)format)
+            continue;
+        if (ret == nullptr)
+            ret = &t;
+        else if (covers(t) != covers(*ret)) {
+            if (covers(t))
+                ret = &t;
+        }
+        else if (covers(t) ? area(t) < area(*ret) : area(t) > area(*ret))
+            ret = &t;
+    }
+    return ret;
+}
+
+EResult read_thumbnail_data(FILE& file, const FileHeader& file_header, const ThumbnailInfo& thumbnail, std::byte* buffer, size_t buffer_size,
+    bool verify_checksum)
+{
+    const size_t data_size = thumbnail.get_data_size();
+    if (buffer == nullptr || buffer_size < data_size)
+        return EResult::InvalidBuffer;
+
+    const EChecksumType checksum_type = (EChecksumType)file_header.checksum_type;
+    const long position = verify_checksum ? thumbnail.block_header.get_position() + (long)thumbnail.block_header.get_size() :
+        thumbnail.get_data_position();
+    if (fseek(&file, position, SEEK_SET) != 0)
+        return EResult::ReadError;
+
+    Checksum cs(checksum_type);
+    if (verify_checksum) {
+        // the parameters are covered by the checksum
+        ThumbnailParams params;
+        const EResult res = params.read(file);
+        if (res != EResult::Success)
+            return res;
+        update_checksum(cs, thumbnail.block_header);
+        cs.append(params.format);
+        cs.append(params.width);
+        cs.append(params.height);
+    }
+
+    if (fread(buffer, 1, data_size, &file) != data_size)
+        return EResult::ReadError;
+
+    if (verify_checksum && checksum_type != EChecksumType::None) {
+        cs.append(buffer, data_size);
+        Checksum file_cs(checksum_type);
+        const EResult res = file_cs.read(file);
+        if (res != EResult::Success)
+            return res;
+        if (!cs.matches(file_cs))
+            return EResult::InvalidChecksum;
+    }
+
+    return EResult::Success;
+}
+
+EResult get_thumbnail_view(const std::byte* file_data, size_t file_size, const FileHeader& file_header, const ThumbnailInfo& thumbnail,
+    bool verify_checksum, const std::byte*& image)
+{
+    const EChecksumType checksum_type = (EChecksumType)file_header.checksum_type;
+    const size_t payload_position = (size_t)thumbnail.block_header.get_position() + thumbnail.block_header.get_size();
+    const size_t payload_size = block_payload_size(thumbnail.block_header);
+    if (file_data == nullptr || thumbnail.block_header.get_position() < 0 ||
+        payload_position + payload_size + checksum_size(checksum_type) > file_size)
+        return EResult::ReadError;
+
+    if (verify_checksum && checksum_type != EChecksumType::None) {
+        Checksum cs(checksum_type);
+        update_checksum(cs, thumbnail.block_header);
+        cs.append(file_data + payload_position, payload_size);
+        if (std::memcmp(cs.data(), file_data + payload_position + payload_size, cs.size()) != 0)
+            return EResult::InvalidChecksum;
+    }
+
+    image = file_data + thumbnail.get_data_position();
+    return EResult::Success;
+}
+
+EResult MappedFile::open(const char* filename)
+{
+    close();
+#ifdef _WIN32
+    const int wlength = MultiByteToWideChar(CP_UTF8, 0, filename, -1, nullptr, 0);
+    if (wlength == 0)
+        return EResult::ReadError;
+    std::vector<wchar_t> wfilename(wlength);
+    MultiByteToWideChar(CP_UTF8, 0, filename, -1, wfilename.data(), wlength);
+
+    HANDLE file = CreateFileW(wfilename.data(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return EResult::ReadError;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        return EResult::ReadError;
+    }
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return EResult::ReadError;
+    }
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return EResult::ReadError;
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_data = static_cast<const std::byte*>(data);
+    m_size = (size_t)size.QuadPart;
+#else
+    const int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+        return EResult::ReadError;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return EResult::ReadError;
+    }
+    void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file referenced
+    ::close(fd);
+    if (data == MAP_FAILED)
+        return EResult::ReadError;
+    m_data = static_cast<const std::byte*>(data);
+    m_size = (size_t)st.st_size;
+#endif // _WIN32
+    return EResult::Success;
+}
+
+void MappedFile::close()
+{
+    if (m_data == nullptr)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file = nullptr;
+#else
+    munmap(const_cast<std::byte*>(m_data), m_size);
+#endif // _WIN32
+    m_data = nullptr;
+    m_size = 0;
+}
+
+} // namespace binarize
+} // namespace bgcode
@@ -0,0 +1,79 @@
+#ifndef BGCODE_BINARIZE_THUMBNAILS_HPP
+#define BGCODE_BINARIZE_THUMBNAILS_HPP
+
+#include "binarize/export.h"
+#include "core/core.hpp"
+
+#include <vector>
+
+//
+// Lazy access to the thumbnails: the thumbnail blocks are enumerated reading only their parameters,
+// then the image of the chosen thumbnail is read into a caller buffer or accessed in place into a memory mapped file.
+//
+
+namespace bgcode { namespace binarize {
+
+struct BGCODE_BINARIZE_EXPORT ThumbnailInfo
+{
+    core::BlockHeader block_header;
+    core::ThumbnailParams params{ 0, 0, 0 };
+
+    // position of the image in the file
+    long get_data_position() const;
+    // size of the image, in bytes
+    size_t get_data_size() const { return block_header.uncompressed_size; }
+};
+
+// Enumerates the thumbnail blocks of the file, without reading the images.
+// The enumeration stops at the first gcode block.
+// If return == EResult::Success:
+// - file_header will contain the file header.
+// - thumbnails will contain the thumbnails, in file order.
+extern BGCODE_BINARIZE_EXPORT core::EResult enumerate_thumbnails(FILE& file, core::FileHeader& file_header, std::vector<ThumbnailInfo>& thumbnails);
+
+// Returns the thumbnail which better fits the given format and size, nullptr if thumbnails is empty.
+// Thumbnails with the given format are preferred, among them the smallest one not smaller than the given size
+// is selected or, if all of them are smaller, the biggest one.
+extern BGCODE_BINARIZE_EXPORT const ThumbnailInfo* select_thumbnail(const std::vector<ThumbnailInfo>& thumbnails, core::EThumbnailFormat format,
+    uint16_t width, uint16_t height);
+
+// Reads the image of the given thumbnail into the given buffer, which must be at least thumbnail.get_data_size() bytes long.
+// If verify_checksum is true, the block checksum is verified while reading.
+// Returns EResult::InvalidBuffer if the buffer is too small.
+extern BGCODE_BINARIZE_EXPORT core::EResult read_thumbnail_data(FILE& file, const core::FileHeader& file_header, const ThumbnailInfo& thumbnail,
+    std::byte* buffer, size_t buffer_size, bool verify_checksum);
+
+// Read only view of a whole file mapped into memory
+class BGCODE_BINARIZE_EXPORT MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // filename is utf8 encoded
+    core::EResult open(const char* filename);
+    void close();
+
+    const std::byte* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const std::byte* m_data{ nullptr };
+    size_t m_size{ 0 };
+#ifdef _WIN32
+    void* m_file{ nullptr };
+    void* m_mapping{ nullptr };
+#endif // _WIN32
+};
+
+// Sets image to point to the image of the given thumbnail into the given file data (e.g. a MappedFile), without copying it.
+// If verify_checksum is true, the block checksum is verified.
+extern BGCODE_BINARIZE_EXPORT core::EResult get_thumbnail_view(const std::byte* file_data, size_t file_size, const core::FileHeader& file_header,
+    const ThumbnailInfo& thumbnail, bool verify_checksum, const std::byte*& image);
+
+} // namespace binarize
+} // namespace bgcode
+
+#endif // BGCODE_BINARIZE_THUMBNAILS_HPP
@@ -1,9 +1,20 @@
 #include "convert/convert.hpp"
+#include "convert/appender.hpp"
+#include "convert/catalog.hpp"
+#include "convert/metadata_editor.hpp"
+#include "convert/patch.hpp"
+#include "convert/validator.hpp"
+#include "binarize/deflate_dictionary.hpp"
 
 #include <string>
 #include <string_view>
 #include <iostream>
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <optional>
 #include <stdexcept>
 #include <stdlib.h>
 #include <boost/nowide/cstdio.hpp>
@@ -24,14 +35,25 @@ using namespace std::literals;
 static const BinarizerConfig DefaultBinarizerConfig;
 
 static const std::vector<Parameter> parameters = {
-    { "checksum"sv, { "None"sv, "CRC32"sv }, (size_t) DefaultBinarizerConfig.checksum },
-    { "file_metadata_compression"sv, { "None"sv, "Deflate"sv, "Heatshrink_11_4"sv, "Heatshrink_12_4"sv }, (size_t)DefaultBinarizerConfig.compression.file_metadata },
-    { "print_metadata_compression"sv, { "None"sv, "Deflate"sv, "Heatshrink_11_4"sv, "Heatshrink_12_4"sv }, (size_t)DefaultBinarizerConfig.compression.print_metadata },
-    { "printer_metadata_compression"sv, { "None"sv, "Deflate"sv, "Heatshrink_11_4"sv, "Heatshrink_12_4"sv }, (size_t)DefaultBinarizerConfig.compression.printer_metadata },
-    { "slicer_metadata_compression"sv, { "None"sv, "Deflate"sv, "Heatshrink_11_4"sv, "Heatshrink_12_4"sv }, (size_t)DefaultBinarizerConfig.compression.slicer_metadata },
-    { "gcode_compression"sv, { "None"sv, "Deflate"sv, "Heatshrink_11_4"sv, "Heatshrink_12_4"sv }, (size_t)DefaultBinarizerConfig.compression.gcode },
-    { "gcode_encoding"sv, { "None"sv, "MeatPack"sv, "MeatPackComments"sv }, (size_t)DefaultBinarizerConfig.gcode_encoding },
-    { "metadata_encoding"sv, { "INI"sv }, (size_t) DefaultBinarizerConfig.metadata_encoding }
+    { "checksum"sv, { "None"sv, "CRC32"sv, "CRC32C"sv }, (size_t) DefaultBinarizerConfig.checksum },
+    { "file_metadata_compression"sv, { "None"sv, "Deflate"sv, "Heatshrink_11_4"sv, "Heatshrink_12_4"sv, "DeflateDictionary"sv }, (size_t)DefaultBinarizerConfig.compression.file_metadata },
+    { "print_metadata_compression"sv, { "None"sv, "Deflate"sv, "Heatshrink_11_4"sv, "Heatshrink_12_4"sv, "DeflateDictionary"sv }, (size_t)DefaultBinarizerConfig.compression.print_metadata },
+    { "printer_metadata_compression"sv, { "None"sv, "Deflate"sv, "Heatshrink_11_4"sv, "Heatshrink_12_4"sv, "DeflateDictionary"sv }, (size_t)DefaultBinarizerConfig.compression.printer_metadata },
+    { "slicer_metadata_compression"sv, { "None"sv, "Deflate"sv, "Heatshrink_11_4"sv, "Heatshrink_12_4"sv, "DeflateDictionary"sv }, (size_t)DefaultBinarizerConfig.compression.slicer_metadata },
+    { "gcode_compression"sv, { "None"sv, "Deflate"sv, "Heatshrink_11_4"sv, "Heatshrink_12_4"sv, "DeflateDictionary"sv }, (size_t)DefaultBinarizerConfig.compression.gcode },
+    { "gcode_encoding"sv, { "None"sv, "MeatPack"sv, "MeatPackComments"sv, "Tokenized"sv, "Columnar"sv }, (size_t)DefaultBinarizerConfig.gcode_encoding },
+    { "metadata_encoding"sv, { "INI"sv }, (size_t) DefaultBinarizerConfig.metadata_encoding },
+    { "gcode_blocks"sv, { "Fixed size"sv, "Layer aligned"sv, "Content defined"sv }, (size_t)DefaultBinarizerConfig.layer_aligned_blocks },
+    { "index_block"sv, { "No"sv, "Yes"sv }, (size_t)DefaultBinarizerConfig.index_block },
+    { "hash_tree_block"sv, { "No"sv, "Yes"sv }, (size_t)DefaultBinarizerConfig.hash_tree_block },
+    { "auto_gcode_compression"sv, { "Disabled"sv, "Smallest"sv, "FastestDecoding"sv }, (size_t)DefaultBinarizerConfig.auto_gcode_compression },
+    // the values of the levels start from 1
+    { "metadata_deflate_level"sv, { "1"sv, "2"sv, "3"sv, "4"sv, "5"sv, "6"sv, "7"sv, "8"sv, "9"sv }, (size_t)DefaultBinarizerConfig.deflate.metadata.level - 1 },
+    { "metadata_deflate_strategy"sv, { "Default"sv, "Filtered"sv, "RLE"sv }, (size_t)DefaultBinarizerConfig.deflate.metadata.strategy },
+    { "metadata_deflate_mem_level"sv, { "1"sv, "2"sv, "3"sv, "4"sv, "5"sv, "6"sv, "7"sv, "8"sv, "9"sv }, (size_t)DefaultBinarizerConfig.deflate.metadata.mem_level - 1 },
+    { "gcode_deflate_level"sv, { "1"sv, "2"sv, "3"sv, "4"sv, "5"sv, "6"sv, "7"sv, "8"sv, "9"sv }, (size_t)DefaultBinarizerConfig.deflate.gcode.level - 1 },
+    { "gcode_deflate_strategy"sv, { "Default"sv, "Filtered"sv, "RLE"sv }, (size_t)DefaultBinarizerConfig.deflate.gcode.strategy },
+    { "gcode_deflate_mem_level"sv, { "1"sv, "2"sv, "3"sv, "4"sv, "5"sv, "6"sv, "7"sv, "8"sv, "9"sv }, (size_t)DefaultBinarizerConfig.deflate.gcode.mem_level - 1 }
 };
 
 class ScopedFile
@@ -45,7 +67,57 @@ private:
 
 void show_help() {
     std::cout << "Usage: bgcode filename [ Binarization parameters ]\n";
-    std::cout << "\nBinarization parameters (used only when converting to binary format):\n";
+    std::cout << "       bgcode transcode src_filename dst_filename [ Binarization parameters ] [ --jobs=N ]\n";
+    std::cout << "       bgcode catalog directory [ Catalog parameters ]\n";
+    std::cout << "       bgcode edit filename [ Edit parameters ]\n";
+    std::cout << "       bgcode append filename gcode_filename [ Append parameters ] [ Binarization parameters ]\n";
+    std::cout << "       bgcode concat dst_filename src_filename1 src_filename2 ...\n";
+    std::cout << "       bgcode split filename --blocks=N\n";
+    std::cout << "       bgcode diff old_filename new_filename patch_filename\n";
+    std::cout << "       bgcode patch old_filename patch_filename new_filename\n";
+    std::cout << "       bgcode verify filename [ Verify parameters ]\n";
+    std::cout << "       bgcode validate filename [ Validate parameters ]\n";
+    std::cout << "       bgcode train_dictionary dst_filename src_filename1 src_filename2 ... [ Dictionary parameters ]\n";
+    std::cout << "\nCatalog parameters:\n";
+    std::cout << "--cache=filename\n";
+    std::cout << "  cache file, read before and written after the scan\n";
+    std::cout << "--jobs=N\n";
+    std::cout << "  count of threads used to scan the files (default: hardware concurrency)\n";
+    std::cout << "--verify_checksum\n";
+    std::cout << "  verify the checksum of the metadata blocks\n";
+    std::cout << "\nEdit parameters:\n";
+    std::cout << "--set=block:key=value\n";
+    std::cout << "  set the value of the given metadata key, block is one of file, printer, print, slicer\n";
+    std::cout << "--erase=block:key\n";
+    std::cout << "  remove the given metadata key\n";
+    std::cout << "--output=filename\n";
+    std::cout << "  save the edited file with the given name (default: edit the file in place)\n";
+    std::cout << "\nAppend parameters (the gcode of the ascii file gcode_filename is saved after the gcode blocks of filename):\n";
+    std::cout << "--set=block:key=value, --erase=block:key\n";
+    std::cout << "  edit the metadata, as edit, once the gcode is appended; the edited blocks must keep their size\n";
+    std::cout << "\nSplit parameters:\n";
+    std::cout << "--blocks=N\n";
+    std::cout << "  count of gcode blocks of each part, saved as filename.1.bgcode, filename.2.bgcode...\n";
+    std::cout << "\nVerify parameters (the file must contain a hash tree block, see hash_tree_block):\n";
+    std::cout << "--jobs=N\n";
+    std::cout << "  count of threads used to verify the blocks (default: hardware concurrency)\n";
+    std::cout << "--blocks=first:count\n";
+    std::cout << "  verify only the given range of gcode blocks, the blocks preceding the gcode blocks are always verified\n";
+    std::cout << "--root=xxxxxxxx\n";
+    std::cout << "  check the hash tree against the given root (hexadecimal), as printed when verifying the original file\n";
+    std::cout << "\nValidate parameters:\n";
+    std::cout << "--jobs=N\n";
+    std::cout << "  count of threads used to validate the blocks (default: hardware concurrency)\n";
+    std::cout << "--no_decode\n";
+    std::cout << "  verify only the structure of the file and the checksums, do not decode the blocks\n";
+    std::cout << "--report\n";
+    std::cout << "  show all the blocks (default: show only the invalid blocks)\n";
+    std::cout << "\nDictionary parameters (the source files are ascii gcode files):\n";
+    std::cout << "--size=N\n";
+    std::cout << "  max size of the dictionary, in bytes (default: 16384)\n";
+    std::cout << "--format=raw|cpp\n";
+    std::cout << "  save the dictionary as it is or as a C++ string literal, to be embedded into the library (default: raw)\n";
+    std::cout << "\nBinarization parameters (used only when converting to binary format or transcoding):\n";
     for (const Parameter& p : parameters) {
         std::cout << "--" << p.name << "=X\n";
         std::cout << "  where X is one of:\n";
@@ -60,6 +132,148 @@ void show_help() {
     }
 }
 
+bool parse_binarizer_parameter(std::string_view a, BinarizerConfig& config)
+{
+    if (a.length() < 2 || a[0] != '-' || a[1] != '-') {
+        std::cout << "Found invalid parameter '" << a << "'\n";
+        std::cout << "Required syntax: --parameter=value\n";
+        return false;
+    }
+
+    const size_t pos = a.find("=");
+    if (pos == std::string_view::npos) {
+        std::cout << "Found invalid parameter '" << a << "'\n";
+        std::cout << "Required syntax: --parameter=value\n";
+        return false;
+    }
+
+    const std::string_view key = a.substr(2, pos - 2);
+    auto it = std::find_if(parameters.begin(), parameters.end(),
+        [&key](const Parameter& item) { return item.name == key; });
+    if (it == parameters.end()) {
+        std::cout << "Found unknown parameter '" << key << "'\n";
+        std::cout << "Accepted parameters:\n";
+        for (const Parameter& p : parameters) {
+            std::cout << p.name << "\n";
+        }
+        return false;
+    }
+
+    const Parameter& parameter = parameters[std::distance(parameters.begin(), it)];
+
+    const std::string_view value_str = a.substr(pos + 1);
+    int value;
+    try {
+        value = std::stoi(std::string(value_str));
+        if (value >= parameter.values.size())
+            throw std::runtime_error("invalid value");
+    }
+    catch (...) {
+        std::cout << "Found invalid value for parameter '" << parameter.name << "'\n";
+        std::cout << "Accepted values:\n";
+        for (size_t p = 0; p < parameter.values.size(); ++p) {
+            std::cout << p << ") " << parameter.values[p] << "\n";
+        }
+        return false;
+    }
+
+    if (parameter.name == "checksum")
+        config.checksum = (EChecksumType)value;
+    else if (parameter.name == "file_metadata_compression")
+        config.compression.file_metadata = (ECompressionType)value;
+    else if (parameter.name == "print_metadata_compression")
+        config.compression.print_metadata = (ECompressionType)value;
+    else if (parameter.name == "printer_metadata_compression")
+        config.compression.printer_metadata = (ECompressionType)value;
+    else if (parameter.name == "slicer_metadata_compression")
+        config.compression.slicer_metadata = (ECompressionType)value;
+    else if (parameter.name == "gcode_compression")
+        config.compression.gcode = (ECompressionType)value;
+    else if (parameter.name == "gcode_encoding")
+        config.gcode_encoding = (EGCodeEncodingType)value;
+    else if (parameter.name == "metadata_encoding")
+        config.metadata_encoding = (EMetadataEncodingType)value;
+    else if (parameter.name == "gcode_blocks") {
+        config.layer_aligned_blocks = value == 1;
+        config.content_defined_blocks = value == 2;
+    }
+    else if (parameter.name == "index_block")
+        config.index_block = value == 1;
+    else if (parameter.name == "hash_tree_block")
+        config.hash_tree_block = value == 1;
+    else if (parameter.name == "auto_gcode_compression")
+        config.auto_gcode_compression = (EAutoCompression)value;
+    else if (parameter.name == "metadata_deflate_level")
+        config.deflate.metadata.level = (uint8_t)(value + 1);
+    else if (parameter.name == "metadata_deflate_strategy")
+        config.deflate.metadata.strategy = (EDeflateStrategy)value;
+    else if (parameter.name == "metadata_deflate_mem_level")
+        config.deflate.metadata.mem_level = (uint8_t)(value + 1);
+    else if (parameter.name == "gcode_deflate_level")
+        config.deflate.gcode.level = (uint8_t)(value + 1);
+    else if (parameter.name == "gcode_deflate_strategy")
+        config.deflate.gcode.strategy = (EDeflateStrategy)value;
+    else if (parameter.name == "gcode_deflate_mem_level")
+        config.deflate.gcode.mem_level = (uint8_t)(value + 1);
+    return true;
+}
+
+void print_binarizer_config(const BinarizerConfig& config)
+{
+    std::cout << "Binarization parameters\n";
+    for (const Parameter& p : parameters) {
+        std::cout << p.name << ": ";
+        if (p.name == "checksum")
+            std::cout << p.values[(size_t)config.checksum] << "\n";
+        else if (p.name == "file_metadata_compression")
+            std::cout << p.values[(size_t)config.compression.file_metadata] << "\n";
+        else if (p.name == "print_metadata_compression")
+            std::cout << p.values[(size_t)config.compression.print_metadata] << "\n";
+        else if (p.name == "printer_metadata_compression")
+            std::cout << p.values[(size_t)config.compression.printer_metadata] << "\n";
+        else if (p.name == "slicer_metadata_compression")
+            std::cout << p.values[(size_t)config.compression.slicer_metadata] << "\n";
+        else if (p.name == "gcode_compression")
+            std::cout << p.values[(size_t)config.compression.gcode] << "\n";
+        else if (p.name == "gcode_encoding")
+            std::cout << p.values[(size_t)config.gcode_encoding] << "\n";
+        else if (p.name == "metadata_encoding")
+            std::cout << p.values[(size_t)config.metadata_encoding] << "\n";
+        else if (p.name == "gcode_blocks")
+            std::cout << p.values[config.content_defined_blocks ? 2 : (size_t)config.layer_aligned_blocks] << "\n";
+        else if (p.name == "index_block")
+            std::cout << p.values[(size_t)config.index_block] << "\n";
+        else if (p.name == "hash_tree_block")
+            std::cout << p.values[(size_t)config.hash_tree_block] << "\n";
+        else if (p.name == "auto_gcode_compression")
+            std::cout << p.values[(size_t)config.auto_gcode_compression] << "\n";
+        else if (p.name == "metadata_deflate_level")
+            std::cout << p.values[(size_t)config.deflate.metadata.level - 1] << "\n";
+        else if (p.name == "metadata_deflate_strategy")
+            std::cout << p.values[(size_t)config.deflate.metadata.strategy] << "\n";
+        else if (p.name == "metadata_deflate_mem_level")
+            std::cout << p.values[(size_t)config.deflate.metadata.mem_level - 1] << "\n";
+        else if (p.name == "gcode_deflate_level")
+            std::cout << p.values[(size_t)config.deflate.gcode.level - 1] << "\n";
+        else if (p.name == "gcode_deflate_strategy")
+            std::cout << p.values[(size_t)config.deflate.gcode.strategy] << "\n";
+        else if (p.name == "gcode_deflate_mem_level")
+            std::cout << p.values[(size_t)config.deflate.gcode.mem_level - 1] << "\n";
+    }
+}
+
+void print_binarizer_statistics(const BinarizerStatistics& statistics)
+{
+    const Parameter& compressions = *std::find_if(parameters.begin(), parameters.end(),
+        [](const Parameter& p) { return p.name == "gcode_compression"; });
+    std::cout << "GCode blocks\n";
+    for (size_t i = 0; i < statistics.gcode_blocks.size(); ++i) {
+        if (statistics.gcode_blocks[i] > 0)
+            std::cout << compressions.values[i] << ": " << statistics.gcode_blocks[i] << "\n";
+    }
+    std::cout << "size: " << statistics.gcode_blocks_size << " bytes (gcode: " << statistics.gcode_size << " bytes)\n";
+}
+
 bool parse_args(int argc, const char* argv[], std::string& src_filename, bool& src_is_binary, BinarizerConfig& config)
 {
     if (argc < 2) {
@@ -97,73 +311,779 @@ bool parse_args(int argc, const char* argv[], std::string& src_filename, bool& s
 
     if (!src_is_binary) {
         for (size_t i = 2; i < arguments.size(); ++i) {
-            const std::string_view& a = arguments[i];
-            if (a.length() < 2 || a[0] != '-' || a[1] != '-') {
-                std::cout << "Found invalid parameter '" << a << "'\n";
-                std::cout << "Required syntax: --parameter=value\n";
+            if (!parse_binarizer_parameter(arguments[i], config))
                 return false;
+        }
+    }
+    return true;
+}
+
+int transcode(int argc, const char* argv[])
+{
+    if (argc < 4) {
+        show_help();
+        return EXIT_FAILURE;
+    }
+
+    const std::string src_filename = argv[2];
+    const std::string dst_filename = argv[3];
+    BinarizerConfig config;
+    size_t jobs = 0;
+    for (int i = 4; i < argc; ++i) {
+        const std::string_view a = argv[i];
+        if (a.substr(0, 7) == "--jobs=") {
+            try {
+                jobs = std::stoul(std::string(a.substr(7)));
+            }
+            catch (...) {
+                std::cout << "Found invalid value for parameter 'jobs'\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (!parse_binarizer_parameter(a, config))
+            return EXIT_FAILURE;
+    }
+
+    FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+    if (src_file == nullptr) {
+        std::cout << "Unable to open file '" << src_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_src_file(src_file);
+
+    FILE* dst_file = boost::nowide::fopen(dst_filename.c_str(), "wb");
+    if (dst_file == nullptr) {
+        std::cout << "Unable to open file '" << dst_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_dst_file(dst_file);
+
+    const EResult res = bgcode::convert::transcode(*src_file, *dst_file, config, jobs);
+    if (res != EResult::Success) {
+        std::cout << "Unable to transcode the file '" << src_filename << "'\n";
+        std::cout << "Error: " << translate_result(res) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    print_binarizer_config(config);
+    std::cout << "Succesfully generated file '" << dst_filename << "'\n";
+    return EXIT_SUCCESS;
+}
+
+static std::string_view find_metadata(const std::vector<std::pair<std::string, std::string>>& metadata, std::string_view key)
+{
+    auto it = std::find_if(metadata.begin(), metadata.end(), [key](const auto& item) { return item.first == key; });
+    return (it != metadata.end()) ? std::string_view(it->second) : std::string_view();
+}
+
+int catalog(int argc, const char* argv[])
+{
+    if (argc < 3) {
+        show_help();
+        return EXIT_FAILURE;
+    }
+
+    const std::string directory = argv[2];
+    std::string cache_filename;
+    CatalogConfig config;
+    for (int i = 3; i < argc; ++i) {
+        const std::string_view a = argv[i];
+        if (a == "--verify_checksum")
+            config.verify_checksum = true;
+        else if (a.substr(0, 8) == "--cache=")
+            cache_filename = a.substr(8);
+        else if (a.substr(0, 7) == "--jobs=") {
+            try {
+                config.jobs = std::stoul(std::string(a.substr(7)));
+            }
+            catch (...) {
+                std::cout << "Found invalid value for parameter 'jobs'\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else {
+            std::cout << "Found invalid parameter '" << a << "'\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    Catalog catalog;
+    if (!cache_filename.empty())
+        // a missing or invalid cache simply results into a full scan
+        catalog.load(cache_filename);
+
+    const auto start = std::chrono::steady_clock::now();
+    size_t rescanned_count = 0;
+    EResult res = catalog.scan(directory, config, &rescanned_count);
+    if (res != EResult::Success) {
+        std::cout << "Unable to scan the directory '" << directory << "'\n";
+        std::cout << "Error: " << translate_result(res) << "\n";
+        return EXIT_FAILURE;
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    for (const CatalogEntry& entry : catalog.get_entries()) {
+        std::cout << entry.path << "\n";
+        if (entry.result != EResult::Success) {
+            std::cout << "  Error: " << translate_result(entry.result) << "\n";
+            continue;
+        }
+        std::cout << "  printer_model: " << find_metadata(entry.printer_metadata, "printer_model") << "\n";
+        std::cout << "  estimated printing time (normal mode): " << find_metadata(entry.print_metadata, "estimated printing time (normal mode)") << "\n";
+        if (entry.thumbnail_position >= 0)
+            std::cout << "  thumbnail: " << entry.thumbnail.width << "x" << entry.thumbnail.height << "\n";
+    }
+    std::cout << catalog.get_entries().size() << " files, " << rescanned_count << " scanned in " << elapsed.count() << " ms\n";
+
+    if (!cache_filename.empty()) {
+        res = catalog.save(cache_filename);
+        if (res != EResult::Success) {
+            std::cout << "Unable to save the cache file '" << cache_filename << "'\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Parses block:key[=value]
+static bool parse_metadata_edit(std::string_view a, bool erase, MetadataEdit& edit)
+{
+    static const std::vector<std::pair<std::string_view, EBlockType>> blocks = {
+        { "file"sv, EBlockType::FileMetadata },
+        { "printer"sv, EBlockType::PrinterMetadata },
+        { "print"sv, EBlockType::PrintMetadata },
+        { "slicer"sv, EBlockType::SlicerMetadata }
+    };
+
+    const size_t colon_pos = a.find(':');
+    const size_t equal_pos = a.find('=', colon_pos);
+    if (colon_pos == std::string_view::npos || erase != (equal_pos == std::string_view::npos))
+        return false;
+    auto it = std::find_if(blocks.begin(), blocks.end(), [block = a.substr(0, colon_pos)](const auto& item) { return item.first == block; });
+    if (it == blocks.end())
+        return false;
+
+    edit.block_type = it->second;
+    edit.key = a.substr(colon_pos + 1, erase ? std::string_view::npos : equal_pos - colon_pos - 1);
+    if (!erase)
+        edit.value = a.substr(equal_pos + 1);
+    edit.erase = erase;
+    return !edit.key.empty();
+}
+
+int edit(int argc, const char* argv[])
+{
+    if (argc < 3) {
+        show_help();
+        return EXIT_FAILURE;
+    }
+
+    const std::string filename = argv[2];
+    std::string output_filename;
+    std::vector<MetadataEdit> edits;
+    for (int i = 3; i < argc; ++i) {
+        const std::string_view a = argv[i];
+        const bool erase = a.substr(0, 8) == "--erase=";
+        if (erase || a.substr(0, 6) == "--set=") {
+            if (!parse_metadata_edit(a.substr(erase ? 8 : 6), erase, edits.emplace_back())) {
+                std::cout << "Found invalid parameter '" << a << "'\n";
+                std::cout << "Required syntax: --set=block:key=value or --erase=block:key\n";
+                return EXIT_FAILURE;
             }
+        }
+        else if (a.substr(0, 9) == "--output=")
+            output_filename = a.substr(9);
+        else {
+            std::cout << "Found invalid parameter '" << a << "'\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    EResult res = EResult::Success;
+    if (output_filename.empty()) {
+        FILE* file = boost::nowide::fopen(filename.c_str(), "r+b");
+        if (file == nullptr) {
+            std::cout << "Unable to open file '" << filename << "'\n";
+            return EXIT_FAILURE;
+        }
+        bool edited = false;
+        res = edit_metadata_in_place(*file, edits, edited);
+        fclose(file);
+        if (res == EResult::Success && edited) {
+            std::cout << "Succesfully edited file '" << filename << "' in place\n";
+            return EXIT_SUCCESS;
+        }
+        if (res == EResult::Success)
+            // the edited blocks do not fit, rewrite the file
+            output_filename = filename + ".tmp";
+    }
 
-            pos = a.find("=");
-            if (pos == std::string_view::npos) {
+    if (res == EResult::Success) {
+        FILE* src_file = boost::nowide::fopen(filename.c_str(), "rb");
+        if (src_file == nullptr) {
+            std::cout << "Unable to open file '" << filename << "'\n";
+            return EXIT_FAILURE;
+        }
+        ScopedFile scoped_src_file(src_file);
+        FILE* dst_file = boost::nowide::fopen(output_filename.c_str(), "wb");
+        if (dst_file == nullptr) {
+            std::cout << "Unable to open file '" << output_filename << "'\n";
+            return EXIT_FAILURE;
+        }
+        res = edit_metadata(*src_file, *dst_file, edits);
+        if (fclose(dst_file) != 0 && res == EResult::Success)
+            res = EResult::WriteError;
+    }
+
+    if (res != EResult::Success) {
+        std::cout << "Unable to edit the file '" << filename << "'\n";
+        std::cout << "Error: " << translate_result(res) << "\n";
+        if (!output_filename.empty())
+            boost::nowide::remove(output_filename.c_str());
+        return EXIT_FAILURE;
+    }
+
+    if (output_filename == filename + ".tmp") {
+        if (boost::nowide::remove(filename.c_str()) != 0 || boost::nowide::rename(output_filename.c_str(), filename.c_str()) != 0) {
+            std::cout << "Unable to replace file '" << filename << "'\n";
+            return EXIT_FAILURE;
+        }
+        output_filename = filename;
+    }
+    std::cout << "Succesfully generated file '" << output_filename << "'\n";
+    return EXIT_SUCCESS;
+}
+
+int append(int argc, const char* argv[])
+{
+    if (argc < 4) {
+        show_help();
+        return EXIT_FAILURE;
+    }
+
+    const std::string filename = argv[2];
+    const std::string gcode_filename = argv[3];
+    BinarizerConfig config;
+    std::vector<MetadataEdit> edits;
+    for (int i = 4; i < argc; ++i) {
+        const std::string_view a = argv[i];
+        const bool erase = a.substr(0, 8) == "--erase=";
+        if (erase || a.substr(0, 6) == "--set=") {
+            if (!parse_metadata_edit(a.substr(erase ? 8 : 6), erase, edits.emplace_back())) {
                 std::cout << "Found invalid parameter '" << a << "'\n";
-                std::cout << "Required syntax: --parameter=value\n";
-                return false;
+                std::cout << "Required syntax: --set=block:key=value or --erase=block:key\n";
+                return EXIT_FAILURE;
             }
+        }
+        else if (!parse_binarizer_parameter(a, config))
+            return EXIT_FAILURE;
+    }
 
-            const std::string_view key = a.substr(2, pos - 2);
-            auto it = std::find_if(parameters.begin(), parameters.end(),
-                [&key](const Parameter& item) { return item.name == key; });
-            if (it == parameters.end()) {
-                std::cout << "Found unknown parameter '" << key << "'\n";
-                std::cout << "Accepted parameters:\n";
-                for (const Parameter& p : parameters) {
-                    std::cout << p.name << "\n";
-                }
-                return false;
+    FILE* gcode_file = boost::nowide::fopen(gcode_filename.c_str(), "rb");
+    if (gcode_file == nullptr) {
+        std::cout << "Unable to open file '" << gcode_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    std::string gcode;
+    {
+        ScopedFile scoped_gcode_file(gcode_file);
+        std::array<char, 65536> buffer;
+        size_t size;
+        while ((size = fread(buffer.data(), 1, buffer.size(), gcode_file)) > 0) {
+            gcode.append(buffer.data(), size);
+        }
+        if (ferror(gcode_file)) {
+            std::cout << "Unable to read file '" << gcode_filename << "'\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (!gcode.empty() && gcode.back() != '\n')
+        gcode.push_back('\n');
+
+    FILE* file = boost::nowide::fopen(filename.c_str(), "r+b");
+    if (file == nullptr) {
+        std::cout << "Unable to open file '" << filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_file(file);
+
+    GCodeAppender appender;
+    EResult res = appender.open(*file, config);
+    if (res == EResult::Success)
+        res = appender.append_gcode(gcode);
+    if (res == EResult::Success)
+        res = appender.finalize();
+    bool edited = true;
+    if (res == EResult::Success && !edits.empty())
+        res = appender.update_metadata(edits, edited);
+    if (res != EResult::Success) {
+        std::cout << "Unable to append to the file '" << filename << "'\n";
+        std::cout << "Error: " << translate_result(res) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Succesfully appended to file '" << filename << "' (gcode blocks: " << appender.get_gcode_blocks_count() << ")\n";
+    if (!edited) {
+        std::cout << "The edited metadata do not fit into their blocks, use edit to rewrite the file\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int concat(int argc, const char* argv[])
+{
+    if (argc < 4) {
+        show_help();
+        return EXIT_FAILURE;
+    }
+
+    const std::string dst_filename = argv[2];
+    std::vector<FILE*> src_files;
+    std::vector<std::unique_ptr<ScopedFile>> scoped_src_files;
+    for (int i = 3; i < argc; ++i) {
+        FILE* src_file = boost::nowide::fopen(argv[i], "rb");
+        if (src_file == nullptr) {
+            std::cout << "Unable to open file '" << argv[i] << "'\n";
+            return EXIT_FAILURE;
+        }
+        src_files.emplace_back(src_file);
+        scoped_src_files.emplace_back(std::make_unique<ScopedFile>(src_file));
+    }
+
+    FILE* dst_file = boost::nowide::fopen(dst_filename.c_str(), "wb");
+    if (dst_file == nullptr) {
+        std::cout << "Unable to open file '" << dst_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_dst_file(dst_file);
+
+    const EResult res = concatenate(src_files, *dst_file);
+    if (res != EResult::Success) {
+        std::cout << "Unable to concatenate the files\n";
+        std::cout << "Error: " << translate_result(res) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Succesfully generated file '" << dst_filename << "'\n";
+    return EXIT_SUCCESS;
+}
+
+int split(int argc, const char* argv[])
+{
+    if (argc < 4) {
+        show_help();
+        return EXIT_FAILURE;
+    }
+
+    const std::string src_filename = argv[2];
+    size_t blocks_per_part = 0;
+    for (int i = 3; i < argc; ++i) {
+        const std::string_view a = argv[i];
+        if (a.substr(0, 9) == "--blocks=") {
+            try {
+                blocks_per_part = std::stoul(std::string(a.substr(9)));
             }
+            catch (...) {
+                blocks_per_part = 0;
+            }
+            if (blocks_per_part == 0) {
+                std::cout << "Found invalid value for parameter 'blocks'\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else {
+            std::cout << "Found invalid parameter '" << a << "'\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (blocks_per_part == 0) {
+        show_help();
+        return EXIT_FAILURE;
+    }
+
+    FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+    if (src_file == nullptr) {
+        std::cout << "Unable to open file '" << src_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_src_file(src_file);
+
+    size_t blocks_count = 0;
+    EResult res = count_gcode_blocks(*src_file, blocks_count);
+    const std::string src_stem = src_filename.substr(0, src_filename.find_last_of("."));
+    for (size_t first_block = 0; res == EResult::Success && first_block < blocks_count; first_block += blocks_per_part) {
+        const std::string dst_filename = src_stem + "." + std::to_string(1 + first_block / blocks_per_part) + ".bgcode";
+        FILE* dst_file = boost::nowide::fopen(dst_filename.c_str(), "wb");
+        if (dst_file == nullptr) {
+            std::cout << "Unable to open file '" << dst_filename << "'\n";
+            return EXIT_FAILURE;
+        }
+        ScopedFile scoped_dst_file(dst_file);
+        res = extract_gcode_blocks(*src_file, *dst_file, first_block, blocks_per_part);
+        if (res == EResult::Success)
+            std::cout << "Succesfully generated file '" << dst_filename << "'\n";
+    }
 
-            const Parameter& parameter = parameters[std::distance(parameters.begin(), it)];
+    if (res != EResult::Success) {
+        std::cout << "Unable to split the file '" << src_filename << "'\n";
+        std::cout << "Error: " << translate_result(res) << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
 
-            const std::string_view value_str = a.substr(pos + 1);
-            int value;
+int diff(int argc, const char* argv[])
+{
+    if (argc != 5) {
+        show_help();
+        return EXIT_FAILURE;
+    }
+
+    const std::string old_filename = argv[2];
+    const std::string new_filename = argv[3];
+    const std::string patch_filename = argv[4];
+    FILE* old_file = boost::nowide::fopen(old_filename.c_str(), "rb");
+    if (old_file == nullptr) {
+        std::cout << "Unable to open file '" << old_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_old_file(old_file);
+    FILE* new_file = boost::nowide::fopen(new_filename.c_str(), "rb");
+    if (new_file == nullptr) {
+        std::cout << "Unable to open file '" << new_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_new_file(new_file);
+    FILE* patch_file = boost::nowide::fopen(patch_filename.c_str(), "wb");
+    if (patch_file == nullptr) {
+        std::cout << "Unable to open file '" << patch_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_patch_file(patch_file);
+
+    PatchStatistics statistics;
+    const EResult res = diff_binary_gcode(*old_file, *new_file, *patch_file, &statistics);
+    if (res != EResult::Success) {
+        std::cout << "Unable to generate the patch '" << patch_filename << "'\n";
+        std::cout << "Error: " << translate_result(res) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Succesfully generated file '" << patch_filename << "'\n";
+    std::cout << "Copied blocks:   " << statistics.copied_blocks << " (" << statistics.copied_size << " bytes)\n";
+    std::cout << "Inserted blocks: " << statistics.inserted_blocks << " (" << statistics.inserted_size << " bytes)\n";
+    std::cout << "Patch size:      " << statistics.patch_size << " bytes\n";
+    return EXIT_SUCCESS;
+}
+
+int patch(int argc, const char* argv[])
+{
+    if (argc != 5) {
+        show_help();
+        return EXIT_FAILURE;
+    }
+
+    const std::string old_filename = argv[2];
+    const std::string patch_filename = argv[3];
+    const std::string new_filename = argv[4];
+    FILE* old_file = boost::nowide::fopen(old_filename.c_str(), "rb");
+    if (old_file == nullptr) {
+        std::cout << "Unable to open file '" << old_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_old_file(old_file);
+    FILE* patch_file = boost::nowide::fopen(patch_filename.c_str(), "rb");
+    if (patch_file == nullptr) {
+        std::cout << "Unable to open file '" << patch_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_patch_file(patch_file);
+    FILE* new_file = boost::nowide::fopen(new_filename.c_str(), "wb");
+    if (new_file == nullptr) {
+        std::cout << "Unable to open file '" << new_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_new_file(new_file);
+
+    const EResult res = apply_patch(*old_file, *patch_file, *new_file);
+    if (res != EResult::Success) {
+        std::cout << "Unable to apply the patch '" << patch_filename << "' to file '" << old_filename << "'\n";
+        std::cout << "Error: " << translate_result(res) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Succesfully generated file '" << new_filename << "'\n";
+    return EXIT_SUCCESS;
+}
+
+int verify(int argc, const char* argv[])
+{
+    if (argc < 3) {
+        show_help();
+        return EXIT_FAILURE;
+    }
+
+    const std::string src_filename = argv[2];
+    size_t jobs = 0;
+    size_t first_block = 0;
+    size_t blocks_count = SIZE_MAX;
+    std::optional<uint32_t> expected_root;
+    for (int i = 3; i < argc; ++i) {
+        const std::string_view a = argv[i];
+        if (a.substr(0, 7) == "--jobs=") {
             try {
-                value = std::stoi(std::string(value_str));
-                if (value >= parameter.values.size())
-                    throw std::runtime_error("invalid value");
+                jobs = std::stoul(std::string(a.substr(7)));
             }
             catch (...) {
-                std::cout << "Found invalid value for parameter '" << parameter.name << "'\n";
-                std::cout << "Accepted values:\n";
-                for (size_t p = 0; p < parameter.values.size(); ++p) {
-                    std::cout << p << ") " << parameter.values[p] << "\n";
-                }
-                return false;
+                std::cout << "Found invalid value for parameter 'jobs'\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (a.substr(0, 9) == "--blocks=") {
+            const std::string_view range = a.substr(9);
+            const size_t pos = range.find(':');
+            try {
+                first_block = std::stoul(std::string(range.substr(0, pos)));
+                blocks_count = (pos == std::string_view::npos) ? 0 : std::stoul(std::string(range.substr(pos + 1)));
             }
+            catch (...) {
+                blocks_count = 0;
+            }
+            if (blocks_count == 0) {
+                std::cout << "Found invalid value for parameter 'blocks'\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (a.substr(0, 7) == "--root=") {
+            const std::string value(a.substr(7));
+            size_t pos = 0;
+            unsigned long root = 0;
+            try {
+                root = std::stoul(value, &pos, 16);
+            }
+            catch (...) {
+                pos = 0;
+            }
+            if (value.empty() || pos != value.size() || root > UINT32_MAX) {
+                std::cout << "Found invalid value for parameter 'root'\n";
+                return EXIT_FAILURE;
+            }
+            expected_root = (uint32_t)root;
+        }
+        else {
+            std::cout << "Found invalid parameter '" << a << "'\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+    if (src_file == nullptr) {
+        std::cout << "Unable to open file '" << src_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_src_file(src_file);
+
+    FileHeader file_header;
+    HashTreeLeaves leaves;
+    size_t available_blocks_count = 0;
+    EResult res = read_header(*src_file, file_header, nullptr);
+    if (res == EResult::Success)
+        res = read_hash_tree(*src_file, file_header, leaves);
+    if (res == EResult::Success)
+        res = verify_blocks(*src_file, first_block, blocks_count, jobs, expected_root.has_value() ? &*expected_root : nullptr,
+            &available_blocks_count);
+    if (res != EResult::Success) {
+        std::cout << "Unable to verify the file '" << src_filename << "'\n";
+        std::cout << "Error: " << translate_result(res) << "\n";
+        if (res == EResult::BlockNotFound && !leaves.empty())
+            std::cout << "Gcode blocks contained into the file: " << available_blocks_count << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Hash tree root: " << std::hex << std::setw(8) << std::setfill('0') << hash_tree_root(leaves) << std::dec << "\n";
+    std::cout << "Succesfully verified file '" << src_filename << "'\n";
+    return EXIT_SUCCESS;
+}
 
-            if (parameter.name == "checksum")
-                config.checksum = (EChecksumType)value;
-            else if (parameter.name == "file_metadata_compression")
-                config.compression.file_metadata = (ECompressionType)value;
-            else if (parameter.name == "print_metadata_compression")
-                config.compression.print_metadata = (ECompressionType)value;
-            else if (parameter.name == "printer_metadata_compression")
-                config.compression.printer_metadata = (ECompressionType)value;
-            else if (parameter.name == "slicer_metadata_compression")
-                config.compression.slicer_metadata = (ECompressionType)value;
-            else if (parameter.name == "gcode_compression")
-                config.compression.gcode = (ECompressionType)value;
-            else if (parameter.name == "gcode_encoding")
-                config.gcode_encoding = (EGCodeEncodingType)value;
-            else if (parameter.name == "metadata_encoding")
-                config.metadata_encoding = (EMetadataEncodingType)value;
+int validate(int argc, const char* argv[])
+{
+    if (argc < 3) {
+        show_help();
+        return EXIT_FAILURE;
+    }
+
+    const std::string src_filename = argv[2];
+    size_t jobs = 0;
+    bool decode_blocks = true;
+    bool full_report = false;
+    for (int i = 3; i < argc; ++i) {
+        const std::string_view a = argv[i];
+        if (a.substr(0, 7) == "--jobs=") {
+            try {
+                jobs = std::stoul(std::string(a.substr(7)));
+            }
+            catch (...) {
+                std::cout << "Found invalid value for parameter 'jobs'\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (a == "--no_decode")
+            decode_blocks = false;
+        else if (a == "--report")
+            full_report = true;
+        else {
+            std::cout << "Found invalid parameter '" << a << "'\n";
+            return EXIT_FAILURE;
         }
     }
-    return true;
+
+    FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+    if (src_file == nullptr) {
+        std::cout << "Unable to open file '" << src_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_src_file(src_file);
+
+    static constexpr const std::array<std::string_view, 8> BlockTypes{ "FileMetadata"sv, "GCode"sv, "SlicerMetadata"sv,
+        "PrinterMetadata"sv, "PrintMetadata"sv, "Thumbnail"sv, "Index"sv, "HashTree"sv };
+    static constexpr const std::array<std::string_view, 5> CompressionTypes{ "None"sv, "Deflate"sv, "Heatshrink_11_4"sv,
+        "Heatshrink_12_4"sv, "DeflateDictionary"sv };
+
+    ValidationReport report;
+    const EResult res = validate_binary_gcode(*src_file, report, jobs, decode_blocks);
+    for (const BlockReport& block : report.blocks) {
+        const bool valid = block.checksum == EResult::Success && block.decoding == EResult::Success;
+        if (valid && !full_report)
+            continue;
+        std::cout << std::setw(10) << block.offset << " " << std::setw(15) << std::left << BlockTypes[(size_t)block.type] << " " <<
+            std::setw(17) << CompressionTypes[(size_t)block.compression] << std::right << " encoding " << block.encoding << " size " <<
+            block.compressed_size << "/" << block.uncompressed_size;
+        if (block.checksum != EResult::Success)
+            std::cout << " checksum: " << translate_result(block.checksum);
+        if (block.decoding != EResult::Success)
+            std::cout << " decoding: " << translate_result(block.decoding);
+        std::cout << "\n";
+    }
+    if (res != EResult::Success) {
+        std::cout << "Invalid file '" << src_filename << "' (" << report.blocks.size() << " blocks)\n";
+        std::cout << "Error: " << translate_result(res) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Succesfully validated file '" << src_filename << "' (" << report.blocks.size() << " blocks)\n";
+    return EXIT_SUCCESS;
+}
+
+int train_dictionary(int argc, const char* argv[])
+{
+    if (argc < 4) {
+        show_help();
+        return EXIT_FAILURE;
+    }
+
+    const std::string dst_filename = argv[2];
+    size_t max_size = 16384;
+    bool cpp_format = false;
+    std::vector<std::string> samples;
+    for (int i = 3; i < argc; ++i) {
+        const std::string_view a = argv[i];
+        if (a.substr(0, 7) == "--size=") {
+            try {
+                max_size = std::stoul(std::string(a.substr(7)));
+            }
+            catch (...) {
+                max_size = 0;
+            }
+            if (max_size == 0) {
+                std::cout << "Found invalid value for parameter 'size'\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (a == "--format=raw" || a == "--format=cpp")
+            cpp_format = (a == "--format=cpp");
+        else if (a.substr(0, 2) == "--") {
+            std::cout << "Found invalid parameter '" << a << "'\n";
+            return EXIT_FAILURE;
+        }
+        else {
+            FILE* src_file = boost::nowide::fopen(argv[i], "rb");
+            if (src_file == nullptr) {
+                std::cout << "Unable to open file '" << argv[i] << "'\n";
+                return EXIT_FAILURE;
+            }
+            ScopedFile scoped_src_file(src_file);
+            std::string& sample = samples.emplace_back();
+            std::array<char, 65536> buffer;
+            size_t count;
+            while ((count = fread(buffer.data(), 1, buffer.size(), src_file)) > 0) {
+                sample.append(buffer.data(), count);
+            }
+        }
+    }
+
+    const std::string dictionary = train_deflate_dictionary(std::vector<std::string_view>(samples.begin(), samples.end()), max_size);
+    std::string out;
+    if (cpp_format) {
+        // one string literal per line, with octal escapes, which cannot be extended by the following characters
+        out += "\"";
+        for (const char c : dictionary) {
+            if (c == '\n')
+                out += "\\n\"\n\"";
+            else if (c == '"' || c == '\\')
+                out += std::string("\\") + c;
+            else if (c < ' ' || c > '~') {
+                const unsigned char u = (unsigned char)c;
+                out += std::string("\\") + (char)('0' + (u >> 6)) + (char)('0' + ((u >> 3) & 7)) + (char)('0' + (u & 7));
+            }
+            else
+                out += c;
+        }
+        out += "\"\n";
+    }
+    else
+        out = dictionary;
+
+    FILE* dst_file = boost::nowide::fopen(dst_filename.c_str(), "wb");
+    if (dst_file == nullptr) {
+        std::cout << "Unable to open file '" << dst_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+    ScopedFile scoped_dst_file(dst_file);
+    if (fwrite(out.data(), 1, out.size(), dst_file) != out.size()) {
+        std::cout << "Unable to write file '" << dst_filename << "'\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Succesfully generated file '" << dst_filename << "' (dictionary size: " << dictionary.size() << " bytes)\n";
+    return EXIT_SUCCESS;
 }
 
 int main(int argc, const char* argv[])
 {
+    if (argc > 1 && argv[1] == "transcode"sv)
+        return transcode(argc, argv);
+    if (argc > 1 && argv[1] == "catalog"sv)
+        return catalog(argc, argv);
+    if (argc > 1 && argv[1] == "edit"sv)
+        return edit(argc, argv);
+    if (argc > 1 && argv[1] == "append"sv)
+        return append(argc, argv);
+    if (argc > 1 && argv[1] == "concat"sv)
+        return concat(argc, argv);
+    if (argc > 1 && argv[1] == "split"sv)
+        return split(argc, argv);
+    if (argc > 1 && argv[1] == "diff"sv)
+        return diff(argc, argv);
+    if (argc > 1 && argv[1] == "patch"sv)
+        return patch(argc, argv);
+    if (argc > 1 && argv[1] == "verify"sv)
+        return verify(argc, argv);
+    if (argc > 1 && argv[1] == "validate"sv)
+        return validate(argc, argv);
+    if (argc > 1 && argv[1] == "train_dictionary"sv)
+        return train_dictionary(argc, argv);
+
     std::string src_filename;
     bool src_is_binary;
     BinarizerConfig config;
@@ -195,29 +1115,12 @@ int main(int argc, const char* argv[])
     ScopedFile scoped_dst_file(dst_file);
 
     // Perform conversion
-    const EResult res = src_is_binary ? from_binary_to_ascii(*src_file, *dst_file, true) : from_ascii_to_binary(*src_file, *dst_file, config);
+    BinarizerStatistics statistics;
+    const EResult res = src_is_binary ? from_binary_to_ascii(*src_file, *dst_file, true) : from_ascii_to_binary(*src_file, *dst_file, config, statistics);
     if (res == EResult::Success) {
         if (!src_is_binary) {
-            std::cout << "Binarization parameters\n";
-            for (const Parameter& p : parameters) {
-                std::cout << p.name << ": ";
-                if (p.name == "checksum")
-                    std::cout << p.values[(size_t)config.checksum] << "\n";
-                else if (p.name == "file_metadata_compression")
-                    std::cout << p.values[(size_t)config.compression.file_metadata] << "\n";
-                else if (p.name == "print_metadata_compression")
-                    std::cout << p.values[(size_t)config.compression.print_metadata] << "\n";
-                else if (p.name == "printer_metadata_compression")
-                    std::cout << p.values[(size_t)config.compression.printer_metadata] << "\n";
-                else if (p.name == "slicer_metadata_compression")
-                    std::cout << p.values[(size_t)config.compression.slicer_metadata] << "\n";
-                else if (p.name == "gcode_compression")
-                    std::cout << p.values[(size_t)config.compression.gcode] << "\n";
-                else if (p.name == "gcode_encoding")
-                    std::cout << p.values[(size_t)config.gcode_encoding] << "\n";
-                else if (p.name == "metadata_encoding")
-                    std::cout << p.values[(size_t)config.metadata_encoding] << "\n";
-            }
+            print_binarizer_config(config);
+            print_binarizer_statistics(statistics);
         }
         std::cout << "Succesfully generated file '" << dst_filename << "'\n";
     }
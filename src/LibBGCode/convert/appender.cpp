@@ -0,0 +1,111 @@
+#include "appender.hpp"
+#include "file_utils.hpp"
+
+#include <numeric>
+
+namespace bgcode {
+using namespace core;
+using namespace binarize;
+namespace convert {
+
+EResult GCodeAppender::open(FILE& file, const BinarizerConfig& config)
+{
+    m_file = nullptr;
+    m_gcode_blocks_count = 0;
+
+    // structure of the file, only the block headers are read
+    EResult res = is_valid_binary_gcode(file, true);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    const long file_size = get_file_size(file);
+    if (file_size < 0)
+        return EResult::ReadError;
+
+    FileHeader file_header;
+    res = read_header(file, file_header, nullptr);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    BlockHeader block_header;
+    long position = ftell(&file);
+    while (position < file_size) {
+        if (fseek(&file, position, SEEK_SET) != 0)
+            return EResult::ReadError;
+        res = read_next_block_header(file, file_header, block_header);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        const EBlockType block_type = (EBlockType)block_header.type;
+        if (block_type == EBlockType::Index || block_type == EBlockType::HashTree)
+            // they would have to grow with the new gcode blocks
+            return EResult::InvalidSequenceOfBlocks;
+        if (block_type == EBlockType::GCode)
+            ++m_gcode_blocks_count;
+        position += (long)(block_header.get_size() + block_content_size(file_header, block_header));
+    }
+
+    BinarizerConfig append_config = config;
+    append_config.checksum = (EChecksumType)file_header.checksum_type;
+    append_config.index_block = false;
+    append_config.hash_tree_block = false;
+
+    // the encoding of the new blocks may require a later version of the file
+    const uint32_t version = gcode_encoding_version(append_config.gcode_encoding);
+    if (version > file_header.version) {
+        file_header.version = version;
+        rewind(&file);
+        res = file_header.write(file);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+    }
+
+    // the new blocks follow the last one
+    if (fseek(&file, 0, SEEK_END) != 0)
+        return EResult::ReadError;
+    m_binarizer.set_enabled(true);
+    res = m_binarizer.initialize_append(file, append_config, (uint64_t)file_size);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    m_file = &file;
+    return EResult::Success;
+}
+
+EResult GCodeAppender::append_gcode(const std::string& gcode)
+{
+    if (m_file == nullptr)
+        return EResult::WriteError;
+    return m_binarizer.append_gcode(gcode);
+}
+
+EResult GCodeAppender::finalize()
+{
+    if (m_file == nullptr)
+        return EResult::WriteError;
+    const EResult res = m_binarizer.finalize();
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+    return (fflush(m_file) == 0) ? EResult::Success : EResult::WriteError;
+}
+
+EResult GCodeAppender::update_metadata(const std::vector<MetadataEdit>& edits, bool& edited)
+{
+    edited = false;
+    if (m_file == nullptr)
+        return EResult::WriteError;
+    return edit_metadata_in_place(*m_file, edits, edited);
+}
+
+size_t GCodeAppender::get_gcode_blocks_count() const
+{
+    const auto& appended = m_binarizer.get_statistics().gcode_blocks;
+    return m_gcode_blocks_count + std::accumulate(appended.begin(), appended.end(), size_t(0));
+}
+
+}} // bgcode::convert
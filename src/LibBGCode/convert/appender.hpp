@@ -0,0 +1,58 @@
+#ifndef _BGCODE_APPENDER_HPP_
+#define _BGCODE_APPENDER_HPP_
+
+#include "convert/export.h"
+#include "convert/metadata_editor.hpp"
+#include "binarize/binarize.hpp"
+
+#include <string>
+#include <vector>
+
+namespace bgcode { namespace convert {
+
+//
+// Incremental append of gcode to an existing binary gcode file.
+// The blocks already saved are not rewritten: the file is validated by reading its block headers, then the new gcode blocks
+// are saved at its end, so that the cost depends only on the size of the new gcode.
+// Files with an index or a hash tree block cannot be appended to, as those blocks precede the gcode blocks and would grow,
+// transcode them first (see transcode()).
+//
+
+class BGCODE_CONVERT_EXPORT GCodeAppender
+{
+public:
+    GCodeAppender() = default;
+    explicit GCodeAppender(std::pmr::memory_resource* resource) : m_binarizer(resource) {}
+
+    // Opens the binary gcode file contained into file, which must be opened for update ("r+b").
+    // The gcode blocks are saved with the compressions and the encoding of the given config, and with the checksum type of
+    // the file, which replaces config.checksum. config.index_block and config.hash_tree_block are ignored.
+    // If the encoding of config requires a later version of the format (see core::gcode_encoding_version()), the version saved
+    // into the file header is updated.
+    // Returns EResult::InvalidSequenceOfBlocks if the file contains an index or a hash tree block.
+    core::EResult open(FILE& file, const binarize::BinarizerConfig& config);
+    // Appends the given gcode, made of whole lines, as binarize::Binarizer::append_gcode()
+    core::EResult append_gcode(const std::string& gcode);
+    // Saves the gcode still cached, the file is left open
+    core::EResult finalize();
+    // Rewrites the edited metadata blocks as edit_metadata_in_place(), e.g. to update the print metadata with the data of the
+    // appended gcode. To be called after finalize().
+    // If return == EResult::Success:
+    // - edited will be false if the edited blocks did not fit and the file was left untouched, then edit_metadata() is required.
+    core::EResult update_metadata(const std::vector<MetadataEdit>& edits, bool& edited);
+
+    // Count of gcode blocks of the file, the appended ones included
+    size_t get_gcode_blocks_count() const;
+    // Index of the layers of the appended gcode, see layer_index.hpp
+    const binarize::LayerIndex& get_layer_index() const { return m_binarizer.get_layer_index(); }
+
+private:
+    FILE* m_file{ nullptr };
+    binarize::Binarizer m_binarizer;
+    // count of gcode blocks found into the file by open()
+    size_t m_gcode_blocks_count{ 0 };
+};
+
+}} // bgcode::convert
+
+#endif // _BGCODE_APPENDER_HPP_
@@ -0,0 +1,482 @@
+#include "catalog.hpp"
+#include "file_utils.hpp"
+
+#include "core/core_impl.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+namespace bgcode {
+using namespace core;
+using namespace binarize;
+namespace convert {
+
+namespace fs = std::filesystem;
+
+// Cache file layout: magic, version, thumbnail format used to select the thumbnails, entries count, entries
+static constexpr const std::array<char, 4> CACHE_MAGIC{ 'B', 'G', 'C', 'C' };
+static constexpr const uint32_t CACHE_VERSION = 2;
+
+static FILE* open_file(const std::string& path, bool write)
+{
+#ifdef _WIN32
+    return _wfopen(fs::u8path(path).c_str(), write ? L"wb" : L"rb");
+#else
+    return std::fopen(path.c_str(), write ? "wb" : "rb");
+#endif // _WIN32
+}
+
+class ScopedFile
+{
+public:
+    explicit ScopedFile(FILE* file) : m_file(file) {}
+    ~ScopedFile() { if (m_file != nullptr) fclose(m_file); }
+private:
+    FILE* m_file{ nullptr };
+};
+
+static bool is_bgcode_extension(const fs::path& path)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+    return extension == ".bgcode" || extension == ".bgc";
+}
+
+static void copy_metadata(const BaseMetadataBlock& block, std::vector<std::pair<std::string, std::string>>& dst)
+{
+    dst.clear();
+    dst.reserve(block.raw_data.size());
+    for (const auto& [key, value] : block.raw_data) {
+        dst.emplace_back(std::string(key.data(), key.size()), std::string(value.data(), value.size()));
+    }
+}
+
+static bool is_better_thumbnail(const ThumbnailParams& candidate, const ThumbnailParams& current, EThumbnailFormat format)
+{
+    const bool candidate_format = candidate.format == (uint16_t)format;
+    const bool current_format = current.format == (uint16_t)format;
+    if (candidate_format != current_format)
+        return candidate_format;
+    return (uint32_t)candidate.width * candidate.height > (uint32_t)current.width * current.height;
+}
+
+static void start_header_crc(Checksum& header_crc, const FileHeader& file_header)
+{
+    header_crc.append(file_header.magic);
+    header_crc.append(file_header.version);
+    header_crc.append(file_header.checksum_type);
+}
+
+// Adds the given block header and the block checksum, if any, to header_crc.
+// The file position is left at the start of the block payload.
+static EResult update_header_crc(Checksum& header_crc, FILE& file, const FileHeader& file_header, const BlockHeader& block_header)
+{
+    const long payload_position = block_header.get_position() + (long)block_header.get_size();
+    update_checksum(header_crc, block_header);
+    if (checksum_size((EChecksumType)file_header.checksum_type) > 0) {
+        // the stored block checksum covers the block content
+        Checksum block_checksum((EChecksumType)file_header.checksum_type);
+        if (fseek(&file, payload_position + (long)block_payload_size(block_header), SEEK_SET) != 0)
+            return EResult::ReadError;
+        const EResult res = block_checksum.read(file);
+        if (res != EResult::Success)
+            return res;
+        header_crc.append(block_checksum.data(), block_checksum.size());
+        if (fseek(&file, payload_position, SEEK_SET) != 0)
+            return EResult::ReadError;
+    }
+    return EResult::Success;
+}
+
+static uint32_t get_header_crc(const Checksum& header_crc)
+{
+    return load_integer<uint32_t>(header_crc.data(), header_crc.data() + header_crc.size());
+}
+
+// Sets header_crc to the CRC32 of the headers of the given file, as CatalogEntry::header_crc, reading only the block headers
+// and checksums
+static EResult read_header_crc(FILE& file, uint32_t& header_crc)
+{
+    FileHeader file_header;
+    EResult res = read_header(file, file_header, nullptr);
+    if (res != EResult::Success)
+        return res;
+
+    Checksum crc(EChecksumType::CRC32);
+    start_header_crc(crc, file_header);
+    BlockHeader block_header;
+    while (true) {
+        res = read_next_block_header(file, file_header, block_header);
+        if (res != EResult::Success)
+            return res;
+        if ((EBlockType)block_header.type == EBlockType::GCode)
+            break;
+        res = update_header_crc(crc, file, file_header, block_header);
+        if (res != EResult::Success)
+            return res;
+        res = skip_block(file, file_header, block_header);
+        if (res != EResult::Success)
+            return res;
+    }
+    header_crc = get_header_crc(crc);
+    return EResult::Success;
+}
+
+static EResult read_catalog_entry(FILE& file, const CatalogConfig& config, CatalogEntry& entry)
+{
+    FileHeader file_header;
+    EResult res = read_header(file, file_header, nullptr);
+    if (res != EResult::Success)
+        return res;
+
+    Checksum header_crc(EChecksumType::CRC32);
+    start_header_crc(header_crc, file_header);
+
+    // the metadata blocks are small, decode them into a local arena
+    std::array<std::byte, 8192> arena;
+    std::pmr::monotonic_buffer_resource resource(arena.data(), arena.size());
+    std::array<std::byte, 4096> cs_buffer;
+    const size_t cs_size = checksum_size((EChecksumType)file_header.checksum_type);
+    bool printer_metadata_found = false;
+    bool print_metadata_found = false;
+    BlockHeader block_header;
+    while (true) {
+        res = read_next_block_header(file, file_header, block_header);
+        if (res != EResult::Success)
+            return res;
+
+        const EBlockType type = (EBlockType)block_header.type;
+        if (type == EBlockType::GCode)
+            break;
+
+        const long payload_position = block_header.get_position() + (long)block_header.get_size();
+        res = update_header_crc(header_crc, file, file_header, block_header);
+        if (res != EResult::Success)
+            return res;
+
+        if (type == EBlockType::PrinterMetadata || type == EBlockType::PrintMetadata) {
+            if (config.verify_checksum && cs_size > 0) {
+                res = verify_block_checksum(file, file_header, block_header, cs_buffer.data(), cs_buffer.size());
+                if (res != EResult::Success)
+                    return res;
+                if (fseek(&file, payload_position, SEEK_SET) != 0)
+                    return EResult::ReadError;
+            }
+
+            if (type == EBlockType::PrinterMetadata) {
+                PrinterMetadataBlock block(&resource);
+                res = block.read_data(file, file_header, block_header);
+                if (res != EResult::Success)
+                    return res;
+                copy_metadata(block, entry.printer_metadata);
+                printer_metadata_found = true;
+            }
+            else {
+                PrintMetadataBlock block(&resource);
+                res = block.read_data(file, file_header, block_header);
+                if (res != EResult::Success)
+                    return res;
+                copy_metadata(block, entry.print_metadata);
+                print_metadata_found = true;
+            }
+            continue;
+        }
+
+        if (type == EBlockType::Thumbnail) {
+            // only the parameters are read, the image is skipped
+            ThumbnailParams params;
+            res = params.read(file);
+            if (res != EResult::Success)
+                return res;
+            if (entry.thumbnail_position < 0 || is_better_thumbnail(params, entry.thumbnail, config.thumbnail_format)) {
+                entry.thumbnail = params;
+                entry.thumbnail_position = block_header.get_position();
+            }
+        }
+
+        res = skip_block(file, file_header, block_header);
+        if (res != EResult::Success)
+            return res;
+    }
+
+    if (!printer_metadata_found)
+        return EResult::MissingPrinterMetadata;
+    if (!print_metadata_found)
+        return EResult::MissingPrintMetadata;
+
+    entry.header_crc = get_header_crc(header_crc);
+    entry.gcode_position = block_header.get_position();
+    return EResult::Success;
+}
+
+void read_catalog_entry(const std::string& path, const CatalogConfig& config, CatalogEntry& entry)
+{
+    // path may refer to entry.path
+    CatalogEntry new_entry;
+    new_entry.path = path;
+    new_entry.checksum_verified = config.verify_checksum;
+
+    std::error_code ec;
+    const fs::path fs_path = fs::u8path(path);
+    new_entry.file_size = fs::file_size(fs_path, ec);
+    if (!ec)
+        new_entry.mtime = fs::last_write_time(fs_path, ec).time_since_epoch().count();
+
+    FILE* file = ec ? nullptr : open_file(path, false);
+    if (file != nullptr) {
+        ScopedFile scoped_file(file);
+        new_entry.result = read_catalog_entry(*file, config, new_entry);
+    }
+    else
+        new_entry.result = EResult::ReadError;
+
+    if (new_entry.result != EResult::Success) {
+        new_entry.header_crc = 0;
+        new_entry.printer_metadata.clear();
+        new_entry.print_metadata.clear();
+        new_entry.thumbnail = { 0, 0, 0 };
+        new_entry.thumbnail_position = -1;
+        new_entry.gcode_position = 0;
+    }
+    entry = std::move(new_entry);
+}
+
+template<class T>
+static bool write_value(FILE& file, const T& value)
+{
+    return fwrite(&value, 1, sizeof(T), &file) == sizeof(T);
+}
+
+template<class T>
+static bool read_value(FILE& file, T& value)
+{
+    return fread(&value, 1, sizeof(T), &file) == sizeof(T);
+}
+
+static bool write_string(FILE& file, const std::string& str)
+{
+    const uint32_t size = (uint32_t)str.size();
+    return write_value(file, size) && fwrite(str.data(), 1, size, &file) == size;
+}
+
+// max_size bounds the size read from the file, e.g. to the file size
+static bool read_string(FILE& file, std::string& str, uint64_t max_size)
+{
+    uint32_t size;
+    if (!read_value(file, size) || size > max_size)
+        return false;
+    str.resize(size);
+    return fread(str.data(), 1, size, &file) == size;
+}
+
+static bool write_metadata(FILE& file, const std::vector<std::pair<std::string, std::string>>& metadata)
+{
+    if (!write_value(file, (uint32_t)metadata.size()))
+        return false;
+    for (const auto& [key, value] : metadata) {
+        if (!write_string(file, key) || !write_string(file, value))
+            return false;
+    }
+    return true;
+}
+
+static bool read_metadata(FILE& file, std::vector<std::pair<std::string, std::string>>& metadata, uint64_t max_size)
+{
+    uint32_t count;
+    if (!read_value(file, count))
+        return false;
+    metadata.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        auto& [key, value] = metadata.emplace_back();
+        if (!read_string(file, key, max_size) || !read_string(file, value, max_size))
+            return false;
+    }
+    return true;
+}
+
+EResult Catalog::load(const std::string& cache_path)
+{
+    m_entries.clear();
+
+    FILE* file = open_file(cache_path, false);
+    if (file == nullptr)
+        return EResult::ReadError;
+    ScopedFile scoped_file(file);
+    const long file_size = get_file_size(*file);
+    if (file_size < 0)
+        return EResult::ReadError;
+
+    uint32_t magic;
+    uint32_t version;
+    uint16_t thumbnail_format;
+    uint32_t count;
+    if (!read_value(*file, magic) || !read_value(*file, version))
+        return EResult::ReadError;
+    if (magic != load_integer<uint32_t>(CACHE_MAGIC.begin(), CACHE_MAGIC.end()))
+        return EResult::InvalidMagicNumber;
+    if (version != CACHE_VERSION)
+        return EResult::InvalidVersionNumber;
+    if (!read_value(*file, thumbnail_format) || !read_value(*file, count))
+        return EResult::ReadError;
+
+    std::vector<CatalogEntry> entries;
+    for (uint32_t i = 0; i < count; ++i) {
+        CatalogEntry& entry = entries.emplace_back();
+        uint16_t result;
+        int64_t thumbnail_position;
+        int64_t gcode_position;
+        uint8_t checksum_verified;
+        if (!read_string(*file, entry.path, (uint64_t)file_size) ||
+            !read_value(*file, entry.file_size) ||
+            !read_value(*file, entry.mtime) ||
+            !read_value(*file, entry.header_crc) ||
+            !read_value(*file, checksum_verified) ||
+            !read_value(*file, result) ||
+            !read_metadata(*file, entry.printer_metadata, (uint64_t)file_size) ||
+            !read_metadata(*file, entry.print_metadata, (uint64_t)file_size) ||
+            !read_value(*file, entry.thumbnail.format) ||
+            !read_value(*file, entry.thumbnail.width) ||
+            !read_value(*file, entry.thumbnail.height) ||
+            !read_value(*file, thumbnail_position) ||
+            !read_value(*file, gcode_position))
+            return EResult::ReadError;
+        entry.checksum_verified = checksum_verified != 0;
+        entry.result = (EResult)result;
+        entry.thumbnail_position = (long)thumbnail_position;
+        entry.gcode_position = (long)gcode_position;
+    }
+
+    m_entries = std::move(entries);
+    m_thumbnail_format = (EThumbnailFormat)thumbnail_format;
+    return EResult::Success;
+}
+
+EResult Catalog::save(const std::string& cache_path) const
+{
+    FILE* file = open_file(cache_path, true);
+    if (file == nullptr)
+        return EResult::WriteError;
+    ScopedFile scoped_file(file);
+
+    if (!write_value(*file, load_integer<uint32_t>(CACHE_MAGIC.begin(), CACHE_MAGIC.end())) ||
+        !write_value(*file, CACHE_VERSION) ||
+        !write_value(*file, (uint16_t)m_thumbnail_format) ||
+        !write_value(*file, (uint32_t)m_entries.size()))
+        return EResult::WriteError;
+
+    for (const CatalogEntry& entry : m_entries) {
+        if (!write_string(*file, entry.path) ||
+            !write_value(*file, entry.file_size) ||
+            !write_value(*file, entry.mtime) ||
+            !write_value(*file, entry.header_crc) ||
+            !write_value(*file, (uint8_t)(entry.checksum_verified ? 1 : 0)) ||
+            !write_value(*file, (uint16_t)entry.result) ||
+            !write_metadata(*file, entry.printer_metadata) ||
+            !write_metadata(*file, entry.print_metadata) ||
+            !write_value(*file, entry.thumbnail.format) ||
+            !write_value(*file, entry.thumbnail.width) ||
+            !write_value(*file, entry.thumbnail.height) ||
+            !write_value(*file, (int64_t)entry.thumbnail_position) ||
+            !write_value(*file, (int64_t)entry.gcode_position))
+            return EResult::WriteError;
+    }
+
+    return EResult::Success;
+}
+
+EResult Catalog::scan(const std::string& directory, const CatalogConfig& config, size_t* rescanned_count)
+{
+    // collect the files
+    std::vector<CatalogEntry> entries;
+    std::error_code ec;
+    auto add_file = [&entries](const fs::directory_entry& item) {
+        std::error_code item_ec;
+        if (!item.is_regular_file(item_ec) || !is_bgcode_extension(item.path()))
+            return;
+        CatalogEntry& entry = entries.emplace_back();
+        entry.path = item.path().u8string();
+        entry.file_size = item.file_size(item_ec);
+        if (!item_ec)
+            entry.mtime = item.last_write_time(item_ec).time_since_epoch().count();
+    };
+    const fs::path root = fs::u8path(directory);
+    if (config.recursive) {
+        for (fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end; !ec && it != end; it.increment(ec)) {
+            add_file(*it);
+        }
+    }
+    else {
+        for (fs::directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+            add_file(*it);
+        }
+    }
+    if (ec)
+        return EResult::ReadError;
+
+    std::sort(entries.begin(), entries.end(), [](const CatalogEntry& a, const CatalogEntry& b) { return a.path < b.path; });
+
+    // candidates to reuse, the entries with the same path, size and modification time, scanned with the checksum verification
+    // if requested
+    const bool reuse = config.thumbnail_format == m_thumbnail_format;
+    std::vector<const CatalogEntry*> old_entries(entries.size(), nullptr);
+    auto old_it = m_entries.begin();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const CatalogEntry& entry = entries[i];
+        old_it = std::lower_bound(old_it, m_entries.end(), entry.path, [](const CatalogEntry& e, const std::string& path) { return e.path < path; });
+        if (reuse && old_it != m_entries.end() && old_it->path == entry.path &&
+            old_it->file_size == entry.file_size && old_it->mtime == entry.mtime &&
+            (!config.verify_checksum || old_it->checksum_verified))
+            old_entries[i] = &(*old_it);
+    }
+
+    // the candidates are reused if their header CRC did not change, the other files are read
+    size_t jobs = (config.jobs > 0) ? config.jobs : std::max<size_t>(1, std::thread::hardware_concurrency());
+    jobs = std::min(jobs, entries.size());
+    std::atomic<size_t> next{ 0 };
+    std::atomic<size_t> read_count{ 0 };
+    auto worker = [&]() {
+        for (size_t i = next++; i < entries.size(); i = next++) {
+            CatalogEntry& entry = entries[i];
+            const CatalogEntry* old_entry = old_entries[i];
+            if (old_entry != nullptr) {
+                if (old_entry->result != EResult::Success) {
+                    // the file is not read again until modified
+                    entry = *old_entry;
+                    continue;
+                }
+                FILE* file = open_file(entry.path, false);
+                if (file != nullptr) {
+                    ScopedFile scoped_file(file);
+                    uint32_t header_crc;
+                    if (read_header_crc(*file, header_crc) == EResult::Success && header_crc == old_entry->header_crc) {
+                        entry = *old_entry;
+                        continue;
+                    }
+                }
+            }
+            read_catalog_entry(entry.path, config, entry);
+            ++read_count;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < jobs; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    m_entries = std::move(entries);
+    m_thumbnail_format = config.thumbnail_format;
+    if (rescanned_count != nullptr)
+        *rescanned_count = read_count;
+    return EResult::Success;
+}
+
+}} // bgcode::convert
@@ -0,0 +1,84 @@
+#ifndef _BGCODE_CATALOG_HPP_
+#define _BGCODE_CATALOG_HPP_
+
+#include "convert/export.h"
+#include "binarize/binarize.hpp"
+
+#include <string>
+#include <vector>
+
+namespace bgcode { namespace convert {
+
+//
+// Catalog of the binary gcode files contained into a directory.
+// Only the file header and the blocks in front of the first gcode block are read, the files are scanned in parallel.
+// The catalog can be saved into a cache file, so that a rescan of the directory reads only the new or modified files.
+//
+
+struct CatalogEntry
+{
+    // utf8 path of the file
+    std::string path;
+    // used, together with the path, to detect modified files
+    uint64_t file_size{ 0 };
+    int64_t mtime{ 0 };
+    // CRC32 of the file header and of the headers (and checksums, if any) of the blocks in front of the first gcode block,
+    // compared before reusing the entry, as files can be rewritten keeping their size and modification time
+    uint32_t header_crc{ 0 };
+    // whether the checksums of the metadata blocks were verified, see CatalogConfig::verify_checksum
+    bool checksum_verified{ false };
+    // result of the scan of the file, the following data are valid only if result == EResult::Success
+    core::EResult result{ core::EResult::Success };
+    std::vector<std::pair<std::string, std::string>> printer_metadata;
+    std::vector<std::pair<std::string, std::string>> print_metadata;
+    // the best thumbnail, see CatalogConfig::thumbnail_format
+    // thumbnail_position is the position of the thumbnail block header, -1 if the file has no thumbnails
+    core::ThumbnailParams thumbnail{ 0, 0, 0 };
+    long thumbnail_position{ -1 };
+    // position of the header of the first gcode block
+    long gcode_position{ 0 };
+};
+
+struct CatalogConfig
+{
+    // count of threads used to scan the files, 0 = hardware concurrency
+    size_t jobs{ 0 };
+    bool recursive{ true };
+    // verify the checksum of the metadata blocks
+    bool verify_checksum{ false };
+    // the best thumbnail is the biggest one with this format or, if none, the biggest one
+    core::EThumbnailFormat thumbnail_format{ core::EThumbnailFormat::PNG };
+};
+
+// Reads the catalog entry of the file with the given path.
+// The entry result is set to the outcome of the scan.
+extern BGCODE_CONVERT_EXPORT void read_catalog_entry(const std::string& path, const CatalogConfig& config, CatalogEntry& entry);
+
+class BGCODE_CONVERT_EXPORT Catalog
+{
+public:
+    // Loads the entries from the given cache file, replacing the current ones
+    core::EResult load(const std::string& cache_path);
+    // Saves the entries into the given cache file
+    core::EResult save(const std::string& cache_path) const;
+
+    // Scans the given directory for .bgcode and .bgc files.
+    // Entries of files whose path, size, modification time and header CRC (see CatalogEntry::header_crc) did not change are kept,
+    // the others are read again. Entries read without checksum verification are read again if config.verify_checksum is set.
+    // Entries of files not found anymore are removed.
+    // If not null, rescanned_count will contain the count of files read by this scan.
+    core::EResult scan(const std::string& directory, const CatalogConfig& config, size_t* rescanned_count = nullptr);
+
+    // Entries sorted by path
+    const std::vector<CatalogEntry>& get_entries() const { return m_entries; }
+    void clear() { m_entries.clear(); }
+
+private:
+    std::vector<CatalogEntry> m_entries;
+    // thumbnail format used to select the thumbnails of the entries
+    core::EThumbnailFormat m_thumbnail_format{ core::EThumbnailFormat::PNG };
+};
+
+}} // bgcode::convert
+
+#endif // _BGCODE_CATALOG_HPP_
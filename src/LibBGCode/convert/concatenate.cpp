@@ -0,0 +1,162 @@
+#include "convert.hpp"
+#include "file_utils.hpp"
+
+#include <algorithm>
+
+namespace bgcode {
+using namespace core;
+namespace convert {
+
+// Sets positions to the positions of the headers of the gcode blocks, which are the last blocks of the file,
+// and leading_size to the size of the blocks preceding them, but the hash tree and the index blocks (which are the last of them, if present)
+static EResult read_gcode_block_positions(FILE& file, FileHeader& file_header, long& file_size, std::vector<long>& positions,
+    long& leading_size)
+{
+    positions.clear();
+    leading_size = 0;
+    EResult res = is_valid_binary_gcode(file, false);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    file_size = get_file_size(file);
+    if (file_size < 0)
+        return EResult::ReadError;
+
+    res = read_header(file, file_header, nullptr);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    BlockHeader block_header;
+    long position = ftell(&file);
+    while (position < file_size) {
+        if (fseek(&file, position, SEEK_SET) != 0)
+            return EResult::ReadError;
+        res = read_next_block_header(file, file_header, block_header);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        if ((EBlockType)block_header.type == EBlockType::GCode) {
+            if (positions.empty() && leading_size == 0)
+                leading_size = position;
+            positions.emplace_back(position);
+        }
+        else if ((EBlockType)block_header.type == EBlockType::Index || (EBlockType)block_header.type == EBlockType::HashTree) {
+            // the positions into the index and the checksums into the hash tree are not valid for the destination file
+            if (leading_size == 0)
+                leading_size = position;
+        }
+        position += (long)(block_header.get_size() + block_content_size(file_header, block_header));
+    }
+    return EResult::Success;
+}
+
+// Copies the blocks in [begin, end) from src_file to dst_file, with the given checksum type
+static EResult copy_blocks(FILE& src_file, const FileHeader& src_header, long begin, long end, FILE& dst_file, EChecksumType checksum_type)
+{
+    if ((EChecksumType)src_header.checksum_type == checksum_type)
+        // a single raw copy
+        return copy_file_data(src_file, begin, dst_file, (size_t)(end - begin));
+
+    BlockHeader block_header;
+    while (begin < end) {
+        if (fseek(&src_file, begin, SEEK_SET) != 0)
+            return EResult::ReadError;
+        EResult res = read_next_block_header(src_file, src_header, block_header);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        res = copy_block_with_checksum(src_file, src_header, block_header, dst_file, checksum_type);
+        if (res != EResult::Success)
+            return res;
+        begin += (long)(block_header.get_size() + block_content_size(src_header, block_header));
+    }
+    return EResult::Success;
+}
+
+BGCODE_CONVERT_EXPORT EResult concatenate(const std::vector<FILE*>& src_files, FILE& dst_file)
+{
+    if (src_files.empty())
+        return EResult::InvalidBinaryGCodeFile;
+
+    // the destination contains the blocks of all the files, its version is the latest of them
+    uint32_t dst_version = 0;
+    for (FILE* src_file : src_files) {
+        FileHeader src_header;
+        const EResult res = read_header(*src_file, src_header, nullptr);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        dst_version = std::max(dst_version, src_header.version);
+    }
+
+    FileHeader dst_header;
+    std::vector<long> positions;
+    for (size_t i = 0; i < src_files.size(); ++i) {
+        FILE& src_file = *src_files[i];
+        FileHeader src_header;
+        long file_size;
+        long leading_size;
+        EResult res = read_gcode_block_positions(src_file, src_header, file_size, positions, leading_size);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        if (positions.empty())
+            return EResult::BlockNotFound;
+
+        if (i == 0) {
+            // file header, metadata and thumbnails
+            dst_header = src_header;
+            dst_header.version = dst_version;
+            res = dst_header.write(dst_file);
+            if (res != EResult::Success)
+                return res;
+            const long header_size = (long)(sizeof(dst_header.magic) + sizeof(dst_header.version) + sizeof(dst_header.checksum_type));
+            res = copy_file_data(src_file, header_size, dst_file, (size_t)(leading_size - header_size));
+            if (res != EResult::Success)
+                return res;
+        }
+
+        res = copy_blocks(src_file, src_header, positions.front(), file_size, dst_file, (EChecksumType)dst_header.checksum_type);
+        if (res != EResult::Success)
+            return res;
+    }
+    return EResult::Success;
+}
+
+BGCODE_CONVERT_EXPORT EResult count_gcode_blocks(FILE& file, size_t& count)
+{
+    FileHeader file_header;
+    long file_size;
+    long leading_size;
+    std::vector<long> positions;
+    const EResult res = read_gcode_block_positions(file, file_header, file_size, positions, leading_size);
+    count = positions.size();
+    return res;
+}
+
+BGCODE_CONVERT_EXPORT EResult extract_gcode_blocks(FILE& src_file, FILE& dst_file, size_t first_block, size_t blocks_count)
+{
+    FileHeader file_header;
+    long file_size;
+    long leading_size;
+    std::vector<long> positions;
+    EResult res = read_gcode_block_positions(src_file, file_header, file_size, positions, leading_size);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+    if (first_block >= positions.size() || blocks_count == 0)
+        return EResult::BlockNotFound;
+
+    // file header, metadata and thumbnails
+    res = copy_file_data(src_file, 0, dst_file, (size_t)leading_size);
+    if (res != EResult::Success)
+        return res;
+
+    const long begin = positions[first_block];
+    const long end = (blocks_count < positions.size() - first_block) ? positions[first_block + blocks_count] : file_size;
+    return copy_file_data(src_file, begin, dst_file, (size_t)(end - begin));
+}
+
+}} // bgcode::convert
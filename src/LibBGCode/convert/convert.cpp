@@ -179,7 +179,8 @@ static void to_int(const std::string_view& str, Integer& out) {
         out = 0;
 }
 
-BGCODE_CONVERT_EXPORT EResult from_ascii_to_binary(FILE& src_file, FILE& dst_file, const BinarizerConfig& config)
+static EResult ascii_to_binary(FILE& src_file, Binarizer::OutputCallback dst, const BinarizerConfig& config,
+    std::pmr::memory_resource* resource, LayerIndex* layer_index, BinarizerStatistics* statistics)
 {
     using namespace std::literals;
     static constexpr const std::string_view GeneratedByPrusaSlicer = "generated by PrusaSlicer"sv;
@@ -246,7 +247,7 @@ BGCODE_CONVERT_EXPORT EResult from_ascii_to_binary(FILE& src_file, FILE& dst_fil
     if (res == EResult::Success)
         return EResult::AlreadyBinarized;
 
-    Binarizer binarizer;
+    Binarizer binarizer(resource);
     binarizer.set_enabled(true);
     BinaryData& binary_data = binarizer.get_binary_data();
 
@@ -404,7 +405,7 @@ BGCODE_CONVERT_EXPORT EResult from_ascii_to_binary(FILE& src_file, FILE& dst_fil
                     parse_res = EResult::InvalidAsciiGCodeFile;
                     return;
                 }
-                binary_data.slicer_metadata.raw_data.emplace_back(std::string(key), std::string(value));
+                binary_data.slicer_metadata.raw_data.emplace_back(key, value);
                 processed_lines.emplace_back(lines_counter++);
                 return;
             }
@@ -426,7 +427,7 @@ BGCODE_CONVERT_EXPORT EResult from_ascii_to_binary(FILE& src_file, FILE& dst_fil
                 sv_thumbnail_str = trim(sv_line.substr(ThumbnailQOIBegin.size()));
             }
             if (reading_thumbnail.has_value()) {
-                ThumbnailBlock& thumbnail = binary_data.thumbnails.emplace_back(ThumbnailBlock());
+                ThumbnailBlock& thumbnail = binary_data.thumbnails.emplace_back(resource);
                 thumbnail.params.format = (uint16_t)*reading_thumbnail;
                 pos = sv_thumbnail_str.find(" ");
                 if (pos == std::string_view::npos) {
@@ -547,7 +548,7 @@ BGCODE_CONVERT_EXPORT EResult from_ascii_to_binary(FILE& src_file, FILE& dst_fil
     if (!producer_found)
         return EResult::InvalidAsciiGCodeFile;
 
-    auto append_metadata = [](std::vector<std::pair<std::string, std::string>>& dst, const std::string& key, const std::string& value) {
+    auto append_metadata = [](std::pmr::vector<std::pair<std::pmr::string, std::pmr::string>>& dst, std::string_view key, const std::string& value) {
         if (!value.empty()) dst.emplace_back(key, value);
     };
 
@@ -589,7 +590,7 @@ BGCODE_CONVERT_EXPORT EResult from_ascii_to_binary(FILE& src_file, FILE& dst_fil
     append_metadata(binary_data.print_metadata.raw_data, std::string(Estimated1stLayerPrintingTimeNormal), estimated_1st_layer_printing_time_normal);
     append_metadata(binary_data.print_metadata.raw_data, std::string(Estimated1stLayerPrintingTimeSilent), estimated_1st_layer_printing_time_silent);
 
-    res = binarizer.initialize(dst_file, config);
+    res = binarizer.initialize(std::move(dst), config);
     if (res != EResult::Success)
         // propagate error
         return res;
@@ -618,24 +619,58 @@ BGCODE_CONVERT_EXPORT EResult from_ascii_to_binary(FILE& src_file, FILE& dst_fil
         // propagate error
         return res;
 
+    if (layer_index != nullptr)
+        layer_index->assign(binarizer.get_layer_index().begin(), binarizer.get_layer_index().end());
+    if (statistics != nullptr)
+        *statistics = binarizer.get_statistics();
+
     return EResult::Success;
 }
 
-BGCODE_CONVERT_EXPORT EResult from_binary_to_ascii(FILE& src_file, FILE& dst_file, bool verify_checksum)
+BGCODE_CONVERT_EXPORT EResult from_ascii_to_binary(FILE& src_file, Binarizer::OutputCallback dst, const BinarizerConfig& config,
+    std::pmr::memory_resource* resource)
+{
+    return ascii_to_binary(src_file, std::move(dst), config, resource, nullptr, nullptr);
+}
+
+static Binarizer::OutputCallback file_output(FILE& dst_file)
+{
+    return [&dst_file](const std::byte* data, size_t size) {
+        const size_t wsize = fwrite(static_cast<const void*>(data), 1, size, &dst_file);
+        return !ferror(&dst_file) && wsize == size;
+    };
+}
+
+BGCODE_CONVERT_EXPORT EResult from_ascii_to_binary(FILE& src_file, FILE& dst_file, const BinarizerConfig& config)
+{
+    return from_ascii_to_binary(src_file, file_output(dst_file), config);
+}
+
+BGCODE_CONVERT_EXPORT EResult from_ascii_to_binary(FILE& src_file, FILE& dst_file, const BinarizerConfig& config, LayerIndex& layer_index)
+{
+    return ascii_to_binary(src_file, file_output(dst_file), config, layer_index.get_allocator().resource(), &layer_index, nullptr);
+}
+
+BGCODE_CONVERT_EXPORT EResult from_ascii_to_binary(FILE& src_file, FILE& dst_file, const BinarizerConfig& config, BinarizerStatistics& statistics)
+{
+    return ascii_to_binary(src_file, file_output(dst_file), config, std::pmr::get_default_resource(), nullptr, &statistics);
+}
+
+BGCODE_CONVERT_EXPORT EResult from_binary_to_ascii(FILE& src_file, FILE& dst_file, bool verify_checksum, std::pmr::memory_resource* resource)
 {
     // initialize buffer for checksum calculation, if verify_checksum is true
-    std::vector<std::byte> checksum_buffer;
+    std::pmr::vector<std::byte> checksum_buffer(resource);
     if (verify_checksum)
         checksum_buffer.resize(65535);
 
-    auto write_line = [&](const std::string& line) {
+    auto write_line = [&](std::string_view line) {
         const size_t wsize = fwrite(line.data(), 1, line.length(), &dst_file);
         return !ferror(&dst_file) && wsize == line.length();
     };
 
-    auto write_metadata = [&](const std::vector<std::pair<std::string, std::string>>& data) {
+    auto write_metadata = [&](const std::pmr::vector<std::pair<std::pmr::string, std::pmr::string>>& data) {
         for (const auto& [key, value] : data) {
-            if (!write_line("; " + key + " = " + value + "\n"))
+            if (!write_line("; ") || !write_line(key) || !write_line(" = ") || !write_line(value) || !write_line("\n"))
                 return false;
         }
         return !ferror(&dst_file);
@@ -671,24 +706,24 @@ BGCODE_CONVERT_EXPORT EResult from_binary_to_ascii(FILE& src_file, FILE& dst_fil
         (EBlockType)block_header.type != EBlockType::PrinterMetadata)
         return EResult::InvalidSequenceOfBlocks;
     if ((EBlockType)block_header.type == EBlockType::FileMetadata) {
-        FileMetadataBlock file_metadata_block;
+        FileMetadataBlock file_metadata_block(resource);
         res = file_metadata_block.read_data(src_file, file_header, block_header);
         if (res != EResult::Success)
             // propagate error
             return res;
 
         auto producer_it = std::find_if(file_metadata_block.raw_data.begin(), file_metadata_block.raw_data.end(),
-            [](const std::pair<std::string, std::string>& item) { return item.first == "Producer"; });
+            [](const auto& item) { return item.first == "Producer"; });
         auto prepared_it = std::find_if(file_metadata_block.raw_data.begin(), file_metadata_block.raw_data.end(),
-            [](const std::pair<std::string, std::string>& item) { return item.first == "Prepared by"; });
+            [](const auto& item) { return item.first == "Prepared by"; });
         auto produced_on_it = std::find_if(file_metadata_block.raw_data.begin(), file_metadata_block.raw_data.end(),
             [](const auto& item) { return item.first == "Produced on"; });
 
-        std::string producer_str = (producer_it != file_metadata_block.raw_data.end()) ? producer_it->second : "Unknown";
+        std::string producer_str = (producer_it != file_metadata_block.raw_data.end()) ? std::string(producer_it->second) : "Unknown";
         if (produced_on_it != file_metadata_block.raw_data.end())
-          producer_str += " on " + produced_on_it->second;
+          producer_str += " on " + std::string(produced_on_it->second);
         if (prepared_it != file_metadata_block.raw_data.end())
-          producer_str += "\n; prepared by " + prepared_it->second;
+          producer_str += "\n; prepared by " + std::string(prepared_it->second);
 
         if (!write_line("; generated by " + producer_str + "\n\n\n"))
             return EResult::WriteError;
@@ -704,7 +739,7 @@ BGCODE_CONVERT_EXPORT EResult from_binary_to_ascii(FILE& src_file, FILE& dst_fil
     //
     // convert printer metadata block
     //
-    PrinterMetadataBlock printer_metadata_block;
+    PrinterMetadataBlock printer_metadata_block(resource);
     res = printer_metadata_block.read_data(src_file, file_header, block_header);
     if (res != EResult::Success)
         // propagate error
@@ -721,13 +756,13 @@ BGCODE_CONVERT_EXPORT EResult from_binary_to_ascii(FILE& src_file, FILE& dst_fil
         // propagate error
         return res;
     while ((EBlockType)block_header.type == EBlockType::Thumbnail) {
-        ThumbnailBlock thumbnail_block;
+        ThumbnailBlock thumbnail_block(resource);
         res = thumbnail_block.read_data(src_file, file_header, block_header);
         if (res != EResult::Success)
             // propagate error
             return res;
         static constexpr const size_t max_row_length = 78;
-        std::string encoded;
+        std::pmr::string encoded(resource);
         encoded.resize(boost::beast::detail::base64::encoded_size(thumbnail_block.data.size()));
         encoded.resize(boost::beast::detail::base64::encode((void*)encoded.data(), (const void*)thumbnail_block.data.data(), thumbnail_block.data.size()));
         std::string format;
@@ -741,13 +776,14 @@ BGCODE_CONVERT_EXPORT EResult from_binary_to_ascii(FILE& src_file, FILE& dst_fil
         if (!write_line("\n;\n; " + format + " begin " + std::to_string(thumbnail_block.params.width) + "x" + std::to_string(thumbnail_block.params.height) +
             " " + std::to_string(encoded.length()) + "\n"))
             return EResult::WriteError;
-        while (encoded.size() > max_row_length) {
-            if (!write_line("; " + encoded.substr(0, max_row_length) + "\n"))
+        std::string_view encoded_rows(encoded);
+        while (encoded_rows.size() > max_row_length) {
+            if (!write_line("; ") || !write_line(encoded_rows.substr(0, max_row_length)) || !write_line("\n"))
                 return EResult::WriteError;
-            encoded = encoded.substr(max_row_length);
+            encoded_rows.remove_prefix(max_row_length);
         }
-        if (encoded.size() > 0) {
-            if (!write_line("; " + encoded + "\n"))
+        if (encoded_rows.size() > 0) {
+            if (!write_line("; ") || !write_line(encoded_rows) || !write_line("\n"))
                 return EResult::WriteError;
         }
         if (!write_line("; " + format + " end\n;\n"))
@@ -763,8 +799,8 @@ BGCODE_CONVERT_EXPORT EResult from_binary_to_ascii(FILE& src_file, FILE& dst_fil
     //
     // convert gcode blocks
     //
-    auto remove_empty_lines = [](const std::string& data) {
-        std::string ret;
+    auto remove_empty_lines = [resource](const std::pmr::string& data) {
+        std::pmr::string ret(resource);
         auto begin_it = data.begin();
         auto end_it = data.begin();
         while (end_it != data.end()) {
@@ -776,8 +812,10 @@ BGCODE_CONVERT_EXPORT EResult from_binary_to_ascii(FILE& src_file, FILE& dst_fil
           const size_t line_length = std::distance(begin_it, end_it);
           const std::string_view original_line(&data[pos], line_length);
           const std::string_view reduced_line = uncomment(trim(original_line));
-          if (!reduced_line.empty())
-              ret += std::string(original_line) + "\n";
+          if (!reduced_line.empty()) {
+              ret += original_line;
+              ret += '\n';
+          }
           begin_it = ++end_it;
         }
 
@@ -795,12 +833,12 @@ BGCODE_CONVERT_EXPORT EResult from_binary_to_ascii(FILE& src_file, FILE& dst_fil
         // propagate error
         return res;
     while ((EBlockType)block_header.type == EBlockType::GCode) {
-        GCodeBlock block;
+        GCodeBlock block(resource);
         res = block.read_data(src_file, file_header, block_header);
         if (res != EResult::Success)
             // propagate error
             return res;
-        const std::string out_str = remove_empty_lines(block.raw_data);
+        const std::pmr::string out_str = remove_empty_lines(block.raw_data);
         if (!out_str.empty()) {
             if (!write_line(out_str))
                 return EResult::WriteError;
@@ -823,7 +861,7 @@ BGCODE_CONVERT_EXPORT EResult from_binary_to_ascii(FILE& src_file, FILE& dst_fil
         return res;
     if ((EBlockType)block_header.type != EBlockType::PrintMetadata)
         return EResult::InvalidSequenceOfBlocks;
-    PrintMetadataBlock print_metadata_block;
+    PrintMetadataBlock print_metadata_block(resource);
     res = print_metadata_block.read_data(src_file, file_header, block_header);
     if (res != EResult::Success)
         // propagate error
@@ -855,7 +893,7 @@ BGCODE_CONVERT_EXPORT EResult from_binary_to_ascii(FILE& src_file, FILE& dst_fil
 
         case EPeekSlicerMetadataResult::Slicer3MetadataFound:
         {
-            Slicer3MetadataBlock block;
+            Slicer3MetadataBlock block(resource);
             res = block.read_data(src_file, file_header, block_header);
             slicer_metadata_block = std::move(block);
 
@@ -864,7 +902,7 @@ BGCODE_CONVERT_EXPORT EResult from_binary_to_ascii(FILE& src_file, FILE& dst_fil
 
         case EPeekSlicerMetadataResult::SlicerMetadataFound:
         {
-            SlicerMetadataBlock block;
+            SlicerMetadataBlock block(resource);
             res = block.read_data(src_file, file_header, block_header);
             slicer_legacy_metadata_block = std::move(block);
             break;
@@ -882,7 +920,7 @@ BGCODE_CONVERT_EXPORT EResult from_binary_to_ascii(FILE& src_file, FILE& dst_fil
     if (slicer_metadata_block.has_value()) {
         if (!write_line("\n; prusaslicer_json_config = begin\n"))
             return EResult::WriteError;
-        if (!write_line("; " + slicer_metadata_block->json() + "\n"))
+        if (!write_line("; ") || !write_line(slicer_metadata_block->json()) || !write_line("\n"))
             return EResult::WriteError;
         if (!write_line("; prusaslicer_json_config = end\n"))
             return EResult::WriteError;
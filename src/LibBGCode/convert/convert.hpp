@@ -10,8 +10,73 @@ namespace bgcode { namespace convert {
 // and save the results into dst_file,
 extern BGCODE_CONVERT_EXPORT core::EResult from_ascii_to_binary(FILE& src_file, FILE& dst_file, const binarize::BinarizerConfig& config);
 
-// Converts the gcode file contained into src_file from binary to ascii format and save the results into dst_file
-extern BGCODE_CONVERT_EXPORT core::EResult from_binary_to_ascii(FILE& src_file, FILE& dst_file, bool verify_checksum);
+// Converts the gcode file contained into src_file from ascii (using the parameters specified with the given config) to binary format
+// and passes the results to dst, one block at a time, as soon as each block is complete.
+// The output is never repositioned, so dst may forward the data to a non seekable destination.
+// The binarized blocks are allocated from the given memory resource.
+extern BGCODE_CONVERT_EXPORT core::EResult from_ascii_to_binary(FILE& src_file, binarize::Binarizer::OutputCallback dst,
+    const binarize::BinarizerConfig& config, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+// Converts the gcode file contained into src_file from ascii to binary format, as above, and sets layer_index to the index of the layers
+// of the generated file (see binarize/layer_index.hpp), e.g. to save it into a sidecar file.
+extern BGCODE_CONVERT_EXPORT core::EResult from_ascii_to_binary(FILE& src_file, FILE& dst_file, const binarize::BinarizerConfig& config,
+    binarize::LayerIndex& layer_index);
+
+// Converts the gcode file contained into src_file from ascii to binary format, as above, and sets statistics to the statistics
+// of the generated gcode blocks, e.g. to report the compressions selected by BinarizerConfig::auto_gcode_compression.
+extern BGCODE_CONVERT_EXPORT core::EResult from_ascii_to_binary(FILE& src_file, FILE& dst_file, const binarize::BinarizerConfig& config,
+    binarize::BinarizerStatistics& statistics);
+
+// Converts the gcode file contained into src_file from binary to ascii format and save the results into dst_file.
+// The decoded blocks and the temporaries are allocated from the given memory resource.
+extern BGCODE_CONVERT_EXPORT core::EResult from_binary_to_ascii(FILE& src_file, FILE& dst_file, bool verify_checksum,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+// Converts the binary gcode file contained into src_file to the compressions, encodings and checksum specified with the given config,
+// block by block, and save the results into dst_file.
+// Blocks already matching the config are copied raw (on Linux by the kernel, see copy_file_range()), gcode blocks needing a
+// different compression or encoding are encoded in parallel using the given count of threads (0 = hardware concurrency).
+// Blocks compressed with deflate are compressed again if the deflate parameters of the config differ from the defaults.
+// When auto_gcode_compression is enabled all the gcode blocks are compressed again, each with the compression it selects
+// (see binarize::serialize_gcode_block()).
+// The blocks are never split nor merged: the fields of the config setting the block boundaries (layer_aligned_blocks,
+// content_defined_blocks and their sizes) are ignored, as index_block and hash_tree_block.
+// The checksum of the blocks whose data are rewritten is verified.
+// The index and the hash tree blocks, if any, are dropped, and the file header is saved with the version required by the
+// gcode encoding of the config (see core::gcode_encoding_version()).
+extern BGCODE_CONVERT_EXPORT core::EResult transcode(FILE& src_file, FILE& dst_file, const binarize::BinarizerConfig& config, size_t jobs = 0);
+
+// Merges the gcode blocks of the binary gcode files contained into src_files, in the given order, and save the results into dst_file.
+// The blocks preceding the gcode blocks (metadata and thumbnails) are taken from the first file, as its file header, whose version
+// is set to the latest version of the given files.
+// The gcode blocks are copied raw, their checksum is rewritten only for the files having a checksum type different from the first file.
+// The index and the hash tree blocks, if any, are dropped.
+extern BGCODE_CONVERT_EXPORT core::EResult concatenate(const std::vector<FILE*>& src_files, FILE& dst_file);
+
+// Sets count to the count of gcode blocks contained into the given binary gcode file.
+extern BGCODE_CONVERT_EXPORT core::EResult count_gcode_blocks(FILE& file, size_t& count);
+
+// Saves into dst_file the blocks of the binary gcode file contained into src_file which precede the gcode blocks, followed by
+// the gcode blocks with index in [first_block, first_block + blocks_count), copied raw.
+// The range is clipped to the blocks contained into src_file, returns EResult::BlockNotFound if it is empty.
+// The index and the hash tree blocks, if any, are dropped.
+extern BGCODE_CONVERT_EXPORT core::EResult extract_gcode_blocks(FILE& src_file, FILE& dst_file, size_t first_block, size_t blocks_count);
+
+// Verifies the blocks of the binary gcode file contained into file against its hash tree block (see core::HashTreeLeaves):
+// the blocks preceding the gcode blocks and the gcode blocks with index in [first_block, first_block + blocks_count) must match
+// both their own checksum and their leaf. The blocks are read sequentially and verified in parallel using the given count
+// of threads (0 = hardware concurrency), e.g. to check only the metadata and the blocks about to be printed.
+// If expected_root is not null, the leaves are first checked against it, returning EResult::InvalidHashTree if the root of
+// the hash tree differs: with a root obtained separately from the file (e.g. from the sender), a range of blocks is then
+// verified to belong to the whole expected file, and not only to match the hash tree saved into it.
+// The range is clipped to the gcode blocks covered by the hash tree, returns EResult::BlockNotFound if it is empty or if the file
+// has no hash tree block.
+// The file may be truncated, e.g. partially downloaded: the blocks it contains are verified, then EResult::BlockNotFound
+// is returned if the range includes missing gcode blocks.
+// If available_blocks_count is not null, it is set to the count of gcode blocks contained into the file, which is the index
+// of the first missing one, e.g. to resume the download from it.
+extern BGCODE_CONVERT_EXPORT core::EResult verify_blocks(FILE& file, size_t first_block = 0, size_t blocks_count = SIZE_MAX,
+    size_t jobs = 0, const uint32_t* expected_root = nullptr, size_t* available_blocks_count = nullptr);
 
 }} // bgcode::core
 
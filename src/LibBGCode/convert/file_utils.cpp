@@ -0,0 +1,113 @@
+#include "file_utils.hpp"
+
+#include "core/core_impl.hpp"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#if defined(__linux__) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define BGCODE_HAS_COPY_FILE_RANGE
+#include <unistd.h>
+#endif
+
+namespace bgcode {
+using namespace core;
+namespace convert {
+
+long get_file_size(FILE& file)
+{
+    const long position = ftell(&file);
+    if (position < 0 || fseek(&file, 0, SEEK_END) != 0)
+        return -1;
+    const long size = ftell(&file);
+    if (fseek(&file, position, SEEK_SET) != 0)
+        return -1;
+    return size;
+}
+
+EResult copy_file_data(FILE& src_file, long src_position, FILE& dst_file, size_t size)
+{
+#ifdef BGCODE_HAS_COPY_FILE_RANGE
+    // the kernel copies from/to explicit offsets, bypassing the stdio buffers
+    if (size > 0 && fflush(&dst_file) == 0) {
+        const long dst_position = ftell(&dst_file);
+        if (dst_position >= 0) {
+            loff_t in_offset = src_position;
+            loff_t out_offset = dst_position;
+            while (size > 0) {
+                const ssize_t copied = copy_file_range(fileno(&src_file), &in_offset, fileno(&dst_file), &out_offset, size, 0);
+                if (copied <= 0)
+                    // not supported by the files (pipes, different file systems on old kernels...), copy the rest through the buffer
+                    break;
+                size -= (size_t)copied;
+            }
+            src_position = (long)in_offset;
+            if (fseek(&dst_file, (long)out_offset, SEEK_SET) != 0)
+                return EResult::WriteError;
+        }
+    }
+#endif // BGCODE_HAS_COPY_FILE_RANGE
+
+    if (size == 0)
+        return EResult::Success;
+
+    if (fseek(&src_file, src_position, SEEK_SET) != 0)
+        return EResult::ReadError;
+    std::array<std::byte, 65536> buffer;
+    while (size > 0) {
+        const size_t chunk_size = std::min(size, buffer.size());
+        if (fread(buffer.data(), 1, chunk_size, &src_file) != chunk_size)
+            return EResult::ReadError;
+        if (fwrite(buffer.data(), 1, chunk_size, &dst_file) != chunk_size)
+            return EResult::WriteError;
+        size -= chunk_size;
+    }
+    return EResult::Success;
+}
+
+EResult copy_block(FILE& src_file, const FileHeader& file_header, const BlockHeader& block_header, FILE& dst_file)
+{
+    return copy_file_data(src_file, block_header.get_position(), dst_file, block_header.get_size() + block_content_size(file_header, block_header));
+}
+
+EResult copy_block_with_checksum(FILE& src_file, const FileHeader& src_header, const BlockHeader& block_header, FILE& dst_file,
+    EChecksumType checksum_type)
+{
+    if (fseek(&src_file, block_header.get_position() + (long)block_header.get_size(), SEEK_SET) != 0)
+        return EResult::ReadError;
+    std::vector<std::byte> payload(block_payload_size(block_header));
+    if (fread(payload.data(), 1, payload.size(), &src_file) != payload.size())
+        return EResult::ReadError;
+
+    const EChecksumType src_checksum_type = (EChecksumType)src_header.checksum_type;
+    if (src_checksum_type != EChecksumType::None) {
+        Checksum src_cs(src_checksum_type);
+        update_checksum(src_cs, block_header);
+        src_cs.append(payload.data(), payload.size());
+        Checksum file_cs(src_checksum_type);
+        const EResult res = file_cs.read(src_file);
+        if (res != EResult::Success)
+            return res;
+        if (!src_cs.matches(file_cs))
+            return EResult::InvalidChecksum;
+    }
+
+    BlockHeader dst_header(block_header.type, block_header.compression, block_header.uncompressed_size, block_header.compressed_size);
+    EResult res = dst_header.write(dst_file);
+    if (res != EResult::Success)
+        return res;
+    if (fwrite(payload.data(), 1, payload.size(), &dst_file) != payload.size())
+        return EResult::WriteError;
+    if (checksum_type != EChecksumType::None) {
+        Checksum cs(checksum_type);
+        update_checksum(cs, dst_header);
+        cs.append(payload.data(), payload.size());
+        res = cs.write(dst_file);
+        if (res != EResult::Success)
+            return res;
+    }
+    return EResult::Success;
+}
+
+}} // bgcode::convert
@@ -0,0 +1,31 @@
+#ifndef _BGCODE_FILE_UTILS_HPP_
+#define _BGCODE_FILE_UTILS_HPP_
+
+#include "core/core.hpp"
+
+// Internal helpers shared by the block level file operations (not installed)
+
+namespace bgcode { namespace convert {
+
+// Returns the size of the given file, in bytes, or -1 in case of error.
+// The file position is preserved.
+long get_file_size(FILE& file);
+
+// Copies size bytes, starting at src_position, from src_file to the current position of dst_file.
+// On Linux the data are copied by the kernel (copy_file_range), when the files allow it, otherwise they are
+// copied through a buffer.
+// If return == EResult::Success:
+// - dst_file position will be advanced by size.
+// The src_file position is undefined.
+core::EResult copy_file_data(FILE& src_file, long src_position, FILE& dst_file, size_t size);
+
+// Copies the whole block with the given header, header included, from src_file to the current position of dst_file.
+core::EResult copy_block(FILE& src_file, const core::FileHeader& file_header, const core::BlockHeader& block_header, FILE& dst_file);
+
+// Copies the block header and payload, like copy_block(), verifies the source checksum and replaces it with a checksum of the given type.
+core::EResult copy_block_with_checksum(FILE& src_file, const core::FileHeader& src_header, const core::BlockHeader& block_header, FILE& dst_file,
+    core::EChecksumType checksum_type);
+
+}} // bgcode::convert
+
+#endif // _BGCODE_FILE_UTILS_HPP_
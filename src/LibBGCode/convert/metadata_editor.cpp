@@ -0,0 +1,425 @@
+#include "metadata_editor.hpp"
+#include "file_utils.hpp"
+
+#include "binarize/binarize.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bgcode {
+using namespace core;
+using namespace binarize;
+namespace convert {
+
+static EResult check_edits(const std::vector<MetadataEdit>& edits)
+{
+    for (const MetadataEdit& edit : edits) {
+        switch (edit.block_type)
+        {
+        case EBlockType::FileMetadata:
+        case EBlockType::PrinterMetadata:
+        case EBlockType::PrintMetadata:
+        case EBlockType::SlicerMetadata: { break; }
+        default:                         { return EResult::InvalidBlockType; }
+        }
+    }
+    return EResult::Success;
+}
+
+static bool is_edited(EBlockType block_type, const std::vector<MetadataEdit>& edits)
+{
+    return std::any_of(edits.begin(), edits.end(), [block_type](const MetadataEdit& edit) { return edit.block_type == block_type; });
+}
+
+static void apply_edits(EBlockType block_type, const std::vector<MetadataEdit>& edits, BaseMetadataBlock& block)
+{
+    for (const MetadataEdit& edit : edits) {
+        if (edit.block_type != block_type)
+            continue;
+        auto it = std::find_if(block.raw_data.begin(), block.raw_data.end(),
+            [&edit](const auto& item) { return std::string_view(item.first) == edit.key; });
+        if (edit.erase) {
+            if (it != block.raw_data.end())
+                block.raw_data.erase(it);
+        }
+        else if (it != block.raw_data.end())
+            it->second.assign(edit.value);
+        else
+            block.raw_data.emplace_back(edit.key, edit.value);
+    }
+}
+
+// Returns true if the block with the given header, whose data the file is positioned at, is modified by the edits.
+// The slicer metadata block with JSON encoding is kept untouched, only the INI one is edited
+static bool is_edited(FILE& file, const BlockHeader& block_header, const std::vector<MetadataEdit>& edits)
+{
+    const EBlockType block_type = (EBlockType)block_header.type;
+    if (!is_edited(block_type, edits))
+        return false;
+    return block_type != EBlockType::SlicerMetadata ||
+        peek_slicer_metadata_block(file, block_header) != EPeekSlicerMetadataResult::Slicer3MetadataFound;
+}
+
+// Decodes the metadata block with the given header into block and applies the edits
+static EResult edit_block(FILE& file, const FileHeader& file_header, const BlockHeader& block_header, const std::vector<MetadataEdit>& edits,
+    std::vector<std::byte>& cs_buffer, BaseMetadataBlock& block)
+{
+    const EBlockType block_type = (EBlockType)block_header.type;
+
+    const EChecksumType checksum_type = (EChecksumType)file_header.checksum_type;
+    if (checksum_type != EChecksumType::None) {
+        // the data are rewritten with a new checksum, verify the old one
+        const EResult res = verify_block_checksum(file, file_header, block_header, cs_buffer.data(), cs_buffer.size());
+        if (res != EResult::Success)
+            return res;
+    }
+
+    if (fseek(&file, block_header.get_position() + (long)block_header.get_size(), SEEK_SET) != 0)
+        return EResult::ReadError;
+    block.raw_data.clear();
+    const EResult res = block.read_data(file, block_header);
+    if (res != EResult::Success)
+        return res;
+    apply_edits(block_type, edits, block);
+    return EResult::Success;
+}
+
+// Returns EResult::BlockNotFound if any of the edited blocks, but the file metadata one, is not contained into found
+static EResult check_found(const std::vector<MetadataEdit>& edits, const std::vector<EBlockType>& found)
+{
+    for (const MetadataEdit& edit : edits) {
+        if (edit.block_type != EBlockType::FileMetadata && std::find(found.begin(), found.end(), edit.block_type) == found.end())
+            return EResult::BlockNotFound;
+    }
+    return EResult::Success;
+}
+
+// Serializes into block the index block starting at the given position, with the positions moved by the given offset
+static EResult shift_gcode_block_index(FILE& src_file, const FileHeader& file_header, long position, long offset,
+    std::vector<std::byte>& cs_buffer, std::pmr::vector<uint8_t>& block)
+{
+    if (fseek(&src_file, position, SEEK_SET) != 0)
+        return EResult::ReadError;
+    GCodeBlockIndex index;
+    const EResult res = read_gcode_block_index(src_file, file_header, index, cs_buffer.data(), cs_buffer.size());
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+    for (GCodeBlockIndexEntry& entry : index) {
+        entry.position += offset;
+    }
+    return write_gcode_block_index(index, (EChecksumType)file_header.checksum_type, block);
+}
+
+// Returns the checksum closing the given serialized block, which must be 4 bytes long
+static uint32_t block_checksum(const std::pmr::vector<uint8_t>& block)
+{
+    uint32_t ret;
+    memcpy(&ret, block.data() + block.size() - sizeof(ret), sizeof(ret));
+    return ret;
+}
+
+// Reads the checksum closing the block with the given header, which must be 4 bytes long
+static EResult read_block_checksum(FILE& file, const FileHeader& file_header, const BlockHeader& block_header, uint32_t& checksum)
+{
+    const long end = block_header.get_position() + (long)(block_header.get_size() + block_content_size(file_header, block_header));
+    if (fseek(&file, end - (long)sizeof(checksum), SEEK_SET) != 0 || fread(&checksum, 1, sizeof(checksum), &file) != sizeof(checksum))
+        return EResult::ReadError;
+    return EResult::Success;
+}
+
+// Saves into dst_file the hash tree block starting at the given position, followed by the index block, if any.
+// The checksums of the src_leading_count blocks preceding the hash tree are replaced by dst_checksums, the ones of the blocks already
+// saved into dst_file, and the positions into the index are moved accordingly.
+// Sets position to the position of the block following the saved ones.
+static EResult update_hash_tree(FILE& src_file, const FileHeader& file_header, long& position, size_t src_leading_count,
+    HashTreeLeaves& dst_checksums, std::vector<std::byte>& cs_buffer, FILE& dst_file)
+{
+    if (fseek(&src_file, position, SEEK_SET) != 0)
+        return EResult::ReadError;
+    HashTreeLeaves leaves;
+    EResult res = read_hash_tree(src_file, file_header, leaves, cs_buffer.data(), cs_buffer.size());
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+    const long next_position = ftell(&src_file);
+    BlockHeader block_header;
+    res = read_next_block_header(src_file, file_header, block_header);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+    const bool has_index = (EBlockType)block_header.type == EBlockType::Index;
+    const size_t gcode_leaves_begin = src_leading_count + (has_index ? 1 : 0);
+    if (leaves.size() < gcode_leaves_begin)
+        return EResult::InvalidHashTree;
+
+    const EChecksumType checksum_type = (EChecksumType)file_header.checksum_type;
+    const size_t leaves_count = dst_checksums.size() + leaves.size() - src_leading_count;
+    const BlockHeader tree_header((uint16_t)EBlockType::HashTree, (uint16_t)ECompressionType::None, (uint32_t)(leaves_count * sizeof(uint32_t)));
+    const long tree_size = (long)(tree_header.get_size() + block_content_size(file_header, tree_header));
+
+    std::pmr::vector<uint8_t> index_block;
+    if (has_index) {
+        // the gcode blocks are moved by the size change of the metadata and of the hash tree
+        res = shift_gcode_block_index(src_file, file_header, next_position, ftell(&dst_file) + tree_size - next_position, cs_buffer, index_block);
+        if (res != EResult::Success)
+            return res;
+        dst_checksums.emplace_back(block_checksum(index_block));
+    }
+    // the gcode blocks are not modified
+    dst_checksums.insert(dst_checksums.end(), leaves.begin() + gcode_leaves_begin, leaves.end());
+
+    std::pmr::vector<uint8_t> tree_block;
+    res = write_hash_tree(dst_checksums, checksum_type, tree_block);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+    if (fwrite(tree_block.data(), 1, tree_block.size(), &dst_file) != tree_block.size() ||
+        fwrite(index_block.data(), 1, index_block.size(), &dst_file) != index_block.size())
+        return EResult::WriteError;
+
+    position = has_index ? ftell(&src_file) : next_position;
+    return EResult::Success;
+}
+
+BGCODE_CONVERT_EXPORT EResult edit_metadata(FILE& src_file, FILE& dst_file, const std::vector<MetadataEdit>& edits)
+{
+    EResult res = check_edits(edits);
+    if (res != EResult::Success)
+        return res;
+
+    const long file_size = get_file_size(src_file);
+    if (file_size < 0)
+        return EResult::ReadError;
+
+    FileHeader file_header;
+    res = read_header(src_file, file_header, nullptr);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+    res = file_header.write(dst_file);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    const EChecksumType checksum_type = (EChecksumType)file_header.checksum_type;
+    std::vector<std::byte> cs_buffer(65536);
+    BaseMetadataBlock metadata;
+    std::pmr::vector<uint8_t> block;
+    std::vector<EBlockType> found;
+    bool file_metadata_found = false;
+    // checksums of the blocks saved into dst_file, used to update the hash tree, if any
+    const bool hash_tree_allowed = checksum_size(checksum_type) == sizeof(uint32_t);
+    HashTreeLeaves dst_checksums;
+    size_t src_blocks_count = 0;
+
+    BlockHeader block_header;
+    long position = ftell(&src_file);
+    while (position < file_size) {
+        if (fseek(&src_file, position, SEEK_SET) != 0)
+            return EResult::ReadError;
+        res = read_next_block_header(src_file, file_header, block_header);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+
+        const EBlockType block_type = (EBlockType)block_header.type;
+        if (block_type == EBlockType::GCode) {
+            // no metadata follow the gcode blocks, copy all of them at once
+            res = copy_file_data(src_file, position, dst_file, (size_t)(file_size - position));
+            if (res != EResult::Success)
+                return res;
+            break;
+        }
+
+        if (block_type == EBlockType::HashTree) {
+            // the hash tree block is followed by the index block, if any, and by the gcode blocks
+            if (!hash_tree_allowed)
+                return EResult::InvalidHashTree;
+            res = update_hash_tree(src_file, file_header, position, src_blocks_count, dst_checksums, cs_buffer, dst_file);
+            if (res != EResult::Success)
+                return res;
+            continue;
+        }
+
+        if (block_type == EBlockType::Index) {
+            // the index block is the last block preceding the gcode blocks, which are moved by the size change of the metadata
+            res = shift_gcode_block_index(src_file, file_header, position, ftell(&dst_file) - position, cs_buffer, block);
+            if (res != EResult::Success)
+                return res;
+            if (fwrite(block.data(), 1, block.size(), &dst_file) != block.size())
+                return EResult::WriteError;
+            position = ftell(&src_file);
+            continue;
+        }
+
+        ++src_blocks_count;
+
+        if (block_type == EBlockType::FileMetadata)
+            file_metadata_found = true;
+        else if (!file_metadata_found) {
+            // the file metadata block, if any, is the first block
+            file_metadata_found = true;
+            if (is_edited(EBlockType::FileMetadata, edits)) {
+                FileMetadataBlock file_metadata;
+                apply_edits(EBlockType::FileMetadata, edits, file_metadata);
+                if (!file_metadata.raw_data.empty()) {
+                    res = file_metadata.serialize(block, EBlockType::FileMetadata, ECompressionType::None, checksum_type);
+                    if (res != EResult::Success)
+                        return res;
+                    if (fwrite(block.data(), 1, block.size(), &dst_file) != block.size())
+                        return EResult::WriteError;
+                    if (hash_tree_allowed)
+                        dst_checksums.emplace_back(block_checksum(block));
+                }
+            }
+        }
+
+        if (is_edited(src_file, block_header, edits)) {
+            res = edit_block(src_file, file_header, block_header, edits, cs_buffer, metadata);
+            if (res != EResult::Success)
+                return res;
+            found.emplace_back(block_type);
+            // the file metadata block is optional, it is dropped once empty
+            if (block_type != EBlockType::FileMetadata || !metadata.raw_data.empty()) {
+                res = metadata.serialize(block, block_type, (ECompressionType)block_header.compression, checksum_type);
+                if (res != EResult::Success)
+                    return res;
+                if (fwrite(block.data(), 1, block.size(), &dst_file) != block.size())
+                    return EResult::WriteError;
+                if (hash_tree_allowed)
+                    dst_checksums.emplace_back(block_checksum(block));
+            }
+        }
+        else {
+            res = copy_block(src_file, file_header, block_header, dst_file);
+            if (res == EResult::Success && hash_tree_allowed)
+                res = read_block_checksum(src_file, file_header, block_header, dst_checksums.emplace_back());
+            if (res != EResult::Success)
+                return res;
+        }
+
+        position = block_header.get_position() + (long)block_header.get_size() + (long)block_content_size(file_header, block_header);
+    }
+
+    return check_found(edits, found);
+}
+
+BGCODE_CONVERT_EXPORT EResult edit_metadata_in_place(FILE& file, const std::vector<MetadataEdit>& edits, bool& edited)
+{
+    edited = false;
+    EResult res = check_edits(edits);
+    if (res != EResult::Success)
+        return res;
+
+    const long file_size = get_file_size(file);
+    if (file_size < 0)
+        return EResult::ReadError;
+
+    FileHeader file_header;
+    res = read_header(file, file_header, nullptr);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    struct EditedBlock
+    {
+        long position;
+        // position of the checksum of the block into the hash tree
+        size_t leaf;
+        std::pmr::vector<uint8_t> data;
+    };
+    std::vector<EditedBlock> edited_blocks;
+    BaseMetadataBlock metadata;
+    std::vector<std::byte> cs_buffer(65536);
+    std::vector<EBlockType> found;
+    // the hash tree, if any, is updated with the checksums of the edited blocks
+    HashTreeLeaves leaves;
+    long hash_tree_position = -1;
+    size_t blocks_count = 0;
+
+    BlockHeader block_header;
+    long position = ftell(&file);
+    while (position < file_size) {
+        if (fseek(&file, position, SEEK_SET) != 0)
+            return EResult::ReadError;
+        res = read_next_block_header(file, file_header, block_header);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+
+        const EBlockType block_type = (EBlockType)block_header.type;
+        if (block_type == EBlockType::GCode)
+            break;
+
+        const size_t block_size = block_header.get_size() + block_content_size(file_header, block_header);
+        if (block_type == EBlockType::HashTree) {
+            hash_tree_position = position;
+            if (fseek(&file, position, SEEK_SET) != 0)
+                return EResult::ReadError;
+            res = read_hash_tree(file, file_header, leaves, cs_buffer.data(), cs_buffer.size());
+            if (res != EResult::Success)
+                // propagate error
+                return res;
+            position += (long)block_size;
+            continue;
+        }
+
+        if (is_edited(file, block_header, edits)) {
+            EditedBlock& edited_block = edited_blocks.emplace_back();
+            edited_block.position = position;
+            edited_block.leaf = blocks_count;
+            res = edit_block(file, file_header, block_header, edits, cs_buffer, metadata);
+            if (res == EResult::Success)
+                res = metadata.serialize(edited_block.data, block_type, (ECompressionType)block_header.compression,
+                    (EChecksumType)file_header.checksum_type);
+            if (res != EResult::Success)
+                return res;
+            if (edited_block.data.size() != block_size)
+                // the edited block does not fit
+                return EResult::Success;
+            found.emplace_back(block_type);
+        }
+
+        position += (long)block_size;
+        ++blocks_count;
+    }
+
+    if (is_edited(EBlockType::FileMetadata, edits) && std::find(found.begin(), found.end(), EBlockType::FileMetadata) == found.end())
+        // the file metadata block cannot be inserted in place
+        return EResult::Success;
+    res = check_found(edits, found);
+    if (res != EResult::Success)
+        return res;
+
+    if (hash_tree_position >= 0) {
+        if (checksum_size((EChecksumType)file_header.checksum_type) != sizeof(uint32_t))
+            return EResult::InvalidHashTree;
+        for (const EditedBlock& edited_block : edited_blocks) {
+            if (edited_block.leaf >= leaves.size())
+                return EResult::InvalidHashTree;
+            leaves[edited_block.leaf] = block_checksum(edited_block.data);
+        }
+        // the hash tree keeps its size
+        EditedBlock& edited_block = edited_blocks.emplace_back();
+        edited_block.position = hash_tree_position;
+        res = write_hash_tree(leaves, (EChecksumType)file_header.checksum_type, edited_block.data);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+    }
+
+    for (const EditedBlock& edited_block : edited_blocks) {
+        if (fseek(&file, edited_block.position, SEEK_SET) != 0)
+            return EResult::WriteError;
+        if (fwrite(edited_block.data.data(), 1, edited_block.data.size(), &file) != edited_block.data.size())
+            return EResult::WriteError;
+    }
+    if (fflush(&file) != 0)
+        return EResult::WriteError;
+
+    edited = true;
+    return EResult::Success;
+}
+
+}} // bgcode::convert
@@ -0,0 +1,47 @@
+#ifndef _BGCODE_METADATA_EDITOR_HPP_
+#define _BGCODE_METADATA_EDITOR_HPP_
+
+#include "convert/export.h"
+#include "core/core.hpp"
+
+#include <string>
+#include <vector>
+
+namespace bgcode { namespace convert {
+
+//
+// Editing of the metadata of binary gcode files.
+// Only the edited metadata blocks are decoded and encoded again (keeping their compression and encoding), all the other blocks
+// are copied raw, so that the cost does not depend on the size of the gcode.
+// Slicer metadata in JSON format cannot be edited, the block is copied untouched and the edits apply to the INI one.
+//
+
+struct MetadataEdit
+{
+    // one of FileMetadata, PrinterMetadata, PrintMetadata, SlicerMetadata
+    core::EBlockType block_type{ core::EBlockType::PrintMetadata };
+    std::string key;
+    // ignored if erase is true
+    std::string value;
+    // remove the key instead of setting it
+    bool erase{ false };
+};
+
+// Applies the given edits to the metadata of the binary gcode file contained into src_file and save the results into dst_file.
+// The edits are applied in order, keys not found are appended to the block.
+// A file metadata block is inserted if the file has none and it is edited, and it is removed if all its keys are erased.
+// The checksum of the edited blocks is verified before decoding them.
+// The positions saved into the index block, if any, are moved to follow the gcode blocks.
+// Returns EResult::BlockNotFound if any of the edited blocks (but the file metadata one) is missing.
+extern BGCODE_CONVERT_EXPORT core::EResult edit_metadata(FILE& src_file, FILE& dst_file, const std::vector<MetadataEdit>& edits);
+
+// Applies the given edits to the metadata of the binary gcode file contained into file, which must be opened for update ("r+b"),
+// overwriting the edited blocks.
+// This is possible only when every edited block keeps its size, otherwise edit_metadata() is required.
+// If return == EResult::Success:
+// - edited will be true if the edits were applied, false if they did not fit and the file was left untouched.
+extern BGCODE_CONVERT_EXPORT core::EResult edit_metadata_in_place(FILE& file, const std::vector<MetadataEdit>& edits, bool& edited);
+
+}} // bgcode::convert
+
+#endif // _BGCODE_METADATA_EDITOR_HPP_
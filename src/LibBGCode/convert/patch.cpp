@@ -0,0 +1,293 @@
+#include "patch.hpp"
+#include "file_utils.hpp"
+
+#include "core/core_impl.hpp"
+
+#include <array>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace bgcode {
+using namespace core;
+namespace convert {
+
+static constexpr const std::array<char, 4> PatchMagic{ 'G', 'C', 'D', 'P' };
+static constexpr const uint32_t PatchVersion{ 2 };
+
+enum class EPatchOperation : uint8_t
+{
+    Copy,
+    Insert,
+    End
+};
+
+// Position and size of a block, header and checksum included, or of the file header
+struct BlockRange
+{
+    long position;
+    size_t size;
+};
+
+// Sets ranges to the ranges of the file header and of all the blocks of the given file, which cover the whole file
+static EResult read_block_ranges(FILE& file, std::vector<BlockRange>& ranges)
+{
+    ranges.clear();
+    const long file_size = get_file_size(file);
+    if (file_size < 0)
+        return EResult::ReadError;
+
+    FileHeader file_header;
+    EResult res = read_header(file, file_header, nullptr);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+    long position = ftell(&file);
+    ranges.push_back({ 0, (size_t)position });
+
+    BlockHeader block_header;
+    while (position < file_size) {
+        if (fseek(&file, position, SEEK_SET) != 0)
+            return EResult::ReadError;
+        res = read_next_block_header(file, file_header, block_header);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        const size_t size = block_header.get_size() + block_content_size(file_header, block_header);
+        if (position + (long)size > file_size)
+            return EResult::ReadError;
+        ranges.push_back({ position, size });
+        position += (long)size;
+    }
+    return EResult::Success;
+}
+
+static bool read_range(FILE& file, const BlockRange& range, std::vector<uint8_t>& data)
+{
+    data.resize(range.size);
+    return fseek(&file, range.position, SEEK_SET) == 0 && fread(data.data(), 1, range.size, &file) == range.size;
+}
+
+template<typename T>
+static bool write_value(FILE& file, const T& value)
+{
+    return fwrite(&value, 1, sizeof(value), &file) == sizeof(value);
+}
+
+template<typename T>
+static bool read_value(FILE& file, T& value)
+{
+    return fread(&value, 1, sizeof(value), &file) == sizeof(value);
+}
+
+BGCODE_CONVERT_EXPORT EResult diff_binary_gcode(FILE& old_file, FILE& new_file, FILE& patch_file, PatchStatistics* statistics)
+{
+    std::vector<BlockRange> old_ranges;
+    EResult res = read_block_ranges(old_file, old_ranges);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+    std::vector<BlockRange> new_ranges;
+    res = read_block_ranges(new_file, new_ranges);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    // blocks of the old file by checksum, the ranges cover the whole old file, in order
+    std::unordered_multimap<uint32_t, size_t> old_blocks;
+    uint32_t old_crc = 0;
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < old_ranges.size(); ++i) {
+        if (!read_range(old_file, old_ranges[i], data))
+            return EResult::ReadError;
+        old_blocks.emplace(crc32c(data.data(), data.size(), 0), i);
+        old_crc = crc32c(data.data(), data.size(), old_crc);
+    }
+
+    const BlockRange& old_last_range = old_ranges.back();
+    const uint64_t old_file_size = (uint64_t)old_last_range.position + old_last_range.size;
+    if (fwrite(PatchMagic.data(), 1, PatchMagic.size(), &patch_file) != PatchMagic.size() || !write_value(patch_file, PatchVersion) ||
+        !write_value(patch_file, old_file_size) || !write_value(patch_file, old_crc))
+        return EResult::WriteError;
+
+    PatchStatistics stats;
+    stats.patch_size = PatchMagic.size() + sizeof(PatchVersion) + sizeof(old_file_size) + sizeof(old_crc);
+    // the operation being built, consecutive blocks are merged into a single operation
+    EPatchOperation pending = EPatchOperation::End;
+    BlockRange pending_copy{ 0, 0 };
+    // the inserted blocks are contiguous into the new file, their bytes are copied from it when the operation is flushed
+    BlockRange pending_insert{ 0, 0 };
+    auto flush_pending = [&]() {
+        bool ok = true;
+        if (pending == EPatchOperation::Copy) {
+            ok = write_value(patch_file, pending) && write_value(patch_file, (uint64_t)pending_copy.position) &&
+                write_value(patch_file, (uint64_t)pending_copy.size);
+            stats.patch_size += sizeof(pending) + 2 * sizeof(uint64_t);
+        }
+        else if (pending == EPatchOperation::Insert) {
+            ok = write_value(patch_file, pending) && write_value(patch_file, (uint64_t)pending_insert.size) &&
+                copy_file_data(new_file, pending_insert.position, patch_file, pending_insert.size) == EResult::Success;
+            stats.patch_size += sizeof(pending) + sizeof(uint64_t) + pending_insert.size;
+        }
+        pending = EPatchOperation::End;
+        return ok;
+    };
+
+    uint32_t new_crc = 0;
+    uint64_t new_file_size = 0;
+    std::vector<uint8_t> old_data;
+    for (const BlockRange& range : new_ranges) {
+        if (!read_range(new_file, range, data))
+            return EResult::ReadError;
+        const uint32_t crc = crc32c(data.data(), data.size(), 0);
+        new_crc = crc32c(data.data(), data.size(), new_crc);
+        new_file_size += range.size;
+
+        // the old block following the pending copy, if matching, or the first matching one
+        const BlockRange* match = nullptr;
+        auto [begin, end] = old_blocks.equal_range(crc);
+        for (auto it = begin; it != end; ++it) {
+            const BlockRange& old_range = old_ranges[it->second];
+            if (old_range.size != range.size)
+                continue;
+            if (!read_range(old_file, old_range, old_data))
+                return EResult::ReadError;
+            if (old_data != data)
+                continue;
+            if (match == nullptr || (pending == EPatchOperation::Copy && old_range.position == pending_copy.position + (long)pending_copy.size))
+                match = &old_range;
+        }
+
+        if (match != nullptr) {
+            ++stats.copied_blocks;
+            stats.copied_size += range.size;
+            if (pending == EPatchOperation::Copy && match->position == pending_copy.position + (long)pending_copy.size) {
+                pending_copy.size += match->size;
+                continue;
+            }
+            if (!flush_pending())
+                return EResult::WriteError;
+            pending = EPatchOperation::Copy;
+            pending_copy = *match;
+        }
+        else {
+            ++stats.inserted_blocks;
+            stats.inserted_size += range.size;
+            if (pending == EPatchOperation::Insert) {
+                pending_insert.size += range.size;
+                continue;
+            }
+            if (!flush_pending())
+                return EResult::WriteError;
+            pending = EPatchOperation::Insert;
+            pending_insert = range;
+        }
+    }
+
+    if (!flush_pending() || !write_value(patch_file, EPatchOperation::End) || !write_value(patch_file, new_file_size) ||
+        !write_value(patch_file, new_crc))
+        return EResult::WriteError;
+    stats.patch_size += sizeof(EPatchOperation) + sizeof(new_file_size) + sizeof(new_crc);
+
+    if (statistics != nullptr)
+        *statistics = stats;
+    return EResult::Success;
+}
+
+BGCODE_CONVERT_EXPORT EResult apply_patch(FILE& old_file, FILE& patch_file, FILE& new_file)
+{
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint64_t old_file_size;
+    uint32_t old_crc;
+    if (fread(magic.data(), 1, magic.size(), &patch_file) != magic.size())
+        return EResult::ReadError;
+    if (magic != PatchMagic)
+        return EResult::InvalidMagicNumber;
+    if (!read_value(patch_file, version))
+        return EResult::ReadError;
+    if (version != PatchVersion)
+        return EResult::InvalidVersionNumber;
+    if (!read_value(patch_file, old_file_size) || !read_value(patch_file, old_crc))
+        return EResult::ReadError;
+    if (get_file_size(old_file) != (long)old_file_size)
+        return EResult::InvalidBinaryGCodeFile;
+
+    // the whole old file is verified before writing anything
+    std::vector<uint8_t> buffer(65536);
+    if (fseek(&old_file, 0, SEEK_SET) != 0)
+        return EResult::ReadError;
+    uint32_t crc = 0;
+    for (uint64_t size = old_file_size; size > 0;) {
+        const size_t chunk_size = (size_t)std::min<uint64_t>(size, buffer.size());
+        if (fread(buffer.data(), 1, chunk_size, &old_file) != chunk_size)
+            return EResult::ReadError;
+        crc = crc32c(buffer.data(), chunk_size, crc);
+        size -= chunk_size;
+    }
+    if (crc != old_crc)
+        return EResult::InvalidBinaryGCodeFile;
+
+    uint32_t new_crc = 0;
+    uint64_t new_file_size = 0;
+    // copies size bytes from src to new_file, through the buffer
+    auto copy_data = [&](FILE& src, uint64_t size) {
+        while (size > 0) {
+            const size_t chunk_size = (size_t)std::min<uint64_t>(size, buffer.size());
+            if (fread(buffer.data(), 1, chunk_size, &src) != chunk_size)
+                return EResult::ReadError;
+            if (fwrite(buffer.data(), 1, chunk_size, &new_file) != chunk_size)
+                return EResult::WriteError;
+            new_crc = crc32c(buffer.data(), chunk_size, new_crc);
+            new_file_size += chunk_size;
+            size -= chunk_size;
+        }
+        return EResult::Success;
+    };
+
+    EPatchOperation operation;
+    while (read_value(patch_file, operation)) {
+        EResult res = EResult::Success;
+        switch (operation)
+        {
+        case EPatchOperation::Copy:
+        {
+            uint64_t position;
+            uint64_t size;
+            if (!read_value(patch_file, position) || !read_value(patch_file, size))
+                return EResult::ReadError;
+            if (position > old_file_size || size > old_file_size - position)
+                return EResult::InvalidBuffer;
+            if (fseek(&old_file, (long)position, SEEK_SET) != 0)
+                return EResult::ReadError;
+            res = copy_data(old_file, size);
+            break;
+        }
+        case EPatchOperation::Insert:
+        {
+            uint64_t size;
+            if (!read_value(patch_file, size))
+                return EResult::ReadError;
+            res = copy_data(patch_file, size);
+            break;
+        }
+        case EPatchOperation::End:
+        {
+            uint64_t expected_size;
+            uint32_t expected_crc;
+            if (!read_value(patch_file, expected_size) || !read_value(patch_file, expected_crc))
+                return EResult::ReadError;
+            return (expected_size == new_file_size && expected_crc == new_crc) ? EResult::Success : EResult::InvalidChecksum;
+        }
+        default:
+            return EResult::InvalidBuffer;
+        }
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+    }
+    // missing end operation
+    return EResult::ReadError;
+}
+
+}} // bgcode::convert
@@ -0,0 +1,50 @@
+#ifndef _BGCODE_PATCH_HPP_
+#define _BGCODE_PATCH_HPP_
+
+#include "convert/export.h"
+#include "core/core.hpp"
+
+namespace bgcode { namespace convert {
+
+//
+// Block level patches between binary gcode files.
+// The blocks of the new file are matched against the blocks of the old file by checksum (CRC32C of the whole block, header and
+// checksum included) and then byte by byte, the blocks are never decoded. The patch contains the operations rebuilding the new file:
+// copies of runs of blocks of the old file and the bytes of the blocks not found into it.
+// Re-sliced files saved with content defined blocks (see BinarizerConfig::content_defined_blocks) share most of their blocks.
+//
+// Patch format (little endian):
+// magic "GCDP", uint32 version, uint64 size of the old file, uint32 CRC32C of the old file, followed by the operations:
+// uint8 0 (copy), uint64 position into the old file, uint64 size
+// uint8 1 (insert), uint64 size, size bytes
+// uint8 2 (end), uint64 size of the new file, uint32 CRC32C of the new file
+//
+
+struct PatchStatistics
+{
+    // blocks of the new file copied from the old file and saved into the patch, the file header is counted as a block
+    size_t copied_blocks{ 0 };
+    size_t inserted_blocks{ 0 };
+    uint64_t copied_size{ 0 };
+    uint64_t inserted_size{ 0 };
+    // size of the patch
+    uint64_t patch_size{ 0 };
+};
+
+// Saves into patch_file the patch turning the binary gcode file contained into old_file into the one contained into new_file.
+// The old file is read only to match the blocks, the new file is read once, plus the blocks not found into the old file,
+// which are copied into the patch without being buffered in memory.
+// If statistics is not null, it is set to the statistics of the patch.
+extern BGCODE_CONVERT_EXPORT core::EResult diff_binary_gcode(FILE& old_file, FILE& new_file, FILE& patch_file,
+    PatchStatistics* statistics = nullptr);
+
+// Rebuilds into new_file the binary gcode file described by the patch contained into patch_file, whose blocks are copied from
+// old_file, and verifies it against the size and the CRC32C saved into the patch.
+// Returns EResult::InvalidBinaryGCodeFile if the size or the CRC32C of old_file do not match the ones of the file the patch was
+// made from, in which case nothing is written into new_file.
+// Returns EResult::InvalidChecksum if the rebuilt file does not match (new_file is then to be discarded).
+extern BGCODE_CONVERT_EXPORT core::EResult apply_patch(FILE& old_file, FILE& patch_file, FILE& new_file);
+
+}} // bgcode::convert
+
+#endif // _BGCODE_PATCH_HPP_
@@ -0,0 +1,250 @@
+#include "convert.hpp"
+#include "file_utils.hpp"
+
+#include "core/core_impl.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <thread>
+
+namespace bgcode {
+using namespace core;
+using namespace binarize;
+namespace convert {
+
+static ECompressionType target_compression(EBlockType type, bool slicer3, const BinarizerConfig& config)
+{
+    switch (type)
+    {
+    case EBlockType::FileMetadata:    { return config.compression.file_metadata; }
+    case EBlockType::PrinterMetadata: { return config.compression.printer_metadata; }
+    case EBlockType::PrintMetadata:   { return config.compression.print_metadata; }
+    case EBlockType::SlicerMetadata:  { return slicer3 ? config.compression.slicer3_metadata : config.compression.slicer_metadata; }
+    case EBlockType::GCode:           { return config.compression.gcode; }
+    default:                          { return ECompressionType::None; }
+    }
+}
+
+// Reads the encoding type stored as first parameter of metadata and gcode blocks
+static EResult read_encoding_type(FILE& file, const BlockHeader& block_header, uint16_t& encoding_type)
+{
+    if (fseek(&file, block_header.get_position() + (long)block_header.get_size(), SEEK_SET) != 0)
+        return EResult::ReadError;
+    if (fread(&encoding_type, 1, sizeof(encoding_type), &file) != sizeof(encoding_type))
+        return EResult::ReadError;
+    return EResult::Success;
+}
+
+// Returns true if the blocks with the given compression have to be compressed again with the given parameters, which are
+// considered explicitly set when different from the defaults
+static bool is_deflate_changed(ECompressionType compression_type, const DeflateParameters& deflate)
+{
+    const DeflateParameters defaults;
+    return (compression_type == ECompressionType::Deflate || compression_type == ECompressionType::DeflateDictionary) &&
+        (deflate.level != defaults.level || deflate.strategy != defaults.strategy || deflate.mem_level != defaults.mem_level);
+}
+
+template<class Block>
+static EResult transcode_metadata_block(FILE& src_file, const FileHeader& src_header, const BlockHeader& block_header, FILE& dst_file,
+    ECompressionType compression_type, EChecksumType checksum_type, const uint16_t* encoding_type, const DeflateParameters& deflate)
+{
+    if (fseek(&src_file, block_header.get_position() + (long)block_header.get_size(), SEEK_SET) != 0)
+        return EResult::ReadError;
+    Block block;
+    EResult res = block.read_data(src_file, src_header, block_header);
+    if (res != EResult::Success)
+        return res;
+    if (encoding_type != nullptr)
+        block.encoding_type = *encoding_type;
+    std::pmr::vector<uint8_t> data;
+    res = block.serialize(data, (EBlockType)block_header.type, compression_type, checksum_type, deflate);
+    if (res != EResult::Success)
+        return res;
+    return (fwrite(data.data(), 1, data.size(), &dst_file) == data.size()) ? EResult::Success : EResult::WriteError;
+}
+
+// GCode blocks decoded by the reading thread, waiting to be encoded by the workers
+class GCodeBatch
+{
+public:
+    GCodeBatch(const BinarizerConfig& config, size_t jobs) : m_config(config), m_jobs(jobs) {
+        m_blocks.reserve(2 * jobs);
+    }
+
+    bool is_full() const { return m_blocks.size() >= 2 * m_jobs; }
+
+    EResult add(FILE& src_file, const FileHeader& src_header, const BlockHeader& block_header, std::vector<std::byte>& cs_buffer) {
+        if ((EChecksumType)src_header.checksum_type != EChecksumType::None) {
+            // the data are rewritten with a new checksum, verify the old one
+            EResult res = verify_block_checksum(src_file, src_header, block_header, cs_buffer.data(), cs_buffer.size());
+            if (res != EResult::Success)
+                return res;
+        }
+        if (fseek(&src_file, block_header.get_position() + (long)block_header.get_size(), SEEK_SET) != 0)
+            return EResult::ReadError;
+        GCodeBlock& block = m_blocks.emplace_back();
+        EResult res = block.read_data(src_file, src_header, block_header);
+        if (res != EResult::Success)
+            return res;
+        block.encoding_type = (uint16_t)m_config.gcode_encoding;
+        return EResult::Success;
+    }
+
+    EResult flush(FILE& dst_file) {
+        std::vector<std::pmr::vector<uint8_t>> outputs(m_blocks.size());
+        std::vector<EResult> results(m_blocks.size(), EResult::Success);
+        std::atomic<size_t> next{ 0 };
+        auto worker = [&]() {
+            for (size_t i = next++; i < m_blocks.size(); i = next++) {
+                results[i] = serialize_gcode_block(m_blocks[i], m_config, outputs[i]);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < std::min(m_jobs, m_blocks.size()); ++i) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        m_blocks.clear();
+
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            if (results[i] != EResult::Success)
+                return results[i];
+            if (fwrite(outputs[i].data(), 1, outputs[i].size(), &dst_file) != outputs[i].size())
+                return EResult::WriteError;
+        }
+        return EResult::Success;
+    }
+
+private:
+    const BinarizerConfig& m_config;
+    size_t m_jobs;
+    std::vector<GCodeBlock> m_blocks;
+};
+
+BGCODE_CONVERT_EXPORT EResult transcode(FILE& src_file, FILE& dst_file, const BinarizerConfig& config, size_t jobs)
+{
+    EResult res = is_valid_binary_gcode(src_file, true);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    const long file_size = get_file_size(src_file);
+    if (file_size < 0)
+        return EResult::ReadError;
+
+    FileHeader src_header;
+    res = read_header(src_file, src_header, nullptr);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    // all the gcode blocks are saved with the encoding of the given config, and the index and the hash tree blocks are dropped
+    FileHeader dst_header;
+    dst_header.version = gcode_encoding_version(config.gcode_encoding);
+    dst_header.checksum_type = (uint16_t)config.checksum;
+    res = dst_header.write(dst_file);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+
+    if (jobs == 0)
+        jobs = std::max<size_t>(1, std::thread::hardware_concurrency());
+    GCodeBatch gcode_batch(config, jobs);
+    std::vector<std::byte> cs_buffer(65536);
+    const bool same_checksum = src_header.checksum_type == dst_header.checksum_type;
+
+    BlockHeader block_header;
+    long position = ftell(&src_file);
+    while (position < file_size) {
+        if (fseek(&src_file, position, SEEK_SET) != 0)
+            return EResult::ReadError;
+        res = read_next_block_header(src_file, src_header, block_header);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        position = block_header.get_position() + (long)block_header.get_size() + (long)block_content_size(src_header, block_header);
+
+        const EBlockType type = (EBlockType)block_header.type;
+        if (type == EBlockType::Index || type == EBlockType::HashTree)
+            // the gcode blocks are going to move, and the checksums to change
+            continue;
+
+        bool slicer3 = false;
+        if (type == EBlockType::SlicerMetadata)
+            slicer3 = peek_slicer_metadata_block(src_file, block_header) == EPeekSlicerMetadataResult::Slicer3MetadataFound;
+        const ECompressionType compression = target_compression(type, slicer3, config);
+
+        // encoding expected into the destination block, if any
+        std::optional<uint16_t> encoding;
+        if (type == EBlockType::GCode)
+            encoding = (uint16_t)config.gcode_encoding;
+        else if (type != EBlockType::Thumbnail && !slicer3)
+            encoding = (uint16_t)config.metadata_encoding;
+
+        bool same_codec = block_header.compression == (uint16_t)compression;
+        if (same_codec && encoding.has_value()) {
+            uint16_t encoding_type;
+            res = read_encoding_type(src_file, block_header, encoding_type);
+            if (res != EResult::Success)
+                return res;
+            same_codec = encoding_type == *encoding;
+        }
+        // the deflate parameters given explicitly apply also to the blocks already compressed with deflate
+        if (same_codec && is_deflate_changed(compression, (type == EBlockType::GCode) ? config.deflate.gcode : config.deflate.metadata))
+            same_codec = false;
+        // the automatic compression is selected for each gcode block, by compressing it again
+        if (type == EBlockType::GCode && config.auto_gcode_compression != EAutoCompression::Disabled)
+            same_codec = false;
+
+        if (type == EBlockType::GCode && !same_codec) {
+            res = gcode_batch.add(src_file, src_header, block_header, cs_buffer);
+            if (res == EResult::Success && gcode_batch.is_full())
+                res = gcode_batch.flush(dst_file);
+            if (res != EResult::Success)
+                return res;
+            continue;
+        }
+
+        // keep the order of the blocks
+        res = gcode_batch.flush(dst_file);
+        if (res != EResult::Success)
+            return res;
+
+        if (same_codec) {
+            // no need to decode the data
+            res = same_checksum ? copy_block(src_file, src_header, block_header, dst_file) :
+                copy_block_with_checksum(src_file, src_header, block_header, dst_file, config.checksum);
+        }
+        else {
+            if (!same_checksum && (EChecksumType)src_header.checksum_type != EChecksumType::None) {
+                res = verify_block_checksum(src_file, src_header, block_header, cs_buffer.data(), cs_buffer.size());
+                if (res != EResult::Success)
+                    return res;
+            }
+            const uint16_t* encoding_type = encoding.has_value() ? &*encoding : nullptr;
+            switch (type)
+            {
+            case EBlockType::FileMetadata:    { res = transcode_metadata_block<FileMetadataBlock>(src_file, src_header, block_header, dst_file, compression, config.checksum, encoding_type, config.deflate.metadata); break; }
+            case EBlockType::PrinterMetadata: { res = transcode_metadata_block<PrinterMetadataBlock>(src_file, src_header, block_header, dst_file, compression, config.checksum, encoding_type, config.deflate.metadata); break; }
+            case EBlockType::PrintMetadata:   { res = transcode_metadata_block<PrintMetadataBlock>(src_file, src_header, block_header, dst_file, compression, config.checksum, encoding_type, config.deflate.metadata); break; }
+            case EBlockType::SlicerMetadata:
+            {
+                res = slicer3 ? transcode_metadata_block<Slicer3MetadataBlock>(src_file, src_header, block_header, dst_file, compression, config.checksum, encoding_type, config.deflate.metadata) :
+                    transcode_metadata_block<SlicerMetadataBlock>(src_file, src_header, block_header, dst_file, compression, config.checksum, encoding_type, config.deflate.metadata);
+                break;
+            }
+            default: { res = EResult::InvalidBlockType; break; }
+            }
+        }
+        if (res != EResult::Success)
+            return res;
+    }
+
+    return gcode_batch.flush(dst_file);
+}
+
+}} // bgcode::convert
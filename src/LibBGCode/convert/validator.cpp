@@ -0,0 +1,266 @@
+#include "validator.hpp"
+#include "file_utils.hpp"
+
+#include "binarize/binarize.hpp"
+#include "core/core_impl.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+namespace bgcode {
+using namespace core;
+namespace convert {
+
+// Checks that the blocks are in the order required by the specification:
+// FileMetadata? PrinterMetadata Thumbnail* PrintMetadata SlicerMetadata{1,2} HashTree? Index? GCode*
+static EResult check_blocks_sequence(const std::vector<BlockReport>& blocks)
+{
+    size_t i = 0;
+    auto next_is = [&](EBlockType type) { return i < blocks.size() && blocks[i].type == type; };
+
+    if (next_is(EBlockType::FileMetadata))
+        ++i;
+    if (!next_is(EBlockType::PrinterMetadata))
+        return EResult::InvalidSequenceOfBlocks;
+    ++i;
+    while (next_is(EBlockType::Thumbnail)) {
+        ++i;
+    }
+    if (!next_is(EBlockType::PrintMetadata))
+        return EResult::InvalidSequenceOfBlocks;
+    ++i;
+    if (!next_is(EBlockType::SlicerMetadata))
+        return EResult::InvalidSequenceOfBlocks;
+    ++i;
+    // slicer3 metadata
+    if (next_is(EBlockType::SlicerMetadata))
+        ++i;
+    if (next_is(EBlockType::HashTree))
+        ++i;
+    if (next_is(EBlockType::Index))
+        ++i;
+    while (next_is(EBlockType::GCode)) {
+        ++i;
+    }
+    return (i == blocks.size()) ? EResult::Success : EResult::InvalidSequenceOfBlocks;
+}
+
+// Blocks read by the reading thread, waiting to be checked by the workers
+class ValidationBatch
+{
+public:
+    ValidationBatch(EChecksumType checksum_type, size_t jobs, bool decode_blocks)
+        : m_checksum_type(checksum_type), m_jobs(jobs), m_decode_blocks(decode_blocks) {}
+
+    bool is_full() const { return m_size >= MaxSize; }
+
+    EResult add(FILE& file, const BlockHeader& block_header, size_t size, BlockReport& report) {
+        Block& block = m_blocks.emplace_back();
+        block.header = block_header;
+        block.report = &report;
+        block.data.resize(size);
+        if (fseek(&file, (long)report.offset, SEEK_SET) != 0 || fread(block.data.data(), 1, size, &file) != size)
+            return EResult::ReadError;
+        m_size += size;
+        return EResult::Success;
+    }
+
+    // Checks the blocks of the batch, the payloads of the index and of the hash tree blocks are moved into payloads
+    void flush(std::vector<std::vector<uint8_t>>& payloads) {
+        std::atomic<size_t> next{ 0 };
+        auto worker = [&]() {
+            for (size_t i = next++; i < m_blocks.size(); i = next++) {
+                check(m_blocks[i]);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < std::min(m_jobs, m_blocks.size()); ++i) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+
+        for (Block& block : m_blocks) {
+            const EBlockType type = block.report->type;
+            if (type == EBlockType::Index || type == EBlockType::HashTree) {
+                const size_t header_size = block.header.get_size();
+                payloads.emplace_back(block.data.begin() + header_size, block.data.begin() + header_size + block_payload_size(block.header));
+            }
+        }
+        m_blocks.clear();
+        m_size = 0;
+    }
+
+private:
+    struct Block
+    {
+        BlockHeader header;
+        // header, payload and checksum
+        std::vector<uint8_t> data;
+        BlockReport* report{ nullptr };
+    };
+
+    void check(Block& block) const {
+        const size_t header_size = block.header.get_size();
+        const size_t payload_size = block_payload_size(block.header);
+        BlockReport& report = *block.report;
+        memcpy(&report.encoding, block.data.data() + header_size, sizeof(report.encoding));
+
+        if (m_checksum_type != EChecksumType::None) {
+            Checksum checksum(m_checksum_type);
+            checksum.append(block.data.data(), header_size + payload_size);
+            if (memcmp(checksum.data(), block.data.data() + header_size + payload_size, checksum.size()) != 0)
+                report.checksum = EResult::InvalidChecksum;
+        }
+        if (m_decode_blocks)
+            report.decoding = binarize::decode_block_payload(block.header, block.data.data() + header_size, payload_size);
+    }
+
+    // size of the blocks read before checking them
+    static constexpr const size_t MaxSize{ 16 * 1024 * 1024 };
+
+    EChecksumType m_checksum_type;
+    size_t m_jobs;
+    bool m_decode_blocks;
+    std::vector<Block> m_blocks;
+    size_t m_size{ 0 };
+};
+
+// Checks the index and the hash tree blocks (whose payloads, in file order, are given) against the blocks they refer to
+// sizes are the sizes of the whole blocks
+static EResult check_index_and_hash_tree(FILE& file, const FileHeader& file_header, const std::vector<size_t>& sizes,
+    std::vector<BlockReport>& blocks, const std::vector<std::vector<uint8_t>>& payloads)
+{
+    std::vector<uint64_t> gcode_positions;
+    for (const BlockReport& block : blocks) {
+        if (block.type == EBlockType::GCode)
+            gcode_positions.emplace_back(block.offset);
+    }
+
+    const size_t cs_size = checksum_size((EChecksumType)file_header.checksum_type);
+    size_t payload_id = 0;
+    for (BlockReport& block : blocks) {
+        if (block.type != EBlockType::Index && block.type != EBlockType::HashTree)
+            continue;
+        const std::vector<uint8_t>& payload = payloads[payload_id++];
+        if (block.decoding != EResult::Success || block.compression != ECompressionType::None)
+            // already reported
+            continue;
+        const uint8_t* data = payload.data() + sizeof(uint16_t);
+        const size_t data_size = payload.size() - sizeof(uint16_t);
+
+        if (block.type == EBlockType::Index) {
+            // GCodeBlockIndexEntry: position, first_line, data_offset. Only the positions are checked, first_line and
+            // data_offset would require the decoded gcode of all the blocks
+            const size_t entry_size = 3 * sizeof(uint64_t);
+            bool valid = data_size % entry_size == 0 && data_size / entry_size == gcode_positions.size();
+            for (size_t i = 0; valid && i < gcode_positions.size(); ++i) {
+                uint64_t position;
+                memcpy(&position, data + i * entry_size, sizeof(position));
+                valid = position == gcode_positions[i];
+            }
+            if (!valid)
+                block.decoding = EResult::InvalidIndex;
+        }
+        else {
+            // the leaves are the checksums of all the other blocks, in file order
+            bool valid = cs_size == sizeof(uint32_t) && data_size == (blocks.size() - 1) * sizeof(uint32_t);
+            size_t leaf_id = 0;
+            for (size_t i = 0; valid && i < blocks.size(); ++i) {
+                if (blocks[i].type == EBlockType::HashTree)
+                    continue;
+                // the checksum is at the end of the block
+                const long checksum_position = (long)(blocks[i].offset + sizes[i] - cs_size);
+                uint32_t checksum;
+                if (fseek(&file, checksum_position, SEEK_SET) != 0 || fread(&checksum, 1, sizeof(checksum), &file) != sizeof(checksum))
+                    return EResult::ReadError;
+                valid = memcmp(&checksum, data + leaf_id++ * sizeof(uint32_t), sizeof(checksum)) == 0;
+            }
+            if (!valid)
+                block.decoding = EResult::InvalidHashTree;
+        }
+    }
+    return EResult::Success;
+}
+
+BGCODE_CONVERT_EXPORT EResult validate_binary_gcode(FILE& file, ValidationReport& report, size_t jobs, bool decode_blocks)
+{
+    report = ValidationReport();
+    const long file_size = get_file_size(file);
+    if (file_size < 0)
+        return report.result = EResult::ReadError;
+
+    FileHeader file_header;
+    EResult res = read_header(file, file_header, nullptr);
+    if (res != EResult::Success)
+        // propagate error
+        return report.result = res;
+    report.checksum_type = (EChecksumType)file_header.checksum_type;
+
+    // scan the block headers
+    std::vector<BlockHeader> headers;
+    std::vector<size_t> sizes;
+    long position = ftell(&file);
+    while (position < file_size) {
+        BlockHeader block_header;
+        if (fseek(&file, position, SEEK_SET) != 0)
+            res = EResult::ReadError;
+        if (res == EResult::Success)
+            res = read_next_block_header(file, file_header, block_header);
+        if (res != EResult::Success)
+            break;
+        const size_t size = block_header.get_size() + block_content_size(file_header, block_header);
+        if (position + (long)size > file_size) {
+            // truncated file
+            res = EResult::ReadError;
+            break;
+        }
+        BlockReport& block = report.blocks.emplace_back();
+        block.offset = (uint64_t)position;
+        block.type = (EBlockType)block_header.type;
+        block.compression = (ECompressionType)block_header.compression;
+        block.uncompressed_size = block_header.uncompressed_size;
+        block.compressed_size = (block.compression == ECompressionType::None) ? block_header.uncompressed_size : block_header.compressed_size;
+        headers.emplace_back(block_header);
+        sizes.emplace_back(size);
+        position += (long)size;
+    }
+    // the errors are reported in file order, the scan errors come after the ones of the blocks preceding them
+    const EResult scan_res = res;
+
+    // check the blocks
+    if (jobs == 0)
+        jobs = std::max<size_t>(1, std::thread::hardware_concurrency());
+    ValidationBatch batch(report.checksum_type, jobs, decode_blocks);
+    std::vector<std::vector<uint8_t>> payloads;
+    for (size_t i = 0; i < report.blocks.size(); ++i) {
+        res = batch.add(file, headers[i], sizes[i], report.blocks[i]);
+        if (res != EResult::Success)
+            return report.result = res;
+        if (batch.is_full())
+            batch.flush(payloads);
+    }
+    batch.flush(payloads);
+
+    if (decode_blocks) {
+        res = check_index_and_hash_tree(file, file_header, sizes, report.blocks, payloads);
+        if (res != EResult::Success)
+            return report.result = res;
+    }
+
+    for (const BlockReport& block : report.blocks) {
+        if (block.checksum != EResult::Success)
+            return report.result = block.checksum;
+        if (block.decoding != EResult::Success)
+            return report.result = block.decoding;
+    }
+    if (scan_res != EResult::Success)
+        return report.result = scan_res;
+    return report.result = check_blocks_sequence(report.blocks);
+}
+
+}} // bgcode::convert
@@ -0,0 +1,54 @@
+#ifndef _BGCODE_VALIDATOR_HPP_
+#define _BGCODE_VALIDATOR_HPP_
+
+#include "convert/export.h"
+#include "core/core.hpp"
+
+#include <vector>
+
+namespace bgcode { namespace convert {
+
+//
+// Whole file validation.
+// The block headers are scanned once, then the blocks are read in batches whose checksums are verified, and whose
+// payloads are decoded, by a pool of threads. The outcome of every block is collected into a report.
+//
+
+struct BlockReport
+{
+    // position of the block header
+    uint64_t offset{ 0 };
+    core::EBlockType type{ core::EBlockType::GCode };
+    core::ECompressionType compression{ core::ECompressionType::None };
+    // first parameter of the block: the encoding type or, for thumbnails, the thumbnail format
+    uint16_t encoding{ 0 };
+    uint32_t uncompressed_size{ 0 };
+    // equal to uncompressed_size for uncompressed blocks
+    uint32_t compressed_size{ 0 };
+    // outcome of the checksum verification, Success if the file has no checksums
+    core::EResult checksum{ core::EResult::Success };
+    // outcome of the decoding of the payload, Success if the payload was not decoded
+    core::EResult decoding{ core::EResult::Success };
+};
+
+struct ValidationReport
+{
+    // the first error found, in file order, Success if the file is valid
+    core::EResult result{ core::EResult::Success };
+    core::EChecksumType checksum_type{ core::EChecksumType::None };
+    // the blocks found, in file order. If the scan of the file stops on an error, the blocks following it are missing.
+    std::vector<BlockReport> blocks;
+};
+
+// Validates the structure of the given file, the checksums of all its blocks and, if decode_blocks is true, the
+// payloads of all its blocks, which are uncompressed and decoded. When decoding, the index and the hash tree blocks,
+// if present, are also checked against the blocks they refer to: the positions of the gcode blocks saved into the index
+// (not their first line and data offset) and the checksums saved into the hash tree.
+// jobs is the count of threads used, 0 = hardware concurrency.
+// Returns report.result.
+extern BGCODE_CONVERT_EXPORT core::EResult validate_binary_gcode(FILE& file, ValidationReport& report, size_t jobs = 0,
+    bool decode_blocks = true);
+
+}} // bgcode::convert
+
+#endif // _BGCODE_VALIDATOR_HPP_
@@ -0,0 +1,189 @@
+#include "convert.hpp"
+#include "file_utils.hpp"
+
+#include "core/core_impl.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+namespace bgcode {
+using namespace core;
+namespace convert {
+
+// Blocks read by the reading thread, waiting for their checksums to be verified by the workers
+class ChecksumBatch
+{
+public:
+    ChecksumBatch(EChecksumType checksum_type, size_t jobs) : m_checksum_type(checksum_type), m_jobs(jobs) {}
+
+    bool is_full() const { return m_size >= MaxSize; }
+
+    EResult add(FILE& file, long position, size_t size, uint32_t leaf) {
+        if (size < sizeof(uint32_t))
+            return EResult::InvalidHashTree;
+        Block& block = m_blocks.emplace_back();
+        block.data.resize(size);
+        block.leaf = leaf;
+        if (fseek(&file, position, SEEK_SET) != 0 || fread(block.data.data(), 1, size, &file) != size)
+            return EResult::ReadError;
+        m_size += size;
+        return EResult::Success;
+    }
+
+    EResult flush() {
+        std::vector<EResult> results(m_blocks.size(), EResult::Success);
+        std::atomic<size_t> next{ 0 };
+        auto worker = [&]() {
+            for (size_t i = next++; i < m_blocks.size(); i = next++) {
+                const Block& block = m_blocks[i];
+                const size_t data_size = block.data.size() - sizeof(uint32_t);
+                Checksum checksum(m_checksum_type);
+                checksum.append(block.data.data(), data_size);
+                uint32_t computed;
+                memcpy(&computed, checksum.data(), sizeof(computed));
+                uint32_t saved;
+                memcpy(&saved, block.data.data() + data_size, sizeof(saved));
+                // the block must match its own checksum and the hash tree
+                if (computed != saved || saved != block.leaf)
+                    results[i] = EResult::InvalidChecksum;
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < std::min(m_jobs, m_blocks.size()); ++i) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        m_blocks.clear();
+        m_size = 0;
+
+        for (EResult res : results) {
+            if (res != EResult::Success)
+                return res;
+        }
+        return EResult::Success;
+    }
+
+private:
+    struct Block
+    {
+        // header, payload and checksum
+        std::vector<std::byte> data;
+        uint32_t leaf{ 0 };
+    };
+
+    // size of the blocks read before verifying them
+    static constexpr const size_t MaxSize{ 16 * 1024 * 1024 };
+
+    EChecksumType m_checksum_type;
+    size_t m_jobs;
+    std::vector<Block> m_blocks;
+    size_t m_size{ 0 };
+};
+
+BGCODE_CONVERT_EXPORT EResult verify_blocks(FILE& file, size_t first_block, size_t blocks_count, size_t jobs, const uint32_t* expected_root,
+    size_t* available_blocks_count)
+{
+    if (available_blocks_count != nullptr)
+        *available_blocks_count = 0;
+
+    const long file_size = get_file_size(file);
+    if (file_size < 0)
+        return EResult::ReadError;
+
+    FileHeader file_header;
+    EResult res = read_header(file, file_header, nullptr);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+    const long first_block_position = ftell(&file);
+
+    std::vector<std::byte> cs_buffer(65536);
+    HashTreeLeaves leaves;
+    res = read_hash_tree(file, file_header, leaves, cs_buffer.data(), cs_buffer.size());
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+    const EChecksumType checksum_type = (EChecksumType)file_header.checksum_type;
+    if (checksum_size(checksum_type) != sizeof(uint32_t))
+        return EResult::InvalidHashTree;
+    if (expected_root != nullptr && hash_tree_root(leaves) != *expected_root)
+        // the hash tree does not belong to the expected file
+        return EResult::InvalidHashTree;
+
+    // the blocks covered by the hash tree and contained into the file, in file order
+    struct BlockRange
+    {
+        long position;
+        size_t size;
+        bool gcode;
+    };
+    std::vector<BlockRange> blocks;
+    size_t gcode_blocks_count = 0;
+    BlockHeader block_header;
+    long position = first_block_position;
+    while (position < file_size) {
+        if (fseek(&file, position, SEEK_SET) != 0)
+            return EResult::ReadError;
+        res = read_next_block_header(file, file_header, block_header);
+        if (res == EResult::ReadError)
+            // truncated block header, e.g. of a partially downloaded file
+            break;
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        const size_t size = block_header.get_size() + block_content_size(file_header, block_header);
+        if (position + (long)size > file_size)
+            // truncated block
+            break;
+        const EBlockType type = (EBlockType)block_header.type;
+        if (type != EBlockType::HashTree) {
+            blocks.push_back({ position, size, type == EBlockType::GCode });
+            if (type == EBlockType::GCode)
+                ++gcode_blocks_count;
+        }
+        position += (long)size;
+    }
+    if (blocks.size() > leaves.size())
+        return EResult::InvalidHashTree;
+    if (available_blocks_count != nullptr)
+        *available_blocks_count = gcode_blocks_count;
+    const size_t missing_count = leaves.size() - blocks.size();
+    if (missing_count > 0 && gcode_blocks_count == 0)
+        // the blocks preceding the gcode blocks may be missing too
+        return EResult::BlockNotFound;
+    // the missing blocks are the last gcode blocks
+    const size_t expected_gcode_blocks_count = gcode_blocks_count + missing_count;
+    if (first_block >= expected_gcode_blocks_count || blocks_count == 0)
+        return EResult::BlockNotFound;
+    const size_t end_block = first_block + std::min(blocks_count, expected_gcode_blocks_count - first_block);
+
+    if (jobs == 0)
+        jobs = std::max<size_t>(1, std::thread::hardware_concurrency());
+    ChecksumBatch batch(checksum_type, jobs);
+    size_t gcode_block_id = 0;
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        if (blocks[i].gcode) {
+            // the blocks preceding the gcode blocks are always verified
+            const size_t id = gcode_block_id++;
+            if (id < first_block || id >= end_block)
+                continue;
+        }
+        res = batch.add(file, blocks[i].position, blocks[i].size, leaves[i]);
+        if (res == EResult::Success && batch.is_full())
+            res = batch.flush();
+        if (res != EResult::Success)
+            return res;
+    }
+    res = batch.flush();
+    if (res != EResult::Success)
+        return res;
+    // the range ends after the last gcode block contained into the file
+    return (end_block > gcode_blocks_count) ? EResult::BlockNotFound : EResult::Success;
+}
+
+}} // bgcode::convert
@@ -1,6 +1,18 @@
 #include "core_impl.hpp"
+#include <algorithm>
 #include <cstring>
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define BGCODE_CRC32C_X86
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif // _MSC_VER
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define BGCODE_CRC32C_ARM
+#include <arm_acle.h>
+#endif
+
 namespace bgcode { namespace core {
 
 template<class T>
@@ -97,7 +109,7 @@ EResult Checksum::read(FILE& file)
 
 FileHeader::FileHeader()
     : magic{MAGICi32}
-    , version{VERSION}
+    , version{1}
     , checksum_type{static_cast<uint16_t>(EChecksumType::None)}
 {}
 
@@ -253,10 +265,117 @@ BGCODE_CORE_EXPORT std::string_view translate_result(EResult result)
     case EResult::MissingPrinterMetadata:      { return "Missing printer metadata"sv; }
     case EResult::MissingPrintMetadata:        { return "Missing print metadata"sv; }
     case EResult::MissingSlicerMetadata:       { return "Missing slicer metadata"sv; }
+    case EResult::InvalidIndex:                { return "Invalid index block"sv; }
+    case EResult::InvalidHashTree:             { return "Invalid hash tree block"sv; }
     }
     return std::string_view();
 }
 
+// Returns the size of the file data following the current file position, -1 in case of error.
+// Does not modify the file position
+static long remaining_file_size(FILE& file)
+{
+    const long position = ftell(&file);
+    if (position < 0 || fseek(&file, 0, SEEK_END) != 0)
+        return -1;
+    const long file_size = ftell(&file);
+    if (fseek(&file, position, SEEK_SET) != 0)
+        return -1;
+    return (file_size < position) ? -1 : file_size - position;
+}
+
+// size of a serialized GCodeBlockIndexEntry
+static constexpr const size_t INDEX_ENTRY_SIZE = 3 * sizeof(uint64_t);
+
+// Reads the data of the index block with the given header.
+// File position must be at the start of the block parameters.
+static EResult read_index_data(FILE& file, const BlockHeader& block_header, GCodeBlockIndex& index)
+{
+    index.clear();
+    if ((ECompressionType)block_header.compression != ECompressionType::None)
+        return EResult::InvalidCompressionType;
+    if (block_header.uncompressed_size % INDEX_ENTRY_SIZE != 0)
+        return EResult::InvalidIndex;
+
+    // encoding_type, only 0 is defined
+    uint16_t encoding_type;
+    if (!read_from_file(file, &encoding_type, sizeof(encoding_type)))
+        return EResult::ReadError;
+    if (encoding_type != 0)
+        return EResult::InvalidIndex;
+
+    // the size of the block is checked before allocating the entries
+    const long remaining_size = remaining_file_size(file);
+    if (remaining_size < 0 || (uint64_t)block_header.uncompressed_size > (uint64_t)remaining_size)
+        return EResult::ReadError;
+
+    index.resize(block_header.uncompressed_size / INDEX_ENTRY_SIZE);
+    for (GCodeBlockIndexEntry& entry : index) {
+        if (!read_from_file(file, &entry.position, sizeof(entry.position)) ||
+            !read_from_file(file, &entry.first_line, sizeof(entry.first_line)) ||
+            !read_from_file(file, &entry.data_offset, sizeof(entry.data_offset)))
+            return EResult::ReadError;
+    }
+    return EResult::Success;
+}
+
+// Reads the data of the hash tree block with the given header.
+// File position must be at the start of the block parameters.
+static EResult read_hash_tree_data(FILE& file, const BlockHeader& block_header, HashTreeLeaves& leaves)
+{
+    leaves.clear();
+    if ((ECompressionType)block_header.compression != ECompressionType::None)
+        return EResult::InvalidCompressionType;
+    if (block_header.uncompressed_size % sizeof(uint32_t) != 0)
+        return EResult::InvalidHashTree;
+
+    // encoding_type, only 0 is defined
+    uint16_t encoding_type;
+    if (!read_from_file(file, &encoding_type, sizeof(encoding_type)))
+        return EResult::ReadError;
+    if (encoding_type != 0)
+        return EResult::InvalidHashTree;
+
+    // the size of the block is checked before allocating the leaves
+    const long remaining_size = remaining_file_size(file);
+    if (remaining_size < 0 || (uint64_t)block_header.uncompressed_size > (uint64_t)remaining_size)
+        return EResult::ReadError;
+
+    leaves.resize(block_header.uncompressed_size / sizeof(uint32_t));
+    if (!read_from_file(file, leaves.data(), leaves.size() * sizeof(uint32_t)))
+        return EResult::ReadError;
+    return EResult::Success;
+}
+
+// Reads the checksums of the blocks from the current file position to the end of the file, but the hash tree block.
+// File position must be at the start of a block header.
+static EResult read_block_checksums(FILE& file, const FileHeader& file_header, long file_size, HashTreeLeaves& checksums)
+{
+    checksums.clear();
+    const size_t cs_size = checksum_size((EChecksumType)file_header.checksum_type);
+    if (cs_size != sizeof(uint32_t))
+        return EResult::InvalidChecksumType;
+
+    BlockHeader block_header;
+    long position = ftell(&file);
+    while (position < file_size) {
+        if (fseek(&file, position, SEEK_SET) != 0)
+            return EResult::ReadError;
+        const EResult res = block_header.read(file);
+        if (res != EResult::Success)
+            // propagate error
+            return res;
+        position += (long)(block_header.get_size() + block_content_size(file_header, block_header));
+        if ((EBlockType)block_header.type == EBlockType::HashTree)
+            continue;
+        uint32_t checksum;
+        if (fseek(&file, position - (long)cs_size, SEEK_SET) != 0 || !read_from_file(file, &checksum, sizeof(checksum)))
+            return EResult::ReadError;
+        checksums.emplace_back(checksum);
+    }
+    return EResult::Success;
+}
+
 BGCODE_CORE_EXPORT EResult is_valid_binary_gcode(FILE& file, bool check_contents, std::byte* cs_buffer, size_t cs_buffer_size)
 {
     // cache file position
@@ -289,6 +408,7 @@ BGCODE_CORE_EXPORT EResult is_valid_binary_gcode(FILE& file, bool check_contents
             // propagate error
             return res;
         }
+        const long first_block_position = ftell(&file);
         BlockHeader block_header;
         // read file metadata block header, if present
         res = read_next_block_header(file, file_header, block_header, cs_buffer, cs_buffer_size);
@@ -390,8 +510,62 @@ BGCODE_CORE_EXPORT EResult is_valid_binary_gcode(FILE& file, bool check_contents
             }
         }
 
+        // read hash tree block, if present
+        HashTreeLeaves leaves;
+        const bool has_hash_tree = (EBlockType)block_header.type == EBlockType::HashTree;
+        if (has_hash_tree) {
+            res = read_hash_tree_data(file, block_header, leaves);
+            if (res == EResult::Success)
+                res = skip_block(file, file_header, block_header);
+            if (res == EResult::Success)
+                res = read_next_block_header(file, file_header, block_header, cs_buffer, cs_buffer_size);
+            if (res != EResult::Success) {
+                // restore file position
+                fseek(&file, curr_pos, SEEK_SET);
+                // propagate error
+                return res;
+            }
+            if ((EBlockType)block_header.type != EBlockType::Index && (EBlockType)block_header.type != EBlockType::GCode) {
+                // restore file position
+                fseek(&file, curr_pos, SEEK_SET);
+                return EResult::InvalidBlockType;
+            }
+        }
+
+        // read index block, if present
+        GCodeBlockIndex index;
+        const bool has_index = (EBlockType)block_header.type == EBlockType::Index;
+        if (has_index) {
+            res = read_index_data(file, block_header, index);
+            if (res == EResult::Success)
+                res = skip_block(file, file_header, block_header);
+            if (res == EResult::Success)
+                res = read_next_block_header(file, file_header, block_header, cs_buffer, cs_buffer_size);
+            if (res != EResult::Success) {
+                // restore file position
+                fseek(&file, curr_pos, SEEK_SET);
+                // propagate error
+                return res;
+            }
+            if ((EBlockType)block_header.type != EBlockType::GCode) {
+                // restore file position
+                fseek(&file, curr_pos, SEEK_SET);
+                return EResult::InvalidBlockType;
+            }
+        }
+
         // read gcode block headers
+        size_t gcode_blocks_count = 0;
         do {
+            if (has_index && (EBlockType)block_header.type == EBlockType::GCode) {
+                // the index must point to the gcode blocks
+                if (gcode_blocks_count >= index.size() || index[gcode_blocks_count].position != (uint64_t)block_header.get_position()) {
+                    // restore file position
+                    fseek(&file, curr_pos, SEEK_SET);
+                    return EResult::InvalidIndex;
+                }
+                ++gcode_blocks_count;
+            }
             res = skip_block(file, file_header, block_header);
             if (res != EResult::Success) {
                 // restore file position
@@ -414,6 +588,26 @@ BGCODE_CORE_EXPORT EResult is_valid_binary_gcode(FILE& file, bool check_contents
                 return EResult::InvalidBlockType;
             }
         } while (!feof(&file));
+
+        if (has_index && gcode_blocks_count != index.size()) {
+            // restore file position
+            fseek(&file, curr_pos, SEEK_SET);
+            return EResult::InvalidIndex;
+        }
+
+        if (has_hash_tree) {
+            // the leaves must be the checksums of the blocks
+            HashTreeLeaves checksums;
+            fseek(&file, first_block_position, SEEK_SET);
+            res = read_block_checksums(file, file_header, file_size, checksums);
+            if (res == EResult::InvalidChecksumType || (res == EResult::Success && checksums != leaves))
+                res = EResult::InvalidHashTree;
+            if (res != EResult::Success) {
+                // restore file position
+                fseek(&file, curr_pos, SEEK_SET);
+                return res;
+            }
+        }
     }
 
     fseek(&file, curr_pos, SEEK_SET);
@@ -430,6 +624,9 @@ BGCODE_CORE_EXPORT EResult read_next_block_header(FILE& file, const FileHeader&
     std::byte* cs_buffer, size_t cs_buffer_size)
 {
     EResult res = block_header.read(file);
+    if (res == EResult::Success && block_type_version((EBlockType)block_header.type) > file_header.version)
+        // block type added by a later version
+        res = EResult::InvalidBlockType;
     if (res == EResult::Success && cs_buffer != nullptr && cs_buffer_size > 0) {
         res = verify_block_checksum(file, file_header, block_header, cs_buffer, cs_buffer_size);
         // return to payload position after checksum verification
@@ -489,6 +686,8 @@ BGCODE_CORE_EXPORT size_t block_parameters_size(EBlockType type)
     case EBlockType::PrinterMetadata: { return sizeof(uint16_t); } /* encoding_type */
     case EBlockType::PrintMetadata:   { return sizeof(uint16_t); } /* encoding_type */
     case EBlockType::Thumbnail:       { return sizeof(uint16_t) + sizeof(uint16_t) + sizeof(uint16_t); } /* format, width, height */
+    case EBlockType::Index:           { return sizeof(uint16_t); } /* encoding_type */
+    case EBlockType::HashTree:        { return sizeof(uint16_t); } /* encoding_type */
     }
     return 0;
 }
@@ -517,22 +716,203 @@ BGCODE_CORE_EXPORT size_t checksum_size(EChecksumType type)
 {
   switch (type)
   {
-  case EChecksumType::None:  { return 0; }
-  case EChecksumType::CRC32: { return 4; }
+  case EChecksumType::None:   { return 0; }
+  case EChecksumType::CRC32:  { return 4; }
+  case EChecksumType::CRC32C: { return 4; }
   }
   return 0;
 }
 
+#if defined(BGCODE_CRC32C_X86)
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#endif
+static uint32_t crc32c_hw(const uint8_t* data, size_t size, uint32_t crc)
+{
+    uint64_t value = ~crc;
+    for (; size >= sizeof(uint64_t); data += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        value = _mm_crc32_u64(value, word);
+    }
+    for (; size > 0; ++data, --size) {
+        value = _mm_crc32_u8((uint32_t)value, *data);
+    }
+    return ~(uint32_t)value;
+}
+
+static bool has_crc_instructions()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+}
+#elif defined(BGCODE_CRC32C_ARM)
+static uint32_t crc32c_hw(const uint8_t* data, size_t size, uint32_t crc)
+{
+    uint32_t value = ~crc;
+    for (; size >= sizeof(uint64_t); data += sizeof(uint64_t), size -= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        value = __crc32cd(value, word);
+    }
+    for (; size > 0; ++data, --size) {
+        value = __crc32cb(value, *data);
+    }
+    return ~value;
+}
+
+static bool has_crc_instructions()
+{
+    return true;
+}
+#endif
+
+BGCODE_CORE_EXPORT uint32_t crc32c(const void* data, size_t size, uint32_t crc)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+#if defined(BGCODE_CRC32C_X86) || defined(BGCODE_CRC32C_ARM)
+    static const bool hardware = has_crc_instructions();
+    if (hardware)
+        return crc32c_hw(bytes, size, crc);
+#endif
+    return crc32c_sw(bytes, bytes + size, crc);
+}
+
 BGCODE_CORE_EXPORT size_t block_content_size(const FileHeader& file_header, const BlockHeader& block_header)
 {
   return block_payload_size(block_header) + checksum_size((EChecksumType)file_header.checksum_type);
 }
 
+BGCODE_CORE_EXPORT EResult read_gcode_block_index(FILE& file, const FileHeader& file_header, GCodeBlockIndex& index,
+    std::byte* cs_buffer, size_t cs_buffer_size)
+{
+    // cache file position
+    const long curr_pos = ftell(&file);
+
+    BlockHeader block_header;
+    EResult res = read_next_block_header(file, file_header, block_header, nullptr, 0);
+    // the index block is the last block before the gcode blocks
+    while (res == EResult::Success && (EBlockType)block_header.type != EBlockType::Index && (EBlockType)block_header.type != EBlockType::GCode) {
+        res = skip_block(file, file_header, block_header);
+        if (res == EResult::Success)
+            res = read_next_block_header(file, file_header, block_header, nullptr, 0);
+    }
+    if (res == EResult::Success && (EBlockType)block_header.type != EBlockType::Index)
+        res = EResult::BlockNotFound;
+    if (res == EResult::Success && cs_buffer != nullptr && cs_buffer_size > 0) {
+        res = verify_block_checksum(file, file_header, block_header, cs_buffer, cs_buffer_size);
+        // return to payload position after checksum verification
+        if (res == EResult::Success && fseek(&file, block_header.get_position() + (long)block_header.get_size(), SEEK_SET) != 0)
+            res = EResult::ReadError;
+    }
+    if (res == EResult::Success)
+        res = read_index_data(file, block_header, index);
+    if (res == EResult::Success)
+        res = skip_block(file, file_header, block_header);
+
+    if (res != EResult::Success)
+        // restore file position
+        fseek(&file, curr_pos, SEEK_SET);
+    return res;
+}
+
+BGCODE_CORE_EXPORT EResult read_hash_tree(FILE& file, const FileHeader& file_header, HashTreeLeaves& leaves,
+    std::byte* cs_buffer, size_t cs_buffer_size)
+{
+    // cache file position
+    const long curr_pos = ftell(&file);
+
+    BlockHeader block_header;
+    EResult res = read_next_block_header(file, file_header, block_header, nullptr, 0);
+    while (res == EResult::Success && (EBlockType)block_header.type != EBlockType::HashTree && (EBlockType)block_header.type != EBlockType::GCode) {
+        res = skip_block(file, file_header, block_header);
+        if (res == EResult::Success)
+            res = read_next_block_header(file, file_header, block_header, nullptr, 0);
+    }
+    if (res == EResult::Success && (EBlockType)block_header.type != EBlockType::HashTree)
+        res = EResult::BlockNotFound;
+    if (res == EResult::Success && cs_buffer != nullptr && cs_buffer_size > 0) {
+        res = verify_block_checksum(file, file_header, block_header, cs_buffer, cs_buffer_size);
+        // return to payload position after checksum verification
+        if (res == EResult::Success && fseek(&file, block_header.get_position() + (long)block_header.get_size(), SEEK_SET) != 0)
+            res = EResult::ReadError;
+    }
+    if (res == EResult::Success)
+        res = read_hash_tree_data(file, block_header, leaves);
+    if (res == EResult::Success)
+        res = skip_block(file, file_header, block_header);
+
+    if (res != EResult::Success)
+        // restore file position
+        fseek(&file, curr_pos, SEEK_SET);
+    return res;
+}
+
+BGCODE_CORE_EXPORT uint32_t hash_tree_root(const HashTreeLeaves& leaves)
+{
+    if (leaves.empty())
+        return 0;
+
+    // the levels are computed in place
+    std::vector<uint32_t> nodes(leaves.begin(), leaves.end());
+    while (nodes.size() > 1) {
+        size_t count = 0;
+        for (size_t i = 0; i < nodes.size(); i += 2) {
+            nodes[count++] = (i + 1 < nodes.size()) ? crc32c(&nodes[i], 2 * sizeof(uint32_t), 0) : nodes[i];
+        }
+        nodes.resize(count);
+    }
+    return nodes.front();
+}
+
+BGCODE_CORE_EXPORT size_t find_gcode_block_by_line(const GCodeBlockIndex& index, uint64_t line)
+{
+    auto it = std::upper_bound(index.begin(), index.end(), line,
+        [](uint64_t line, const GCodeBlockIndexEntry& entry) { return line < entry.first_line; });
+    return (it == index.begin()) ? index.size() : std::distance(index.begin(), it) - 1;
+}
+
+BGCODE_CORE_EXPORT size_t find_gcode_block_by_offset(const GCodeBlockIndex& index, uint64_t data_offset)
+{
+    auto it = std::upper_bound(index.begin(), index.end(), data_offset,
+        [](uint64_t data_offset, const GCodeBlockIndexEntry& entry) { return data_offset < entry.data_offset; });
+    return (it == index.begin()) ? index.size() : std::distance(index.begin(), it) - 1;
+}
+
+BGCODE_CORE_EXPORT EResult read_gcode_block_header(FILE& file, const FileHeader& file_header, const GCodeBlockIndex& index, size_t block_id,
+    BlockHeader& block_header, std::byte* cs_buffer, size_t cs_buffer_size)
+{
+    if (block_id >= index.size())
+        return EResult::BlockNotFound;
+    if (fseek(&file, (long)index[block_id].position, SEEK_SET) != 0)
+        return EResult::ReadError;
+    const EResult res = read_next_block_header(file, file_header, block_header, cs_buffer, cs_buffer_size);
+    if (res != EResult::Success)
+        // propagate error
+        return res;
+    return ((EBlockType)block_header.type == EBlockType::GCode) ? EResult::Success : EResult::InvalidIndex;
+}
+
 uint32_t bgcode_version() noexcept
 {
     return VERSION;
 }
 
+uint32_t block_type_version(EBlockType type) noexcept
+{
+    return (type == EBlockType::Index || type == EBlockType::HashTree) ? 2 : 1;
+}
+
+uint32_t gcode_encoding_version(EGCodeEncodingType type) noexcept
+{
+    return (type == EGCodeEncodingType::Tokenized || type == EGCodeEncodingType::Columnar) ? 2 : 1;
+}
+
 const char *version() noexcept
 {
     return LibBGCode_VERSION;
@@ -8,6 +8,7 @@
 #include <cstddef>
 #include <climits>
 #include <array>
+#include <memory_resource>
 #include <vector>
 #include <string>
 #include <string_view>
@@ -46,12 +47,16 @@ enum class EResult : uint16_t
     MissingPrinterMetadata,
     MissingPrintMetadata,
     MissingSlicerMetadata,
+    InvalidIndex,
+    InvalidHashTree,
 };
 
 enum class EChecksumType : uint16_t
 {
     None,
-    CRC32
+    CRC32,
+    // CRC32 with the Castagnoli polynomial, computed by the SSE 4.2 and ARMv8 CRC instructions
+    CRC32C
 };
 
 enum class EBlockType : uint16_t
@@ -61,7 +66,11 @@ enum class EBlockType : uint16_t
     SlicerMetadata,
     PrinterMetadata,
     PrintMetadata,
-    Thumbnail
+    Thumbnail,
+    // optional, placed between the metadata and the gcode blocks, see GCodeBlockIndexEntry
+    Index,
+    // optional, placed between the metadata and the index block (or the gcode blocks, if no index), see HashTreeLeaves
+    HashTree
 };
 
 enum class ECompressionType : uint16_t
@@ -69,7 +78,9 @@ enum class ECompressionType : uint16_t
     None,
     Deflate,
     Heatshrink_11_4,
-    Heatshrink_12_4
+    Heatshrink_12_4,
+    // Deflate with a preset dictionary, see binarize/deflate_dictionary.hpp
+    DeflateDictionary
 };
 
 enum class EMetadataEncodingType : uint16_t
@@ -82,7 +93,11 @@ enum class EGCodeEncodingType : uint16_t
 {
     None,
     MeatPack,
-    MeatPackComments
+    MeatPackComments,
+    // G0/G1/G2/G3 lines saved as binary fixed-point coordinates, see binarize/gcode_tokens.hpp
+    Tokenized,
+    // Tokenized lines split into separately compressed columns, see binarize/gcode_tokens.hpp
+    Columnar
 };
 
 enum class EThumbnailFormat : uint16_t
@@ -139,11 +154,35 @@ struct BGCODE_CORE_EXPORT ThumbnailParams
     EResult read(FILE& file);
 };
 
+// Entry of the index block, one for each gcode block, in file order.
+// The index allows to seek to the gcode block containing a given line or decoded byte without walking the blocks headers.
+struct GCodeBlockIndexEntry
+{
+    // position of the header of the gcode block, from the start of the file
+    uint64_t position{ 0 };
+    // number of the lines preceding the gcode block
+    uint64_t first_line{ 0 };
+    // offset of the data of the gcode block into the decoded gcode
+    uint64_t data_offset{ 0 };
+};
+
+using GCodeBlockIndex = std::pmr::vector<GCodeBlockIndexEntry>;
+
+// Data of the hash tree block: the checksums of all the other blocks of the file, in file order.
+// The checksums are the leaves of a binary tree whose nodes are the CRC32C of the concatenation of their children,
+// the last node of a level being moved up unchanged when it has no sibling. The root of the tree identifies the
+// content of the whole file, while each block can be verified on its own against its leaf.
+// The root is not saved into the file: obtained separately (e.g. from the sender), it lets a reader check that the leaves,
+// and then the blocks verified against them, belong to the expected file. As the leaves are CRCs, this detects corrupted
+// and mismatching data, not intentional modifications.
+using HashTreeLeaves = std::pmr::vector<uint32_t>;
+
 // Returns a string description of the given result
 extern BGCODE_CORE_EXPORT std::string_view translate_result(EResult result);
 
 // Returns EResult::Success if the given file is a valid binary gcode
-// If check_contents is set to true, the order of the blocks is checked
+// If check_contents is set to true, the order of the blocks is checked, the index block, if present, is checked against the gcode blocks
+// and the hash tree block, if present, is checked against the checksums of the blocks
 // Does not modify the file position
 // Caller is responsible for providing buffer for checksum calculation, if needed.
 extern BGCODE_CORE_EXPORT EResult is_valid_binary_gcode(FILE& file, bool check_contents = false, std::byte* cs_buffer = nullptr,
@@ -207,9 +246,60 @@ extern BGCODE_CORE_EXPORT size_t checksum_size(EChecksumType type);
 // Returns the size of the content (parameters + data + checksum) of the block with the given header, in bytes.
 extern BGCODE_CORE_EXPORT size_t block_content_size(const FileHeader& file_header, const BlockHeader& block_header);
 
+// Searches and reads the index block from the current file position, stopping at the first gcode block.
+// File position must be at the start of a block header.
+// If return == EResult::Success:
+// - index will contain the entries of the index block.
+// - file position will be set at the start of the first gcode block header.
+// otherwise:
+// - file position will keep the current value.
+// Returns EResult::BlockNotFound if the file has no index block.
+// Caller is responsible for providing buffer for checksum calculation, if needed.
+extern BGCODE_CORE_EXPORT EResult read_gcode_block_index(FILE& file, const FileHeader& file_header, GCodeBlockIndex& index,
+    std::byte* cs_buffer = nullptr, size_t cs_buffer_size = 0);
+
+// Returns the id of the gcode block containing the given line, index.size() if none.
+extern BGCODE_CORE_EXPORT size_t find_gcode_block_by_line(const GCodeBlockIndex& index, uint64_t line);
+
+// Returns the id of the gcode block containing the given offset into the decoded gcode, index.size() if none.
+extern BGCODE_CORE_EXPORT size_t find_gcode_block_by_offset(const GCodeBlockIndex& index, uint64_t data_offset);
+
+// Reads the header of the gcode block with the given id, seeking directly to it.
+// If return == EResult::Success:
+// - block_header will contain the header of the gcode block.
+// - file position will be set at the start of the block parameters data.
+// Returns EResult::BlockNotFound if block_id is not smaller than index.size().
+// Caller is responsible for providing buffer for checksum calculation, if needed.
+extern BGCODE_CORE_EXPORT EResult read_gcode_block_header(FILE& file, const FileHeader& file_header, const GCodeBlockIndex& index, size_t block_id,
+    BlockHeader& block_header, std::byte* cs_buffer = nullptr, size_t cs_buffer_size = 0);
+
+// Searches and reads the hash tree block from the current file position, stopping at the first gcode block.
+// File position must be at the start of a block header.
+// If return == EResult::Success:
+// - leaves will contain the checksums saved into the hash tree block.
+// - file position will be set at the start of the block header following the hash tree block.
+// otherwise:
+// - file position will keep the current value.
+// Returns EResult::BlockNotFound if the file has no hash tree block.
+// Caller is responsible for providing buffer for checksum calculation, if needed.
+extern BGCODE_CORE_EXPORT EResult read_hash_tree(FILE& file, const FileHeader& file_header, HashTreeLeaves& leaves,
+    std::byte* cs_buffer = nullptr, size_t cs_buffer_size = 0);
+
+// Returns the root of the hash tree with the given leaves, 0 if leaves is empty.
+extern BGCODE_CORE_EXPORT uint32_t hash_tree_root(const HashTreeLeaves& leaves);
+
 // Highest version of the binary format supported by this library instance
 extern BGCODE_CORE_EXPORT uint32_t bgcode_version() noexcept;
 
+// Lowest version of the binary format containing the given block type.
+// Files are saved with the lowest version containing all of their blocks, so that the files not using the blocks added
+// by later versions stay readable by the readers of the older versions.
+extern BGCODE_CORE_EXPORT uint32_t block_type_version(EBlockType type) noexcept;
+
+// Lowest version of the binary format containing gcode blocks with the given encoding, as block_type_version().
+// Readers of version 1 do not check the encoding of the gcode blocks, so the encodings added later require a later version.
+extern BGCODE_CORE_EXPORT uint32_t gcode_encoding_version(EGCodeEncodingType type) noexcept;
+
 // Version of the library
 extern BGCODE_CORE_EXPORT const char* version() noexcept;
 
@@ -17,7 +17,8 @@ static constexpr const size_t MAX_CHECKSUM_SIZE = 4;
 static constexpr const std::array<char, 4> MAGIC{ 'G', 'C', 'D', 'E' };
 
 // Highest binary gcode file version supported.
-static constexpr const uint32_t VERSION = 1;
+// Version 2 adds the index and the hash tree blocks, the files not containing them are saved as version 1.
+static constexpr const uint32_t VERSION = 2;
 
 template<class I, class T = I>
 using IntegerOnly = std::enable_if_t<std::is_integral_v<I>, T>;
@@ -96,6 +97,42 @@ static constexpr uint32_t crc32_sw(It from, It to, uint32_t crc)
     return value;
 }
 
+struct CRC32CTable
+{
+    uint32_t values[256];
+};
+
+static constexpr CRC32CTable make_crc32c_table()
+{
+    constexpr uint32_t crcMagic = 0x82F63B78;
+
+    CRC32CTable table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t value = i;
+        for (int bit = 0; bit < CHAR_BIT; bit++) {
+            value = (value >> 1) ^ (crcMagic & (0u - (value & 1)));
+        }
+        table.values[i] = value;
+    }
+    return table;
+}
+
+static constexpr const CRC32CTable CRC32C_TABLE = make_crc32c_table();
+
+// Table driven, for the targets without CRC instructions
+template<class It, class = BufferIteratorOnly<It>>
+static constexpr uint32_t crc32c_sw(It from, It to, uint32_t crc)
+{
+    uint32_t value = ~crc;
+    for (auto it = from; it != to; ++it) {
+        value = (value >> 8) ^ CRC32C_TABLE.values[(value ^ load_integer<uint32_t>(it, std::next(it))) & 0xFF];
+    }
+    return ~value;
+}
+
+// Uses the CRC instructions when the CPU supports them, crc32c_sw() otherwise
+extern BGCODE_CORE_EXPORT uint32_t crc32c(const void* data, size_t size, uint32_t crc);
+
 template<class Enum>
 constexpr auto to_underlying(Enum enumval) noexcept
 {
@@ -125,6 +162,10 @@ public:
     // Returns true if the given checksum is equal to this one
     bool matches(Checksum& other);
 
+    // Returns the raw checksum data, size() bytes long
+    const std::byte* data() const noexcept { return m_checksum.data(); }
+    size_t size() const noexcept { return m_size; }
+
     EResult write(FILE& file);
     EResult read(FILE& file);
 
@@ -165,14 +206,21 @@ void Checksum::append(const BufT *data, size_t size)
         store_integer_le(new_crc, m_checksum.begin(), m_checksum.size());
         break;
     }
+    case EChecksumType::CRC32C:
+    {
+        const auto old_crc = load_integer<uint32_t>(m_checksum.begin(), m_checksum.end());
+        const uint32_t new_crc = crc32c(data, size * sizeof(BufT), old_crc);
+        store_integer_le(new_crc, m_checksum.begin(), m_checksum.size());
+        break;
+    }
     }
 }
 
 static constexpr auto MAGICi32 = load_integer<uint32_t>(std::begin(MAGIC), std::end(MAGIC));
 
-constexpr auto checksum_types_count() noexcept { auto v = to_underlying(EChecksumType::CRC32); ++v; return v;}
-constexpr auto block_types_count() noexcept { auto v = to_underlying(EBlockType::Thumbnail); ++v; return v; }
-constexpr auto compression_types_count() noexcept { auto v = to_underlying(ECompressionType::Heatshrink_12_4); ++v; return v; }
+constexpr auto checksum_types_count() noexcept { auto v = to_underlying(EChecksumType::CRC32C); ++v; return v;}
+constexpr auto block_types_count() noexcept { auto v = to_underlying(EBlockType::HashTree); ++v; return v; }
+constexpr auto compression_types_count() noexcept { auto v = to_underlying(ECompressionType::DeflateDictionary); ++v; return v; }
 
 } // namespace core
 } // namespace bgcode
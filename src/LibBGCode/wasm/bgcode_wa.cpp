@@ -118,27 +118,58 @@ EMSCRIPTEN_BINDINGS(module) {
         .value("None", bgcode::core::ECompressionType::None)
         .value("Deflate", bgcode::core::ECompressionType::Deflate)
         .value("Heatshrink_11_4", bgcode::core::ECompressionType::Heatshrink_11_4)
-        .value("Heatshrink_12_4", bgcode::core::ECompressionType::Heatshrink_12_4);
+        .value("Heatshrink_12_4", bgcode::core::ECompressionType::Heatshrink_12_4)
+        .value("DeflateDictionary", bgcode::core::ECompressionType::DeflateDictionary);
     emscripten::enum_<bgcode::core::EGCodeEncodingType>("BGCode_GCodeEncodingType")
         .value("None", bgcode::core::EGCodeEncodingType::None)
         .value("MeatPack", bgcode::core::EGCodeEncodingType::MeatPack)
-        .value("MeatPackComments", bgcode::core::EGCodeEncodingType::MeatPackComments);
+        .value("MeatPackComments", bgcode::core::EGCodeEncodingType::MeatPackComments)
+        .value("Tokenized", bgcode::core::EGCodeEncodingType::Tokenized)
+        .value("Columnar", bgcode::core::EGCodeEncodingType::Columnar);
     emscripten::enum_<bgcode::core::EMetadataEncodingType>("BGCode_MetadataEncodingType")
         .value("INI", bgcode::core::EMetadataEncodingType::INI);
     emscripten::enum_<bgcode::core::EChecksumType>("BGCode_ChecksumType")
         .value("None", bgcode::core::EChecksumType::None)
-        .value("CRC32", bgcode::core::EChecksumType::CRC32);
+        .value("CRC32", bgcode::core::EChecksumType::CRC32)
+        .value("CRC32C", bgcode::core::EChecksumType::CRC32C);
+    emscripten::enum_<bgcode::binarize::EAutoCompression>("BGCode_AutoCompression")
+        .value("Disabled", bgcode::binarize::EAutoCompression::Disabled)
+        .value("Smallest", bgcode::binarize::EAutoCompression::Smallest)
+        .value("FastestDecoding", bgcode::binarize::EAutoCompression::FastestDecoding);
+    emscripten::enum_<bgcode::binarize::EDeflateStrategy>("BGCode_DeflateStrategy")
+        .value("Default", bgcode::binarize::EDeflateStrategy::Default)
+        .value("Filtered", bgcode::binarize::EDeflateStrategy::Filtered)
+        .value("RLE", bgcode::binarize::EDeflateStrategy::RLE);
     emscripten::value_object<bgcode::binarize::BinarizerConfig::Compression>("BGCode_BinarizerCompression")
         .field("file_metadata", &bgcode::binarize::BinarizerConfig::Compression::file_metadata)
         .field("printer_metadata", &bgcode::binarize::BinarizerConfig::Compression::printer_metadata)
         .field("print_metadata", &bgcode::binarize::BinarizerConfig::Compression::print_metadata)
         .field("slicer_metadata", &bgcode::binarize::BinarizerConfig::Compression::slicer_metadata)
         .field("gcode", &bgcode::binarize::BinarizerConfig::Compression::gcode);
+    emscripten::value_object<bgcode::binarize::DeflateParameters>("BGCode_DeflateParameters")
+        .field("level", &bgcode::binarize::DeflateParameters::level)
+        .field("strategy", &bgcode::binarize::DeflateParameters::strategy)
+        .field("mem_level", &bgcode::binarize::DeflateParameters::mem_level);
+    emscripten::value_object<bgcode::binarize::BinarizerConfig::Deflate>("BGCode_BinarizerDeflate")
+        .field("metadata", &bgcode::binarize::BinarizerConfig::Deflate::metadata)
+        .field("gcode", &bgcode::binarize::BinarizerConfig::Deflate::gcode);
     emscripten::value_object<bgcode::binarize::BinarizerConfig>("BGCode_BinarizerConfig")
         .field("compression", &bgcode::binarize::BinarizerConfig::compression)
         .field("gcode_encoding", &bgcode::binarize::BinarizerConfig::gcode_encoding)
         .field("metadata_encoding", &bgcode::binarize::BinarizerConfig::metadata_encoding)
-        .field("checksum", &bgcode::binarize::BinarizerConfig::checksum);
+        .field("checksum", &bgcode::binarize::BinarizerConfig::checksum)
+        .field("layer_aligned_blocks", &bgcode::binarize::BinarizerConfig::layer_aligned_blocks)
+        .field("min_layer_block_size", &bgcode::binarize::BinarizerConfig::min_layer_block_size)
+        .field("content_defined_blocks", &bgcode::binarize::BinarizerConfig::content_defined_blocks)
+        .field("min_content_block_size", &bgcode::binarize::BinarizerConfig::min_content_block_size)
+        .field("max_content_block_size", &bgcode::binarize::BinarizerConfig::max_content_block_size)
+        .field("content_boundary_bits", &bgcode::binarize::BinarizerConfig::content_boundary_bits)
+        .field("index_block", &bgcode::binarize::BinarizerConfig::index_block)
+        .field("hash_tree_block", &bgcode::binarize::BinarizerConfig::hash_tree_block)
+        .field("auto_gcode_compression", &bgcode::binarize::BinarizerConfig::auto_gcode_compression)
+        .field("auto_compression_candidates", &bgcode::binarize::BinarizerConfig::auto_compression_candidates)
+        .field("auto_compression_tolerance", &bgcode::binarize::BinarizerConfig::auto_compression_tolerance)
+        .field("deflate", &bgcode::binarize::BinarizerConfig::deflate);
 
     emscripten::function("get_config", &get_config);
 }
@@ -1,9 +1,798 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include "binarize/binarize.hpp"
+#include "binarize/deflate_dictionary.hpp"
+#include "binarize/gcode_stream.hpp"
+#include "binarize/thumbnails.hpp"
+
+#include <boost/nowide/cstdio.hpp>
+
+extern "C" {
+#include <heatshrink/heatshrink_encoder.h>
+#include <heatshrink/heatshrink_decoder.h>
+}
+
+#include <array>
+#include <cstring>
+#include <random>
+
+using namespace bgcode::core;
+using namespace bgcode::binarize;
+
+class ScopedFile
+{
+public:
+    explicit ScopedFile(FILE* file) : m_file(file) {}
+    ~ScopedFile() { if (m_file != nullptr) fclose(m_file); }
+private:
+    FILE* m_file{ nullptr };
+};
+
+static void append_line(void* user_data, const char* line, size_t length)
+{
+    std::string& out = *static_cast<std::string*>(user_data);
+    out.append(line, length);
+    out.push_back('\n');
+}
+
+// Decodes the gcode block at the current file position with both GCodeBlock::read_data() and GCodeStreamDecoder
+static void check_stream_decoding(FILE& file, const FileHeader& file_header, const BlockHeader& block_header, size_t input_buffer_size)
+{
+    const long data_position = ftell(&file);
+    GCodeBlock block;
+    REQUIRE(block.read_data(file, file_header, block_header) == EResult::Success);
+    std::string expected(block.raw_data);
+    if (!expected.empty() && expected.back() != '\n')
+        expected.push_back('\n');
+    const long next_position = ftell(&file);
+
+    std::array<uint8_t, 4096> window;
+    std::array<char, 256> line_buffer;
+    std::vector<uint8_t> input_buffer(input_buffer_size);
+    std::string decoded;
+    GCodeStreamDecoder decoder(window.data(), window.size(), line_buffer.data(), line_buffer.size(), append_line, &decoded);
+    REQUIRE(fseek(&file, data_position, SEEK_SET) == 0);
+    REQUIRE(decode_gcode_block(file, block_header, (EChecksumType)file_header.checksum_type, decoder,
+        input_buffer.data(), input_buffer.size()) == EResult::Success);
+    REQUIRE(ftell(&file) == next_position);
+    REQUIRE(decoded == expected);
+}
 
 TEST_CASE("Dummy", "[Binarize]")
 {
 	REQUIRE(true);
 }
 
+TEST_CASE("Read summary", "[Binarize]")
+{
+    const std::string filename = std::string(TEST_DATA_DIR) + "/mini_cube_b.bgcode";
+    FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+    REQUIRE(file != nullptr);
+    ScopedFile scoped_file(file);
+
+    // reference data, from a full walk of the file
+    FileHeader file_header;
+    REQUIRE(read_header(*file, file_header, nullptr) == EResult::Success);
+    BlockHeader block_header;
+    REQUIRE(read_next_block_header(*file, file_header, block_header, EBlockType::PrinterMetadata) == EResult::Success);
+    PrinterMetadataBlock printer_metadata;
+    REQUIRE(printer_metadata.read_data(*file, file_header, block_header) == EResult::Success);
+    REQUIRE(read_next_block_header(*file, file_header, block_header, EBlockType::PrintMetadata) == EResult::Success);
+    PrintMetadataBlock print_metadata;
+    REQUIRE(print_metadata.read_data(*file, file_header, block_header) == EResult::Success);
+    REQUIRE(read_next_block_header(*file, file_header, block_header, EBlockType::GCode) == EResult::Success);
+    const long gcode_position = block_header.get_position();
+
+    for (bool verify_checksum : { false, true }) {
+        for (bool read_thumbnails : { false, true }) {
+            FileSummary summary;
+            REQUIRE(read_summary(*file, summary, verify_checksum, read_thumbnails) == EResult::Success);
+            REQUIRE(summary.file_header.checksum_type == file_header.checksum_type);
+            REQUIRE(!summary.file_metadata.raw_data.empty());
+            REQUIRE(summary.printer_metadata.raw_data == printer_metadata.raw_data);
+            REQUIRE(summary.print_metadata.raw_data == print_metadata.raw_data);
+            REQUIRE(summary.thumbnails.size() == (read_thumbnails ? 2 : 0));
+            for (const ThumbnailBlock& thumbnail : summary.thumbnails) {
+                REQUIRE(!thumbnail.data.empty());
+            }
+            REQUIRE(summary.gcode_position == gcode_position);
+            REQUIRE(ftell(file) == gcode_position);
+        }
+    }
+}
+
+TEST_CASE("Thumbnails", "[Binarize]")
+{
+    const std::string filename = std::string(TEST_DATA_DIR) + "/mini_cube_b.bgcode";
+    FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+    REQUIRE(file != nullptr);
+    ScopedFile scoped_file(file);
+
+    // reference data
+    FileSummary summary;
+    REQUIRE(read_summary(*file, summary, true) == EResult::Success);
+    REQUIRE(summary.thumbnails.size() == 2);
+
+    FileHeader file_header;
+    std::vector<ThumbnailInfo> thumbnails;
+    REQUIRE(enumerate_thumbnails(*file, file_header, thumbnails) == EResult::Success);
+    REQUIRE(thumbnails.size() == summary.thumbnails.size());
+    for (size_t i = 0; i < thumbnails.size(); ++i) {
+        REQUIRE(thumbnails[i].params.format == summary.thumbnails[i].params.format);
+        REQUIRE(thumbnails[i].params.width == summary.thumbnails[i].params.width);
+        REQUIRE(thumbnails[i].params.height == summary.thumbnails[i].params.height);
+        REQUIRE(thumbnails[i].get_data_size() == summary.thumbnails[i].data.size());
+    }
+
+    SECTION("Selection")
+    {
+        const ThumbnailInfo& small = (thumbnails[0].params.width < thumbnails[1].params.width) ? thumbnails[0] : thumbnails[1];
+        const ThumbnailInfo& big = (&small == &thumbnails[0]) ? thumbnails[1] : thumbnails[0];
+        const EThumbnailFormat format = (EThumbnailFormat)small.params.format;
+        REQUIRE(select_thumbnail({}, format, 100, 100) == nullptr);
+        REQUIRE(select_thumbnail(thumbnails, format, 1, 1) == &small);
+        REQUIRE(select_thumbnail(thumbnails, format, small.params.width, small.params.height) == &small);
+        REQUIRE(select_thumbnail(thumbnails, format, small.params.width + 1, small.params.height) == &big);
+        // no thumbnail is big enough, the biggest one is selected
+        REQUIRE(select_thumbnail(thumbnails, format, 10000, 10000) == &big);
+        // no thumbnail with the given format, the size decides
+        REQUIRE(select_thumbnail(thumbnails, EThumbnailFormat::QOI, 1, 1) == &small);
+    }
+
+    SECTION("Read into buffer")
+    {
+        for (size_t i = 0; i < thumbnails.size(); ++i) {
+            std::vector<std::byte> buffer(thumbnails[i].get_data_size());
+            REQUIRE(read_thumbnail_data(*file, file_header, thumbnails[i], buffer.data(), buffer.size() - 1, true) == EResult::InvalidBuffer);
+            for (bool verify_checksum : { false, true }) {
+                std::fill(buffer.begin(), buffer.end(), std::byte{ 0 });
+                REQUIRE(read_thumbnail_data(*file, file_header, thumbnails[i], buffer.data(), buffer.size(), verify_checksum) == EResult::Success);
+                REQUIRE(std::equal(buffer.begin(), buffer.end(), summary.thumbnails[i].data.begin(), summary.thumbnails[i].data.end()));
+            }
+        }
+    }
+
+    SECTION("Memory mapped view")
+    {
+        MappedFile mapped_file;
+        REQUIRE(mapped_file.open(filename.c_str()) == EResult::Success);
+        for (size_t i = 0; i < thumbnails.size(); ++i) {
+            const std::byte* image = nullptr;
+            REQUIRE(get_thumbnail_view(mapped_file.data(), mapped_file.size(), file_header, thumbnails[i], true, image) == EResult::Success);
+            REQUIRE(std::equal(image, image + thumbnails[i].get_data_size(), summary.thumbnails[i].data.begin(), summary.thumbnails[i].data.end()));
+        }
+
+        // corrupted image
+        std::vector<std::byte> data(mapped_file.data(), mapped_file.data() + mapped_file.size());
+        data[thumbnails[0].get_data_position()] ^= std::byte{ 0x01 };
+        const std::byte* image = nullptr;
+        REQUIRE(get_thumbnail_view(data.data(), data.size(), file_header, thumbnails[0], false, image) == EResult::Success);
+        REQUIRE(get_thumbnail_view(data.data(), data.size(), file_header, thumbnails[0], true, image) == EResult::InvalidChecksum);
+        // truncated file
+        REQUIRE(get_thumbnail_view(data.data(), thumbnails[0].get_data_position(), file_header, thumbnails[0], false, image) == EResult::ReadError);
+
+        REQUIRE(mapped_file.open((filename + ".missing").c_str()) == EResult::ReadError);
+        REQUIRE(mapped_file.data() == nullptr);
+    }
+}
+
+TEST_CASE("GCode stream decoder", "[Binarize]")
+{
+    SECTION("Blocks from file")
+    {
+        const std::string filename = std::string(TEST_DATA_DIR) + "/mini_cube_b.bgcode";
+        FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+
+        FileHeader file_header;
+        REQUIRE(read_header(*file, file_header, nullptr) == EResult::Success);
+
+        size_t gcode_blocks_count = 0;
+        BlockHeader block_header;
+        while (read_next_block_header(*file, file_header, block_header, nullptr, 0) == EResult::Success) {
+            if (block_header.type == (uint16_t)EBlockType::GCode) {
+                check_stream_decoding(*file, file_header, block_header, 1 + gcode_blocks_count * 37);
+                ++gcode_blocks_count;
+            }
+            else
+                REQUIRE(skip_block(*file, file_header, block_header) == EResult::Success);
+        }
+        REQUIRE(gcode_blocks_count > 0);
+    }
+
+    SECTION("Compressions and encodings")
+    {
+        GCodeBlock block;
+        for (int i = 0; i < 200; ++i) {
+            block.raw_data += "G1 X" + std::to_string(i) + ".125 Y" + std::to_string(200 - i) + ".5 E0.0" + std::to_string(i % 7) + "\n";
+            block.raw_data += "; comment " + std::to_string(i) + "\n";
+        }
+        block.raw_data += "M104 S215\n";
+
+        for (ECompressionType compression : { ECompressionType::None, ECompressionType::Heatshrink_11_4, ECompressionType::Heatshrink_12_4 }) {
+            for (EGCodeEncodingType encoding : { EGCodeEncodingType::None, EGCodeEncodingType::MeatPack, EGCodeEncodingType::MeatPackComments,
+                EGCodeEncodingType::Tokenized }) {
+                block.encoding_type = (uint16_t)encoding;
+                FILE* file = std::tmpfile();
+                REQUIRE(file != nullptr);
+                ScopedFile scoped_file(file);
+                FileHeader file_header;
+                file_header.version = gcode_encoding_version(encoding);
+                REQUIRE(block.write(*file, compression, EChecksumType::CRC32) == EResult::Success);
+                rewind(file);
+
+                BlockHeader block_header;
+                REQUIRE(block_header.read(*file) == EResult::Success);
+                check_stream_decoding(*file, file_header, block_header, 64);
+            }
+        }
+    }
+
+    SECTION("Errors")
+    {
+        GCodeBlock block;
+        block.raw_data = "G1 X10 Y10\nG1 X20 Y20\n";
+        FILE* file = std::tmpfile();
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        REQUIRE(block.write(*file, ECompressionType::Heatshrink_12_4, EChecksumType::CRC32) == EResult::Success);
+        rewind(file);
+        BlockHeader block_header;
+        REQUIRE(block_header.read(*file) == EResult::Success);
+        std::vector<uint8_t> content(2 + block_header.compressed_size + 4);
+        REQUIRE(fread(content.data(), 1, content.size(), file) == content.size());
+
+        std::array<uint8_t, 4096> window;
+        std::array<char, 8> line_buffer;
+        std::string decoded;
+
+        // window too small
+        GCodeStreamDecoder small_window_decoder(window.data(), 2048, line_buffer.data(), line_buffer.size(), append_line, &decoded);
+        REQUIRE(small_window_decoder.reset(block_header, EChecksumType::CRC32) == EResult::InvalidBuffer);
+
+        // line longer than the line buffer
+        GCodeStreamDecoder decoder(window.data(), window.size(), line_buffer.data(), line_buffer.size(), append_line, &decoded);
+        REQUIRE(decoder.reset(block_header, EChecksumType::CRC32) == EResult::Success);
+        REQUIRE(decoder.push(content.data(), content.size()) == EResult::InvalidBuffer);
+
+        // verify only, no line is emitted and no buffer is needed
+        GCodeStreamDecoder verify_decoder(nullptr, 0, nullptr, 0, append_line, &decoded);
+        REQUIRE(verify_decoder.reset(block_header, EChecksumType::None, true) == EResult::InvalidChecksumType);
+        REQUIRE(verify_decoder.reset(block_header, EChecksumType::CRC32, true) == EResult::Success);
+        REQUIRE(verify_decoder.push(content.data(), content.size()) == EResult::Success);
+        REQUIRE(verify_decoder.finish() == EResult::Success);
+        REQUIRE(decoded.empty());
+
+        // corrupted checksum, the lines are emitted before it is verified
+        std::array<char, 64> big_line_buffer;
+        GCodeStreamDecoder big_decoder(window.data(), window.size(), big_line_buffer.data(), big_line_buffer.size(), append_line, &decoded);
+        content.back() ^= 0x01;
+        REQUIRE(big_decoder.reset(block_header, EChecksumType::CRC32) == EResult::Success);
+        REQUIRE(big_decoder.push(content.data(), content.size()) == EResult::Success);
+        REQUIRE(big_decoder.finish() == EResult::InvalidChecksum);
+        REQUIRE(!decoded.empty());
+        decoded.clear();
+
+        // corrupted data, detected by a verify only pass before emitting any line
+        content.back() ^= 0x01;
+        content[4] ^= 0x01;
+        REQUIRE(verify_decoder.reset(block_header, EChecksumType::CRC32, true) == EResult::Success);
+        REQUIRE(verify_decoder.push(content.data(), content.size()) == EResult::Success);
+        REQUIRE(verify_decoder.finish() == EResult::InvalidChecksum);
+        REQUIRE(decoded.empty());
+        content[4] ^= 0x01;
+        content.back() ^= 0x01;
+
+        // incomplete block
+        REQUIRE(big_decoder.reset(block_header, EChecksumType::CRC32) == EResult::Success);
+        REQUIRE(big_decoder.push(content.data(), content.size() - 1) == EResult::Success);
+        REQUIRE(big_decoder.finish() == EResult::ReadError);
+    }
+}
+
+// Writes the given block into a temporary file and reads it back, encoded_size is set to the size of the block data
+static std::string write_and_read(const GCodeBlock& block, ECompressionType compression, size_t& encoded_size)
+{
+    FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+    ScopedFile scoped_file(file);
+    REQUIRE(block.write(*file, compression, EChecksumType::CRC32) == EResult::Success);
+    rewind(file);
+
+    FileHeader file_header;
+    file_header.version = gcode_encoding_version((EGCodeEncodingType)block.encoding_type);
+    BlockHeader block_header;
+    REQUIRE(block_header.read(*file) == EResult::Success);
+    encoded_size = (compression == ECompressionType::None) ? block_header.uncompressed_size : block_header.compressed_size;
+    const long data_position = ftell(file);
+    GCodeBlock read_block;
+    REQUIRE(read_block.read_data(*file, file_header, block_header) == EResult::Success);
+    REQUIRE(read_block.encoding_type == block.encoding_type);
+    REQUIRE(fseek(file, data_position, SEEK_SET) == 0);
+    if (compression != ECompressionType::Deflate && compression != ECompressionType::DeflateDictionary &&
+        (EGCodeEncodingType)block.encoding_type != EGCodeEncodingType::Columnar)
+        check_stream_decoding(*file, file_header, block_header, 61);
+    return std::string(read_block.raw_data);
+}
+
+TEST_CASE("Tokenized gcode encoding", "[Binarize]")
+{
+    GCodeBlock block;
+    block.encoding_type = (uint16_t)EGCodeEncodingType::Tokenized;
+    size_t encoded_size = 0;
+
+    SECTION("Lines are regenerated as they are")
+    {
+        block.raw_data =
+            "G1 X10 Y20.5 E.0123 F1200\n"
+            "G1 X-10.125 Y0 Z.2\n"
+            "G0 X9999999999.999 F7200\n"
+            "G1 E-.8 F2100\n"
+            "G2 X11.2 Y30.05 I-1.25 J3.5 E.04321\n"
+            "G3 X12 Y31 I1 J-1\n"
+            "G1\n"
+            // not tokenized
+            "G1 Z0.2\n"
+            "G1 X1.50\n"
+            "G1 X-0\n"
+            "G1 X1.2345\n"
+            "G1 Y10 X20\n"
+            "G1  X10\n"
+            "G1 X10 \n"
+            "G1 X10 ; comment\n"
+            "G1 X10\r\n"
+            "G2 X10 Y10 R5\n"
+            "G28 X\n"
+            "\n"
+            "; comment\n"
+            "M104 S215\n"
+            "G1 X10 Y10";
+        for (ECompressionType compression : { ECompressionType::None, ECompressionType::Heatshrink_12_4 }) {
+            REQUIRE(write_and_read(block, compression, encoded_size) == std::string_view(block.raw_data));
+        }
+        block.raw_data = "G1 X1\n";
+        REQUIRE(write_and_read(block, ECompressionType::None, encoded_size) == std::string_view(block.raw_data));
+        // opcode and 2 bytes varint
+        REQUIRE(encoded_size == 3);
+    }
+
+    SECTION("Sliced gcode")
+    {
+        const std::string filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+        FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        std::array<char, 65536> buffer;
+        const size_t size = fread(buffer.data(), 1, buffer.size(), file);
+        REQUIRE(size > 0);
+        // whole lines
+        const std::string_view data(buffer.data(), std::string_view(buffer.data(), size).rfind('\n') + 1);
+        block.raw_data = data;
+        REQUIRE(write_and_read(block, ECompressionType::None, encoded_size) == data);
+
+        // smaller than MeatPack
+        size_t meatpack_size = 0;
+        GCodeBlock meatpack_block;
+        meatpack_block.encoding_type = (uint16_t)EGCodeEncodingType::MeatPackComments;
+        meatpack_block.raw_data = data;
+        write_and_read(meatpack_block, ECompressionType::None, meatpack_size);
+        REQUIRE(encoded_size < meatpack_size);
+    }
+
+    SECTION("Overflowing deltas")
+    {
+        // two G1 X lines whose deltas (the max and the min values) overflow the sum
+        std::vector<uint8_t> data = { 0xA1, 0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01,
+            0xA1, 0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01 };
+        FILE* file = std::tmpfile();
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        BlockHeader block_header((uint16_t)EBlockType::GCode, (uint16_t)ECompressionType::None, (uint32_t)data.size());
+        REQUIRE(block_header.write(*file) == EResult::Success);
+        REQUIRE(fwrite(&block.encoding_type, 1, sizeof(block.encoding_type), file) == sizeof(block.encoding_type));
+        REQUIRE(fwrite(data.data(), 1, data.size(), file) == data.size());
+        rewind(file);
+
+        FileHeader file_header;
+        REQUIRE(block_header.read(*file) == EResult::Success);
+        const long data_position = ftell(file);
+        GCodeBlock read_block;
+        // the encoding was added by version 2
+        REQUIRE(read_block.read_data(*file, file_header, block_header) == EResult::InvalidGCodeEncodingType);
+        file_header.version = 2;
+        REQUIRE(fseek(file, data_position, SEEK_SET) == 0);
+        REQUIRE(read_block.read_data(*file, file_header, block_header) == EResult::Success);
+        REQUIRE(std::string_view(read_block.raw_data) == "G1 X9223372036854775.807\nG1 X-.002\n");
+        REQUIRE(fseek(file, data_position, SEEK_SET) == 0);
+        check_stream_decoding(*file, file_header, block_header, 61);
+    }
+}
+
+TEST_CASE("Columnar gcode encoding", "[Binarize]")
+{
+    GCodeBlock block;
+    block.encoding_type = (uint16_t)EGCodeEncodingType::Columnar;
+    size_t encoded_size = 0;
+
+    SECTION("Lines are regenerated as they are")
+    {
+        block.raw_data =
+            "G1 X10 Y20.5 E.0123 F1200\n"
+            "G2 X11.2 Y30.05 I-1.25 J3.5 E.04321\n"
+            "; comment\n"
+            "\n"
+            "G1 Z0.2\n"
+            "G1 X-10.125 Y0 Z.2\n"
+            "G1 E-.8 F2100\n"
+            "G1 X10 Y10";
+        for (ECompressionType compression : { ECompressionType::None, ECompressionType::Deflate, ECompressionType::Heatshrink_11_4,
+            ECompressionType::Heatshrink_12_4 }) {
+            REQUIRE(write_and_read(block, compression, encoded_size) == std::string_view(block.raw_data));
+        }
+        block.raw_data = "; comment only\n";
+        REQUIRE(write_and_read(block, ECompressionType::Deflate, encoded_size) == std::string_view(block.raw_data));
+        block.raw_data.clear();
+        REQUIRE(write_and_read(block, ECompressionType::Deflate, encoded_size).empty());
+    }
+
+    SECTION("Not supported by the stream decoder")
+    {
+        block.raw_data = "G1 X10 Y10\n";
+        FILE* file = std::tmpfile();
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        REQUIRE(block.write(*file, ECompressionType::Heatshrink_12_4, EChecksumType::CRC32) == EResult::Success);
+        rewind(file);
+        BlockHeader block_header;
+        REQUIRE(block_header.read(*file) == EResult::Success);
+
+        std::array<uint8_t, 4096> window;
+        std::array<char, 64> line_buffer;
+        std::array<uint8_t, 64> input_buffer;
+        std::string decoded;
+        GCodeStreamDecoder decoder(window.data(), window.size(), line_buffer.data(), line_buffer.size(), append_line, &decoded);
+        REQUIRE(decode_gcode_block(*file, block_header, EChecksumType::CRC32, decoder, input_buffer.data(), input_buffer.size()) ==
+            EResult::InvalidGCodeEncodingType);
+    }
+
+    SECTION("Column sizes exceeding the uncompressed size")
+    {
+        // the size of the opcodes column, as varint, followed by its stored size, then all the other columns empty
+        std::vector<uint8_t> data = { 0xFF, 0xFF, 0xFF, 0xFF, 0x07, 0x00 };
+        data.resize(data.size() + 2 * 7, 0x00);
+        FILE* file = std::tmpfile();
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        BlockHeader block_header((uint16_t)EBlockType::GCode, (uint16_t)ECompressionType::Deflate, 64, (uint32_t)data.size());
+        REQUIRE(block_header.write(*file) == EResult::Success);
+        REQUIRE(fwrite(&block.encoding_type, 1, sizeof(block.encoding_type), file) == sizeof(block.encoding_type));
+        REQUIRE(fwrite(data.data(), 1, data.size(), file) == data.size());
+        rewind(file);
+
+        FileHeader file_header;
+        file_header.version = 2;
+        REQUIRE(block_header.read(*file) == EResult::Success);
+        GCodeBlock read_block;
+        REQUIRE(read_block.read_data(*file, file_header, block_header) == EResult::GCodeDecodingError);
+    }
+
+    SECTION("Sliced gcode")
+    {
+        const std::string filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+        FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        std::array<char, 65536> buffer;
+        const size_t size = fread(buffer.data(), 1, buffer.size(), file);
+        REQUIRE(size > 0);
+        // whole lines
+        const std::string_view data(buffer.data(), std::string_view(buffer.data(), size).rfind('\n') + 1);
+        block.raw_data = data;
+        REQUIRE(write_and_read(block, ECompressionType::Deflate, encoded_size) == data);
+
+        // smaller than the other encodings, with the same compression
+        for (EGCodeEncodingType encoding : { EGCodeEncodingType::MeatPackComments, EGCodeEncodingType::Tokenized }) {
+            size_t other_size = 0;
+            GCodeBlock other_block;
+            other_block.encoding_type = (uint16_t)encoding;
+            other_block.raw_data = data;
+            write_and_read(other_block, ECompressionType::Deflate, other_size);
+            REQUIRE(encoded_size < other_size);
+        }
+    }
+}
+
+TEST_CASE("Deflate with preset dictionary", "[Binarize]")
+{
+    SECTION("Embedded dictionaries")
+    {
+        const DeflateDictionary& dictionary = current_deflate_dictionary();
+        REQUIRE(dictionary.version >= 1);
+        REQUIRE(!dictionary.data.empty());
+        REQUIRE(find_deflate_dictionary(dictionary.id) == &dictionary);
+        REQUIRE(find_deflate_dictionary(dictionary.id + 1) == nullptr);
+    }
+
+    SECTION("Small blocks")
+    {
+        const std::string filename = std::string(TEST_DATA_DIR) + "/mini_cube_ps2.8.1.gcode";
+        FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        std::array<char, 4096> buffer;
+        const size_t size = fread(buffer.data(), 1, buffer.size(), file);
+        REQUIRE(size > 0);
+        // whole lines
+        const std::string_view data(buffer.data(), std::string_view(buffer.data(), size).rfind('\n') + 1);
+
+        GCodeBlock block;
+        block.raw_data = data;
+        size_t deflate_size = 0;
+        REQUIRE(write_and_read(block, ECompressionType::Deflate, deflate_size) == data);
+        size_t dictionary_size = 0;
+        REQUIRE(write_and_read(block, ECompressionType::DeflateDictionary, dictionary_size) == data);
+        REQUIRE(dictionary_size < deflate_size);
+
+        block.encoding_type = (uint16_t)EGCodeEncodingType::Columnar;
+        REQUIRE(write_and_read(block, ECompressionType::DeflateDictionary, dictionary_size) == data);
+    }
+
+    SECTION("Trainer")
+    {
+        std::string first;
+        std::string second;
+        for (int i = 0; i < 2000; ++i) {
+            first += "G0 X" + std::to_string(i) + "\n;TYPE:Perimeter\n";
+            second += "G1 X1 Y" + std::to_string(i) + "\n;TYPE:Perimeter\n;WIDTH:0.45\n";
+        }
+        first += "; layer_height = 0.2\n";
+        second += "; layer_height = 0.2\n";
+
+        const std::string dictionary = train_deflate_dictionary({ first, second }, 1024);
+        // in more chunks and samples, the most frequent at the end
+        REQUIRE(dictionary == "; layer_height = 0.2\n;TYPE:Perimeter\n");
+        REQUIRE(train_deflate_dictionary({ first, second }, 8).empty());
+        // a single sample
+        REQUIRE(train_deflate_dictionary({ second }, 1024) == ";WIDTH:0.45\n;TYPE:Perimeter\n");
+    }
+}
+
+// Compressed data of the gcode block serialized into block
+static std::vector<uint8_t> block_data(const std::pmr::vector<uint8_t>& block)
+{
+    BlockHeader block_header;
+    memcpy(&block_header.compressed_size, block.data() + 8, sizeof(block_header.compressed_size));
+    const size_t data_offset = 12 + sizeof(GCodeBlock::encoding_type);
+    REQUIRE(block.size() >= data_offset + block_header.compressed_size);
+    return std::vector<uint8_t>(block.data() + data_offset, block.data() + data_offset + block_header.compressed_size);
+}
+
+// Compresses data with the heatshrink library
+static std::vector<uint8_t> stock_heatshrink_encode(std::string_view data, uint8_t window_sz)
+{
+    heatshrink_encoder* encoder = heatshrink_encoder_alloc(window_sz, 4);
+    REQUIRE(encoder != nullptr);
+    std::vector<uint8_t> input(data.begin(), data.end());
+    std::vector<uint8_t> ret;
+    std::array<uint8_t, 1024> buffer;
+    size_t sunk = 0;
+    while (sunk < input.size()) {
+        size_t count = 0;
+        REQUIRE(heatshrink_encoder_sink(encoder, input.data() + sunk, input.size() - sunk, &count) == HSER_SINK_OK);
+        sunk += count;
+        HSE_poll_res poll_res;
+        do {
+            poll_res = heatshrink_encoder_poll(encoder, buffer.data(), buffer.size(), &count);
+            REQUIRE(poll_res >= 0);
+            ret.insert(ret.end(), buffer.data(), buffer.data() + count);
+        } while (poll_res == HSER_POLL_MORE);
+    }
+    while (heatshrink_encoder_finish(encoder) == HSER_FINISH_MORE) {
+        size_t count = 0;
+        REQUIRE(heatshrink_encoder_poll(encoder, buffer.data(), buffer.size(), &count) >= 0);
+        ret.insert(ret.end(), buffer.data(), buffer.data() + count);
+    }
+    heatshrink_encoder_free(encoder);
+    return ret;
+}
+
+// Decompresses data with the heatshrink library
+static std::string stock_heatshrink_decode(const std::vector<uint8_t>& data, uint8_t window_sz)
+{
+    heatshrink_decoder* decoder = heatshrink_decoder_alloc(256, window_sz, 4);
+    REQUIRE(decoder != nullptr);
+    std::vector<uint8_t> input(data.begin(), data.end());
+    std::string ret;
+    std::array<uint8_t, 1024> buffer;
+    size_t sunk = 0;
+    while (sunk < input.size()) {
+        size_t count = 0;
+        REQUIRE(heatshrink_decoder_sink(decoder, input.data() + sunk, input.size() - sunk, &count) >= 0);
+        sunk += count;
+        HSD_poll_res poll_res;
+        do {
+            poll_res = heatshrink_decoder_poll(decoder, buffer.data(), buffer.size(), &count);
+            REQUIRE(poll_res >= 0);
+            ret.append(reinterpret_cast<const char*>(buffer.data()), count);
+        } while (poll_res == HSDR_POLL_MORE);
+    }
+    REQUIRE(heatshrink_decoder_finish(decoder) == HSDR_FINISH_DONE);
+    heatshrink_decoder_free(decoder);
+    return ret;
+}
+
+static std::string read_gcode_sample(size_t size)
+{
+    const std::string filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+    FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+    REQUIRE(file != nullptr);
+    ScopedFile scoped_file(file);
+    std::string ret(size, '\0');
+    ret.resize(fread(ret.data(), 1, ret.size(), file));
+    REQUIRE(ret.size() == size);
+    return ret;
+}
+
+TEST_CASE("Heatshrink encoder", "[Binarize]")
+{
+    std::string random(10000, '\0');
+    std::mt19937 generator(1);
+    for (char& c : random) {
+        c = (char)(generator() & 0xFF);
+    }
+    const std::vector<std::string> samples = {
+        "G",
+        "G1 X1",
+        std::string(5000, 'a'),
+        "G1 X10 Y10\nG1 X10 Y10\nG1 X10 Y10\n",
+        random,
+        read_gcode_sample(65536)
+    };
+
+    for (ECompressionType compression : { ECompressionType::Heatshrink_11_4, ECompressionType::Heatshrink_12_4 }) {
+        const uint8_t window_sz = (compression == ECompressionType::Heatshrink_11_4) ? 11 : 12;
+        for (const std::string& sample : samples) {
+            GCodeBlock block;
+            block.raw_data = sample;
+            std::pmr::vector<uint8_t> serialized;
+            REQUIRE(block.write(serialized, compression, EChecksumType::None) == EResult::Success);
+            const std::vector<uint8_t> data = block_data(serialized);
+            // decoded by the heatshrink library
+            REQUIRE(stock_heatshrink_decode(data, window_sz) == sample);
+            // 9 bits per byte at most
+            REQUIRE(data.size() <= sample.size() + sample.size() / 8 + 1);
+            // as small as the library output
+            REQUIRE(data.size() <= stock_heatshrink_encode(sample, window_sz).size() * 101 / 100 + 1);
+        }
+    }
+}
+
+// Reads a gcode block containing the given heatshrink data
+static std::pair<EResult, std::string> read_heatshrink_block(const std::vector<uint8_t>& data, ECompressionType compression,
+    uint32_t uncompressed_size)
+{
+    FILE* file = std::tmpfile();
+    REQUIRE(file != nullptr);
+    ScopedFile scoped_file(file);
+    BlockHeader block_header((uint16_t)EBlockType::GCode, (uint16_t)compression, uncompressed_size, (uint32_t)data.size());
+    REQUIRE(block_header.write(*file) == EResult::Success);
+    const uint16_t encoding_type = (uint16_t)EGCodeEncodingType::None;
+    REQUIRE(fwrite(&encoding_type, 1, sizeof(encoding_type), file) == sizeof(encoding_type));
+    REQUIRE(fwrite(data.data(), 1, data.size(), file) == data.size());
+    rewind(file);
+
+    FileHeader file_header;
+    file_header.checksum_type = (uint16_t)EChecksumType::None;
+    REQUIRE(block_header.read(*file) == EResult::Success);
+    GCodeBlock block;
+    const EResult res = block.read_data(*file, file_header, block_header);
+    return { res, std::string(block.raw_data) };
+}
+
+TEST_CASE("Heatshrink decoder", "[Binarize]")
+{
+    const std::string sample = read_gcode_sample(65536);
+    for (ECompressionType compression : { ECompressionType::Heatshrink_11_4, ECompressionType::Heatshrink_12_4 }) {
+        const uint8_t window_sz = (compression == ECompressionType::Heatshrink_11_4) ? 11 : 12;
+        const std::vector<uint8_t> data = stock_heatshrink_encode(sample, window_sz);
+
+        // data from the heatshrink library
+        REQUIRE(read_heatshrink_block(data, compression, (uint32_t)sample.size()) == std::make_pair(EResult::Success, sample));
+
+        // truncated data
+        const std::vector<uint8_t> truncated(data.begin(), data.end() - 1);
+        REQUIRE(read_heatshrink_block(truncated, compression, (uint32_t)sample.size()).first == EResult::DataUncompressionError);
+        // trailing data
+        std::vector<uint8_t> trailing = data;
+        trailing.push_back(0xFF);
+        REQUIRE(read_heatshrink_block(trailing, compression, (uint32_t)sample.size()).first == EResult::DataUncompressionError);
+        // wrong uncompressed size
+        REQUIRE(read_heatshrink_block(data, compression, (uint32_t)sample.size() - 1).first == EResult::DataUncompressionError);
+        REQUIRE(read_heatshrink_block(data, compression, (uint32_t)sample.size() + 1).first == EResult::DataUncompressionError);
+
+        // corrupted data never writes out of the output
+        std::mt19937 generator(1);
+        for (int i = 0; i < 100; ++i) {
+            std::vector<uint8_t> corrupted = data;
+            corrupted[generator() % corrupted.size()] ^= (uint8_t)(1 + generator() % 255);
+            read_heatshrink_block(corrupted, compression, (uint32_t)sample.size());
+        }
+    }
+
+    // backreferences before the start of the data read zeros, as for the library decoder:
+    // tag 0, offset 2, length 3, then tag 1 and 'a'
+    const std::vector<uint8_t> data = { 0b00000000, 0b00001001, 0b01011000, 0b01000000 };
+    REQUIRE(read_heatshrink_block(data, ECompressionType::Heatshrink_12_4, 4) == std::make_pair(EResult::Success, std::string("\0\0\0a", 4)));
+    REQUIRE(stock_heatshrink_decode(data, 12) == std::string("\0\0\0a", 4));
+}
+
+// Bitwise CRC32C, the reference for the library implementations
+static uint32_t reference_crc32c(const uint8_t* data, size_t size)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+TEST_CASE("CRC32C checksum", "[Binarize]")
+{
+    REQUIRE(checksum_size(EChecksumType::CRC32C) == 4);
+    REQUIRE(reference_crc32c(reinterpret_cast<const uint8_t*>("123456789"), 9) == 0xE3069283);
+
+    std::mt19937 generator(1);
+    for (size_t size : { 0, 1, 7, 8, 9, 63, 1000, 65536 }) {
+        GCodeBlock block;
+        block.raw_data.resize(size);
+        // short lines, for the stream decoder
+        for (char& c : block.raw_data) {
+            c = (generator() % 16 == 0) ? '\n' : (char)('A' + generator() % 26);
+        }
+
+        // the checksum covers the whole block
+        std::pmr::vector<uint8_t> serialized;
+        REQUIRE(block.write(serialized, ECompressionType::None, EChecksumType::CRC32C) == EResult::Success);
+        uint32_t checksum = 0;
+        memcpy(&checksum, serialized.data() + serialized.size() - sizeof(checksum), sizeof(checksum));
+        REQUIRE(checksum == reference_crc32c(serialized.data(), serialized.size() - sizeof(checksum)));
+
+        // verified by the validator and by the stream decoder
+        FILE* file = std::tmpfile();
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        REQUIRE(block.write(*file, ECompressionType::Heatshrink_12_4, EChecksumType::CRC32C) == EResult::Success);
+        FileHeader file_header;
+        file_header.checksum_type = (uint16_t)EChecksumType::CRC32C;
+        rewind(file);
+        BlockHeader block_header;
+        REQUIRE(block_header.read(*file) == EResult::Success);
+        std::array<std::byte, 61> buffer;
+        REQUIRE(verify_block_checksum(*file, file_header, block_header, buffer.data(), buffer.size()) == EResult::Success);
+        REQUIRE(fseek(file, (long)block_header.get_size(), SEEK_SET) == 0);
+        check_stream_decoding(*file, file_header, block_header, 61);
+
+        // corrupted checksum
+        const long checksum_position = (long)(block_header.get_size() + block_content_size(file_header, block_header) - sizeof(checksum));
+        REQUIRE(fseek(file, checksum_position, SEEK_SET) == 0);
+        checksum = 0;
+        REQUIRE(fwrite(&checksum, 1, sizeof(checksum), file) == sizeof(checksum));
+        REQUIRE(fseek(file, (long)block_header.get_size(), SEEK_SET) == 0);
+        REQUIRE(verify_block_checksum(*file, file_header, block_header, buffer.data(), buffer.size()) == EResult::InvalidChecksum);
+        std::array<uint8_t, 4096> window;
+        std::array<char, 256> line_buffer;
+        std::vector<uint8_t> input_buffer(61);
+        GCodeStreamDecoder decoder(window.data(), window.size(), line_buffer.data(), line_buffer.size(),
+            [](void*, const char*, size_t) {}, nullptr);
+        REQUIRE(fseek(file, (long)block_header.get_size(), SEEK_SET) == 0);
+        REQUIRE(decode_gcode_block(*file, block_header, EChecksumType::CRC32C, decoder, input_buffer.data(), input_buffer.size()) ==
+            EResult::InvalidChecksum);
+        REQUIRE(fseek(file, (long)block_header.get_size(), SEEK_SET) == 0);
+        REQUIRE(verify_gcode_block(*file, block_header, EChecksumType::CRC32C, decoder, input_buffer.data(), input_buffer.size()) ==
+            EResult::InvalidChecksum);
+    }
+}
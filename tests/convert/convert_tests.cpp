@@ -1,9 +1,19 @@
 #include <catch2/catch_test_macros.hpp>
 
 #include "convert/convert.hpp"
+#include "convert/appender.hpp"
+#include "convert/catalog.hpp"
+#include "convert/metadata_editor.hpp"
+#include "convert/patch.hpp"
+#include "convert/validator.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <memory_resource>
 
 #include <boost/nowide/cstdio.hpp>
 
@@ -20,6 +30,32 @@ private:
     FILE* m_file{ nullptr };
 };
 
+// Counts the allocations made through it
+class CountingResource : public std::pmr::memory_resource
+{
+public:
+    explicit CountingResource(std::pmr::memory_resource* upstream) : m_upstream(upstream) {}
+    size_t get_allocations_count() const { return m_allocations_count; }
+
+private:
+    std::pmr::memory_resource* m_upstream{ nullptr };
+    size_t m_allocations_count{ 0 };
+
+    void* do_allocate(size_t bytes, size_t alignment) override { ++m_allocations_count; return m_upstream->allocate(bytes, alignment); }
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override { m_upstream->deallocate(p, bytes, alignment); }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// Makes any allocation from the default memory resource fail, while in scope
+class ScopedNullDefaultResource
+{
+public:
+    ScopedNullDefaultResource() : m_old(std::pmr::set_default_resource(std::pmr::null_memory_resource())) {}
+    ~ScopedNullDefaultResource() { std::pmr::set_default_resource(m_old); }
+private:
+    std::pmr::memory_resource* m_old{ nullptr };
+};
+
 void binary_to_ascii(const std::string& src_filename, const std::string& dst_filename)
 {
     // Open source file
@@ -186,3 +222,1712 @@ TEST_CASE("Convert from ascii to binary PS 2.8.1", "[Convert]")
   // compare results
   compare_text_files(ba_dst_filename, ab_src_filename);
 }
+
+TEST_CASE("Convert from ascii to binary into callback", "[Convert]")
+{
+    std::cout << "\nTEST: Convert from ascii to binary into callback\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+    const std::string file_dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_file.bgcode";
+    const std::string callback_dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_callback.bgcode";
+    BinarizerConfig config;
+    config.compression.slicer_metadata = ECompressionType::Deflate;
+    config.compression.gcode = ECompressionType::Heatshrink_12_4;
+    config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+
+    // convert into file
+    ascii_to_binary(src_filename, file_dst_filename, config);
+
+    // convert into callback
+    {
+        FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+        REQUIRE(src_file != nullptr);
+        ScopedFile scoped_src_file(src_file);
+
+        std::vector<std::byte> output;
+        size_t chunks_count = 0;
+        const EResult res = from_ascii_to_binary(*src_file, [&](const std::byte* data, size_t size) {
+            output.insert(output.end(), data, data + size);
+            ++chunks_count;
+            return true;
+        }, config);
+        REQUIRE(res == EResult::Success);
+        REQUIRE(chunks_count > 1);
+
+        FILE* dst_file = boost::nowide::fopen(callback_dst_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+        REQUIRE(fwrite(output.data(), 1, output.size(), dst_file) == output.size());
+    }
+
+    // compare results
+    compare_binary_files(file_dst_filename, callback_dst_filename);
+
+    // a failing callback aborts the conversion
+    FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+    REQUIRE(src_file != nullptr);
+    ScopedFile scoped_src_file(src_file);
+    REQUIRE(from_ascii_to_binary(*src_file, [](const std::byte*, size_t) { return false; }, config) == EResult::WriteError);
+}
+
+TEST_CASE("Convert using a memory resource", "[Convert]")
+{
+    std::cout << "\nTEST: Convert using a memory resource\n";
+
+    const std::string ab_src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+    const std::string ab_dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_resource.bgcode";
+    const std::string ab_check_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_resource_ref.bgcode";
+    const std::string ba_dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_resource_final.gcode";
+    BinarizerConfig config;
+    config.compression.slicer_metadata = ECompressionType::Deflate;
+    config.compression.gcode = ECompressionType::Heatshrink_12_4;
+    config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+
+    // reference conversion, using the default memory resource
+    ascii_to_binary(ab_src_filename, ab_check_filename, config);
+
+    std::pmr::monotonic_buffer_resource arena;
+    CountingResource counting_resource(&arena);
+
+    // convert from ascii to binary
+    {
+        FILE* src_file = boost::nowide::fopen(ab_src_filename.c_str(), "rb");
+        REQUIRE(src_file != nullptr);
+        ScopedFile scoped_src_file(src_file);
+        FILE* dst_file = boost::nowide::fopen(ab_dst_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+
+        ScopedNullDefaultResource null_default_resource;
+        const EResult res = from_ascii_to_binary(*src_file, [dst_file](const std::byte* data, size_t size) {
+            return fwrite(data, 1, size, dst_file) == size;
+        }, config, &counting_resource);
+        REQUIRE(res == EResult::Success);
+    }
+    REQUIRE(counting_resource.get_allocations_count() > 0);
+    compare_binary_files(ab_dst_filename, ab_check_filename);
+
+    // convert back from binary to ascii
+    {
+        FILE* src_file = boost::nowide::fopen(ab_dst_filename.c_str(), "rb");
+        REQUIRE(src_file != nullptr);
+        ScopedFile scoped_src_file(src_file);
+        FILE* dst_file = boost::nowide::fopen(ba_dst_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+
+        ScopedNullDefaultResource null_default_resource;
+        REQUIRE(from_binary_to_ascii(*src_file, *dst_file, true, &counting_resource) == EResult::Success);
+    }
+    compare_text_files(ba_dst_filename, ab_src_filename);
+}
+
+// Returns the decoded gcode of all the gcode blocks of the given file and sets positions to the positions of the blocks
+TEST_CASE("Automatic gcode compression", "[Convert]")
+{
+    std::cout << "\nTEST: Automatic gcode compression\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+    const std::string dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_auto.bgcode";
+    const std::string ascii_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_auto.gcode";
+
+    auto convert = [&](const BinarizerConfig& config, BinarizerStatistics& statistics) {
+        FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+        REQUIRE(src_file != nullptr);
+        ScopedFile scoped_src_file(src_file);
+        FILE* dst_file = boost::nowide::fopen(dst_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+        return from_ascii_to_binary(*src_file, *dst_file, config, statistics);
+    };
+    auto blocks_count = [](const BinarizerStatistics& statistics) {
+        uint32_t ret = 0;
+        for (uint32_t count : statistics.gcode_blocks) {
+            ret += count;
+        }
+        return ret;
+    };
+
+    BinarizerConfig config;
+    config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+
+    // fixed compressions
+    uint64_t min_size = std::numeric_limits<uint64_t>::max();
+    uint32_t count = 0;
+    for (ECompressionType type : { ECompressionType::None, ECompressionType::Deflate, ECompressionType::Heatshrink_11_4,
+        ECompressionType::Heatshrink_12_4, ECompressionType::DeflateDictionary }) {
+        config.compression.gcode = type;
+        BinarizerStatistics statistics;
+        REQUIRE(convert(config, statistics) == EResult::Success);
+        count = blocks_count(statistics);
+        REQUIRE(count > 1);
+        REQUIRE(statistics.gcode_blocks[(size_t)type] == count);
+        min_size = std::min(min_size, statistics.gcode_blocks_size);
+    }
+
+    config.compression.gcode = ECompressionType::None;
+    config.auto_gcode_compression = EAutoCompression::Smallest;
+    {
+        // never bigger than the best fixed compression
+        BinarizerStatistics statistics;
+        REQUIRE(convert(config, statistics) == EResult::Success);
+        REQUIRE(blocks_count(statistics) == count);
+        REQUIRE(statistics.gcode_blocks_size <= min_size);
+        binary_to_ascii(dst_filename, ascii_filename);
+        compare_text_files(ascii_filename, src_filename);
+    }
+    {
+        // only the enabled candidates are used
+        config.auto_compression_candidates = auto_compression_candidate(ECompressionType::None) |
+            auto_compression_candidate(ECompressionType::Heatshrink_11_4);
+        BinarizerStatistics statistics;
+        REQUIRE(convert(config, statistics) == EResult::Success);
+        REQUIRE(statistics.gcode_blocks[(size_t)ECompressionType::None] + statistics.gcode_blocks[(size_t)ECompressionType::Heatshrink_11_4] == count);
+        binary_to_ascii(dst_filename, ascii_filename);
+        compare_text_files(ascii_filename, src_filename);
+    }
+    {
+        // any size is tolerated, the fastest to decode is used
+        config.auto_gcode_compression = EAutoCompression::FastestDecoding;
+        config.auto_compression_candidates = 0xFFFFFFFF;
+        config.auto_compression_tolerance = 1000;
+        BinarizerStatistics statistics;
+        REQUIRE(convert(config, statistics) == EResult::Success);
+        REQUIRE(statistics.gcode_blocks[(size_t)ECompressionType::None] == count);
+    }
+    {
+        // no candidates
+        config.auto_compression_candidates = 0;
+        BinarizerStatistics statistics;
+        REQUIRE(convert(config, statistics) == EResult::InvalidCompressionType);
+    }
+}
+
+// Converts the given file with the given config, returns the size of the gcode blocks
+static uint64_t convert_gcode_blocks_size(const std::string& src_filename, const std::string& dst_filename, const BinarizerConfig& config)
+{
+    FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+    REQUIRE(src_file != nullptr);
+    ScopedFile scoped_src_file(src_file);
+    FILE* dst_file = boost::nowide::fopen(dst_filename.c_str(), "wb");
+    REQUIRE(dst_file != nullptr);
+    ScopedFile scoped_dst_file(dst_file);
+    BinarizerStatistics statistics;
+    REQUIRE(from_ascii_to_binary(*src_file, *dst_file, config, statistics) == EResult::Success);
+    return statistics.gcode_blocks_size;
+}
+
+TEST_CASE("Deflate parameters", "[Convert]")
+{
+    std::cout << "\nTEST: Deflate parameters\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+    const std::string dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_deflate.bgcode";
+    const std::string ascii_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_deflate.gcode";
+
+    BinarizerConfig config;
+    config.compression.slicer_metadata = ECompressionType::Deflate;
+    config.compression.gcode = ECompressionType::Deflate;
+    config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+
+    // the default parameters match zlib defaults
+    const uint64_t default_size = convert_gcode_blocks_size(src_filename, dst_filename, config);
+    config.deflate.gcode.level = 1;
+    const uint64_t fastest_size = convert_gcode_blocks_size(src_filename, dst_filename, config);
+    config.deflate.gcode.level = 9;
+    const uint64_t smallest_size = convert_gcode_blocks_size(src_filename, dst_filename, config);
+    REQUIRE(smallest_size <= default_size);
+    REQUIRE(default_size < fastest_size);
+
+    // any combination is decoded
+    for (EDeflateStrategy strategy : { EDeflateStrategy::Default, EDeflateStrategy::Filtered, EDeflateStrategy::RLE }) {
+        for (ECompressionType type : { ECompressionType::Deflate, ECompressionType::DeflateDictionary }) {
+            config.compression.gcode = type;
+            config.deflate.gcode = { 1, strategy, 1 };
+            config.deflate.metadata = { 9, strategy, 9 };
+            convert_gcode_blocks_size(src_filename, dst_filename, config);
+            binary_to_ascii(dst_filename, ascii_filename);
+            compare_text_files(ascii_filename, src_filename);
+        }
+    }
+
+    // invalid parameters
+    for (const DeflateParameters& parameters : { DeflateParameters{ 0, EDeflateStrategy::Default, 8 },
+        DeflateParameters{ 10, EDeflateStrategy::Default, 8 }, DeflateParameters{ 6, EDeflateStrategy::Default, 0 },
+        DeflateParameters{ 6, EDeflateStrategy::Default, 10 }, DeflateParameters{ 6, (EDeflateStrategy)3, 8 } }) {
+        config.deflate.gcode = parameters;
+        FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+        REQUIRE(src_file != nullptr);
+        ScopedFile scoped_src_file(src_file);
+        REQUIRE(from_ascii_to_binary(*src_file, [](const std::byte*, size_t) { return true; }, config) == EResult::InvalidCompressionType);
+    }
+}
+
+static std::pmr::string read_all_gcode(FILE& file, std::vector<long>& positions)
+{
+    std::pmr::string gcode;
+    FileHeader file_header;
+    REQUIRE(read_header(file, file_header, nullptr) == EResult::Success);
+    BlockHeader block_header;
+    while (read_next_block_header(file, file_header, block_header, EBlockType::GCode) == EResult::Success) {
+        positions.emplace_back(block_header.get_position());
+        GCodeBlock block;
+        REQUIRE(block.read_data(file, file_header, block_header) == EResult::Success);
+        gcode += block.raw_data;
+    }
+    return gcode;
+}
+
+TEST_CASE("Layer index", "[Convert]")
+{
+    std::cout << "\nTEST: Layer index\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+    const std::string dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_layers.bgcode";
+    const std::string ascii_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_layers.gcode";
+
+    BinarizerConfig config;
+    config.compression.gcode = ECompressionType::Heatshrink_12_4;
+    config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+
+    for (bool layer_aligned_blocks : { false, true }) {
+        config.layer_aligned_blocks = layer_aligned_blocks;
+        config.min_layer_block_size = 0;
+        LayerIndex index;
+        {
+            FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+            REQUIRE(src_file != nullptr);
+            ScopedFile scoped_src_file(src_file);
+            FILE* dst_file = boost::nowide::fopen(dst_filename.c_str(), "wb");
+            REQUIRE(dst_file != nullptr);
+            ScopedFile scoped_dst_file(dst_file);
+            REQUIRE(from_ascii_to_binary(*src_file, *dst_file, config, index) == EResult::Success);
+        }
+
+        // the gcode is not changed
+        binary_to_ascii(dst_filename, ascii_filename);
+        compare_text_files(ascii_filename, src_filename);
+
+        REQUIRE(index.size() == 120);
+        REQUIRE(index[0].z == 0.2f);
+        REQUIRE(index[1].z == 0.35f);
+        REQUIRE(find_layer(index, 0.3f) == 1);
+        REQUIRE(find_layer(index, 100.0f) == index.size());
+
+        FILE* file = boost::nowide::fopen(dst_filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        std::vector<long> positions;
+        const std::pmr::string gcode = read_all_gcode(*file, positions);
+
+        // the layers, in sequence, are the whole gcode following the first layer change
+        std::pmr::string layers;
+        for (size_t i = 0; i < index.size(); ++i) {
+            const LayerIndexEntry& entry = index[i];
+            REQUIRE(std::find(positions.begin(), positions.end(), (long)entry.block_position) != positions.end());
+            if (layer_aligned_blocks)
+                REQUIRE(entry.data_offset == 0);
+            std::pmr::string layer;
+            REQUIRE(read_layer_gcode(*file, index, i, layer) == EResult::Success);
+            REQUIRE(layer.rfind(";LAYER_CHANGE\n;Z:", 0) == 0);
+            layers += layer;
+        }
+        REQUIRE(gcode.size() > layers.size());
+        REQUIRE(std::string_view(gcode).substr(gcode.size() - layers.size()) == std::string_view(layers));
+        std::pmr::string layer;
+        REQUIRE(read_layer_gcode(*file, index, index.size(), layer) == EResult::BlockNotFound);
+        if (!layer_aligned_blocks)
+            REQUIRE(std::any_of(index.begin(), index.end(), [](const LayerIndexEntry& entry) { return entry.data_offset > 0; }));
+
+        // sidecar file
+        FILE* index_file = std::tmpfile();
+        REQUIRE(index_file != nullptr);
+        ScopedFile scoped_index_file(index_file);
+        REQUIRE(write_layer_index(*index_file, index) == EResult::Success);
+        rewind(index_file);
+        LayerIndex read_index;
+        REQUIRE(read_layer_index(*index_file, read_index) == EResult::Success);
+        REQUIRE(read_index.size() == index.size());
+        for (size_t i = 0; i < index.size(); ++i) {
+            REQUIRE(read_index[i].z == index[i].z);
+            REQUIRE(read_index[i].block_position == index[i].block_position);
+            REQUIRE(read_index[i].data_offset == index[i].data_offset);
+        }
+    }
+}
+
+void transcode(const std::string& src_filename, const std::string& dst_filename, const BinarizerConfig& config, size_t jobs)
+{
+    FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+    REQUIRE(src_file != nullptr);
+    ScopedFile scoped_src_file(src_file);
+    FILE* dst_file = boost::nowide::fopen(dst_filename.c_str(), "wb");
+    REQUIRE(dst_file != nullptr);
+    ScopedFile scoped_dst_file(dst_file);
+    REQUIRE(transcode(*src_file, *dst_file, config, jobs) == EResult::Success);
+}
+
+TEST_CASE("Transcode", "[Convert]")
+{
+    std::cout << "\nTEST: Transcode\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b.bgcode";
+    const std::string src_ascii_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b_transcode_ref.gcode";
+    const std::string dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b_transcode.bgcode";
+    const std::string dst_ascii_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b_transcode.gcode";
+    const std::string back_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b_transcode_back.bgcode";
+    binary_to_ascii(src_filename, src_ascii_filename);
+
+    // config of the source file
+    BinarizerConfig src_config;
+    src_config.compression.slicer_metadata = ECompressionType::Deflate;
+    src_config.compression.gcode = ECompressionType::Heatshrink_12_4;
+    src_config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+
+    // all the blocks are copied raw
+    transcode(src_filename, dst_filename, src_config, 2);
+    compare_binary_files(dst_filename, src_filename);
+
+    // the blocks already compressed with deflate are compressed again with the deflate parameters given explicitly
+    BinarizerConfig deflate_config = src_config;
+    deflate_config.compression.gcode = ECompressionType::Deflate;
+    transcode(src_filename, dst_filename, deflate_config, 2);
+    deflate_config.deflate.gcode.level = 1;
+    deflate_config.deflate.metadata.level = 1;
+    transcode(dst_filename, back_filename, deflate_config, 2);
+    REQUIRE(std::filesystem::file_size(std::filesystem::u8path(back_filename)) > std::filesystem::file_size(std::filesystem::u8path(dst_filename)));
+    binary_to_ascii(back_filename, dst_ascii_filename);
+    compare_text_files(dst_ascii_filename, src_ascii_filename);
+
+    std::vector<BinarizerConfig> configs(4);
+    configs[0].checksum = EChecksumType::CRC32;
+    configs[1].compression.gcode = ECompressionType::Heatshrink_11_4;
+    configs[1].gcode_encoding = EGCodeEncodingType::MeatPackComments;
+    configs[1].compression.printer_metadata = ECompressionType::Deflate;
+    configs[2] = src_config;
+    configs[2].checksum = EChecksumType::None;
+    configs[3].compression.file_metadata = ECompressionType::Heatshrink_12_4;
+    configs[3].compression.slicer_metadata = ECompressionType::Deflate;
+    configs[3].compression.gcode = ECompressionType::Deflate;
+    configs[3].gcode_encoding = EGCodeEncodingType::MeatPackComments;
+    for (size_t jobs : { 1, 3 }) {
+        for (const BinarizerConfig& config : configs) {
+            transcode(src_filename, dst_filename, config, jobs);
+            binary_to_ascii(dst_filename, dst_ascii_filename);
+            compare_text_files(dst_ascii_filename, src_ascii_filename);
+
+            // transcoding back gives a file with the same size of the source file
+            transcode(dst_filename, back_filename, src_config, jobs);
+            REQUIRE(std::filesystem::file_size(std::filesystem::u8path(back_filename)) == std::filesystem::file_size(std::filesystem::u8path(src_filename)));
+            binary_to_ascii(back_filename, dst_ascii_filename);
+            compare_text_files(dst_ascii_filename, src_ascii_filename);
+        }
+    }
+
+    // automatic compression, selected for each gcode block
+    BinarizerConfig auto_config = src_config;
+    auto_config.auto_gcode_compression = EAutoCompression::Smallest;
+    transcode(src_filename, dst_filename, auto_config, 2);
+    REQUIRE(std::filesystem::file_size(std::filesystem::u8path(dst_filename)) <= std::filesystem::file_size(std::filesystem::u8path(src_filename)));
+    binary_to_ascii(dst_filename, dst_ascii_filename);
+    compare_text_files(dst_ascii_filename, src_ascii_filename);
+    // any size is tolerated, all the gcode blocks are saved uncompressed
+    auto_config.auto_gcode_compression = EAutoCompression::FastestDecoding;
+    auto_config.auto_compression_tolerance = 1000;
+    transcode(src_filename, dst_filename, auto_config, 2);
+    BinarizerConfig none_config = src_config;
+    none_config.compression.gcode = ECompressionType::None;
+    transcode(src_filename, back_filename, none_config, 2);
+    compare_binary_files(dst_filename, back_filename);
+
+    // corrupted gcode block
+    std::vector<std::byte> data;
+    {
+        std::ifstream in(src_filename, std::ios::binary);
+        std::vector<char> chars((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        data.resize(chars.size());
+        std::memcpy(data.data(), chars.data(), chars.size());
+    }
+    data[data.size() - 10] ^= std::byte{ 0x01 };
+    FILE* src_file = std::tmpfile();
+    REQUIRE(src_file != nullptr);
+    ScopedFile scoped_src_file(src_file);
+    REQUIRE(fwrite(data.data(), 1, data.size(), src_file) == data.size());
+    rewind(src_file);
+    FILE* dst_file = std::tmpfile();
+    REQUIRE(dst_file != nullptr);
+    ScopedFile scoped_dst_file(dst_file);
+    REQUIRE(transcode(*src_file, *dst_file, configs[0], 2) == EResult::InvalidChecksum);
+}
+
+static std::vector<std::byte> read_file_data(const std::string& filename)
+{
+    std::ifstream in(std::filesystem::u8path(filename), std::ios::binary);
+    std::vector<char> chars((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::vector<std::byte> data(chars.size());
+    std::memcpy(data.data(), chars.data(), chars.size());
+    return data;
+}
+
+static std::string_view find_value(const BaseMetadataBlock& block, std::string_view key)
+{
+    for (const auto& [k, v] : block.raw_data) {
+        if (k == key)
+            return v;
+    }
+    return {};
+}
+
+// Saves a copy of the given gcode file with a few lines inserted at about a quarter of it, as sliced again after a small change
+static void write_modified_gcode(const std::string& src_filename, const std::string& dst_filename)
+{
+    std::ifstream src_file(src_filename, std::ios::binary);
+    REQUIRE(src_file.good());
+    std::string gcode((std::istreambuf_iterator<char>(src_file)), std::istreambuf_iterator<char>());
+    gcode.insert(gcode.find('\n', gcode.size() / 4) + 1, "; modified\nG1 X10 Y10 F600\n");
+    std::ofstream dst_file(dst_filename, std::ios::binary);
+    REQUIRE(dst_file.good());
+    dst_file << gcode;
+}
+
+// Returns the gcode blocks of the given binary gcode file, as saved into it
+static std::vector<std::vector<std::byte>> read_raw_gcode_blocks(const std::string& filename)
+{
+    const std::vector<std::byte> data = read_file_data(filename);
+    FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+    REQUIRE(file != nullptr);
+    ScopedFile scoped_file(file);
+    std::vector<long> positions;
+    read_all_gcode(*file, positions);
+    positions.emplace_back((long)data.size());
+    std::vector<std::vector<std::byte>> ret;
+    for (size_t i = 0; i + 1 < positions.size(); ++i) {
+        ret.emplace_back(data.begin() + positions[i], data.begin() + positions[i + 1]);
+    }
+    return ret;
+}
+
+// Returns the fraction of the gcode blocks of dst_filename found, byte by byte, into src_filename
+static double gcode_blocks_reuse_ratio(const std::string& src_filename, const std::string& dst_filename)
+{
+    std::vector<std::vector<std::byte>> src_blocks = read_raw_gcode_blocks(src_filename);
+    std::sort(src_blocks.begin(), src_blocks.end());
+    const std::vector<std::vector<std::byte>> dst_blocks = read_raw_gcode_blocks(dst_filename);
+    const size_t reused = std::count_if(dst_blocks.begin(), dst_blocks.end(),
+        [&src_blocks](const std::vector<std::byte>& block) { return std::binary_search(src_blocks.begin(), src_blocks.end(), block); });
+    return (double)reused / (double)dst_blocks.size();
+}
+
+TEST_CASE("Content defined blocks", "[Convert]")
+{
+    std::cout << "\nTEST: Content defined blocks\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+    const std::string modified_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_modified.gcode";
+    const std::string dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_cdc.bgcode";
+    const std::string modified_dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_modified_cdc.bgcode";
+    const std::string ascii_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_cdc.gcode";
+    write_modified_gcode(src_filename, modified_filename);
+
+    BinarizerConfig config;
+    config.compression.gcode = ECompressionType::Deflate;
+    config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+
+    // the fixed size blocks following the modified lines all change
+    ascii_to_binary(src_filename, dst_filename, config);
+    ascii_to_binary(modified_filename, modified_dst_filename, config);
+    const double fixed_ratio = gcode_blocks_reuse_ratio(dst_filename, modified_dst_filename);
+    REQUIRE(fixed_ratio < 0.5);
+
+    config.content_defined_blocks = true;
+    ascii_to_binary(src_filename, dst_filename, config);
+    ascii_to_binary(modified_filename, modified_dst_filename, config);
+    binary_to_ascii(dst_filename, ascii_filename);
+    compare_text_files(ascii_filename, src_filename);
+    const double content_defined_ratio = gcode_blocks_reuse_ratio(dst_filename, modified_dst_filename);
+    REQUIRE(content_defined_ratio > 0.8);
+
+    // the blocks respect the min and max sizes, but the last one
+    config.min_content_block_size = 8192;
+    config.max_content_block_size = 20000;
+    config.compression.gcode = ECompressionType::None;
+    config.gcode_encoding = EGCodeEncodingType::None;
+    ascii_to_binary(src_filename, dst_filename, config);
+    FILE* file = boost::nowide::fopen(dst_filename.c_str(), "rb");
+    REQUIRE(file != nullptr);
+    ScopedFile scoped_file(file);
+    FileHeader file_header;
+    REQUIRE(read_header(*file, file_header, nullptr) == EResult::Success);
+    std::vector<uint32_t> sizes;
+    BlockHeader block_header;
+    while (read_next_block_header(*file, file_header, block_header, EBlockType::GCode) == EResult::Success) {
+        sizes.emplace_back(block_header.uncompressed_size);
+        REQUIRE(skip_block(*file, file_header, block_header) == EResult::Success);
+    }
+    REQUIRE(sizes.size() > 2);
+    for (size_t i = 0; i + 1 < sizes.size(); ++i) {
+        REQUIRE(sizes[i] >= config.min_content_block_size);
+        REQUIRE(sizes[i] <= config.max_content_block_size);
+    }
+}
+
+TEST_CASE("Block patch", "[Convert]")
+{
+    std::cout << "\nTEST: Block patch\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+    const std::string modified_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_modified.gcode";
+    const std::string old_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_patch_old.bgcode";
+    const std::string new_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_patch_new.bgcode";
+    const std::string patch_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.patch";
+    const std::string rebuilt_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_patch_rebuilt.bgcode";
+    const std::string other_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_patch_other.bgcode";
+    write_modified_gcode(src_filename, modified_filename);
+
+    BinarizerConfig config;
+    config.compression.gcode = ECompressionType::Deflate;
+    config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+    config.content_defined_blocks = true;
+    ascii_to_binary(src_filename, old_filename, config);
+    ascii_to_binary(modified_filename, new_filename, config);
+
+    auto diff = [](const std::string& old_filename, const std::string& new_filename, const std::string& patch_filename) {
+        FILE* old_file = boost::nowide::fopen(old_filename.c_str(), "rb");
+        REQUIRE(old_file != nullptr);
+        ScopedFile scoped_old_file(old_file);
+        FILE* new_file = boost::nowide::fopen(new_filename.c_str(), "rb");
+        REQUIRE(new_file != nullptr);
+        ScopedFile scoped_new_file(new_file);
+        FILE* patch_file = boost::nowide::fopen(patch_filename.c_str(), "wb");
+        REQUIRE(patch_file != nullptr);
+        ScopedFile scoped_patch_file(patch_file);
+        PatchStatistics statistics;
+        REQUIRE(diff_binary_gcode(*old_file, *new_file, *patch_file, &statistics) == EResult::Success);
+        return statistics;
+    };
+    auto patch = [&rebuilt_filename](const std::string& old_filename, const std::string& patch_filename) {
+        FILE* old_file = boost::nowide::fopen(old_filename.c_str(), "rb");
+        REQUIRE(old_file != nullptr);
+        ScopedFile scoped_old_file(old_file);
+        FILE* patch_file = boost::nowide::fopen(patch_filename.c_str(), "rb");
+        REQUIRE(patch_file != nullptr);
+        ScopedFile scoped_patch_file(patch_file);
+        FILE* new_file = boost::nowide::fopen(rebuilt_filename.c_str(), "wb");
+        REQUIRE(new_file != nullptr);
+        ScopedFile scoped_new_file(new_file);
+        return apply_patch(*old_file, *patch_file, *new_file);
+    };
+
+    // only the blocks around the modified lines are saved into the patch
+    const uint64_t new_size = std::filesystem::file_size(std::filesystem::u8path(new_filename));
+    PatchStatistics statistics = diff(old_filename, new_filename, patch_filename);
+    REQUIRE(statistics.copied_size + statistics.inserted_size == new_size);
+    REQUIRE(statistics.patch_size == std::filesystem::file_size(std::filesystem::u8path(patch_filename)));
+    REQUIRE(statistics.inserted_blocks > 0);
+    REQUIRE(statistics.patch_size < new_size / 4);
+    REQUIRE(patch(old_filename, patch_filename) == EResult::Success);
+    compare_binary_files(rebuilt_filename, new_filename);
+
+    // the patch applies only to the file it was made from
+    REQUIRE(patch(new_filename, patch_filename) == EResult::InvalidBinaryGCodeFile);
+
+    // same size, different content, nothing is written
+    std::vector<std::byte> data = read_file_data(old_filename);
+    data[data.size() / 2] ^= std::byte{ 0x01 };
+    {
+        std::ofstream out(std::filesystem::u8path(other_filename), std::ios::binary);
+        out.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+    }
+    REQUIRE(patch(other_filename, patch_filename) == EResult::InvalidBinaryGCodeFile);
+    REQUIRE(std::filesystem::file_size(std::filesystem::u8path(rebuilt_filename)) == 0);
+
+    // corrupted inserted data, the header (20 bytes) is followed by the copy of the blocks in front of the modified lines
+    // (17 bytes) and by the inserted blocks
+    data = read_file_data(patch_filename);
+    REQUIRE(data[20] == std::byte{ 0 });
+    REQUIRE(data[37] == std::byte{ 1 });
+    data[54] ^= std::byte{ 0x01 };
+    {
+        std::ofstream out(std::filesystem::u8path(patch_filename), std::ios::binary);
+        out.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+    }
+    REQUIRE(patch(old_filename, patch_filename) == EResult::InvalidChecksum);
+
+    // identical files, a single copy
+    statistics = diff(new_filename, new_filename, patch_filename);
+    REQUIRE(statistics.inserted_blocks == 0);
+    REQUIRE(statistics.patch_size == 20 + 17 + 13);
+    REQUIRE(patch(new_filename, patch_filename) == EResult::Success);
+    compare_binary_files(rebuilt_filename, new_filename);
+}
+
+TEST_CASE("Edit metadata", "[Convert]")
+{
+    std::cout << "\nTEST: Edit metadata\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b.bgcode";
+    const std::string dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b_edit.bgcode";
+    const std::string back_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b_edit_back.bgcode";
+
+    auto edit = [](const std::string& src_filename, const std::string& dst_filename, const std::vector<MetadataEdit>& edits) {
+        FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+        REQUIRE(src_file != nullptr);
+        ScopedFile scoped_src_file(src_file);
+        FILE* dst_file = boost::nowide::fopen(dst_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+        return edit_metadata(*src_file, *dst_file, edits);
+    };
+    auto edit_in_place = [](const std::string& filename, const std::vector<MetadataEdit>& edits) {
+        FILE* file = boost::nowide::fopen(filename.c_str(), "r+b");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        bool edited = false;
+        REQUIRE(edit_metadata_in_place(*file, edits, edited) == EResult::Success);
+        return edited;
+    };
+    auto read = [](const std::string& filename, FileSummary& summary) {
+        FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        REQUIRE(is_valid_binary_gcode(*file, true) == EResult::Success);
+        REQUIRE(read_summary(*file, summary, true, false) == EResult::Success);
+    };
+
+    const std::vector<std::byte> src_data = read_file_data(src_filename);
+    FileSummary src_summary;
+    read(src_filename, src_summary);
+
+    SECTION("Edit into a new file")
+    {
+        const std::vector<MetadataEdit> edits = {
+            { EBlockType::PrinterMetadata, "filament_type", "PLA" },
+            { EBlockType::PrinterMetadata, "brim_width", "", true },
+            { EBlockType::FileMetadata, "job_id", "12345" },
+            { EBlockType::SlicerMetadata, "notes", "edited" }
+        };
+        REQUIRE(edit(src_filename, dst_filename, edits) == EResult::Success);
+
+        FileSummary summary;
+        read(dst_filename, summary);
+        REQUIRE(find_value(summary.printer_metadata, "filament_type") == "PLA");
+        REQUIRE(find_value(summary.printer_metadata, "brim_width").empty());
+        REQUIRE(summary.printer_metadata.raw_data.size() + 1 == src_summary.printer_metadata.raw_data.size());
+        REQUIRE(find_value(summary.file_metadata, "job_id") == "12345");
+        REQUIRE(summary.print_metadata.raw_data == src_summary.print_metadata.raw_data);
+
+        // the gcode blocks are copied raw
+        const std::vector<std::byte> dst_data = read_file_data(dst_filename);
+        REQUIRE(dst_data.size() - summary.gcode_position == src_data.size() - src_summary.gcode_position);
+        REQUIRE(std::equal(dst_data.begin() + summary.gcode_position, dst_data.end(), src_data.begin() + src_summary.gcode_position));
+    }
+
+    SECTION("Remove and insert the file metadata block")
+    {
+        REQUIRE(src_summary.file_metadata.raw_data.size() == 1);
+        const auto& [key, value] = src_summary.file_metadata.raw_data.front();
+        REQUIRE(edit(src_filename, dst_filename, { { EBlockType::FileMetadata, std::string(key), "", true } }) == EResult::Success);
+        FileSummary summary;
+        read(dst_filename, summary);
+        REQUIRE(summary.file_metadata.raw_data.empty());
+        REQUIRE(summary.gcode_position < src_summary.gcode_position);
+
+        // the file metadata block cannot be inserted in place
+        REQUIRE(!edit_in_place(dst_filename, { { EBlockType::FileMetadata, std::string(key), std::string(value) } }));
+        REQUIRE(edit(dst_filename, back_filename, { { EBlockType::FileMetadata, std::string(key), std::string(value) } }) == EResult::Success);
+        compare_binary_files(back_filename, src_filename);
+    }
+
+    SECTION("Edit in place")
+    {
+        std::filesystem::copy_file(std::filesystem::u8path(src_filename), std::filesystem::u8path(dst_filename),
+            std::filesystem::copy_options::overwrite_existing);
+
+        // same size
+        REQUIRE(edit_in_place(dst_filename, { { EBlockType::PrinterMetadata, "filament_type", "ASA_" } }));
+        FileSummary summary;
+        read(dst_filename, summary);
+        REQUIRE(find_value(summary.printer_metadata, "filament_type") == "ASA_");
+        REQUIRE(read_file_data(dst_filename).size() == src_data.size());
+
+        // different size, the file is not modified
+        const std::vector<std::byte> data = read_file_data(dst_filename);
+        REQUIRE(!edit_in_place(dst_filename, { { EBlockType::PrinterMetadata, "filament_type", "PLA" } }));
+        REQUIRE(read_file_data(dst_filename) == data);
+
+        // edit back
+        REQUIRE(edit_in_place(dst_filename, { { EBlockType::PrinterMetadata, "filament_type", "PETG" } }));
+        REQUIRE(read_file_data(dst_filename) == src_data);
+    }
+
+    SECTION("Invalid edits")
+    {
+        REQUIRE(edit(src_filename, dst_filename, { { EBlockType::Thumbnail, "width", "10" } }) == EResult::InvalidBlockType);
+
+        // the checksum of the edited blocks is verified
+        std::vector<std::byte> data = src_data;
+        const std::byte petg[] = { std::byte{ 'P' }, std::byte{ 'E' }, std::byte{ 'T' }, std::byte{ 'G' } };
+        auto it = std::search(data.begin(), data.end(), std::begin(petg), std::end(petg));
+        REQUIRE(it != data.end());
+        *it = std::byte{ 'p' };
+        FILE* src_file = std::tmpfile();
+        REQUIRE(src_file != nullptr);
+        ScopedFile scoped_src_file(src_file);
+        REQUIRE(fwrite(data.data(), 1, data.size(), src_file) == data.size());
+        FILE* dst_file = std::tmpfile();
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+        REQUIRE(edit_metadata(*src_file, *dst_file, { { EBlockType::PrinterMetadata, "filament_type", "PLA" } }) == EResult::InvalidChecksum);
+        // the print metadata block is not corrupted
+        rewind(dst_file);
+        REQUIRE(edit_metadata(*src_file, *dst_file, { { EBlockType::PrintMetadata, "filament_type", "PLA" } }) == EResult::Success);
+    }
+
+    SECTION("Edit a file containing slicer metadata in JSON format")
+    {
+        const std::string ascii_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_json.gcode";
+        const std::string json_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_json.bgcode";
+        const std::string json_ascii_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_json_edit.gcode";
+        const std::string json = "{\"layer_height\":0.15}";
+        {
+            std::ifstream in(std::filesystem::u8path(std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode"), std::ios::binary);
+            std::ofstream out(std::filesystem::u8path(ascii_filename), std::ios::binary);
+            out << in.rdbuf() << "; prusaslicer_json_config = begin\n" << json << "\n; prusaslicer_json_config = end\n";
+        }
+        BinarizerConfig config;
+        config.checksum = EChecksumType::CRC32;
+        ascii_to_binary(ascii_filename, json_filename, config);
+        const std::vector<std::byte> json_data = read_file_data(json_filename);
+        const std::byte* json_begin = reinterpret_cast<const std::byte*>(json.data());
+        REQUIRE(std::search(json_data.begin(), json_data.end(), json_begin, json_begin + json.size()) != json_data.end());
+
+        // the json block is copied untouched, the ini one is edited
+        auto check = [&](const std::string& filename, const std::string& layer_height) {
+            const std::vector<std::byte> data = read_file_data(filename);
+            REQUIRE(std::search(data.begin(), data.end(), json_begin, json_begin + json.size()) != data.end());
+            FileSummary summary;
+            read(filename, summary);
+            binary_to_ascii(filename, json_ascii_filename);
+            std::ifstream in(std::filesystem::u8path(json_ascii_filename), std::ios::binary);
+            const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            REQUIRE(text.find("\n; layer_height = " + layer_height + "\n") != std::string::npos);
+        };
+        REQUIRE(edit(json_filename, dst_filename, { { EBlockType::SlicerMetadata, "layer_height", "0.20" } }) == EResult::Success);
+        check(dst_filename, "0.20");
+        REQUIRE(edit_in_place(dst_filename, { { EBlockType::SlicerMetadata, "layer_height", "0.30" } }));
+        check(dst_filename, "0.30");
+        REQUIRE(edit_in_place(dst_filename, { { EBlockType::SlicerMetadata, "layer_height", "0.15" } }));
+        REQUIRE(read_file_data(dst_filename) == json_data);
+    }
+}
+
+TEST_CASE("Concatenate and split", "[Convert]")
+{
+    std::cout << "\nTEST: Concatenate and split\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b.bgcode";
+    const std::string concat_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b_concat.bgcode";
+    const std::string part1_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b_part1.bgcode";
+    const std::string part2_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b_part2.bgcode";
+    const std::string no_checksum_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b_no_checksum.bgcode";
+    const std::string ascii_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b_concat.gcode";
+    const std::string ref_ascii_filename = std::string(TEST_DATA_DIR) + "/mini_cube_b_concat_ref.gcode";
+
+    auto concat = [&concat_filename](const std::vector<std::string>& filenames) {
+        std::vector<FILE*> src_files;
+        for (const std::string& filename : filenames) {
+            src_files.emplace_back(boost::nowide::fopen(filename.c_str(), "rb"));
+            REQUIRE(src_files.back() != nullptr);
+        }
+        FILE* dst_file = boost::nowide::fopen(concat_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        const EResult res = concatenate(src_files, *dst_file);
+        fclose(dst_file);
+        for (FILE* file : src_files) {
+            fclose(file);
+        }
+        REQUIRE(res == EResult::Success);
+    };
+    auto extract = [](const std::string& src_filename, const std::string& dst_filename, size_t first_block, size_t blocks_count) {
+        FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+        REQUIRE(src_file != nullptr);
+        ScopedFile scoped_src_file(src_file);
+        FILE* dst_file = boost::nowide::fopen(dst_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+        return extract_gcode_blocks(*src_file, *dst_file, first_block, blocks_count);
+    };
+    auto count = [](const std::string& filename) {
+        FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        REQUIRE(is_valid_binary_gcode(*file, true) == EResult::Success);
+        size_t count = 0;
+        REQUIRE(count_gcode_blocks(*file, count) == EResult::Success);
+        return count;
+    };
+
+    const size_t blocks_count = count(src_filename);
+    REQUIRE(blocks_count == 10);
+
+    // a single file is copied as is
+    concat({ src_filename });
+    compare_binary_files(concat_filename, src_filename);
+
+    // split and merge back
+    REQUIRE(extract(src_filename, part1_filename, 0, 4) == EResult::Success);
+    REQUIRE(extract(src_filename, part2_filename, 4, 100) == EResult::Success);
+    REQUIRE(count(part1_filename) == 4);
+    REQUIRE(count(part2_filename) == 6);
+    concat({ part1_filename, part2_filename });
+    compare_binary_files(concat_filename, src_filename);
+    REQUIRE(extract(src_filename, part1_filename, 10, 1) == EResult::BlockNotFound);
+
+    // the halves of a file merged with itself are the file
+    concat({ src_filename, src_filename });
+    REQUIRE(count(concat_filename) == 2 * blocks_count);
+    REQUIRE(extract(concat_filename, part1_filename, 0, blocks_count) == EResult::Success);
+    compare_binary_files(part1_filename, src_filename);
+    REQUIRE(extract(concat_filename, part2_filename, blocks_count, blocks_count) == EResult::Success);
+    compare_binary_files(part2_filename, src_filename);
+    binary_to_ascii(concat_filename, ref_ascii_filename);
+
+    // the blocks of files with a different checksum type get a new checksum
+    BinarizerConfig config;
+    config.checksum = EChecksumType::None;
+    config.compression.gcode = ECompressionType::Heatshrink_12_4;
+    config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+    transcode(src_filename, no_checksum_filename, config, 1);
+    concat({ src_filename, no_checksum_filename });
+    REQUIRE(count(concat_filename) == 2 * blocks_count);
+    binary_to_ascii(concat_filename, ascii_filename);
+    compare_text_files(ascii_filename, ref_ascii_filename);
+}
+
+static GCodeBlockIndex read_index(FILE& file, EResult expected_result = EResult::Success)
+{
+    FileHeader file_header;
+    REQUIRE(read_header(file, file_header, nullptr) == EResult::Success);
+    std::array<std::byte, 4096> cs_buffer;
+    GCodeBlockIndex index;
+    REQUIRE(read_gcode_block_index(file, file_header, index, cs_buffer.data(), cs_buffer.size()) == expected_result);
+    return index;
+}
+
+TEST_CASE("Index block", "[Convert]")
+{
+    std::cout << "\nTEST: Index block\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+    const std::string dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_index.bgcode";
+    const std::string ascii_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_index.gcode";
+    const std::string edit_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_index_edit.bgcode";
+    const std::string transcode_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_index_transcode.bgcode";
+    const std::string part_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_index_part.bgcode";
+
+    BinarizerConfig config;
+    config.compression.gcode = ECompressionType::Heatshrink_12_4;
+    config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+    config.layer_aligned_blocks = true;
+    config.index_block = true;
+    LayerIndex layer_index;
+    {
+        FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+        REQUIRE(src_file != nullptr);
+        ScopedFile scoped_src_file(src_file);
+        FILE* dst_file = boost::nowide::fopen(dst_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+        REQUIRE(from_ascii_to_binary(*src_file, *dst_file, config, layer_index) == EResult::Success);
+    }
+
+    // the gcode is not changed
+    binary_to_ascii(dst_filename, ascii_filename);
+    compare_text_files(ascii_filename, src_filename);
+
+    // checks the file and returns its index
+    auto check = [](const std::string& filename, EResult expected_result = EResult::Success) {
+        FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        std::array<std::byte, 4096> cs_buffer;
+        REQUIRE(is_valid_binary_gcode(*file, true, cs_buffer.data(), cs_buffer.size()) == EResult::Success);
+        return read_index(*file, expected_result);
+    };
+
+    const GCodeBlockIndex index = check(dst_filename);
+    FILE* file = boost::nowide::fopen(dst_filename.c_str(), "rb");
+    REQUIRE(file != nullptr);
+    ScopedFile scoped_file(file);
+    FileHeader file_header;
+    REQUIRE(read_header(*file, file_header, nullptr) == EResult::Success);
+
+    // the index matches the gcode blocks
+    std::vector<long> positions;
+    const std::pmr::string gcode = read_all_gcode(*file, positions);
+    REQUIRE(index.size() == positions.size());
+    REQUIRE(index.size() > 2);
+    uint64_t first_line = 0;
+    uint64_t data_offset = 0;
+    for (size_t i = 0; i < index.size(); ++i) {
+        REQUIRE(index[i].position == (uint64_t)positions[i]);
+        REQUIRE(index[i].first_line == first_line);
+        REQUIRE(index[i].data_offset == data_offset);
+        BlockHeader block_header;
+        REQUIRE(read_gcode_block_header(*file, file_header, index, i, block_header) == EResult::Success);
+        REQUIRE(block_header.get_position() == positions[i]);
+        GCodeBlock block;
+        REQUIRE(block.read_data(*file, file_header, block_header) == EResult::Success);
+        REQUIRE(std::string_view(gcode).substr(data_offset, block.raw_data.size()) == std::string_view(block.raw_data));
+        first_line += std::count(block.raw_data.begin(), block.raw_data.end(), '\n');
+        data_offset += block.raw_data.size();
+    }
+    BlockHeader block_header;
+    REQUIRE(read_gcode_block_header(*file, file_header, index, index.size(), block_header) == EResult::BlockNotFound);
+    REQUIRE(find_gcode_block_by_offset(index, 0) == 0);
+    REQUIRE(find_gcode_block_by_offset(index, index[2].data_offset + 1) == 2);
+    REQUIRE(find_gcode_block_by_offset(index, data_offset - 1) == index.size() - 1);
+    REQUIRE(find_gcode_block_by_line(index, index[1].first_line) == 1);
+    REQUIRE(find_gcode_block_by_line(index, index[2].first_line - 1) == 1);
+
+    // the layer index accounts for the index block
+    for (const LayerIndexEntry& entry : layer_index) {
+        REQUIRE(std::find(positions.begin(), positions.end(), (long)entry.block_position) != positions.end());
+    }
+
+    // the index is moved together with the gcode blocks
+    {
+        FILE* dst_file = boost::nowide::fopen(edit_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+        REQUIRE(edit_metadata(*file, *dst_file, { { EBlockType::PrinterMetadata, "filament_type", "a long filament name" } }) == EResult::Success);
+    }
+    const GCodeBlockIndex edited_index = check(edit_filename);
+    REQUIRE(edited_index.size() == index.size());
+    REQUIRE(edited_index[0].position > index[0].position);
+    for (size_t i = 0; i < index.size(); ++i) {
+        REQUIRE(edited_index[i].position - index[i].position == edited_index[0].position - index[0].position);
+        REQUIRE(edited_index[i].first_line == index[i].first_line);
+        REQUIRE(edited_index[i].data_offset == index[i].data_offset);
+    }
+
+    // the index is dropped when the gcode blocks change
+    config.compression.gcode = ECompressionType::Deflate;
+    transcode(dst_filename, transcode_filename, config, 1);
+    check(transcode_filename, EResult::BlockNotFound);
+    {
+        FILE* dst_file = boost::nowide::fopen(part_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+        REQUIRE(extract_gcode_blocks(*file, *dst_file, 1, 1) == EResult::Success);
+    }
+    check(part_filename, EResult::BlockNotFound);
+
+    // the index block requires version 2, rejected by the readers of version 1
+    REQUIRE(file_header.version == 2);
+    REQUIRE(block_type_version(EBlockType::Index) == 2);
+    const uint32_t max_version = 1;
+    rewind(file);
+    REQUIRE(read_header(*file, file_header, &max_version) == EResult::InvalidVersionNumber);
+    std::vector<std::byte> data = read_file_data(dst_filename);
+    data[4] = std::byte{ 1 };
+    FILE* v1_file = std::tmpfile();
+    REQUIRE(v1_file != nullptr);
+    ScopedFile scoped_v1_file(v1_file);
+    REQUIRE(fwrite(data.data(), 1, data.size(), v1_file) == data.size());
+    rewind(v1_file);
+    REQUIRE(is_valid_binary_gcode(*v1_file, true) == EResult::InvalidBlockType);
+
+    // the size of the index block is checked against the size of the file before allocating the entries
+    data[4] = std::byte{ 2 };
+    const size_t index_position = (size_t)index[0].position - (8 + 2 + index.size() * 24 + 4);
+    REQUIRE(data[index_position] == std::byte{ (uint8_t)EBlockType::Index });
+    const uint32_t huge_size = 24u * 0x8000000u;
+    std::memcpy(data.data() + index_position + 4, &huge_size, sizeof(huge_size));
+    FILE* huge_file = std::tmpfile();
+    REQUIRE(huge_file != nullptr);
+    ScopedFile scoped_huge_file(huge_file);
+    REQUIRE(fwrite(data.data(), 1, data.size(), huge_file) == data.size());
+    rewind(huge_file);
+    REQUIRE(read_header(*huge_file, file_header, nullptr) == EResult::Success);
+    GCodeBlockIndex huge_index;
+    REQUIRE(read_gcode_block_index(*huge_file, file_header, huge_index) == EResult::ReadError);
+    REQUIRE(huge_index.empty());
+}
+
+// Returns the checksums closing the blocks of the given file, but the hash tree block
+static HashTreeLeaves read_block_checksums(FILE& file)
+{
+    FileHeader file_header;
+    REQUIRE(read_header(file, file_header, nullptr) == EResult::Success);
+    long position = ftell(&file);
+    fseek(&file, 0, SEEK_END);
+    const long file_size = ftell(&file);
+    HashTreeLeaves checksums;
+    BlockHeader block_header;
+    while (position < file_size) {
+        REQUIRE(fseek(&file, position, SEEK_SET) == 0);
+        REQUIRE(read_next_block_header(file, file_header, block_header) == EResult::Success);
+        position += (long)(block_header.get_size() + block_content_size(file_header, block_header));
+        if ((EBlockType)block_header.type == EBlockType::HashTree)
+            continue;
+        uint32_t checksum;
+        REQUIRE(fseek(&file, position - (long)sizeof(checksum), SEEK_SET) == 0);
+        REQUIRE(fread(&checksum, 1, sizeof(checksum), &file) == sizeof(checksum));
+        checksums.emplace_back(checksum);
+    }
+    return checksums;
+}
+
+TEST_CASE("Hash tree block", "[Convert]")
+{
+    std::cout << "\nTEST: Hash tree block\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+    const std::string dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_hash_tree.bgcode";
+    const std::string ascii_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_hash_tree.gcode";
+    const std::string edit_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_hash_tree_edit.bgcode";
+    const std::string corrupted_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_hash_tree_corrupted.bgcode";
+    const std::string transcode_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_hash_tree_transcode.bgcode";
+
+    BinarizerConfig config;
+    config.compression.gcode = ECompressionType::Deflate;
+    config.checksum = EChecksumType::CRC32C;
+    config.layer_aligned_blocks = true;
+    config.index_block = true;
+    config.hash_tree_block = true;
+    ascii_to_binary(src_filename, dst_filename, config);
+
+    // the gcode is not changed
+    binary_to_ascii(dst_filename, ascii_filename);
+    compare_text_files(ascii_filename, src_filename);
+
+    // checks the file and returns the leaves of its hash tree
+    auto check = [](const std::string& filename, EResult expected_result = EResult::Success) {
+        FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        std::array<std::byte, 4096> cs_buffer;
+        REQUIRE(is_valid_binary_gcode(*file, true, cs_buffer.data(), cs_buffer.size()) == EResult::Success);
+        FileHeader file_header;
+        REQUIRE(read_header(*file, file_header, nullptr) == EResult::Success);
+        HashTreeLeaves leaves;
+        REQUIRE(read_hash_tree(*file, file_header, leaves, cs_buffer.data(), cs_buffer.size()) == expected_result);
+        if (expected_result == EResult::Success) {
+            // the hash tree covers all the other blocks
+            REQUIRE(leaves == read_block_checksums(*file));
+            REQUIRE(verify_blocks(*file) == EResult::Success);
+        }
+        return leaves;
+    };
+
+    const HashTreeLeaves leaves = check(dst_filename);
+    FILE* file = boost::nowide::fopen(dst_filename.c_str(), "rb");
+    REQUIRE(file != nullptr);
+    ScopedFile scoped_file(file);
+    size_t blocks_count = 0;
+    REQUIRE(count_gcode_blocks(*file, blocks_count) == EResult::Success);
+    REQUIRE(blocks_count > 4);
+
+    // the index accounts for the hash tree block
+    std::vector<long> positions;
+    read_all_gcode(*file, positions);
+    const GCodeBlockIndex index = read_index(*file);
+    REQUIRE(index.size() == positions.size());
+    for (size_t i = 0; i < index.size(); ++i) {
+        REQUIRE(index[i].position == (uint64_t)positions[i]);
+    }
+
+    // the root depends on all the leaves
+    REQUIRE(hash_tree_root(HashTreeLeaves()) == 0);
+    REQUIRE(hash_tree_root(HashTreeLeaves(1, 0x12345678)) == 0x12345678);
+    const uint32_t root = hash_tree_root(leaves);
+    for (size_t i = 0; i < leaves.size(); ++i) {
+        HashTreeLeaves modified = leaves;
+        modified[i] ^= 1;
+        REQUIRE(hash_tree_root(modified) != root);
+    }
+
+    // block ranges, with any count of threads
+    for (size_t jobs : { 1, 2, 8 }) {
+        REQUIRE(verify_blocks(*file, 0, SIZE_MAX, jobs) == EResult::Success);
+        REQUIRE(verify_blocks(*file, 1, 2, jobs) == EResult::Success);
+        REQUIRE(verify_blocks(*file, blocks_count - 1, 10, jobs) == EResult::Success);
+    }
+    REQUIRE(verify_blocks(*file, blocks_count, 1) == EResult::BlockNotFound);
+    REQUIRE(verify_blocks(*file, 0, 0) == EResult::BlockNotFound);
+
+    // the hash tree is checked against the expected root, if given
+    REQUIRE(verify_blocks(*file, 0, SIZE_MAX, 2, &root) == EResult::Success);
+    const uint32_t wrong_root = root ^ 1;
+    REQUIRE(verify_blocks(*file, 1, 2, 2, &wrong_root) == EResult::InvalidHashTree);
+
+    // a corrupted gcode block is detected only when it is part of the range
+    std::vector<std::byte> data = read_file_data(dst_filename);
+    auto save_data = [&]() {
+        FILE* dst_file = boost::nowide::fopen(corrupted_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+        REQUIRE(fwrite(data.data(), 1, data.size(), dst_file) == data.size());
+    };
+    data[positions[2] + 20] ^= std::byte{ 0x01 };
+    save_data();
+    {
+        FILE* corrupted_file = boost::nowide::fopen(corrupted_filename.c_str(), "rb");
+        REQUIRE(corrupted_file != nullptr);
+        ScopedFile scoped_corrupted_file(corrupted_file);
+        REQUIRE(verify_blocks(*corrupted_file, 0, SIZE_MAX, 4) == EResult::InvalidChecksum);
+        REQUIRE(verify_blocks(*corrupted_file, 2, 1, 4) == EResult::InvalidChecksum);
+        REQUIRE(verify_blocks(*corrupted_file, 3, SIZE_MAX, 4) == EResult::Success);
+        REQUIRE(verify_blocks(*corrupted_file, 0, 2, 4) == EResult::Success);
+    }
+    data[positions[2] + 20] ^= std::byte{ 0x01 };
+
+    // a truncated file, as partially downloaded, is verified up to its last complete gcode block
+    for (const long size : { positions[3] + 1, positions[3] - 1 }) {
+        data.resize((size_t)size);
+        save_data();
+        FILE* truncated_file = boost::nowide::fopen(corrupted_filename.c_str(), "rb");
+        REQUIRE(truncated_file != nullptr);
+        ScopedFile scoped_truncated_file(truncated_file);
+        size_t available_blocks_count = 0;
+        REQUIRE(verify_blocks(*truncated_file, 0, 2, 2, &root, &available_blocks_count) == EResult::Success);
+        REQUIRE(available_blocks_count == ((size == positions[3] + 1) ? 3 : 2));
+        REQUIRE(verify_blocks(*truncated_file, 0, SIZE_MAX, 2, &root, &available_blocks_count) == EResult::BlockNotFound);
+        REQUIRE(verify_blocks(*truncated_file, blocks_count - 1, 1) == EResult::BlockNotFound);
+        REQUIRE(verify_blocks(*truncated_file, blocks_count, 1) == EResult::BlockNotFound);
+    }
+    data = read_file_data(dst_filename);
+    {
+        // a corrupted block is detected also when blocks are missing
+        data[positions[1] + 20] ^= std::byte{ 0x01 };
+        data.resize((size_t)positions[3]);
+        save_data();
+        FILE* truncated_file = boost::nowide::fopen(corrupted_filename.c_str(), "rb");
+        REQUIRE(truncated_file != nullptr);
+        ScopedFile scoped_truncated_file(truncated_file);
+        REQUIRE(verify_blocks(*truncated_file) == EResult::InvalidChecksum);
+    }
+    data = read_file_data(dst_filename);
+
+    // a leaf not matching its block is detected, even if the hash tree block itself is valid
+    {
+        HashTreeLeaves modified = leaves;
+        modified[modified.size() - 1] ^= 1;
+        std::pmr::vector<uint8_t> block;
+        REQUIRE(write_hash_tree(modified, config.checksum, block) == EResult::Success);
+        FileHeader file_header;
+        REQUIRE(read_header(*file, file_header, nullptr) == EResult::Success);
+        BlockHeader block_header;
+        REQUIRE(read_next_block_header(*file, file_header, block_header, EBlockType::HashTree) == EResult::Success);
+        std::memcpy(data.data() + block_header.get_position(), block.data(), block.size());
+        save_data();
+        FILE* corrupted_file = boost::nowide::fopen(corrupted_filename.c_str(), "rb");
+        REQUIRE(corrupted_file != nullptr);
+        ScopedFile scoped_corrupted_file(corrupted_file);
+        REQUIRE(is_valid_binary_gcode(*corrupted_file, true) == EResult::InvalidHashTree);
+        REQUIRE(verify_blocks(*corrupted_file, 0, blocks_count - 1) == EResult::Success);
+        REQUIRE(verify_blocks(*corrupted_file) == EResult::InvalidChecksum);
+        // the modified leaf is detected by the root, also when its block is not part of the range
+        REQUIRE(verify_blocks(*corrupted_file, 0, blocks_count - 1, 0, &root) == EResult::InvalidHashTree);
+    }
+
+    // the hash tree is updated by the metadata editors
+    {
+        FILE* dst_file = boost::nowide::fopen(edit_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+        REQUIRE(edit_metadata(*file, *dst_file, { { EBlockType::PrinterMetadata, "filament_type", "a long filament name" },
+            { EBlockType::FileMetadata, "Producer", "", true } }) == EResult::Success);
+    }
+    // the file metadata block is dropped once empty
+    REQUIRE(check(edit_filename).size() == leaves.size() - 1);
+    {
+        FILE* edit_file = boost::nowide::fopen(edit_filename.c_str(), "rb+");
+        REQUIRE(edit_file != nullptr);
+        ScopedFile scoped_edit_file(edit_file);
+        bool edited = false;
+        REQUIRE(edit_metadata_in_place(*edit_file, { { EBlockType::PrinterMetadata, "filament_type", "a long filament nam3" } }, edited) == EResult::Success);
+        REQUIRE(edited);
+    }
+    check(edit_filename);
+    {
+        FILE* edit_file = boost::nowide::fopen(edit_filename.c_str(), "rb");
+        REQUIRE(edit_file != nullptr);
+        ScopedFile scoped_edit_file(edit_file);
+        FILE* dst_file = boost::nowide::fopen(corrupted_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+        REQUIRE(edit_metadata(*edit_file, *dst_file, { { EBlockType::FileMetadata, "Producer", "Test" } }) == EResult::Success);
+    }
+    // the file metadata block is inserted
+    REQUIRE(check(corrupted_filename).size() == leaves.size());
+
+    // the hash tree is dropped when the blocks change
+    transcode(dst_filename, transcode_filename, config, 2);
+    check(transcode_filename, EResult::BlockNotFound);
+
+    // a hash tree requires 4 bytes checksums
+    config.checksum = EChecksumType::None;
+    FILE* src_file = boost::nowide::fopen(src_filename.c_str(), "rb");
+    REQUIRE(src_file != nullptr);
+    ScopedFile scoped_src_file(src_file);
+    FILE* dst_file = boost::nowide::fopen(transcode_filename.c_str(), "wb");
+    REQUIRE(dst_file != nullptr);
+    ScopedFile scoped_dst_file(dst_file);
+    REQUIRE(from_ascii_to_binary(*src_file, *dst_file, config) == EResult::InvalidChecksumType);
+}
+
+TEST_CASE("Validation report", "[Convert]")
+{
+    std::cout << "\nTEST: Validation report\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+    const std::string dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_validation.bgcode";
+    const std::string corrupted_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_validation_corrupted.bgcode";
+
+    BinarizerConfig config;
+    config.compression.gcode = ECompressionType::Deflate;
+    config.checksum = EChecksumType::CRC32C;
+    config.index_block = true;
+    config.hash_tree_block = true;
+    ascii_to_binary(src_filename, dst_filename, config);
+
+    auto validate = [](const std::string& filename, size_t jobs, bool decode_blocks = true) {
+        FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        ValidationReport report;
+        REQUIRE(validate_binary_gcode(*file, report, jobs, decode_blocks) == report.result);
+        return report;
+    };
+
+    // the report lists all the blocks, with the same outcome for any count of threads
+    const ValidationReport report = validate(dst_filename, 1);
+    REQUIRE(report.result == EResult::Success);
+    REQUIRE(report.checksum_type == EChecksumType::CRC32C);
+    std::vector<long> positions;
+    {
+        FILE* file = boost::nowide::fopen(dst_filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        read_all_gcode(*file, positions);
+        FileHeader file_header;
+        REQUIRE(read_header(*file, file_header, nullptr) == EResult::Success);
+        REQUIRE(report.blocks.size() == read_block_checksums(*file).size() + 1);
+    }
+    REQUIRE(report.blocks.front().offset == 10);
+    REQUIRE(report.blocks.front().type == EBlockType::FileMetadata);
+    size_t gcode_blocks_count = 0;
+    for (const BlockReport& block : report.blocks) {
+        REQUIRE(block.checksum == EResult::Success);
+        REQUIRE(block.decoding == EResult::Success);
+        if (block.type == EBlockType::GCode) {
+            REQUIRE(block.offset == (uint64_t)positions[gcode_blocks_count++]);
+            REQUIRE(block.compression == ECompressionType::Deflate);
+            REQUIRE(block.compressed_size < block.uncompressed_size);
+        }
+    }
+    REQUIRE(gcode_blocks_count == positions.size());
+    for (size_t jobs : { 2, 8 }) {
+        const ValidationReport other = validate(dst_filename, jobs);
+        REQUIRE(other.result == EResult::Success);
+        REQUIRE(other.blocks.size() == report.blocks.size());
+        for (size_t i = 0; i < report.blocks.size(); ++i) {
+            REQUIRE(other.blocks[i].offset == report.blocks[i].offset);
+            REQUIRE(other.blocks[i].encoding == report.blocks[i].encoding);
+        }
+    }
+    REQUIRE(validate(std::string(TEST_DATA_DIR) + "/mini_cube_b.bgcode", 4).result == EResult::Success);
+
+    std::vector<std::byte> data = read_file_data(dst_filename);
+    auto save_data = [&](size_t size) {
+        FILE* dst_file = boost::nowide::fopen(corrupted_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+        REQUIRE(fwrite(data.data(), 1, size, dst_file) == size);
+    };
+
+    // a corrupted gcode block fails both the checksum and the uncompression, the other blocks are still checked
+    const size_t corrupted_block = report.blocks.size() - 2;
+    data[positions[positions.size() - 2] + 40] ^= std::byte{ 0x01 };
+    save_data(data.size());
+    for (size_t jobs : { 1, 4 }) {
+        const ValidationReport corrupted = validate(corrupted_filename, jobs);
+        REQUIRE(corrupted.result == EResult::InvalidChecksum);
+        REQUIRE(corrupted.blocks.size() == report.blocks.size());
+        for (size_t i = 0; i < corrupted.blocks.size(); ++i) {
+            REQUIRE((corrupted.blocks[i].checksum == EResult::InvalidChecksum) == (i == corrupted_block));
+            REQUIRE((corrupted.blocks[i].decoding != EResult::Success) == (i == corrupted_block));
+        }
+    }
+    const ValidationReport not_decoded = validate(corrupted_filename, 4, false);
+    REQUIRE(not_decoded.result == EResult::InvalidChecksum);
+    REQUIRE(not_decoded.blocks[corrupted_block].decoding == EResult::Success);
+    data[positions[positions.size() - 2] + 40] ^= std::byte{ 0x01 };
+
+    // a truncated file reports the blocks preceding the truncation
+    save_data((size_t)positions.back() + 20);
+    const ValidationReport truncated = validate(corrupted_filename, 4, false);
+    REQUIRE(truncated.result == EResult::ReadError);
+    REQUIRE(truncated.blocks.size() == report.blocks.size() - 1);
+
+    // blocks out of sequence
+    std::vector<std::byte> file_metadata(data.begin() + 10, data.begin() + (long)report.blocks[1].offset);
+    data.insert(data.end(), file_metadata.begin(), file_metadata.end());
+    save_data(data.size());
+    const ValidationReport out_of_sequence = validate(corrupted_filename, 4, false);
+    REQUIRE(out_of_sequence.result == EResult::InvalidSequenceOfBlocks);
+    REQUIRE(out_of_sequence.blocks.size() == report.blocks.size() + 1);
+    REQUIRE(out_of_sequence.blocks.back().type == EBlockType::FileMetadata);
+}
+
+TEST_CASE("Append gcode", "[Convert]")
+{
+    std::cout << "\nTEST: Append gcode\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+    const std::string dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_append.bgcode";
+    const std::string index_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_append_index.bgcode";
+
+    BinarizerConfig config;
+    config.compression.gcode = ECompressionType::Heatshrink_12_4;
+    config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+    config.checksum = EChecksumType::CRC32C;
+    ascii_to_binary(src_filename, dst_filename, config);
+
+    std::vector<long> positions;
+    std::string gcode;
+    {
+        FILE* file = boost::nowide::fopen(dst_filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        gcode = std::string_view(read_all_gcode(*file, positions));
+    }
+    const std::vector<std::byte> data = read_file_data(dst_filename);
+
+    // the gcode of the first layers, appended twice
+    const size_t appended_size = gcode.find('\n', gcode.size() / 2) + 1;
+    const std::string appended(gcode.substr(0, appended_size));
+
+    BinarizerConfig append_config;
+    append_config.compression.gcode = ECompressionType::Deflate;
+    append_config.checksum = EChecksumType::CRC32;
+    {
+        FILE* file = boost::nowide::fopen(dst_filename.c_str(), "r+b");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        GCodeAppender appender;
+        REQUIRE(appender.append_gcode(appended) == EResult::WriteError);
+        REQUIRE(appender.open(*file, append_config) == EResult::Success);
+        REQUIRE(appender.get_gcode_blocks_count() == positions.size());
+        REQUIRE(appender.append_gcode(appended) == EResult::Success);
+        REQUIRE(appender.append_gcode(appended) == EResult::Success);
+        REQUIRE(appender.finalize() == EResult::Success);
+        REQUIRE(appender.get_gcode_blocks_count() > positions.size());
+        REQUIRE(!appender.get_layer_index().empty());
+        REQUIRE(appender.get_layer_index().front().block_position >= data.size());
+    }
+
+    // the existing blocks are untouched
+    const std::vector<std::byte> appended_data = read_file_data(dst_filename);
+    REQUIRE(appended_data.size() > data.size());
+    REQUIRE(std::equal(data.begin(), data.end(), appended_data.begin()));
+
+    // the new blocks follow the old ones, with the new compression and the checksum type of the file
+    {
+        FILE* file = boost::nowide::fopen(dst_filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        REQUIRE(is_valid_binary_gcode(*file, true) == EResult::Success);
+        std::vector<long> appended_positions;
+        REQUIRE(std::string_view(read_all_gcode(*file, appended_positions)) == gcode + appended + appended);
+        ValidationReport report;
+        REQUIRE(validate_binary_gcode(*file, report) == EResult::Success);
+        REQUIRE(report.checksum_type == EChecksumType::CRC32C);
+        for (const BlockReport& block : report.blocks) {
+            if (block.type == EBlockType::GCode)
+                REQUIRE(block.compression == ((block.offset < data.size()) ? ECompressionType::Heatshrink_12_4 : ECompressionType::Deflate));
+        }
+    }
+
+    // the print metadata are rewritten in place only if they keep their size
+    {
+        FILE* file = boost::nowide::fopen(dst_filename.c_str(), "r+b");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        GCodeAppender appender;
+        REQUIRE(appender.open(*file, append_config) == EResult::Success);
+        REQUIRE(appender.append_gcode(appended) == EResult::Success);
+        REQUIRE(appender.finalize() == EResult::Success);
+        bool edited = true;
+        REQUIRE(appender.update_metadata({ { EBlockType::PrintMetadata, "estimated printing time (normal mode)", "a much longer time" } },
+            edited) == EResult::Success);
+        REQUIRE(!edited);
+        REQUIRE(appender.update_metadata({ { EBlockType::PrintMetadata, "estimated printing time (normal mode)", "33m 7s" } },
+            edited) == EResult::Success);
+        REQUIRE(edited);
+    }
+    {
+        FILE* file = boost::nowide::fopen(dst_filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        REQUIRE(is_valid_binary_gcode(*file, true) == EResult::Success);
+        std::vector<long> appended_positions;
+        REQUIRE(std::string_view(read_all_gcode(*file, appended_positions)) == gcode + appended + appended + appended);
+        FileHeader file_header;
+        REQUIRE(read_header(*file, file_header, nullptr) == EResult::Success);
+        BlockHeader block_header;
+        REQUIRE(read_next_block_header(*file, file_header, block_header, EBlockType::PrintMetadata) == EResult::Success);
+        PrintMetadataBlock block;
+        REQUIRE(block.read_data(*file, file_header, block_header) == EResult::Success);
+        REQUIRE(find_value(block, "estimated printing time (normal mode)") == "33m 7s");
+    }
+
+    // the index block would have to grow
+    config.index_block = true;
+    ascii_to_binary(src_filename, index_filename, config);
+    FILE* file = boost::nowide::fopen(index_filename.c_str(), "r+b");
+    REQUIRE(file != nullptr);
+    ScopedFile scoped_file(file);
+    GCodeAppender appender;
+    REQUIRE(appender.open(*file, append_config) == EResult::InvalidSequenceOfBlocks);
+}
+
+TEST_CASE("File version", "[Convert]")
+{
+    std::cout << "\nTEST: File version\n";
+
+    const std::string src_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a.gcode";
+    const std::string v1_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_version_1.bgcode";
+    const std::string v2_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_version_2.bgcode";
+    const std::string dst_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_version.bgcode";
+    const std::string ascii_filename = std::string(TEST_DATA_DIR) + "/mini_cube_a_version.gcode";
+
+    auto read_version = [](const std::string& filename) {
+        FILE* file = boost::nowide::fopen(filename.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        FileHeader file_header;
+        REQUIRE(read_header(*file, file_header, nullptr) == EResult::Success);
+        return file_header.version;
+    };
+
+    // the tokenized and the columnar encodings require version 2
+    BinarizerConfig config;
+    ascii_to_binary(src_filename, v1_filename, config);
+    REQUIRE(read_version(v1_filename) == 1);
+    for (EGCodeEncodingType encoding : { EGCodeEncodingType::Tokenized, EGCodeEncodingType::Columnar }) {
+        config.gcode_encoding = encoding;
+        REQUIRE(gcode_encoding_version(encoding) == 2);
+        ascii_to_binary(src_filename, v2_filename, config);
+        REQUIRE(read_version(v2_filename) == 2);
+        binary_to_ascii(v2_filename, ascii_filename);
+        compare_text_files(ascii_filename, src_filename);
+    }
+
+    // the readers of version 2 reject their gcode blocks in files of version 1
+    std::vector<std::byte> data = read_file_data(v2_filename);
+    data[4] = std::byte{ 1 };
+    {
+        std::ofstream out(std::filesystem::u8path(dst_filename), std::ios::binary);
+        out.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+    }
+    {
+        FILE* src_file = boost::nowide::fopen(dst_filename.c_str(), "rb");
+        REQUIRE(src_file != nullptr);
+        ScopedFile scoped_src_file(src_file);
+        FILE* dst_file = boost::nowide::fopen(ascii_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        ScopedFile scoped_dst_file(dst_file);
+        REQUIRE(from_binary_to_ascii(*src_file, *dst_file, true) == EResult::InvalidGCodeEncodingType);
+    }
+
+    // transcoded files get the version of the new encoding
+    config.gcode_encoding = EGCodeEncodingType::Tokenized;
+    transcode(v1_filename, dst_filename, config, 2);
+    REQUIRE(read_version(dst_filename) == 2);
+    config.gcode_encoding = EGCodeEncodingType::MeatPackComments;
+    transcode(v2_filename, dst_filename, config, 2);
+    REQUIRE(read_version(dst_filename) == 1);
+
+    // concatenated files get the latest version
+    {
+        std::vector<FILE*> src_files = { boost::nowide::fopen(v1_filename.c_str(), "rb"), boost::nowide::fopen(v2_filename.c_str(), "rb") };
+        ScopedFile scoped_file1(src_files[0]);
+        ScopedFile scoped_file2(src_files[1]);
+        REQUIRE((src_files[0] != nullptr && src_files[1] != nullptr));
+        FILE* dst_file = boost::nowide::fopen(dst_filename.c_str(), "wb");
+        REQUIRE(dst_file != nullptr);
+        const EResult res = concatenate(src_files, *dst_file);
+        fclose(dst_file);
+        REQUIRE(res == EResult::Success);
+    }
+    REQUIRE(read_version(dst_filename) == 2);
+    binary_to_ascii(dst_filename, ascii_filename);
+
+    // appending tokenized gcode updates the version
+    {
+        FILE* file = boost::nowide::fopen(v1_filename.c_str(), "r+b");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        config.gcode_encoding = EGCodeEncodingType::Tokenized;
+        GCodeAppender appender;
+        REQUIRE(appender.open(*file, config) == EResult::Success);
+        REQUIRE(appender.append_gcode("G1 X10 Y10 E.5\n") == EResult::Success);
+        REQUIRE(appender.finalize() == EResult::Success);
+    }
+    REQUIRE(read_version(v1_filename) == 2);
+    binary_to_ascii(v1_filename, ascii_filename);
+}
+
+// Creates a directory of binary gcode files to catalog, copies_count copies of each test file
+static std::filesystem::path create_catalog_directory(const std::string& name, size_t copies_count)
+{
+    namespace fs = std::filesystem;
+    const fs::path data_dir = fs::u8path(TEST_DATA_DIR);
+    const fs::path dir = data_dir / name;
+    fs::remove_all(dir);
+    fs::create_directories(dir / "sub");
+    for (size_t i = 0; i < copies_count; ++i) {
+        const std::string suffix = std::to_string(i);
+        fs::copy_file(data_dir / "mini_cube_b.bgcode", dir / ("mini_cube_b_" + suffix + ".bgcode"));
+        fs::copy_file(data_dir / "mini_cube_ps2.8.1.bgcode", dir / "sub" / ("mini_cube_ps2.8.1_" + suffix + ".BGC"));
+    }
+    return dir;
+}
+
+TEST_CASE("Catalog", "[Convert]")
+{
+    std::cout << "\nTEST: Catalog\n";
+
+    namespace fs = std::filesystem;
+    const fs::path dir = create_catalog_directory("catalog", 2);
+    std::ofstream(dir / "broken.bgcode") << "not a binary gcode";
+    std::ofstream(dir / "ignored.gcode") << "G1 X10\n";
+    const std::string cache_filename = (dir / "catalog.cache").u8string();
+
+    CatalogConfig config;
+    config.jobs = 2;
+    config.verify_checksum = true;
+    Catalog catalog;
+    size_t rescanned_count = 0;
+    REQUIRE(catalog.scan(dir.u8string(), config, &rescanned_count) == EResult::Success);
+    REQUIRE(rescanned_count == 5);
+    REQUIRE(catalog.get_entries().size() == 5);
+
+    for (const CatalogEntry& entry : catalog.get_entries()) {
+        if (fs::u8path(entry.path).filename() == "broken.bgcode") {
+            REQUIRE(entry.result != EResult::Success);
+            continue;
+        }
+        REQUIRE(entry.result == EResult::Success);
+        REQUIRE(entry.file_size == fs::file_size(fs::u8path(entry.path)));
+        REQUIRE(entry.header_crc != 0);
+
+        // compare with the full metadata
+        FILE* file = boost::nowide::fopen(entry.path.c_str(), "rb");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        FileSummary summary;
+        REQUIRE(read_summary(*file, summary, true) == EResult::Success);
+        REQUIRE(entry.gcode_position == summary.gcode_position);
+        REQUIRE(entry.printer_metadata.size() == summary.printer_metadata.raw_data.size());
+        REQUIRE(entry.print_metadata.size() == summary.print_metadata.raw_data.size());
+        for (size_t i = 0; i < entry.print_metadata.size(); ++i) {
+            REQUIRE(entry.print_metadata[i].first == std::string_view(summary.print_metadata.raw_data[i].first));
+            REQUIRE(entry.print_metadata[i].second == std::string_view(summary.print_metadata.raw_data[i].second));
+        }
+
+        // the best thumbnail is the biggest png
+        REQUIRE(entry.thumbnail_position > 0);
+        for (const ThumbnailBlock& thumbnail : summary.thumbnails) {
+            REQUIRE((uint32_t)thumbnail.params.width * thumbnail.params.height <= (uint32_t)entry.thumbnail.width * entry.thumbnail.height);
+        }
+    }
+
+    // the cache restores the same entries, the rescan reads only the modified files
+    REQUIRE(catalog.save(cache_filename) == EResult::Success);
+    Catalog cached_catalog;
+    REQUIRE(cached_catalog.load(cache_filename) == EResult::Success);
+    REQUIRE(cached_catalog.get_entries().size() == catalog.get_entries().size());
+    for (size_t i = 0; i < catalog.get_entries().size(); ++i) {
+        const CatalogEntry& a = catalog.get_entries()[i];
+        const CatalogEntry& b = cached_catalog.get_entries()[i];
+        REQUIRE(a.path == b.path);
+        REQUIRE(a.result == b.result);
+        REQUIRE(a.header_crc == b.header_crc);
+        REQUIRE(a.checksum_verified == b.checksum_verified);
+        REQUIRE(a.printer_metadata == b.printer_metadata);
+        REQUIRE(a.print_metadata == b.print_metadata);
+        REQUIRE(a.thumbnail_position == b.thumbnail_position);
+        REQUIRE(a.gcode_position == b.gcode_position);
+    }
+
+    REQUIRE(cached_catalog.scan(dir.u8string(), config, &rescanned_count) == EResult::Success);
+    REQUIRE(rescanned_count == 0);
+
+    // a file rewritten keeping its size and modification time is detected by its header CRC
+    {
+        const fs::path path = dir / "mini_cube_b_0.bgcode";
+        const fs::file_time_type mtime = fs::last_write_time(path);
+        FILE* file = boost::nowide::fopen(path.u8string().c_str(), "r+b");
+        REQUIRE(file != nullptr);
+        ScopedFile scoped_file(file);
+        FileHeader file_header;
+        REQUIRE(read_header(*file, file_header, nullptr) == EResult::Success);
+        BlockHeader block_header;
+        REQUIRE(read_next_block_header(*file, file_header, block_header) == EResult::Success);
+        const long checksum_position = block_header.get_position() + (long)block_header.get_size() + (long)block_payload_size(block_header);
+        uint8_t byte;
+        REQUIRE(fseek(file, checksum_position, SEEK_SET) == 0);
+        REQUIRE(fread(&byte, 1, 1, file) == 1);
+        byte ^= 0xFF;
+        REQUIRE(fseek(file, checksum_position, SEEK_SET) == 0);
+        REQUIRE(fwrite(&byte, 1, 1, file) == 1);
+        REQUIRE(fflush(file) == 0);
+        fs::last_write_time(path, mtime);
+    }
+    REQUIRE(cached_catalog.scan(dir.u8string(), config, &rescanned_count) == EResult::Success);
+    REQUIRE(rescanned_count == 1);
+
+    // the entries read without checksum verification are read again when it is requested
+    {
+        CatalogConfig unverified_config = config;
+        unverified_config.verify_checksum = false;
+        Catalog unverified_catalog;
+        REQUIRE(unverified_catalog.scan(dir.u8string(), unverified_config, &rescanned_count) == EResult::Success);
+        REQUIRE(rescanned_count == 5);
+        REQUIRE(unverified_catalog.scan(dir.u8string(), unverified_config, &rescanned_count) == EResult::Success);
+        REQUIRE(rescanned_count == 0);
+        REQUIRE(unverified_catalog.scan(dir.u8string(), config, &rescanned_count) == EResult::Success);
+        REQUIRE(rescanned_count == 5);
+        REQUIRE(unverified_catalog.scan(dir.u8string(), unverified_config, &rescanned_count) == EResult::Success);
+        REQUIRE(rescanned_count == 0);
+    }
+
+    std::ofstream(dir / "broken.bgcode") << "still not a binary gcode";
+    fs::remove(dir / "sub" / "mini_cube_ps2.8.1_1.BGC");
+    REQUIRE(cached_catalog.scan(dir.u8string(), config, &rescanned_count) == EResult::Success);
+    REQUIRE(rescanned_count == 1);
+    REQUIRE(cached_catalog.get_entries().size() == 4);
+
+    // a non recursive scan ignores the subdirectories
+    config.recursive = false;
+    REQUIRE(cached_catalog.scan(dir.u8string(), config) == EResult::Success);
+    REQUIRE(cached_catalog.get_entries().size() == 3);
+
+    REQUIRE(cached_catalog.load((dir / "broken.bgcode").u8string()) == EResult::InvalidMagicNumber);
+    REQUIRE(cached_catalog.get_entries().empty());
+
+    // a corrupted string size is rejected before allocating it
+    {
+        std::vector<std::byte> data = read_file_data(cache_filename);
+        // magic, version, thumbnail format, entries count, size of the path of the first entry
+        const uint32_t size = 0xFFFFFFF0;
+        std::memcpy(data.data() + 14, &size, sizeof(size));
+        std::ofstream out(fs::u8path(cache_filename), std::ios::binary);
+        out.write(reinterpret_cast<const char*>(data.data()), (std::streamsize)data.size());
+    }
+    REQUIRE(cached_catalog.load(cache_filename) == EResult::ReadError);
+}
@@ -21,8 +21,9 @@ static std::string checksum_type_as_string(EChecksumType type)
 {
     switch (type)
     {
-    case EChecksumType::None:  { return "None"; }
-    case EChecksumType::CRC32: { return "CRC32"; }
+    case EChecksumType::None:   { return "None"; }
+    case EChecksumType::CRC32:  { return "CRC32"; }
+    case EChecksumType::CRC32C: { return "CRC32C"; }
     }
     return "";
 };
@@ -37,6 +38,8 @@ static std::string block_type_as_string(EBlockType type)
     case EBlockType::PrinterMetadata: { return "PrinterMetadata"; }
     case EBlockType::PrintMetadata:   { return "PrintMetadata"; }
     case EBlockType::Thumbnail:       { return "Thumbnail"; }
+    case EBlockType::Index:           { return "Index"; }
+    case EBlockType::HashTree:        { return "HashTree"; }
     }
     return "";
 };
@@ -49,6 +52,7 @@ static std::string compression_type_as_string(ECompressionType type)
     case ECompressionType::Deflate:         { return "Deflate"; }
     case ECompressionType::Heatshrink_11_4: { return "Heatshrink 11,4"; }
     case ECompressionType::Heatshrink_12_4: { return "Heatshrink 12,4"; }
+    case ECompressionType::DeflateDictionary: { return "Deflate with dictionary"; }
     }
     return "";
 };
@@ -70,6 +74,8 @@ static std::string gcode_encoding_as_string(EGCodeEncodingType type)
     case EGCodeEncodingType::None:             { return "None"; }
     case EGCodeEncodingType::MeatPack:         { return "MeatPack"; }
     case EGCodeEncodingType::MeatPackComments: { return "MeatPackComments"; }
+    case EGCodeEncodingType::Tokenized:        { return "Tokenized"; }
+    case EGCodeEncodingType::Columnar:         { return "Columnar"; }
     }
     return "";
 };